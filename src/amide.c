@@ -232,6 +232,7 @@ static void amide_class_init(AmideClass * class) {
   object_class->finalize = amide_finalize;
 }
 
+#ifndef AMIDE_BENCHMARK
 static Amide * amide_new(void) {
 
   Amide * app;
@@ -245,6 +246,7 @@ static Amide * amide_new(void) {
 
   return app;
 }
+#endif
 
 static void amide_finalize(GObject * obj) {
 
@@ -411,6 +413,9 @@ static void amide_startup(GApplication * gapp) {
   missing_functionality_warning(app->preferences);
 }
 
+/* amide_benchmark links in this file for the logging and shared
+   variables, but supplies its own main */
+#ifndef AMIDE_BENCHMARK
 static GOptionEntry command_line_entries[] = {
   //  { "verbose", 'v', 0, G_OPTION_ARG_NONE, &verbose, "Be verbose", NULL },
   { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &remaining_args, NULL, N_("[FILE1] [FILE2] ...") },
@@ -452,3 +457,4 @@ int main (int argc, char *argv []) {
 
   return status;
 }
+#endif
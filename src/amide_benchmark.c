@@ -0,0 +1,426 @@
+/* amide_benchmark.c
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+/* non-GUI benchmark of the core data set operations.  Synthetic data
+   sets are built in memory, and the timings are written out one
+   tab-separated line per operation, so the output can be compared
+   across builds.  Build with "make amide_benchmark". */
+
+#include "amide_config.h"
+#include <math.h>
+#include <stdio.h>
+#include <glib/gstdio.h>
+
+#include "amide.h"
+#include "amide_gconf.h"
+#include "amitk_common.h"
+#include "amitk_study.h"
+#include "analysis.h"
+#include "image.h"
+
+typedef struct _benchmark_t {
+  const gchar * format_name;
+  AmitkVoxel dim;
+  gint repeats;
+  FILE * output;
+} benchmark_t;
+
+typedef void (*benchmark_func_t)(gpointer data);
+
+
+static gchar * format_short_names[AMITK_FORMAT_NUM] = {
+  "ubyte",
+  "sbyte",
+  "ushort",
+  "sshort",
+  "uint",
+  "sint",
+  "float",
+  "double"
+};
+
+static gint size = 128;
+static gint slices = 0;
+static gint frames = 1;
+static gint repeats = 3;
+static gchar * formats = NULL;
+static gchar * output_filename = NULL;
+
+static GOptionEntry command_line_entries[] = {
+  { "size", 's', 0, G_OPTION_ARG_INT, &size, "Width and height of the data sets in voxels (default 128)", "N" },
+  { "slices", 'z', 0, G_OPTION_ARG_INT, &slices, "Number of slices (default same as size)", "N" },
+  { "frames", 't', 0, G_OPTION_ARG_INT, &frames, "Number of frames (default 1)", "N" },
+  { "repeat", 'r', 0, G_OPTION_ARG_INT, &repeats, "Number of timed runs per operation (default 3)", "N" },
+  { "formats", 'f', 0, G_OPTION_ARG_STRING, &formats, "Comma separated list of formats (ubyte,sbyte,ushort,sshort,uint,sint,float,double; default float)", "LIST" },
+  { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output_filename, "Write the results to this file instead of stdout", "FILE" },
+  { NULL }
+};
+
+
+/* fill the data set with a gaussian blob on a noisy background.  The
+   values stay between 0 and 127 so every format can hold them. */
+static void benchmark_fill(AmitkDataSet * ds) {
+
+  AmitkVoxel dim = AMITK_DATA_SET_DIM(ds);
+  AmitkVoxel i;
+  GRand * rand;
+  amide_real_t sigma2;
+  amide_real_t dx, dy, dz;
+  amide_data_t value;
+
+  rand = g_rand_new_with_seed(5);
+  sigma2 = 2.0*(dim.x/6.0)*(dim.x/6.0);
+
+  for (i.t=0; i.t < dim.t; i.t++)
+    for (i.g=0; i.g < dim.g; i.g++)
+      for (i.z=0; i.z < dim.z; i.z++) {
+	dz = i.z - dim.z/2.0;
+	for (i.y=0; i.y < dim.y; i.y++) {
+	  dy = i.y - dim.y/2.0;
+	  for (i.x=0; i.x < dim.x; i.x++) {
+	    dx = i.x - dim.x/2.0;
+	    value = 10.0 + 100.0*exp(-(dx*dx+dy*dy+dz*dz)/sigma2) +
+	      g_rand_double_range(rand, 0.0, 10.0);
+	    amitk_data_set_set_internal_value(ds, i, floor(value), FALSE);
+	  }
+	}
+      }
+
+  g_rand_free(rand);
+
+  return;
+}
+
+static AmitkDataSet * benchmark_data_set_new(AmitkPreferences * preferences,
+					     const AmitkFormat format,
+					     const AmitkVoxel dim) {
+
+  AmitkDataSet * ds;
+  gint t;
+
+  ds = amitk_data_set_new_with_data(preferences, AMITK_MODALITY_PET, format, dim,
+				    AMITK_SCALING_TYPE_0D);
+  if (ds == NULL) return NULL;
+
+  amitk_object_set_name(AMITK_OBJECT(ds), format_short_names[format]);
+  amitk_data_set_set_voxel_size(ds, one_point);
+  amitk_data_set_calc_far_corner(ds);
+  for (t=0; t < dim.t; t++)
+    amitk_data_set_set_frame_duration(ds, t, 60.0);
+
+  benchmark_fill(ds);
+
+  return ds;
+}
+
+/* runs the function the requested number of times, and writes out
+   the fastest and mean wall clock time */
+static void benchmark_run(benchmark_t * benchmark, const gchar * operation,
+			  benchmark_func_t func, gpointer data) {
+
+  gint i;
+  gint64 start;
+  gdouble elapsed;
+  gdouble min_time=G_MAXDOUBLE;
+  gdouble total_time=0.0;
+
+  for (i=0; i < benchmark->repeats; i++) {
+    start = g_get_monotonic_time();
+    (*func)(data);
+    elapsed = (g_get_monotonic_time()-start)/((gdouble) G_USEC_PER_SEC);
+    if (elapsed < min_time) min_time = elapsed;
+    total_time += elapsed;
+  }
+
+  fprintf(benchmark->output, "%s\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%.6f\t%.6f\n",
+	  operation, benchmark->format_name,
+	  benchmark->dim.x, benchmark->dim.y, benchmark->dim.z, benchmark->dim.t,
+	  amitk_get_num_threads(), benchmark->repeats,
+	  min_time, total_time/benchmark->repeats);
+  fflush(benchmark->output);
+
+  return;
+}
+
+
+
+/* the individual operations */
+typedef struct _benchmark_data_t {
+  AmitkStudy * study;
+  AmitkDataSet * ds;
+  AmitkRoi * roi;
+  AmitkVolume * view_volume;
+  amide_time_t duration;
+  gchar * xif_filename;
+} benchmark_data_t;
+
+static void benchmark_get_slices(gpointer data) {
+  benchmark_data_t * bd = data;
+  GList * objects;
+  GList * slices;
+  AmitkCanvasPoint pixel_size;
+
+  pixel_size.x = pixel_size.y = 1.0;
+  objects = g_list_append(NULL, bd->ds);
+  slices = amitk_data_sets_get_slices(objects, NULL, 0, 0.0, bd->duration,
+				      AMITK_DATA_SET_VIEW_START_GATE(bd->ds),
+				      pixel_size, bd->view_volume);
+  amitk_objects_unref(slices);
+  g_list_free(objects);
+}
+
+static void benchmark_calc_min_max(gpointer data) {
+  benchmark_data_t * bd = data;
+  amitk_data_set_calc_min_max(bd->ds, NULL, NULL);
+}
+
+static void benchmark_calc_distribution(gpointer data) {
+  benchmark_data_t * bd = data;
+  amitk_data_set_set_distribution(bd->ds, NULL);
+  amitk_data_set_calc_distribution(bd->ds, NULL, NULL);
+}
+
+static void benchmark_filter_median(gpointer data) {
+  benchmark_data_t * bd = data;
+  AmitkDataSet * filtered;
+
+  filtered = amitk_data_set_get_filtered(bd->ds, AMITK_FILTER_MEDIAN_LINEAR, 3, 0.0, NULL, NULL);
+  if (filtered != NULL) amitk_object_unref(filtered);
+}
+
+#ifdef AMIDE_LIBGSL_SUPPORT
+static void benchmark_filter_gaussian(gpointer data) {
+  benchmark_data_t * bd = data;
+  AmitkDataSet * filtered;
+
+  filtered = amitk_data_set_get_filtered(bd->ds, AMITK_FILTER_GAUSSIAN, 7, 2.0, NULL, NULL);
+  if (filtered != NULL) amitk_object_unref(filtered);
+}
+#endif
+
+static void benchmark_roi_statistics_cached(gpointer data) {
+  benchmark_data_t * bd = data;
+  GList * rois;
+  GList * data_sets;
+  analysis_roi_t * analysis;
+
+  rois = g_list_append(NULL, bd->roi);
+  data_sets = g_list_append(NULL, bd->ds);
+  analysis = analysis_roi_init(bd->study, rois, data_sets, ALL_VOXELS, FALSE, 0.0, 0.0, 0.0);
+  if (analysis != NULL) analysis_roi_unref(analysis);
+  g_list_free(data_sets);
+  g_list_free(rois);
+}
+
+/* the roi caches its voxel mask for the data set, drop it so every
+   repeat pays for working out which voxels are in the roi */
+static void benchmark_roi_statistics(gpointer data) {
+  benchmark_data_t * bd = data;
+
+  g_signal_emit_by_name(G_OBJECT(bd->roi), "roi_changed");
+  benchmark_roi_statistics_cached(data);
+}
+
+static void benchmark_image_from_data_sets(gpointer data) {
+  benchmark_data_t * bd = data;
+  GList * objects;
+  GdkPixbuf * pixbuf;
+
+  objects = g_list_append(NULL, bd->ds);
+  pixbuf = image_from_data_sets(NULL, NULL, 0, objects, bd->ds,
+				0.0, bd->duration, AMITK_DATA_SET_VIEW_START_GATE(bd->ds),
+				1.0, bd->view_volume,
+				AMITK_FUSE_TYPE_BLEND, AMITK_VIEW_MODE_SINGLE);
+  if (pixbuf != NULL) g_object_unref(pixbuf);
+  g_list_free(objects);
+}
+
+/* always a full save, otherwise repeats would just append onto the last
+   save's file without writing out the raw data again */
+static void benchmark_xif_save(gpointer data) {
+  benchmark_data_t * bd = data;
+  g_unlink(bd->xif_filename);
+  if (!amitk_study_save_xml(bd->study, bd->xif_filename, FALSE))
+    g_warning("failed to save %s", bd->xif_filename);
+}
+
+static void benchmark_xif_load(gpointer data) {
+  benchmark_data_t * bd = data;
+  AmitkStudy * study;
+
+  study = amitk_study_load_xml(bd->xif_filename);
+  if (study == NULL)
+    g_warning("failed to load %s", bd->xif_filename);
+  else
+    amitk_object_unref(study);
+}
+
+
+
+static void benchmark_format(benchmark_t * benchmark,
+			     AmitkPreferences * preferences,
+			     const AmitkFormat format,
+			     const gchar * temp_dir) {
+
+  benchmark_data_t bd;
+  AmitkPoint corner;
+  AmitkPoint view_corner;
+  AmitkPoint view_offset;
+  gchar * temp_string;
+
+  bd.ds = benchmark_data_set_new(preferences, format, benchmark->dim);
+  if (bd.ds == NULL) {
+    g_warning("couldn't allocate a %s data set", format_short_names[format]);
+    return;
+  }
+  bd.duration = amitk_data_set_get_frame_duration(bd.ds, 0);
+
+  bd.study = amitk_study_new(preferences);
+  amitk_object_set_name(AMITK_OBJECT(bd.study), "benchmark");
+  amitk_object_add_child(AMITK_OBJECT(bd.study), AMITK_OBJECT(bd.ds));
+
+  /* an ellipsoid covering the middle half of the data set */
+  corner = AMITK_VOLUME_CORNER(bd.ds);
+  bd.roi = amitk_roi_new(AMITK_ROI_TYPE_ELLIPSOID);
+  amitk_object_set_name(AMITK_OBJECT(bd.roi), "benchmark");
+  amitk_volume_set_corner(AMITK_VOLUME(bd.roi), point_cmult(0.5, corner));
+  amitk_space_set_offset(AMITK_SPACE(bd.roi), point_cmult(0.25, corner));
+  amitk_object_add_child(AMITK_OBJECT(bd.study), AMITK_OBJECT(bd.roi));
+
+  /* a one voxel thick transverse slice through the middle */
+  bd.view_volume = amitk_volume_new();
+  view_corner = corner;
+  view_corner.z = 1.0;
+  amitk_volume_set_corner(bd.view_volume, view_corner);
+  view_offset = zero_point;
+  view_offset.z = floor(corner.z/2.0);
+  amitk_space_set_offset(AMITK_SPACE(bd.view_volume), view_offset);
+
+  temp_string = g_strdup_printf("benchmark_%s.xif", format_short_names[format]);
+  bd.xif_filename = g_build_filename(temp_dir, temp_string, NULL);
+  g_free(temp_string);
+
+  benchmark->format_name = format_short_names[format];
+  benchmark_run(benchmark, "calc_min_max", benchmark_calc_min_max, &bd);
+  benchmark_run(benchmark, "calc_distribution", benchmark_calc_distribution, &bd);
+  benchmark_run(benchmark, "get_slices", benchmark_get_slices, &bd);
+  benchmark_run(benchmark, "image_from_data_sets", benchmark_image_from_data_sets, &bd);
+  benchmark_run(benchmark, "filter_median_linear", benchmark_filter_median, &bd);
+#ifdef AMIDE_LIBGSL_SUPPORT
+  benchmark_run(benchmark, "filter_gaussian", benchmark_filter_gaussian, &bd);
+#endif
+  benchmark_run(benchmark, "roi_statistics", benchmark_roi_statistics, &bd);
+  benchmark_run(benchmark, "roi_statistics_cached", benchmark_roi_statistics_cached, &bd);
+  benchmark_run(benchmark, "xif_save", benchmark_xif_save, &bd);
+  benchmark_run(benchmark, "xif_load", benchmark_xif_load, &bd);
+
+  g_unlink(bd.xif_filename);
+  g_free(bd.xif_filename);
+  amitk_object_unref(bd.view_volume);
+  amitk_object_unref(bd.roi);
+  amitk_object_unref(bd.ds);
+  amitk_object_unref(bd.study);
+
+  return;
+}
+
+
+int main (int argc, char *argv []) {
+
+  GOptionContext * context;
+  GError * error=NULL;
+  AmitkPreferences * preferences;
+  benchmark_t benchmark;
+  gchar ** format_list;
+  gchar * temp_dir;
+  AmitkFormat format;
+  gboolean found;
+  gint i;
+
+  context = g_option_context_new("- benchmark amide's data set operations");
+  g_option_context_add_main_entries(context, command_line_entries, GETTEXT_PACKAGE);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  if ((size < 1) || (frames < 1) || (repeats < 1) || (slices < 0)) {
+    g_printerr("size, frames and repeat must be positive\n");
+    return 1;
+  }
+
+  benchmark.dim.x = benchmark.dim.y = size;
+  benchmark.dim.z = (slices > 0) ? slices : size;
+  benchmark.dim.g = 1;
+  benchmark.dim.t = frames;
+  benchmark.repeats = repeats;
+  benchmark.format_name = NULL;
+
+  if (output_filename != NULL) {
+    benchmark.output = fopen(output_filename, "w");
+    if (benchmark.output == NULL) {
+      g_printerr("couldn't open %s for writing\n", output_filename);
+      return 1;
+    }
+  } else {
+    benchmark.output = stdout;
+  }
+
+  temp_dir = g_dir_make_tmp("amide_benchmark_XXXXXX", &error);
+  if (temp_dir == NULL) {
+    g_printerr("%s\n", error->message);
+    g_error_free(error);
+    return 1;
+  }
+
+  amide_gconf_init();
+  preferences = amitk_preferences_new();
+
+  fprintf(benchmark.output, "operation\tformat\tx\ty\tz\tframes\tthreads\trepeat\tmin_seconds\tmean_seconds\n");
+
+  format_list = g_strsplit((formats != NULL) ? formats : "float", ",", -1);
+  for (i=0; format_list[i] != NULL; i++) {
+    found = FALSE;
+    for (format=0; format < AMITK_FORMAT_NUM; format++)
+      if (g_ascii_strcasecmp(g_strstrip(format_list[i]), format_short_names[format]) == 0) {
+	benchmark_format(&benchmark, preferences, format, temp_dir);
+	found = TRUE;
+      }
+    if (!found)
+      g_printerr("unknown format %s\n", format_list[i]);
+  }
+  g_strfreev(format_list);
+
+  g_rmdir(temp_dir);
+  g_free(temp_dir);
+  g_object_unref(preferences);
+  amide_gconf_shutdown();
+
+  if (benchmark.output != stdout)
+    fclose(benchmark.output);
+
+  return 0;
+}
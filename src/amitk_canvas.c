@@ -54,6 +54,8 @@
 #define UPDATE_SUBJECT_ORIENTATION 0x200
 #define UPDATE_ALL 0x2FF
 
+#define CANVAS_TILE_SIZE 64 /* in pixels */
+
 #define cp_2_p(canvas, canvas_cpoint) (canvas_point_2_point(AMITK_VOLUME_CORNER((canvas)->volume),\
 							    (canvas)->pixbuf_width, \
 							    (canvas)->pixbuf_height,\
@@ -196,6 +198,10 @@ static void canvas_update_arrows(AmitkCanvas * canvas);
 static void canvas_update_line_profile(AmitkCanvas * canvas);
 static void canvas_update_time_on_image(AmitkCanvas * canvas);
 static void canvas_update_subject_orientation(AmitkCanvas * canvas);
+static void canvas_invalidate_tiles(AmitkCanvas * canvas);
+static void canvas_set_tiles(AmitkCanvas * canvas, gboolean valid);
+static gboolean canvas_pan_pixbuf(AmitkCanvas * canvas, GList * data_sets, 
+				  AmitkDataSet * active_ds, amide_real_t pixel_dim);
 static void canvas_update_pixbuf(AmitkCanvas * canvas);
 static void canvas_update_object(AmitkCanvas * canvas, AmitkObject * object);
 static void canvas_update_objects(AmitkCanvas * canvas, gboolean all);
@@ -334,6 +340,11 @@ static void canvas_init (AmitkCanvas *canvas)
   canvas->slices=NULL;
   canvas->image=NULL;
   canvas->pixbuf=NULL;
+  canvas->pixbuf_volume=NULL;
+  canvas->pixbuf_pixel_dim=0.0;
+  canvas->tile_valid=NULL;
+  canvas->tile_columns=0;
+  canvas->tile_rows=0;
 
   canvas->time_on_image=FALSE;
   canvas->time_label=NULL;
@@ -385,6 +396,14 @@ static void canvas_destroy (GtkWidget * object) {
     canvas->pixbuf = NULL;
   }
 
+  if (canvas->pixbuf_volume != NULL)
+    canvas->pixbuf_volume = amitk_object_unref(canvas->pixbuf_volume);
+
+  if (canvas->tile_valid != NULL) {
+    g_free(canvas->tile_valid);
+    canvas->tile_valid = NULL;
+  }
+
   if (canvas->undrawn_rois != NULL) {
     canvas->undrawn_rois = amitk_objects_unref(canvas->undrawn_rois);
   }
@@ -598,6 +617,7 @@ static void canvas_line_profile_changed_cb(AmitkLineProfile * line_profile, gpoi
 
 static void canvas_study_changed_cb(AmitkStudy * study, gpointer data) {
   AmitkCanvas * canvas = data;
+  canvas_invalidate_tiles(canvas); /* fuse type */
   canvas_add_update(canvas, UPDATE_ALL);
   return;
 }
@@ -669,6 +689,7 @@ static void canvas_data_set_invalidate_slice_cache(AmitkDataSet * ds, gpointer d
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
 
   canvas->slice_cache = amitk_data_sets_remove_with_slice_parent(canvas->slice_cache, ds);
+  canvas_invalidate_tiles(canvas);
 
 }
 
@@ -703,6 +724,7 @@ static void data_set_thresholding_changed_cb(AmitkDataSet * ds, gpointer data) {
 
   g_return_if_fail(AMITK_IS_CANVAS(canvas));
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  canvas_invalidate_tiles(canvas);
   canvas_add_update(canvas, UPDATE_DATA_SETS);
 }
 
@@ -714,6 +736,7 @@ static void data_set_color_table_changed_cb(AmitkDataSet * ds, AmitkViewMode vie
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
 
   if (view_mode == AMITK_CANVAS_VIEW_MODE(canvas)) {
+    canvas_invalidate_tiles(canvas);
     canvas_add_update(canvas, UPDATE_DATA_SETS);
     canvas_add_update(canvas, UPDATE_OBJECTS);
   }
@@ -2492,10 +2515,39 @@ static void canvas_scrollbar_adjustment_cb(GtkAdjustment * adjustment, gpointer
 }
 
 
+/* keep in plane pans on the pixel grid of the current pixbuf, so that
+   the pixbuf can be shifted instead of regenerated.  Returns TRUE if the
+   volume was snapped. */
+static gboolean canvas_snap_to_pixbuf(AmitkCanvas * canvas) {
+
+  amide_real_t pixel_dim;
+  AmitkPoint shift;
+
+  if (canvas->pixbuf_volume == NULL) return FALSE;
+
+  pixel_dim = (1/AMITK_STUDY_ZOOM(canvas->study))*AMITK_STUDY_VOXEL_DIM(canvas->study); 
+  if (!REAL_EQUAL(pixel_dim, canvas->pixbuf_pixel_dim)) return FALSE;
+  if (!amitk_space_axes_equal(AMITK_SPACE(canvas->volume), AMITK_SPACE(canvas->pixbuf_volume))) return FALSE;
+  if (!POINT_EQUAL(AMITK_VOLUME_CORNER(canvas->volume), AMITK_VOLUME_CORNER(canvas->pixbuf_volume))) return FALSE;
+
+  shift = amitk_space_b2s(AMITK_SPACE(canvas->pixbuf_volume), AMITK_SPACE_OFFSET(canvas->volume));
+  if (fabs(shift.z) > EPSILON*AMITK_VOLUME_Z_CORNER(canvas->volume)) return FALSE;
+
+  shift.x = pixel_dim*rint(shift.x/pixel_dim);
+  shift.y = pixel_dim*rint(shift.y/pixel_dim);
+  shift.z = 0.0;
+  amitk_space_set_offset(AMITK_SPACE(canvas->volume), 
+			 amitk_space_s2b(AMITK_SPACE(canvas->pixbuf_volume), shift));
+
+  return TRUE;
+}
+
 static gboolean canvas_recalc_corners(AmitkCanvas * canvas) {
 
   GList * volumes;
   gboolean changed;
+  AmitkPoint old_offset;
+  AmitkPoint old_corner;
 
   /* sanity checks */
   if (canvas->study == NULL) return FALSE; 
@@ -2512,6 +2564,8 @@ static gboolean canvas_recalc_corners(AmitkCanvas * canvas) {
 							 TRUE);
   }
 
+  old_offset = AMITK_SPACE_OFFSET(canvas->volume);
+  old_corner = AMITK_VOLUME_CORNER(canvas->volume);
   changed = amitk_volumes_calc_display_volume(volumes, 
 					      AMITK_SPACE(canvas->volume), 
 					      canvas->center, 
@@ -2520,6 +2574,12 @@ static gboolean canvas_recalc_corners(AmitkCanvas * canvas) {
 					      canvas->volume);
   amitk_objects_unref(volumes);
 
+  /* a pan of less than half a pixel snaps back to where we were */
+  if (changed && canvas_snap_to_pixbuf(canvas))
+    if (POINT_EQUAL(old_offset, AMITK_SPACE_OFFSET(canvas->volume)) &&
+	POINT_EQUAL(old_corner, AMITK_VOLUME_CORNER(canvas->volume)))
+      changed = FALSE;
+
   return changed;
 }
 
@@ -3258,6 +3318,210 @@ static void canvas_update_subject_orientation(AmitkCanvas * canvas) {
 
 
 
+/* marks every tile of the pixbuf as needing to be recomposited */
+static void canvas_invalidate_tiles(AmitkCanvas * canvas) {
+
+  gint i;
+
+  if (canvas->tile_valid == NULL) return;
+
+  for (i=0; i < canvas->tile_columns*canvas->tile_rows; i++)
+    canvas->tile_valid[i] = FALSE;
+
+  return;
+}
+
+/* sizes the tile grid to the current pixbuf */
+static void canvas_set_tiles(AmitkCanvas * canvas, gboolean valid) {
+
+  gint columns, rows;
+  gint i;
+
+  if (canvas->pixbuf == NULL) {
+    columns = rows = 0;
+  } else {
+    columns = (gdk_pixbuf_get_width(canvas->pixbuf)+CANVAS_TILE_SIZE-1)/CANVAS_TILE_SIZE;
+    rows = (gdk_pixbuf_get_height(canvas->pixbuf)+CANVAS_TILE_SIZE-1)/CANVAS_TILE_SIZE;
+  }
+
+  if ((columns != canvas->tile_columns) || (rows != canvas->tile_rows)) {
+    g_free(canvas->tile_valid);
+    canvas->tile_valid = (columns*rows > 0) ? g_new(gboolean, columns*rows) : NULL;
+    canvas->tile_columns = columns;
+    canvas->tile_rows = rows;
+  }
+
+  for (i=0; i < columns*rows; i++)
+    canvas->tile_valid[i] = valid;
+
+  return;
+}
+
+/* if the only thing that's changed since the pixbuf was generated is an in
+   plane pan by a whole number of pixels, shift the old pixbuf and slices over,
+   reslice just the strips that came into view, and recomposite just the
+   tiles that aren't valid.  Returns FALSE if the pixbuf needs to be
+   regenerated from scratch. */
+static gboolean canvas_pan_pixbuf(AmitkCanvas * canvas, GList * data_sets, 
+				  AmitkDataSet * active_ds, amide_real_t pixel_dim) {
+
+  AmitkPoint shift;
+  AmitkCanvasPoint pixel_size;
+  amide_intpoint_t shift_x, shift_y;
+  amide_data_t old_min, old_max, new_min, new_max;
+  GList * slices=NULL;
+  GList * old_slices;
+  GList * last;
+  AmitkDataSet * old_slice;
+  AmitkDataSet * slice;
+  GdkPixbuf * pixbuf;
+  gboolean * tile_valid;
+  gboolean thresholds_changed=FALSE;
+  gint width, height;
+  gint keep_x, keep_y, keep_width, keep_height;
+  gint i_column, i_row, j_column, j_row, end_column;
+  gint x0, y0, x1, y1;
+  gboolean valid;
+
+  if ((canvas->pixbuf == NULL) || (canvas->slices == NULL) || 
+      (canvas->pixbuf_volume == NULL) || (canvas->tile_valid == NULL))
+    return FALSE;
+  if (!REAL_EQUAL(pixel_dim, canvas->pixbuf_pixel_dim)) return FALSE;
+  if (!amitk_space_axes_equal(AMITK_SPACE(canvas->volume), AMITK_SPACE(canvas->pixbuf_volume))) return FALSE;
+  if (!POINT_EQUAL(AMITK_VOLUME_CORNER(canvas->volume), AMITK_VOLUME_CORNER(canvas->pixbuf_volume))) return FALSE;
+  if (g_list_length(data_sets) != g_list_length(canvas->slices)) return FALSE;
+
+  shift = amitk_space_b2s(AMITK_SPACE(canvas->pixbuf_volume), AMITK_SPACE_OFFSET(canvas->volume));
+  shift_x = rint(shift.x/pixel_dim);
+  shift_y = rint(shift.y/pixel_dim);
+
+  /* get the shifted slices */
+  pixel_size.x = pixel_size.y = pixel_dim;
+  for (old_slices = canvas->slices; old_slices != NULL; old_slices = old_slices->next) {
+    old_slice = old_slices->data;
+
+    /* slices of data sets that have changed get pulled out of the slice cache */
+    if ((g_list_index(canvas->slice_cache, old_slice) < 0) ||
+	(g_list_index(data_sets, AMITK_DATA_SET_SLICE_PARENT(old_slice)) < 0)) {
+      amitk_objects_unref(slices);
+      return FALSE;
+    }
+
+    slice = amitk_data_set_get_shifted_slice(old_slice,
+					     AMITK_STUDY_VIEW_START_TIME(canvas->study),
+					     AMITK_STUDY_VIEW_DURATION(canvas->study),
+					     -1, pixel_size, canvas->volume, shift_x, shift_y);
+    if (slice == NULL) {
+      amitk_objects_unref(slices);
+      return FALSE;
+    }
+    slices = g_list_append(slices, slice);
+
+    /* per slice thresholds shift with the slice's contents */
+    if (AMITK_DATA_SET_THRESHOLDING(AMITK_DATA_SET_SLICE_PARENT(slice)) == AMITK_THRESHOLDING_PER_SLICE) {
+      amitk_data_set_get_thresholding_min_max(AMITK_DATA_SET_SLICE_PARENT(old_slice), old_slice,
+					      AMITK_STUDY_VIEW_START_TIME(canvas->study),
+					      AMITK_STUDY_VIEW_DURATION(canvas->study),
+					      &old_min, &old_max);
+      amitk_data_set_get_thresholding_min_max(AMITK_DATA_SET_SLICE_PARENT(slice), slice,
+					      AMITK_STUDY_VIEW_START_TIME(canvas->study),
+					      AMITK_STUDY_VIEW_DURATION(canvas->study),
+					      &new_min, &new_max);
+      if (!REAL_EQUAL(old_min, new_min) || !REAL_EQUAL(old_max, new_max))
+	thresholds_changed = TRUE;
+    }
+  }
+
+  /* move the old image over, pixbuf rows run the opposite way to slice y */
+  width = gdk_pixbuf_get_width(canvas->pixbuf);
+  height = gdk_pixbuf_get_height(canvas->pixbuf);
+  pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, width, height);
+  if (pixbuf == NULL) {
+    amitk_objects_unref(slices);
+    return FALSE;
+  }
+
+  keep_x = MAX(0, -shift_x);
+  keep_y = MAX(0, shift_y);
+  keep_width = width-ABS(shift_x);
+  keep_height = height-ABS(shift_y);
+  gdk_pixbuf_copy_area(canvas->pixbuf, keep_x+shift_x, keep_y-shift_y, keep_width, keep_height,
+		       pixbuf, keep_x, keep_y);
+
+  /* a tile is still valid if it was entirely covered by valid tiles of the old image */
+  tile_valid = g_new(gboolean, canvas->tile_columns*canvas->tile_rows);
+  for (i_row=0; i_row < canvas->tile_rows; i_row++) {
+    for (i_column=0; i_column < canvas->tile_columns; i_column++) {
+      x0 = i_column*CANVAS_TILE_SIZE;
+      y0 = i_row*CANVAS_TILE_SIZE;
+      x1 = MIN(x0+CANVAS_TILE_SIZE, width);
+      y1 = MIN(y0+CANVAS_TILE_SIZE, height);
+
+      valid = !thresholds_changed && 
+	(x0 >= keep_x) && (x1 <= keep_x+keep_width) &&
+	(y0 >= keep_y) && (y1 <= keep_y+keep_height);
+
+      /* where this tile came from in the old image */
+      x0 += shift_x; x1 += shift_x;
+      y0 -= shift_y; y1 -= shift_y;
+      for (j_row = y0/CANVAS_TILE_SIZE; valid && (j_row <= (y1-1)/CANVAS_TILE_SIZE); j_row++)
+	for (j_column = x0/CANVAS_TILE_SIZE; valid && (j_column <= (x1-1)/CANVAS_TILE_SIZE); j_column++)
+	  valid = canvas->tile_valid[j_row*canvas->tile_columns+j_column];
+
+      tile_valid[i_row*canvas->tile_columns+i_column] = valid;
+    }
+  }
+  g_free(canvas->tile_valid);
+  canvas->tile_valid = tile_valid;
+
+  /* recomposite the invalid tiles, a row of tiles at a time */
+  for (i_row=0; i_row < canvas->tile_rows; i_row++) {
+    i_column = 0;
+    while (i_column < canvas->tile_columns) {
+      if (canvas->tile_valid[i_row*canvas->tile_columns+i_column]) {
+	i_column++;
+      } else {
+	end_column = i_column;
+	while ((end_column < canvas->tile_columns) && 
+	       !canvas->tile_valid[i_row*canvas->tile_columns+end_column]) {
+	  canvas->tile_valid[i_row*canvas->tile_columns+end_column] = TRUE;
+	  end_column++;
+	}
+	x0 = i_column*CANVAS_TILE_SIZE;
+	y0 = i_row*CANVAS_TILE_SIZE;
+	image_composite_slices(pixbuf, slices, active_ds,
+			       AMITK_STUDY_VIEW_START_TIME(canvas->study),
+			       AMITK_STUDY_VIEW_DURATION(canvas->study),
+			       AMITK_STUDY_FUSE_TYPE(canvas->study),
+			       AMITK_CANVAS_VIEW_MODE(canvas),
+			       x0, y0, 
+			       MIN(end_column*CANVAS_TILE_SIZE, width)-x0,
+			       MIN(y0+CANVAS_TILE_SIZE, height)-y0);
+	i_column = end_column;
+      }
+    }
+  }
+
+  /* the new slices go in the slice cache, same as resliced ones would */
+  for (old_slices = slices; old_slices != NULL; old_slices = old_slices->next)
+    if (g_list_index(canvas->slice_cache, old_slices->data) < 0)
+      canvas->slice_cache = g_list_prepend(canvas->slice_cache, amitk_object_ref(old_slices->data));
+  while (g_list_length(canvas->slice_cache) > canvas->max_slice_cache_size) {
+    last = g_list_last(canvas->slice_cache);
+    canvas->slice_cache = g_list_remove_link(canvas->slice_cache, last);
+    amitk_objects_unref(last);
+  }
+
+  amitk_objects_unref(canvas->slices);
+  canvas->slices = slices;
+  g_object_unref(canvas->pixbuf);
+  canvas->pixbuf = pixbuf;
+
+  return TRUE;
+}
+
+
+
 static void canvas_update_pixbuf(AmitkCanvas * canvas) {
 
   gint old_width, old_height;
@@ -3279,12 +3543,6 @@ static void canvas_update_pixbuf(AmitkCanvas * canvas) {
   old_width = canvas->pixbuf_width;
   old_height = canvas->pixbuf_height;
 
-  /* free the previous pixbuf if possible */
-  if (canvas->pixbuf != NULL) {
-    g_object_unref(canvas->pixbuf);
-    canvas->pixbuf = NULL;
-  }
-
   /* compensate for zoom */
   pixel_dim = (1/AMITK_STUDY_ZOOM(canvas->study))*AMITK_STUDY_VOXEL_DIM(canvas->study); 
 
@@ -3321,28 +3579,46 @@ static void canvas_update_pixbuf(AmitkCanvas * canvas) {
     height =  ceil(corner.y/pixel_dim);
     if (height < 1) height = 1;
 				 
+    if (canvas->pixbuf != NULL) 
+      g_object_unref(canvas->pixbuf);
     canvas->pixbuf = image_blank(width, height,blank_rgba);
     amitk_objects_unref(canvas->slices);
     canvas->slices = NULL;
 
+    if (canvas->pixbuf_volume != NULL)
+      canvas->pixbuf_volume = amitk_object_unref(canvas->pixbuf_volume);
+    canvas_set_tiles(canvas, FALSE);
+
   } else {
     if (AMITK_IS_DATA_SET(canvas->active_object))
       active_ds = AMITK_DATA_SET(canvas->active_object);
     else
       active_ds = NULL;
-    canvas->pixbuf = image_from_data_sets(&(canvas->slices),
-					  &(canvas->slice_cache),
-					  canvas->max_slice_cache_size,
-					  data_sets,
-					  active_ds,
-					  AMITK_STUDY_VIEW_START_TIME(canvas->study),
-					  AMITK_STUDY_VIEW_DURATION(canvas->study),
-					  -1,
-					  pixel_dim,
-					  canvas->volume,
-					  AMITK_STUDY_FUSE_TYPE(canvas->study),
-					  AMITK_CANVAS_VIEW_MODE(canvas));
+
+    if (!canvas_pan_pixbuf(canvas, data_sets, active_ds, pixel_dim)) {
+      if (canvas->pixbuf != NULL) 
+	g_object_unref(canvas->pixbuf);
+      canvas->pixbuf = image_from_data_sets(&(canvas->slices),
+					    &(canvas->slice_cache),
+					    canvas->max_slice_cache_size,
+					    data_sets,
+					    active_ds,
+					    AMITK_STUDY_VIEW_START_TIME(canvas->study),
+					    AMITK_STUDY_VIEW_DURATION(canvas->study),
+					    -1,
+					    pixel_dim,
+					    canvas->volume,
+					    AMITK_STUDY_FUSE_TYPE(canvas->study),
+					    AMITK_CANVAS_VIEW_MODE(canvas));
+      canvas_set_tiles(canvas, TRUE);
+    }
     amitk_objects_unref(data_sets);
+
+    /* remember what the pixbuf shows, so later pans can reuse it */
+    if (canvas->pixbuf_volume != NULL)
+      amitk_object_unref(canvas->pixbuf_volume);
+    canvas->pixbuf_volume = AMITK_VOLUME(amitk_object_copy(AMITK_OBJECT(canvas->volume)));
+    canvas->pixbuf_pixel_dim = pixel_dim;
   }
 
   if (canvas->pixbuf != NULL) {
@@ -3663,6 +3939,7 @@ static void canvas_add_object(AmitkCanvas * canvas, AmitkObject * object) {
     g_signal_connect(G_OBJECT(object), "thresholding_changed", G_CALLBACK(data_set_thresholding_changed_cb), canvas);
     g_signal_connect(G_OBJECT(object), "thresholds_changed", G_CALLBACK(data_set_thresholding_changed_cb), canvas);
     g_signal_connect(G_OBJECT(object), "color_table_changed", G_CALLBACK(data_set_color_table_changed_cb), canvas);
+    g_signal_connect(G_OBJECT(object), "color_table_independent_changed", G_CALLBACK(data_set_color_table_changed_cb), canvas);
     g_signal_connect(G_OBJECT(object), "subject_orientation_changed", G_CALLBACK(data_set_subject_orientation_changed_cb), canvas);
     g_signal_connect(G_OBJECT(object), "view_gates_changed", G_CALLBACK(data_set_changed_cb), canvas);
   }
@@ -3816,6 +4093,7 @@ void amitk_canvas_set_active_object(AmitkCanvas * canvas,
 
   if (canvas->active_object != active_object) {
     canvas->active_object = active_object;
+    canvas_invalidate_tiles(canvas);
     if (AMITK_STUDY_FUSE_TYPE(canvas->study) == AMITK_FUSE_TYPE_BLEND) {
       canvas_add_update(canvas, UPDATE_OBJECTS);
     } else /* AMITK_FUSE_TYPE_OVERLAY */
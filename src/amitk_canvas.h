@@ -84,6 +84,10 @@ struct _AmitkCanvas
   gdouble border_width;
   AmitkCanvasItem * image;
   GdkPixbuf * pixbuf;
+  AmitkVolume * pixbuf_volume; /* the volume the pixbuf was generated for */
+  amide_real_t pixbuf_pixel_dim;
+  gboolean * tile_valid; /* which tiles of the pixbuf are up to date */
+  gint tile_columns, tile_rows;
 
   gboolean time_on_image;
   AmitkCanvasItem * time_label;
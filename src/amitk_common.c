@@ -321,6 +321,87 @@ gboolean amitk_is_xif_flat_file(const gchar * filename, guint64 * plocation_le,
 }
 
 
+/* how many threads to split work over, one per processor */
+guint amitk_get_num_threads(void) {
+
+  static guint num_threads = 0;
+
+  if (num_threads == 0)
+    num_threads = CLAMP(g_get_num_processors(), 1, AMITK_MAX_THREADS);
+
+  return num_threads;
+}
+
+typedef struct {
+  AmitkParallelFunc func;
+  gpointer data;
+  guint64 start;
+  guint64 end;
+} parallel_chunk_t;
+
+static gpointer parallel_chunk_thread(gpointer data) {
+
+  parallel_chunk_t * chunk = data;
+
+  (*chunk->func)(chunk->start, chunk->end, chunk->data);
+
+  return NULL;
+}
+
+/* splits the items [0, num_items) into contiguous chunks and runs func over
+   them in parallel, returning once all the chunks are done.  The calling
+   thread does the first chunk itself.  Chunks are never smaller than
+   min_items_per_thread, so small jobs just get run in the calling thread.  
+   func needs to be thread safe, and shouldn't touch gtk. */
+void amitk_parallel_for(guint64 num_items, guint64 min_items_per_thread,
+			AmitkParallelFunc func, gpointer data) {
+
+  parallel_chunk_t * chunks;
+  GThread ** threads;
+  guint num_chunks;
+  guint i_chunk;
+
+  if (num_items == 0) return;
+  if (min_items_per_thread < 1) min_items_per_thread = 1;
+
+  num_chunks = amitk_get_num_threads();
+  if (num_items/min_items_per_thread < num_chunks)
+    num_chunks = MAX(1, num_items/min_items_per_thread);
+
+  if (num_chunks == 1) {
+    (*func)(0, num_items, data);
+    return;
+  }
+
+  chunks = g_new(parallel_chunk_t, num_chunks);
+  threads = g_new0(GThread *, num_chunks);
+  for (i_chunk=0; i_chunk < num_chunks; i_chunk++) {
+    chunks[i_chunk].func = func;
+    chunks[i_chunk].data = data;
+    chunks[i_chunk].start = (num_items*i_chunk)/num_chunks;
+    chunks[i_chunk].end = (num_items*(i_chunk+1))/num_chunks;
+  }
+
+  /* if we can't get a thread, just do that chunk ourselves */
+  for (i_chunk=1; i_chunk < num_chunks; i_chunk++) 
+    threads[i_chunk] = g_thread_try_new("amitk_parallel", parallel_chunk_thread, &(chunks[i_chunk]), NULL);
+
+  parallel_chunk_thread(&(chunks[0]));
+
+  for (i_chunk=1; i_chunk < num_chunks; i_chunk++) {
+    if (threads[i_chunk] != NULL)
+      g_thread_join(threads[i_chunk]);
+    else
+      parallel_chunk_thread(&(chunks[i_chunk]));
+  }
+
+  g_free(threads);
+  g_free(chunks);
+
+  return;
+}
+
+
 
 
 
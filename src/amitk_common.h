@@ -37,10 +37,14 @@ G_BEGIN_DECLS
 #define AMITK_RESPONSE_COPY 2
 #define AMITK_RESPONSE_SAVE_AS 3
 #define AMITK_RESPONSE_SAVE_RAW_AS 4
+#define AMITK_RESPONSE_SAVE_RAW_BINARY_AS 5
 
 /* defines how many times we want the progress bar to be updated over the course of an action */
 #define AMITK_UPDATE_DIVIDER 40.0 /* must be float point */
 
+/* upper limit on how many threads we'll split up the number crunching over */
+#define AMITK_MAX_THREADS 64
+
 /* file info.  magic string needs to be < 64 bytes */
 #define AMITK_FILE_VERSION (xmlChar *) "2.0"
 #define AMITK_FLAT_FILE_MAGIC_STRING "AMIDE XML Image Format Flat File"
@@ -133,6 +137,9 @@ typedef enum {
 } AmitkHelpInfo;
 
 
+/* function run over the items [start, end) by amitk_parallel_for */
+typedef void (*AmitkParallelFunc)(guint64 start, guint64 end, gpointer data);
+
 /* external variables */
 extern gchar * amitk_limit_names[AMITK_THRESHOLD_STYLE_NUM][AMITK_LIMIT_NUM];
 extern gchar * amitk_window_names[AMITK_WINDOW_NUM];
@@ -154,6 +161,10 @@ GdkPixbuf * amitk_get_pixbuf_from_canvas(AmitkSimpleCanvas * canvas, gint xoffse
 gboolean amitk_is_xif_directory(const gchar * filename, gboolean * plegacy, gchar ** pxml_filename);
 gboolean amitk_is_xif_flat_file(const gchar * filename, guint64 * plocation_le, guint64 *psize_le);
 
+guint amitk_get_num_threads(void);
+void amitk_parallel_for(guint64 num_items, guint64 min_items_per_thread,
+			AmitkParallelFunc func, gpointer data);
+
 
 /* built in type functions */
 const gchar *   amitk_layout_get_name             (const AmitkLayout layout);
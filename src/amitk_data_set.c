@@ -258,6 +258,7 @@ static guint         data_set_signals[LAST_SIGNAL];
 static amide_data_t calculate_scale_factor(AmitkDataSet * ds);
 GList * slice_cache_trim(GList * slice_cache, gint max_size);
 #define MIN_LOCAL_CACHE_SIZE 3
+#define PROJECTIONS_BATCH_BYTES 0x4000000 /* 64MB */
 
 GType amitk_data_set_get_type(void) {
 
@@ -691,6 +692,8 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
   AmitkDataSet * src_ds;
   AmitkDataSet * dest_ds;
   AmitkViewMode i_view_mode;
+  AmitkWindow i_window;
+  AmitkLimit i_limit;
   guint i;
 
   g_return_if_fail(AMITK_IS_DATA_SET(src_object));
@@ -763,6 +766,9 @@ static void data_set_copy_in_place (AmitkObject * dest_object, const AmitkObject
     dest_ds->threshold_min[i] = AMITK_DATA_SET_THRESHOLD_MIN(src_object, i);
     dest_ds->threshold_ref_frame[i] = AMITK_DATA_SET_THRESHOLD_REF_FRAME(src_object, i);
   }
+  for (i_window=0; i_window < AMITK_WINDOW_NUM; i_window++)
+    for (i_limit=0; i_limit < AMITK_LIMIT_NUM; i_limit++)
+      dest_ds->threshold_window[i_window][i_limit] = src_ds->threshold_window[i_window][i_limit];
   amitk_data_set_set_view_start_gate(dest_ds, AMITK_DATA_SET_VIEW_START_GATE(src_object));
   amitk_data_set_set_view_end_gate(dest_ds, AMITK_DATA_SET_VIEW_END_GATE(src_object));
 
@@ -3103,6 +3109,60 @@ void amitk_data_set_slice_calc_min_max (AmitkDataSet * ds,
   (*calc_slice_min_max_func[ds->raw_data->format][ds->scaling_type])(ds, frame, gate, z, pmin, pmax);
 }
 
+static void (*get_plane_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(const AmitkDataSet *, const amide_intpoint_t, const amide_intpoint_t, const amide_intpoint_t, amide_data_t *) = {
+  {amitk_data_set_UBYTE_0D_SCALING_get_plane, amitk_data_set_UBYTE_1D_SCALING_get_plane, amitk_data_set_UBYTE_2D_SCALING_get_plane, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_SBYTE_0D_SCALING_get_plane, amitk_data_set_SBYTE_1D_SCALING_get_plane, amitk_data_set_SBYTE_2D_SCALING_get_plane, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_USHORT_0D_SCALING_get_plane, amitk_data_set_USHORT_1D_SCALING_get_plane, amitk_data_set_USHORT_2D_SCALING_get_plane, amitk_data_set_USHORT_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_USHORT_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_SSHORT_0D_SCALING_get_plane, amitk_data_set_SSHORT_1D_SCALING_get_plane, amitk_data_set_SSHORT_2D_SCALING_get_plane, amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_UINT_0D_SCALING_get_plane, amitk_data_set_UINT_1D_SCALING_get_plane, amitk_data_set_UINT_2D_SCALING_get_plane, amitk_data_set_UINT_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_UINT_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_UINT_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_SINT_0D_SCALING_get_plane, amitk_data_set_SINT_1D_SCALING_get_plane, amitk_data_set_SINT_2D_SCALING_get_plane, amitk_data_set_SINT_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_SINT_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_SINT_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_FLOAT_0D_SCALING_get_plane, amitk_data_set_FLOAT_1D_SCALING_get_plane, amitk_data_set_FLOAT_2D_SCALING_get_plane, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_get_plane},
+  {amitk_data_set_DOUBLE_0D_SCALING_get_plane, amitk_data_set_DOUBLE_1D_SCALING_get_plane, amitk_data_set_DOUBLE_2D_SCALING_get_plane, amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_get_plane, amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_get_plane, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_get_plane}
+};
+
+/* copies the values of the given plane into values, which needs to be dim.x*dim.y long.
+   This is a lot quicker than going through amitk_data_set_get_value voxel by voxel, 
+   and is thread safe */
+void amitk_data_set_get_plane(const AmitkDataSet * ds,
+			      const amide_intpoint_t frame,
+			      const amide_intpoint_t gate,
+			      const amide_intpoint_t z,
+			      amide_data_t * values) {
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(ds->raw_data != NULL);
+
+  (*get_plane_func[ds->raw_data->format][ds->scaling_type])(ds, frame, gate, z, values);
+
+  return;
+}
+
+static void (*get_voxel_series_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(const AmitkDataSet *, const AmitkVoxel, amide_data_t *) = {
+  {amitk_data_set_UBYTE_0D_SCALING_get_voxel_series, amitk_data_set_UBYTE_1D_SCALING_get_voxel_series, amitk_data_set_UBYTE_2D_SCALING_get_voxel_series, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_SBYTE_0D_SCALING_get_voxel_series, amitk_data_set_SBYTE_1D_SCALING_get_voxel_series, amitk_data_set_SBYTE_2D_SCALING_get_voxel_series, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_USHORT_0D_SCALING_get_voxel_series, amitk_data_set_USHORT_1D_SCALING_get_voxel_series, amitk_data_set_USHORT_2D_SCALING_get_voxel_series, amitk_data_set_USHORT_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_USHORT_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_SSHORT_0D_SCALING_get_voxel_series, amitk_data_set_SSHORT_1D_SCALING_get_voxel_series, amitk_data_set_SSHORT_2D_SCALING_get_voxel_series, amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_UINT_0D_SCALING_get_voxel_series, amitk_data_set_UINT_1D_SCALING_get_voxel_series, amitk_data_set_UINT_2D_SCALING_get_voxel_series, amitk_data_set_UINT_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_UINT_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_UINT_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_SINT_0D_SCALING_get_voxel_series, amitk_data_set_SINT_1D_SCALING_get_voxel_series, amitk_data_set_SINT_2D_SCALING_get_voxel_series, amitk_data_set_SINT_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_SINT_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_SINT_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_FLOAT_0D_SCALING_get_voxel_series, amitk_data_set_FLOAT_1D_SCALING_get_voxel_series, amitk_data_set_FLOAT_2D_SCALING_get_voxel_series, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_get_voxel_series},
+  {amitk_data_set_DOUBLE_0D_SCALING_get_voxel_series, amitk_data_set_DOUBLE_1D_SCALING_get_voxel_series, amitk_data_set_DOUBLE_2D_SCALING_get_voxel_series, amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_get_voxel_series, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_get_voxel_series}
+};
+
+/* copies the values of the given voxel over all the frames and gates into values, 
+   which needs to be dim.t*dim.g long with the gates varying fastest.  The voxel's
+   t and g are ignored.  Quicker than amitk_data_set_get_value, and thread safe */
+void amitk_data_set_get_voxel_series(const AmitkDataSet * ds,
+				     const AmitkVoxel voxel,
+				     amide_data_t * values) {
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail(ds->raw_data != NULL);
+
+  (*get_voxel_series_func[ds->raw_data->format][ds->scaling_type])(ds, voxel, values);
+
+  return;
+}
+
 /* function to calculate the max and min over the data frames */
 void amitk_data_set_calc_min_max(AmitkDataSet * ds,
 				 AmitkUpdateFunc update_func,
@@ -3392,36 +3452,82 @@ void amitk_data_set_get_thresholding_min_max(AmitkDataSet * ds,
 
   
 
-static void (*calc_distribution_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(AmitkDataSet *, AmitkUpdateFunc, gpointer) = {
-  {amitk_data_set_UBYTE_0D_SCALING_calc_distribution, amitk_data_set_UBYTE_1D_SCALING_calc_distribution,  amitk_data_set_UBYTE_2D_SCALING_calc_distribution, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_calc_distribution, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_calc_distribution,  amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_calc_distribution  },
-  {amitk_data_set_SBYTE_0D_SCALING_calc_distribution, amitk_data_set_SBYTE_1D_SCALING_calc_distribution,  amitk_data_set_SBYTE_2D_SCALING_calc_distribution, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_calc_distribution, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_calc_distribution,  amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_calc_distribution  },
-  {amitk_data_set_USHORT_0D_SCALING_calc_distribution,amitk_data_set_USHORT_1D_SCALING_calc_distribution, amitk_data_set_USHORT_2D_SCALING_calc_distribution,amitk_data_set_USHORT_0D_SCALING_INTERCEPT_calc_distribution,amitk_data_set_USHORT_1D_SCALING_INTERCEPT_calc_distribution, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_calc_distribution },
-  {amitk_data_set_SSHORT_0D_SCALING_calc_distribution,amitk_data_set_SSHORT_1D_SCALING_calc_distribution, amitk_data_set_SSHORT_2D_SCALING_calc_distribution,amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_calc_distribution,amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_calc_distribution, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_calc_distribution },
-  {amitk_data_set_UINT_0D_SCALING_calc_distribution,  amitk_data_set_UINT_1D_SCALING_calc_distribution,   amitk_data_set_UINT_2D_SCALING_calc_distribution,  amitk_data_set_UINT_0D_SCALING_INTERCEPT_calc_distribution,  amitk_data_set_UINT_1D_SCALING_INTERCEPT_calc_distribution,   amitk_data_set_UINT_2D_SCALING_INTERCEPT_calc_distribution   },
-  {amitk_data_set_SINT_0D_SCALING_calc_distribution,  amitk_data_set_SINT_1D_SCALING_calc_distribution,   amitk_data_set_SINT_2D_SCALING_calc_distribution,  amitk_data_set_SINT_0D_SCALING_INTERCEPT_calc_distribution,  amitk_data_set_SINT_1D_SCALING_INTERCEPT_calc_distribution,   amitk_data_set_SINT_2D_SCALING_INTERCEPT_calc_distribution   },
-  {amitk_data_set_FLOAT_0D_SCALING_calc_distribution, amitk_data_set_FLOAT_1D_SCALING_calc_distribution,  amitk_data_set_FLOAT_2D_SCALING_calc_distribution, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_calc_distribution, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_calc_distribution,  amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_calc_distribution  },
-  {amitk_data_set_DOUBLE_0D_SCALING_calc_distribution,amitk_data_set_DOUBLE_1D_SCALING_calc_distribution, amitk_data_set_DOUBLE_2D_SCALING_calc_distribution,amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_calc_distribution,amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_calc_distribution, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_calc_distribution }
+static AmitkRawData * (*bin_distribution_func[AMITK_FORMAT_NUM][AMITK_SCALING_TYPE_NUM])(const AmitkDataSet *, const amide_intpoint_t, AmitkUpdateFunc, gpointer) = {
+  {amitk_data_set_UBYTE_0D_SCALING_bin_distribution, amitk_data_set_UBYTE_1D_SCALING_bin_distribution,  amitk_data_set_UBYTE_2D_SCALING_bin_distribution, amitk_data_set_UBYTE_0D_SCALING_INTERCEPT_bin_distribution, amitk_data_set_UBYTE_1D_SCALING_INTERCEPT_bin_distribution,  amitk_data_set_UBYTE_2D_SCALING_INTERCEPT_bin_distribution  },
+  {amitk_data_set_SBYTE_0D_SCALING_bin_distribution, amitk_data_set_SBYTE_1D_SCALING_bin_distribution,  amitk_data_set_SBYTE_2D_SCALING_bin_distribution, amitk_data_set_SBYTE_0D_SCALING_INTERCEPT_bin_distribution, amitk_data_set_SBYTE_1D_SCALING_INTERCEPT_bin_distribution,  amitk_data_set_SBYTE_2D_SCALING_INTERCEPT_bin_distribution  },
+  {amitk_data_set_USHORT_0D_SCALING_bin_distribution,amitk_data_set_USHORT_1D_SCALING_bin_distribution, amitk_data_set_USHORT_2D_SCALING_bin_distribution,amitk_data_set_USHORT_0D_SCALING_INTERCEPT_bin_distribution,amitk_data_set_USHORT_1D_SCALING_INTERCEPT_bin_distribution, amitk_data_set_USHORT_2D_SCALING_INTERCEPT_bin_distribution },
+  {amitk_data_set_SSHORT_0D_SCALING_bin_distribution,amitk_data_set_SSHORT_1D_SCALING_bin_distribution, amitk_data_set_SSHORT_2D_SCALING_bin_distribution,amitk_data_set_SSHORT_0D_SCALING_INTERCEPT_bin_distribution,amitk_data_set_SSHORT_1D_SCALING_INTERCEPT_bin_distribution, amitk_data_set_SSHORT_2D_SCALING_INTERCEPT_bin_distribution },
+  {amitk_data_set_UINT_0D_SCALING_bin_distribution,  amitk_data_set_UINT_1D_SCALING_bin_distribution,   amitk_data_set_UINT_2D_SCALING_bin_distribution,  amitk_data_set_UINT_0D_SCALING_INTERCEPT_bin_distribution,  amitk_data_set_UINT_1D_SCALING_INTERCEPT_bin_distribution,   amitk_data_set_UINT_2D_SCALING_INTERCEPT_bin_distribution   },
+  {amitk_data_set_SINT_0D_SCALING_bin_distribution,  amitk_data_set_SINT_1D_SCALING_bin_distribution,   amitk_data_set_SINT_2D_SCALING_bin_distribution,  amitk_data_set_SINT_0D_SCALING_INTERCEPT_bin_distribution,  amitk_data_set_SINT_1D_SCALING_INTERCEPT_bin_distribution,   amitk_data_set_SINT_2D_SCALING_INTERCEPT_bin_distribution   },
+  {amitk_data_set_FLOAT_0D_SCALING_bin_distribution, amitk_data_set_FLOAT_1D_SCALING_bin_distribution,  amitk_data_set_FLOAT_2D_SCALING_bin_distribution, amitk_data_set_FLOAT_0D_SCALING_INTERCEPT_bin_distribution, amitk_data_set_FLOAT_1D_SCALING_INTERCEPT_bin_distribution,  amitk_data_set_FLOAT_2D_SCALING_INTERCEPT_bin_distribution  },
+  {amitk_data_set_DOUBLE_0D_SCALING_bin_distribution,amitk_data_set_DOUBLE_1D_SCALING_bin_distribution, amitk_data_set_DOUBLE_2D_SCALING_bin_distribution,amitk_data_set_DOUBLE_0D_SCALING_INTERCEPT_bin_distribution,amitk_data_set_DOUBLE_1D_SCALING_INTERCEPT_bin_distribution, amitk_data_set_DOUBLE_2D_SCALING_INTERCEPT_bin_distribution }
 };
 
+/* bin the data set into a new distribution array, looking at every stride'th
+   voxel in x, y, and z.  The data set's min/max have to be calculated
+   beforehand, after which the data set is only read from, so this can be
+   called from a worker thread on a data set nothing else is changing (e.g.
+   a copy, as set_scale_factor rewrites the scaling).  Returns NULL if cancelled. */
+AmitkRawData * amitk_data_set_bin_distribution(const AmitkDataSet * ds,
+					       const amide_intpoint_t stride,
+					       AmitkUpdateFunc update_func,
+					       gpointer update_data) {
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+  g_return_val_if_fail(ds->raw_data != NULL, NULL);
+  g_return_val_if_fail(ds->min_max_calculated, NULL);
+  g_return_val_if_fail(stride >= 1, NULL);
+
+  return (*bin_distribution_func[ds->raw_data->format][ds->scaling_type])(ds, stride, update_func, update_data);
+}
+
+/* TRUE if the data set already has an up to date distribution array.  The
+   distribution may be the wrong size if we've changed
+   AMITK_DATA_SET_DISTRIBUTION_SIZE, and we've loaded in an old file */
+gboolean amitk_data_set_has_distribution(const AmitkDataSet * ds) {
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), FALSE);
+
+  return ((ds->distribution != NULL) && 
+	  (AMITK_RAW_DATA_DIM_X(ds->distribution) == AMITK_DATA_SET_DISTRIBUTION_SIZE));
+}
+
+/* hand a distribution array calculated with amitk_data_set_bin_distribution
+   over to the data set, adds a reference */
+void amitk_data_set_set_distribution(AmitkDataSet * ds, AmitkRawData * distribution) {
+
+  g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  g_return_if_fail((distribution == NULL) || AMITK_IS_RAW_DATA(distribution));
+
+  if (distribution != NULL)
+    g_object_ref(distribution);
+  if (ds->distribution != NULL)
+    g_object_unref(ds->distribution);
+  ds->distribution = distribution;
+
+  return;
+}
+
 /* generate the distribution array for a data set */
 void amitk_data_set_calc_distribution(AmitkDataSet * ds, 
 				      AmitkUpdateFunc update_func,
 				      gpointer update_data) {
 
+  AmitkRawData * distribution;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
   g_return_if_fail(ds->raw_data != NULL);
 
-  /* check that the distribution is the right size.  This may not be the case
-     if we've changed AMITK_DATA_SET_DISTRIBUTION_SIZE, and we've loaded
-     in an old file */
-  if (ds->distribution != NULL)
-    if (AMITK_RAW_DATA_DIM_X(ds->distribution) != AMITK_DATA_SET_DISTRIBUTION_SIZE) {
-      g_object_unref(ds->distribution);
-      ds->distribution = NULL;
-    }
+  if (amitk_data_set_has_distribution(ds))
+    return;
+
+  amitk_data_set_calc_min_max_if_needed(ds, update_func, update_data);
+  distribution = amitk_data_set_bin_distribution(ds, 1, update_func, update_data);
+  if (distribution == NULL) return;
+
+  amitk_data_set_set_distribution(ds, distribution);
+  g_object_unref(distribution);
 
-  (*calc_distribution_func[ds->raw_data->format][ds->scaling_type])(ds, update_func, update_data);
   return;
 }
 
@@ -3942,6 +4048,25 @@ amide_data_t amitk_data_set_get_scaling_intercept(const AmitkDataSet * ds, const
 
 
 
+/* the raw data might be getting written out in the background (see
+   amitk_study_save_xml_in_background), in which case it can't be changed in
+   place, and the data set gets switched over to its own copy of it */
+static gboolean data_set_unshare_raw_data(AmitkDataSet * ds) {
+
+  AmitkRawData * copy;
+
+  if (!AMITK_RAW_DATA_SHARED(ds->raw_data)) return TRUE;
+
+  if ((copy = amitk_raw_data_copy(ds->raw_data)) == NULL) {
+    g_warning(_("couldn't allocate memory space for a copy of the data set being saved, data set not changed"));
+    return FALSE;
+  }
+  g_object_unref(ds->raw_data);
+  ds->raw_data = copy;
+
+  return TRUE;
+}
+
 /* sets the current voxel to the given value.  If value/scaling is
    outside of the range of the data set type (i.e. negative for unsigned type),
    it will be truncated to lie at the limits of the range */
@@ -3956,6 +4081,7 @@ void amitk_data_set_set_value(AmitkDataSet * ds,
   amide_data_t unscaled_value;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  if (!data_set_unshare_raw_data(ds)) return;
 
   /* figure out what the value is unscaled */
   switch(ds->scaling_type) {
@@ -4028,6 +4154,7 @@ void amitk_data_set_set_value(AmitkDataSet * ds,
     g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
     break;
   }
+  amitk_raw_data_set_modified(ds->raw_data);
 
   if (signal_change) {
     g_signal_emit (G_OBJECT (ds), data_set_signals[INVALIDATE_SLICE_CACHE], 0);
@@ -4048,6 +4175,7 @@ void amitk_data_set_set_internal_value(AmitkDataSet * ds,
   amide_data_t unscaled_value;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
+  if (!data_set_unshare_raw_data(ds)) return;
 
   /* figure out what the value is unscaled */
   switch(ds->scaling_type) {
@@ -4120,6 +4248,7 @@ void amitk_data_set_set_internal_value(AmitkDataSet * ds,
     g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
     break;
   }
+  amitk_raw_data_set_modified(ds->raw_data);
 
   if (signal_change) {
     g_signal_emit (G_OBJECT (ds), data_set_signals[INVALIDATE_SLICE_CACHE], 0);
@@ -4158,29 +4287,66 @@ AmitkDataSet *amitk_data_set_get_slice(AmitkDataSet * ds,
   return slice;
 }
 
-/* start_point and end_point should be in the base coordinate frame */
+/* the value at the given voxel, averaged over the frames [start_frame, end_frame]
+   with the given time weights, and over the data set's view gates */
+static amide_data_t line_profile_value(const AmitkDataSet * ds,
+				       AmitkVoxel voxel,
+				       const gint start_frame,
+				       const gint end_frame,
+				       const amide_data_t * time_weights) {
+
+  amide_data_t value, gate_value;
+  amide_intpoint_t i_gate;
+
+  value = 0.0;
+  for (voxel.t=start_frame; voxel.t<=end_frame; voxel.t++) {
+    gate_value = 0.0;
+    for (i_gate=0; i_gate < AMITK_DATA_SET_NUM_VIEW_GATES(ds); i_gate++) {
+      voxel.g = i_gate+AMITK_DATA_SET_VIEW_START_GATE(ds);
+      if (voxel.g >= AMITK_DATA_SET_NUM_GATES(ds))
+	voxel.g -= AMITK_DATA_SET_NUM_GATES(ds);
+      gate_value += amitk_data_set_get_value(ds, voxel);
+    }
+    value += time_weights[voxel.t-start_frame]*gate_value/((gdouble) AMITK_DATA_SET_NUM_VIEW_GATES(ds));
+  }
+
+  return value;
+}
+
+/* walks exactly the voxels the line passes through (Amanatides and Woo's voxel
+   traversal), recording for each voxel the value at the point on the line closest to
+   the voxel's center, if that point is within the voxel.  If width is greater than zero,
+   the value is averaged over parallel lines spread out over width along width_axis.
+   start_point, end_point, and width_axis should be in the base coordinate frame */
 void  amitk_data_set_get_line_profile(AmitkDataSet * ds,
 				      const amide_time_t start,
 				      const amide_time_t duration,
 				      const AmitkPoint base_start_point,
 				      const AmitkPoint base_end_point,
+				      const amide_real_t width,
+				      const AmitkPoint base_width_axis,
 				      GPtrArray ** preturn_data) {
 
   AmitkPoint start_point, end_point;
-  AmitkPoint candidate_point, current_point;
-  AmitkPoint step;
   AmitkPoint direction;
-  AmitkVoxel current_voxel, last_voxel, candidate_voxel;
-  amide_real_t min_size;
+  AmitkPoint width_axis;
+  AmitkPoint voxel_size;
+  AmitkPoint sample_point;
+  AmitkVoxel dim, voxel, sample_voxel;
+  amide_real_t p0[3], d[3], vs[3], t_max[3], t_delta[3];
+  gint v[3], step[3], dims[3];
+  gint axis;
   amide_real_t length;
-  amide_intpoint_t i_gate;
+  amide_real_t t_enter, t_exit, t_a, t_b, t_cur, t_next, m;
   gint start_frame, end_frame;
   amide_time_t used_start, used_end, used_duration;
   amide_time_t ds_start, ds_end;
-  amide_data_t value, gate_value, time_weight;
+  amide_data_t * time_weights;
+  amide_data_t value;
+  gint num_widths, i_width, num_samples;
+  amide_real_t used_width;
+  amide_real_t * offsets;
   AmitkLineProfileDataElement * element;
-  AmitkPoint voxel_point;
-  gdouble m;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
 
@@ -4200,84 +4366,145 @@ void  amitk_data_set_get_line_profile(AmitkDataSet * ds,
   if (ds_start > used_start) used_start = ds_start;
   used_duration = used_end-used_start;
 
+  /* and how much each of those frames counts for */
+  time_weights = g_new(amide_data_t, end_frame-start_frame+1);
+  for (voxel.t=start_frame; voxel.t<=end_frame; voxel.t++) {
+    if (start_frame == end_frame)
+      time_weights[voxel.t-start_frame] = 1.0;
+    else if (voxel.t == start_frame)
+      time_weights[voxel.t-start_frame] = (amitk_data_set_get_end_time(ds, start_frame)-used_start)/used_duration;
+    else if (voxel.t == end_frame)
+      time_weights[voxel.t-start_frame] = (used_end-amitk_data_set_get_start_time(ds, end_frame))/used_duration;
+    else
+      time_weights[voxel.t-start_frame] = amitk_data_set_get_frame_duration(ds, voxel.t)/used_duration;
+  }
+
   /* translate the start and end into the data set's coordinate frame */
   start_point = amitk_space_b2s(AMITK_SPACE(ds), base_start_point);
   end_point = amitk_space_b2s(AMITK_SPACE(ds), base_end_point);
-
-  /* figure out the direction we want to go */
   direction = point_sub(end_point, start_point);
   length = point_mag(direction);
+  voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ds);
+  dim = AMITK_DATA_SET_DIM(ds);
 
-  /* figure out what our "step" size will be (1/4 a voxel size) */
-  min_size = point_min_dim(AMITK_DATA_SET_VOXEL_SIZE(ds));
-  step = point_cmult((1.0/4.0)*min_size*(1.0/length), direction);
-
-  /* initialize starting values */
-  current_point = start_point;
-  POINT_TO_VOXEL(current_point, AMITK_DATA_SET_VOXEL_SIZE(ds), start_frame, AMITK_DATA_SET_VIEW_START_GATE(ds), current_voxel);
-
-  while (point_mag(point_sub(current_point, start_point)) < length) {
-
-    /* this next snippet of code advances us along the line so that we're at the point
-       on the line closest to the center of the voxel */
-    VOXEL_TO_POINT(current_voxel, AMITK_DATA_SET_VOXEL_SIZE(ds), voxel_point);
-    m = ((voxel_point.x-start_point.x)*direction.x + 
-	 (voxel_point.y-start_point.y)*direction.y + 
-	 (voxel_point.z-start_point.z)*direction.z) / (length*length);
-    candidate_point = point_add(start_point, point_cmult(m, direction));
-    /* note, we may get a voxel out that's not the current voxel... we'll skip the voxel
-       in that case */
-    POINT_TO_VOXEL(candidate_point, AMITK_DATA_SET_VOXEL_SIZE(ds), current_voxel.t, current_voxel.g,candidate_voxel);
-
-    /* record the value if it's in the data set */
-    if ((amitk_raw_data_includes_voxel(AMITK_DATA_SET_RAW_DATA(ds), current_voxel)) &&
-	(VOXEL_EQUAL(candidate_voxel, current_voxel))) {
-
-      /* need to average over frames */
-      value = 0;
-      for (current_voxel.t=start_frame; current_voxel.t<=end_frame;current_voxel.t++) {
-
-	if (start_frame == end_frame)
-	  time_weight = 1.0;
-	else if (current_voxel.t == start_frame)
-	  time_weight = (amitk_data_set_get_end_time(ds, start_frame)-used_start)/used_duration;
-	else if (current_voxel.t == end_frame)
-	  time_weight = (used_end-amitk_data_set_get_start_time(ds, end_frame))/used_duration;
-	else
-	  time_weight = amitk_data_set_get_frame_duration(ds, current_voxel.t)/used_duration;
-
-	/* need to average over gates */
-	gate_value = 0.0;
-	for (i_gate=0; i_gate < AMITK_DATA_SET_NUM_VIEW_GATES(ds); i_gate++) {
-	  current_voxel.g = i_gate+AMITK_DATA_SET_VIEW_START_GATE(ds);
-	  if (current_voxel.g >= AMITK_DATA_SET_NUM_GATES(ds))
-	    current_voxel.g -= AMITK_DATA_SET_NUM_GATES(ds);
-	  
-	  gate_value += amitk_data_set_get_value(ds, current_voxel);
-	}
-	value += time_weight*gate_value/((gdouble) AMITK_DATA_SET_NUM_VIEW_GATES(ds));
+  /* the offsets of the parallel lines for a thick profile.  Lines further than the
+     data set's diagonal off to either side can't hit any of it, so the width's
+     limited to that, which also keeps the number of lines sane */
+  used_width = MIN(width, 2.0*point_mag(AMITK_VOLUME_CORNER(ds)));
+  if (used_width > 0.0) 
+    num_widths = MAX(1, ceil(used_width/point_min_dim(voxel_size)));
+  else
+    num_widths = 1;
+  offsets = g_new(amide_real_t, num_widths);
+  for (i_width=0; i_width < num_widths; i_width++)
+    offsets[i_width] = (num_widths == 1) ? 0.0 : (i_width+0.5)*used_width/num_widths - used_width/2.0;
+  width_axis = point_sub(amitk_space_b2s(AMITK_SPACE(ds), base_width_axis),
+			 amitk_space_b2s(AMITK_SPACE(ds), zero_point));
+
+  p0[0] = start_point.x; p0[1] = start_point.y; p0[2] = start_point.z;
+  d[0] = direction.x; d[1] = direction.y; d[2] = direction.z;
+  vs[0] = voxel_size.x; vs[1] = voxel_size.y; vs[2] = voxel_size.z;
+  dims[0] = dim.x; dims[1] = dim.y; dims[2] = dim.z;
+
+  /* clip the line, parameterized as p0+t*d with t in [0,1], to the data set */
+  t_enter = 0.0;
+  t_exit = 1.0;
+  for (axis=0; (axis < 3) && (t_enter < t_exit) && (length > EPSILON); axis++) {
+    if (fabs(d[axis]) < EPSILON) {
+      if ((p0[axis] < 0.0) || (p0[axis] >= dims[axis]*vs[axis]))
+	t_exit = t_enter; /* parallel to, and outside of, this pair of faces */
+    } else {
+      t_a = -p0[axis]/d[axis];
+      t_b = (dims[axis]*vs[axis]-p0[axis])/d[axis];
+      if (t_a > t_b) {
+	m = t_a;
+	t_a = t_b;
+	t_b = m;
       }
+      if (t_a > t_enter) t_enter = t_a;
+      if (t_b < t_exit) t_exit = t_b;
+    }
+  }
 
-      /* record value in array */
-      element = g_malloc(sizeof(AmitkLineProfileDataElement));
-      g_return_if_fail(element != NULL);
-      element->value = value;
-      element->location = point_mag(point_sub(candidate_point, start_point));
-      g_ptr_array_add(*preturn_data, element);
-      
+  if ((length > EPSILON) && (t_enter < t_exit)) {
+
+    /* setup the traversal from the voxel the line enters the data set at */
+    voxel.t = start_frame;
+    voxel.g = AMITK_DATA_SET_VIEW_START_GATE(ds);
+    for (axis=0; axis < 3; axis++) {
+      v[axis] = floor((p0[axis]+t_enter*d[axis])/vs[axis]);
+      v[axis] = CLAMP(v[axis], 0, dims[axis]-1);
+      if (d[axis] > EPSILON) {
+	step[axis] = 1;
+	t_max[axis] = ((v[axis]+1)*vs[axis]-p0[axis])/d[axis];
+	t_delta[axis] = vs[axis]/d[axis];
+      } else if (d[axis] < -EPSILON) {
+	step[axis] = -1;
+	t_max[axis] = (v[axis]*vs[axis]-p0[axis])/d[axis];
+	t_delta[axis] = -vs[axis]/d[axis];
+      } else {
+	step[axis] = 0;
+	t_max[axis] = G_MAXDOUBLE;
+	t_delta[axis] = G_MAXDOUBLE;
+      }
     }
-    current_voxel.t = start_frame;
-    current_voxel.g = AMITK_DATA_SET_VIEW_START_GATE(ds);
-
-    /* get next voxel */
-    last_voxel = current_voxel;
-    /* this makes sure we move at least one voxel */
-    while (VOXEL_EQUAL(last_voxel, current_voxel)) {
-      current_point = point_add(current_point, step);
-      POINT_TO_VOXEL(current_point, AMITK_DATA_SET_VOXEL_SIZE(ds), current_voxel.t, current_voxel.g, current_voxel);
+
+    t_cur = t_enter;
+    while (t_cur < t_exit) {
+
+      /* the part of the line in this voxel is [t_cur, t_next) */
+      axis = (t_max[0] < t_max[1]) ? 0 : 1;
+      if (t_max[2] < t_max[axis]) axis = 2;
+      t_next = MIN(t_max[axis], t_exit);
+
+      /* the point on the line closest to the center of the voxel */
+      m = (((v[0]+0.5)*vs[0]-p0[0])*d[0] + 
+	   ((v[1]+0.5)*vs[1]-p0[1])*d[1] + 
+	   ((v[2]+0.5)*vs[2]-p0[2])*d[2]) / (length*length);
+
+      if ((m >= t_cur) && (m < t_next)) {
+	voxel.x = v[0];
+	voxel.y = v[1];
+	voxel.z = v[2];
+
+	if (num_widths == 1) {
+	  value = line_profile_value(ds, voxel, start_frame, end_frame, time_weights);
+	  num_samples = 1;
+	} else {
+	  value = 0.0;
+	  num_samples = 0;
+	  for (i_width=0; i_width < num_widths; i_width++) {
+	    sample_point = point_add(point_add(start_point, point_cmult(m, direction)),
+				     point_cmult(offsets[i_width], width_axis));
+	    POINT_TO_VOXEL(sample_point, voxel_size, voxel.t, voxel.g, sample_voxel);
+	    if (amitk_raw_data_includes_voxel(AMITK_DATA_SET_RAW_DATA(ds), sample_voxel)) {
+	      value += line_profile_value(ds, sample_voxel, start_frame, end_frame, time_weights);
+	      num_samples++;
+	    }
+	  }
+	  if (num_samples > 0) value /= num_samples;
+	}
+
+	if (num_samples > 0) {
+	  element = g_malloc(sizeof(AmitkLineProfileDataElement));
+	  element->value = value;
+	  element->location = m*length;
+	  g_ptr_array_add(*preturn_data, element);
+	}
+      }
+
+      /* step into the next voxel */
+      if (t_max[axis] >= t_exit) break;
+      v[axis] += step[axis];
+      if ((v[axis] < 0) || (v[axis] >= dims[axis])) break;
+      t_cur = t_max[axis];
+      t_max[axis] += t_delta[axis];
     }
   }
 
+  g_free(offsets);
+  g_free(time_weights);
+
   return;
 }
 
@@ -4285,6 +4512,76 @@ void  amitk_data_set_get_line_profile(AmitkDataSet * ds,
 
 /* return the three planar projections of the data set */
 /* projections should be an array of 3 pointers to data sets */
+typedef struct {
+  const AmitkDataSet * ds;
+  guint frame;
+  guint gate;
+  AmitkVoxel dim;
+  gsize plane_size;
+  gint first_plane; /* of the current batch */
+  gint num_planes; /* in the current batch */
+  amide_data_t * planes; /* plane_size values for each plane of the batch */
+  amitk_format_DOUBLE_t * transverse;
+  amitk_format_DOUBLE_t * coronal;
+  amitk_format_DOUBLE_t * sagittal;
+} projections_t;
+
+/* reads in planes [start, end) of the current batch, and sums each of them into
+   its own row of the coronal and sagittal projections */
+static void projections_sum_planes(guint64 start, guint64 end, gpointer data) {
+
+  projections_t * proj = data;
+  amide_data_t * values;
+  amitk_format_DOUBLE_t * coronal_row;
+  amitk_format_DOUBLE_t * sagittal_row;
+  amide_data_t row_sum;
+  guint64 i_plane;
+  gint z, y, x;
+
+  for (i_plane = start; i_plane < end; i_plane++) {
+    z = proj->first_plane+i_plane;
+    values = proj->planes + i_plane*proj->plane_size;
+    amitk_data_set_get_plane(proj->ds, proj->frame, proj->gate, z, values);
+
+    coronal_row = proj->coronal + ((gsize) (proj->dim.z-z-1))*proj->dim.x;
+    sagittal_row = proj->sagittal + ((gsize) (proj->dim.z-z-1))*proj->dim.y;
+    for (y = 0; y < proj->dim.y; y++) {
+      row_sum = 0.0;
+      for (x = 0; x < proj->dim.x; x++, values++) {
+	coronal_row[x] += *values;
+	row_sum += *values;
+      }
+      sagittal_row[y] += row_sum;
+    }
+  }
+
+  return;
+}
+
+/* adds the planes of the current batch into rows [start, end) of the transverse 
+   projection, always in the same order so the result doesn't depend on the threads */
+static void projections_sum_transverse(guint64 start, guint64 end, gpointer data) {
+
+  projections_t * proj = data;
+  const amide_data_t * values;
+  amitk_format_DOUBLE_t * transverse_row;
+  guint64 y;
+  gint i_plane, x;
+
+  for (y = start; y < end; y++) {
+    transverse_row = proj->transverse + y*proj->dim.x;
+    for (i_plane = 0; i_plane < proj->num_planes; i_plane++) {
+      values = proj->planes + i_plane*proj->plane_size + y*proj->dim.x;
+      for (x = 0; x < proj->dim.x; x++)
+	transverse_row[x] += values[x];
+    }
+  }
+
+  return;
+}
+
+/* return the three planar projections of the data set, these are computed
+   together in a single pass through the data set */
 void amitk_data_set_get_projections(AmitkDataSet * ds,
 				    const guint frame,
 				    const guint gate,
@@ -4295,12 +4592,11 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
   AmitkVoxel dim, planar_dim, i;
   AmitkPoint voxel_size;
   amide_data_t normalizers[AMITK_VIEW_NUM];
-  div_t x;
-  gint divider;
+  projections_t proj;
+  gint batch_planes;
   gboolean continue_work=TRUE;
   gchar * temp_string;
   AmitkView i_view;
-  amide_data_t value;
 
   g_return_if_fail(AMITK_IS_DATA_SET(ds));
   g_return_if_fail(ds->raw_data != NULL);
@@ -4316,7 +4612,6 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
     continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
     g_free(temp_string);
   }
-  divider = ((dim.z/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (dim.z/AMITK_UPDATE_DIVIDER);
 
   /* initialize the 3 projections */
   for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) {
@@ -4386,29 +4681,37 @@ void amitk_data_set_get_projections(AmitkDataSet * ds,
   }
 
 
-  /* now iterate through the entire data set, adding up the 3 projections */
-  i.t = frame;
-  i.g = gate;
-  for (i.z = 0; (i.z < dim.z) && continue_work; i.z++) {
+  /* now go through the data set a batch of planes at a time, adding up the 3 projections */
+  proj.ds = ds;
+  proj.frame = frame;
+  proj.gate = gate;
+  proj.dim = dim;
+  proj.plane_size = ((gsize) dim.x)*((gsize) dim.y);
+  proj.transverse = AMITK_RAW_DATA_DOUBLE_2D_POINTER(projections[AMITK_VIEW_TRANSVERSE]->raw_data, 0, 0);
+  proj.coronal = AMITK_RAW_DATA_DOUBLE_2D_POINTER(projections[AMITK_VIEW_CORONAL]->raw_data, 0, 0);
+  proj.sagittal = AMITK_RAW_DATA_DOUBLE_2D_POINTER(projections[AMITK_VIEW_SAGITTAL]->raw_data, 0, 0);
 
-    if (update_func != NULL) {
-      x = div(i.z,divider);
-      if (x.rem == 0)
-	continue_work = (*update_func)(update_data, NULL, (gdouble) (i.z)/dim.z);
-    }
+  batch_planes = 4*amitk_get_num_threads();
+  batch_planes = MAX(1, MIN(batch_planes, PROJECTIONS_BATCH_BYTES/(proj.plane_size*sizeof(amide_data_t))));
+  batch_planes = MIN(batch_planes, dim.z);
+  if ((proj.planes = g_try_new(amide_data_t, batch_planes*proj.plane_size)) == NULL) {
+    g_warning(_("couldn't allocate memory space for the projection planes"));
+    continue_work = FALSE;
+  }
 
-    for (i.y = 0; i.y < dim.y; i.y++) {
-      for (i.x = 0; i.x < dim.x; i.x++) {
-	value = amitk_data_set_get_value(ds, i);
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[AMITK_VIEW_TRANSVERSE]->raw_data,i.y, i.x) += value;
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[AMITK_VIEW_CORONAL]->raw_data,dim.z-i.z-1, i.x) += value;
-	AMITK_RAW_DATA_DOUBLE_2D_SET_CONTENT(projections[AMITK_VIEW_SAGITTAL]->raw_data,dim.z-i.z-1, i.y) += value;
-      }
-    }
+  for (proj.first_plane = 0; (proj.first_plane < dim.z) && continue_work; proj.first_plane += proj.num_planes) {
+    proj.num_planes = MIN(batch_planes, dim.z-proj.first_plane);
+    amitk_parallel_for(proj.num_planes, 1, projections_sum_planes, &proj);
+    amitk_parallel_for(dim.y, 1, projections_sum_transverse, &proj);
+
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, 
+				     (gdouble) (proj.first_plane+proj.num_planes)/dim.z);
   }
+  g_free(proj.planes);
 
   if (update_func != NULL) /* remove progress bar */
-    continue_work = (*update_func)(update_data, NULL, (gdouble) 2.0);
+    (*update_func)(update_data, NULL, (gdouble) 2.0);
 
   if (!continue_work) {/* we hit cancel */
     for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++) {
@@ -5563,6 +5866,39 @@ GList * slice_cache_trim(GList * slice_cache, gint max_size) {
   return slice_cache;
 }
 
+static gboolean slice_matches(AmitkDataSet * slice, AmitkDataSet * parent_ds,
+			      const amide_time_t start, const amide_time_t duration,
+			      const amide_intpoint_t gate,
+			      const AmitkCanvasPoint pixel_size, const AmitkVolume * view_volume) {
+
+  AmitkVoxel dim;
+  amide_intpoint_t start_gate, end_gate;
+
+  if (AMITK_DATA_SET_SLICE_PARENT(slice) != parent_ds) return FALSE;
+  if (!REAL_EQUAL(slice->scan_start, start)) return FALSE;
+  if (!REAL_EQUAL(amitk_data_set_get_frame_duration(slice,0), duration)) return FALSE;
+
+  if (gate < 0) {
+    start_gate = AMITK_DATA_SET_VIEW_START_GATE(parent_ds);
+    end_gate = AMITK_DATA_SET_VIEW_END_GATE(parent_ds);
+  } else {
+    start_gate = gate;
+    end_gate = gate;
+  }
+  if (AMITK_DATA_SET_VIEW_START_GATE(slice) != start_gate) return FALSE;
+  if (AMITK_DATA_SET_VIEW_END_GATE(slice) != end_gate) return FALSE;
+  if (!REAL_EQUAL(slice->voxel_size.z,AMITK_VOLUME_Z_CORNER(view_volume))) return FALSE;
+
+  dim.x = ceil(fabs(AMITK_VOLUME_X_CORNER(view_volume))/pixel_size.x);
+  dim.y = ceil(fabs(AMITK_VOLUME_Y_CORNER(view_volume))/pixel_size.y);
+  dim.z = dim.t = dim.g = 1;
+  if (!VOXEL_EQUAL(dim, AMITK_DATA_SET_DIM(slice))) return FALSE;
+  if (AMITK_DATA_SET_INTERPOLATION(slice) != AMITK_DATA_SET_INTERPOLATION(parent_ds)) return FALSE;
+  if (AMITK_DATA_SET_RENDERING(slice) != AMITK_DATA_SET_RENDERING(parent_ds)) return FALSE;
+
+  return TRUE;
+}
+
 /* several things cause slice caches to get invalidated, so they don't need to be
    explicitly checked here
 
@@ -5578,41 +5914,16 @@ static AmitkDataSet * slice_cache_find (GList * slice_cache, AmitkDataSet * pare
 					const AmitkCanvasPoint pixel_size, const AmitkVolume * view_volume) {
 
   AmitkDataSet * slice;
-  AmitkVoxel dim;
-  amide_intpoint_t start_gate, end_gate;
 
-  if (slice_cache == NULL) {
-    return NULL;
-  } else {
+  while (slice_cache != NULL) {
     slice = slice_cache->data;
-    if (AMITK_DATA_SET_SLICE_PARENT(slice) == parent_ds) 
-      if (amitk_space_equal(AMITK_SPACE(slice), AMITK_SPACE(view_volume))) 
-	if (REAL_EQUAL(slice->scan_start, start)) 
-	  if (REAL_EQUAL(amitk_data_set_get_frame_duration(slice,0), duration)) {
-	    if (gate < 0) {
-	      start_gate = AMITK_DATA_SET_VIEW_START_GATE(AMITK_DATA_SET_SLICE_PARENT(slice));
-	      end_gate = AMITK_DATA_SET_VIEW_END_GATE(AMITK_DATA_SET_SLICE_PARENT(slice));
-	    } else {
-	      start_gate = gate;
-	      end_gate = gate;
-	    }
-	    if (AMITK_DATA_SET_VIEW_START_GATE(slice) == start_gate)
-	      if (AMITK_DATA_SET_VIEW_END_GATE(slice) == end_gate)
-		if (REAL_EQUAL(slice->voxel_size.z,AMITK_VOLUME_Z_CORNER(view_volume))) {
-		  dim.x = ceil(fabs(AMITK_VOLUME_X_CORNER(view_volume))/pixel_size.x);
-		  dim.y = ceil(fabs(AMITK_VOLUME_Y_CORNER(view_volume))/pixel_size.y);
-		  dim.z = dim.t = dim.g = 1;
-		  if (VOXEL_EQUAL(dim, AMITK_DATA_SET_DIM(slice))) 
-		    if (AMITK_DATA_SET_INTERPOLATION(slice) == AMITK_DATA_SET_INTERPOLATION(parent_ds)) 
-		      if (AMITK_DATA_SET_RENDERING(slice) == AMITK_DATA_SET_RENDERING(parent_ds)) 
-			return slice;
-		}
-	  }
+    if (amitk_space_equal(AMITK_SPACE(slice), AMITK_SPACE(view_volume)))
+      if (slice_matches(slice, parent_ds, start, duration, gate, pixel_size, view_volume))
+	return slice;
+    slice_cache = slice_cache->next;
   }
-  
 
-  /* this one's not it, keep looking */
-  return slice_cache_find(slice_cache->next, parent_ds, start, duration, gate, pixel_size, view_volume);
+  return NULL;
 }
 
 
@@ -5710,6 +6021,223 @@ GList * amitk_data_sets_get_slices(GList * objects,
   return slices;
 }
 
+typedef struct {
+  AmitkDataSet ** data_sets;
+  GPtrArray ** lines;
+  amide_time_t start;
+  amide_time_t duration;
+  AmitkPoint start_point;
+  AmitkPoint end_point;
+  amide_real_t width;
+  AmitkPoint width_axis;
+} line_profiles_t;
+
+static void line_profiles_calc(guint64 start, guint64 end, gpointer data) {
+
+  line_profiles_t * profiles = data;
+  guint64 i;
+
+  for (i=start; i < end; i++)
+    amitk_data_set_get_line_profile(profiles->data_sets[i], profiles->start, profiles->duration,
+				    profiles->start_point, profiles->end_point,
+				    profiles->width, profiles->width_axis,
+				    &(profiles->lines[i]));
+
+  return;
+}
+
+/* calculates the line profiles of all the data sets in the list, with the data
+   sets divided up between threads.  Returns an array with a GPtrArray of
+   AmitkLineProfileDataElement's for each data set, in the order of the list.
+   See amitk_data_set_get_line_profile for the parameters */
+GPtrArray * amitk_data_sets_get_line_profiles(GList * objects,
+					      const amide_time_t start,
+					      const amide_time_t duration,
+					      const AmitkPoint start_point,
+					      const AmitkPoint end_point,
+					      const amide_real_t width,
+					      const AmitkPoint width_axis) {
+
+  line_profiles_t profiles;
+  GPtrArray * lines;
+  guint num_data_sets;
+  guint i;
+
+  num_data_sets = amitk_data_sets_count(objects, FALSE);
+  lines = g_ptr_array_sized_new(num_data_sets);
+  if (num_data_sets == 0) return lines;
+
+  profiles.data_sets = g_new(AmitkDataSet *, num_data_sets);
+  profiles.lines = g_new0(GPtrArray *, num_data_sets);
+  profiles.start = start;
+  profiles.duration = duration;
+  profiles.start_point = start_point;
+  profiles.end_point = end_point;
+  profiles.width = width;
+  profiles.width_axis = width_axis;
+
+  for (i=0; objects != NULL; objects = objects->next)
+    if (AMITK_IS_DATA_SET(objects->data))
+      profiles.data_sets[i++] = AMITK_DATA_SET(objects->data);
+
+  amitk_parallel_for(num_data_sets, 1, line_profiles_calc, &profiles);
+
+  for (i=0; i < num_data_sets; i++)
+    g_ptr_array_add(lines, profiles.lines[i]);
+
+  g_free(profiles.lines);
+  g_free(profiles.data_sets);
+
+  return lines;
+}
+
+/* reslices the given region (in pixels of view_volume) out of the data set */
+static AmitkDataSet * slice_get_region(AmitkDataSet * parent_ds,
+				       const amide_time_t start,
+				       const amide_time_t duration,
+				       const amide_intpoint_t gate,
+				       const AmitkCanvasPoint pixel_size,
+				       const AmitkVolume * view_volume,
+				       const amide_intpoint_t x, const amide_intpoint_t y,
+				       const amide_intpoint_t width, const amide_intpoint_t height) {
+
+  AmitkVolume * region;
+  AmitkDataSet * slice;
+  AmitkPoint point;
+
+  region = amitk_volume_new();
+  amitk_space_copy_in_place(AMITK_SPACE(region), AMITK_SPACE(view_volume));
+  point.x = x*pixel_size.x;
+  point.y = y*pixel_size.y;
+  point.z = 0.0;
+  amitk_space_set_offset(AMITK_SPACE(region), amitk_space_s2b(AMITK_SPACE(view_volume), point));
+  point.x = width*pixel_size.x;
+  point.y = height*pixel_size.y;
+  point.z = AMITK_VOLUME_Z_CORNER(view_volume);
+  amitk_volume_set_corner(region, point);
+
+  slice = amitk_data_set_get_slice(parent_ds, start, duration, gate, pixel_size, region);
+  amitk_object_unref(region);
+
+  return slice;
+}
+
+/* copies a block of the src slice into the dest slice */
+static void slice_copy_region(AmitkDataSet * dest, const amide_intpoint_t dest_x, const amide_intpoint_t dest_y,
+			      AmitkDataSet * src, const amide_intpoint_t src_x, const amide_intpoint_t src_y,
+			      amide_intpoint_t width, amide_intpoint_t height) {
+
+  amide_intpoint_t j;
+
+  width = MIN(width, AMITK_DATA_SET_DIM_X(src)-src_x);
+  height = MIN(height, AMITK_DATA_SET_DIM_Y(src)-src_y);
+  if ((width <= 0) || (height <= 0)) return;
+
+  for (j=0; j<height; j++)
+    memcpy(AMITK_RAW_DATA_DOUBLE_2D_POINTER(dest->raw_data, dest_y+j, dest_x),
+	   AMITK_RAW_DATA_DOUBLE_2D_POINTER(src->raw_data, src_y+j, src_x),
+	   sizeof(amitk_format_DOUBLE_t)*width);
+
+  return;
+}
+
+/* returns the slice that amitk_data_set_get_slice would return for view_volume,
+   given a slice of the same data set whose volume is view_volume panned in plane
+   by a whole number of pixels.  Pixel (x,y) of the returned slice is pixel
+   (x+shift_x, y+shift_y) of old_slice, so only the strips that the pan exposed
+   need to be resliced.  Returns NULL if old_slice can't be reused this way. */
+AmitkDataSet * amitk_data_set_get_shifted_slice(AmitkDataSet * old_slice,
+						const amide_time_t start,
+						const amide_time_t duration,
+						const amide_intpoint_t gate,
+						const AmitkCanvasPoint pixel_size,
+						const AmitkVolume * view_volume,
+						const amide_intpoint_t shift_x,
+						const amide_intpoint_t shift_y) {
+
+  AmitkDataSet * parent_ds;
+  AmitkDataSet * slice;
+  AmitkDataSet * strip;
+  AmitkVoxel dim;
+  AmitkPoint shift;
+  amide_intpoint_t keep_x, keep_y, width, height;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(old_slice), NULL);
+
+  parent_ds = AMITK_DATA_SET_SLICE_PARENT(old_slice);
+  if (parent_ds == NULL) return NULL;
+  if (!slice_matches(old_slice, parent_ds, start, duration, gate, pixel_size, view_volume)) return NULL;
+  if (!REAL_EQUAL(old_slice->voxel_size.x, pixel_size.x)) return NULL;
+  if (!REAL_EQUAL(old_slice->voxel_size.y, pixel_size.y)) return NULL;
+  if (!amitk_space_axes_equal(AMITK_SPACE(old_slice), AMITK_SPACE(view_volume))) return NULL;
+
+  /* make sure this really is an in plane pan by the given number of pixels */
+  dim = AMITK_DATA_SET_DIM(old_slice);
+  if ((ABS(shift_x) >= dim.x) || (ABS(shift_y) >= dim.y)) return NULL;
+  shift = amitk_space_b2s(AMITK_SPACE(old_slice), AMITK_SPACE_OFFSET(view_volume));
+  if (fabs(shift.x - shift_x*pixel_size.x) > 0.001*pixel_size.x) return NULL;
+  if (fabs(shift.y - shift_y*pixel_size.y) > 0.001*pixel_size.y) return NULL;
+  if (fabs(shift.z) > 0.001*old_slice->voxel_size.z) return NULL;
+
+  if ((shift_x == 0) && (shift_y == 0))
+    return amitk_object_ref(old_slice);
+
+  slice = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(old_slice), 
+				       AMITK_FORMAT_DOUBLE, dim, AMITK_SCALING_TYPE_0D);
+  if (slice == NULL) {
+    g_warning(_("couldn't allocate memory space for the slice, wanted %dx%dx%d elements"), 
+	      dim.x, dim.y, dim.z);
+    return NULL;
+  }
+
+  slice->slice_parent = parent_ds;
+  g_object_add_weak_pointer(G_OBJECT(parent_ds), 
+			    (gpointer *) &(slice->slice_parent));
+  slice->voxel_size = old_slice->voxel_size;
+  amitk_space_copy_in_place(AMITK_SPACE(slice), AMITK_SPACE(view_volume));
+  slice->scan_start = old_slice->scan_start;
+  slice->thresholding = old_slice->thresholding;
+  slice->interpolation = AMITK_DATA_SET_INTERPOLATION(old_slice);
+  slice->rendering = AMITK_DATA_SET_RENDERING(old_slice);
+  slice->view_start_gate = AMITK_DATA_SET_VIEW_START_GATE(old_slice);
+  slice->view_end_gate = AMITK_DATA_SET_VIEW_END_GATE(old_slice);
+  amitk_data_set_calc_far_corner(slice);
+  amitk_data_set_set_frame_duration(slice, 0, amitk_data_set_get_frame_duration(old_slice, 0));
+
+  /* the part of the old slice that's still in view */
+  width = dim.x-ABS(shift_x);
+  height = dim.y-ABS(shift_y);
+  keep_x = MAX(0, -shift_x);
+  keep_y = MAX(0, -shift_y);
+  slice_copy_region(slice, keep_x, keep_y, old_slice, keep_x+shift_x, keep_y+shift_y, width, height);
+
+  /* the exposed columns */
+  if (shift_x != 0) {
+    strip = slice_get_region(parent_ds, start, duration, gate, pixel_size, view_volume,
+			     (shift_x > 0) ? width : 0, 0, ABS(shift_x), dim.y);
+    if (strip == NULL) {
+      amitk_object_unref(slice);
+      return NULL;
+    }
+    slice_copy_region(slice, (shift_x > 0) ? width : 0, 0, strip, 0, 0, ABS(shift_x), dim.y);
+    amitk_object_unref(strip);
+  }
+
+  /* and the exposed rows not covered by the exposed columns */
+  if (shift_y != 0) {
+    strip = slice_get_region(parent_ds, start, duration, gate, pixel_size, view_volume,
+			     keep_x, (shift_y > 0) ? height : 0, width, ABS(shift_y));
+    if (strip == NULL) {
+      amitk_object_unref(slice);
+      return NULL;
+    }
+    slice_copy_region(slice, keep_x, (shift_y > 0) ? height : 0, strip, 0, 0, width, ABS(shift_y));
+    amitk_object_unref(strip);
+  }
+
+  return slice;
+}
+
 /* function to perform the given operation on a single data set
    parameter0 and parameter1 are used by some operations, for instance for the
    threshold operation, values below parameter0 are set to 0, values above
@@ -5753,7 +6281,7 @@ AmitkDataSet * amitk_data_sets_math_unary(AmitkDataSet * ds1,
   output_ds = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(ds1), 
 					   format, i_dim, AMITK_SCALING_TYPE_0D);
   if (output_ds == NULL) {
-    g_warning(_("couldn't allocate %d MB for the output_ds data set structure"),
+    g_warning(_("couldn't allocate %" G_GUINT64_FORMAT " MB for the output_ds data set structure"),
 	      amitk_raw_format_calc_num_bytes(i_dim, format)/(1024*1024));
     goto error;
   }
@@ -5991,7 +6519,7 @@ AmitkDataSet * amitk_data_sets_math_binary(AmitkDataSet * ds1,
   output_ds = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(ds1), 
 					   AMITK_FORMAT_FLOAT, i_dim, AMITK_SCALING_TYPE_0D);
   if (output_ds == NULL) {
-    g_warning(_("couldn't allocate %d MB for the output_ds data set structure"),
+    g_warning(_("couldn't allocate %" G_GUINT64_FORMAT " MB for the output_ds data set structure"),
 	      amitk_raw_format_calc_num_bytes(i_dim, AMITK_FORMAT_FLOAT)/(1024*1024));
     goto error;
   }
@@ -516,6 +516,14 @@ void           amitk_data_set_slice_calc_min_max (AmitkDataSet * ds,
 						  const amide_intpoint_t z,
 						  amitk_format_DOUBLE_t * pmin,
 						  amitk_format_DOUBLE_t * pmax);
+void           amitk_data_set_get_plane          (const AmitkDataSet * ds,
+						  const amide_intpoint_t frame,
+						  const amide_intpoint_t gate,
+						  const amide_intpoint_t z,
+						  amide_data_t * values);
+void           amitk_data_set_get_voxel_series   (const AmitkDataSet * ds,
+						  const AmitkVoxel voxel,
+						  amide_data_t * values);
 amide_data_t   amitk_data_set_get_max            (AmitkDataSet * ds, 
 						  const amide_time_t start, 
 						  const amide_time_t duration);
@@ -527,6 +535,13 @@ void           amitk_data_set_get_thresholding_min_max(AmitkDataSet * ds,
 						       const amide_time_t start,
 						       const amide_time_t duration,
 						       amide_data_t * min, amide_data_t * max);
+AmitkRawData * amitk_data_set_bin_distribution    (const AmitkDataSet * ds,
+						   const amide_intpoint_t stride,
+						   AmitkUpdateFunc update_func,
+						   gpointer update_data);
+gboolean       amitk_data_set_has_distribution    (const AmitkDataSet * ds);
+void           amitk_data_set_set_distribution    (AmitkDataSet * ds,
+						   AmitkRawData * distribution);
 void           amitk_data_set_calc_distribution   (AmitkDataSet * ds, 
 						   AmitkUpdateFunc update_func,
 						   gpointer update_data);
@@ -573,11 +588,21 @@ AmitkDataSet * amitk_data_set_get_slice           (AmitkDataSet * ds,
 						   const amide_intpoint_t gate,
 						   const AmitkCanvasPoint pixel_size,
 						   const AmitkVolume * slice_volume);
+AmitkDataSet * amitk_data_set_get_shifted_slice   (AmitkDataSet * old_slice,
+						   const amide_time_t start,
+						   const amide_time_t duration,
+						   const amide_intpoint_t gate,
+						   const AmitkCanvasPoint pixel_size,
+						   const AmitkVolume * view_volume,
+						   const amide_intpoint_t shift_x,
+						   const amide_intpoint_t shift_y);
 void           amitk_data_set_get_line_profile    (AmitkDataSet * ds,
 						   const amide_time_t start,
 						   const amide_time_t duration,
 						   const AmitkPoint start_point,
 						   const AmitkPoint end_point,
+						   const amide_real_t width,
+						   const AmitkPoint width_axis,
 						   GPtrArray ** preturn_data);
 
 
@@ -595,6 +620,13 @@ GList *        amitk_data_sets_get_slices            (GList * objects,
 						      const amide_intpoint_t gate,
 						      const AmitkCanvasPoint pixel_size,
 						      const AmitkVolume * view_volume);
+GPtrArray *    amitk_data_sets_get_line_profiles     (GList * objects,
+						      const amide_time_t start,
+						      const amide_time_t duration,
+						      const AmitkPoint start_point,
+						      const AmitkPoint end_point,
+						      const amide_real_t width,
+						      const AmitkPoint width_axis);
 AmitkDataSet * amitk_data_sets_find_with_slice_parent(GList * slices, 
 						      const AmitkDataSet * slice_parent);
 GList *        amitk_data_sets_remove_with_slice_parent(GList * slices,
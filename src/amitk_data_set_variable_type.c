@@ -77,13 +77,60 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_s
   return;
 }
 
-/* generate the distribution array for a data_set */
-void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_distribution(AmitkDataSet * data_set,
-									    AmitkUpdateFunc update_func,
-									    gpointer update_data) {
+/* copies the values of a plane of the data set into values (dim.x*dim.y long), 
+   straight from the raw data */
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'get_plane(const AmitkDataSet * data_set,
+										    const amide_intpoint_t frame,
+										    const amide_intpoint_t gate,
+										    const amide_intpoint_t z,
+										    amide_data_t * values) {
+
+  AmitkVoxel i;
+  AmitkVoxel dim;
+  
+  dim = AMITK_DATA_SET_DIM(data_set);
+
+  i.t = frame;
+  i.g = gate;
+  i.z = z;
+
+  for (i.y = 0; i.y < dim.y; i.y++) 
+    for (i.x = 0; i.x < dim.x; i.x++, values++) 
+      *values = AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set, i);
+
+  return;
+}
+
+/* copies the values of the given voxel in every frame and gate into values,
+   which needs to be dim.t*dim.g long, gates varying fastest */
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'get_voxel_series(const AmitkDataSet * data_set,
+											   const AmitkVoxel voxel,
+											   amide_data_t * values) {
+
+  AmitkVoxel i;
+  AmitkVoxel dim;
+  
+  dim = AMITK_DATA_SET_DIM(data_set);
+  i = voxel;
+
+  for (i.t = 0; i.t < dim.t; i.t++) 
+    for (i.g = 0; i.g < dim.g; i.g++, values++) 
+      *values = AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set, i);
+
+  return;
+}
+
+/* bin the data set into a log scaled distribution array, only looking at every
+   stride'th voxel in x, y, and z.  The data set isn't modified, so this can be
+   run off the main thread as long as the global min/max are already known.
+   Returns NULL if update_func asks us to quit. */
+AmitkRawData * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'bin_distribution(const AmitkDataSet * data_set,
+												    const amide_intpoint_t stride,
+												    AmitkUpdateFunc update_func,
+												    gpointer update_data) {
 
   AmitkVoxel i,j;
-  amide_data_t scale, diff;
+  amide_data_t scale, diff, global_min;
   AmitkVoxel distribution_dim;
   AmitkVoxel data_set_dim;
   gchar * temp_string;
@@ -94,11 +141,9 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
   gboolean continue_work=TRUE;
   AmitkRawData * distribution;
 
-  if (data_set->distribution != NULL)
-    return;
-
   data_set_dim = AMITK_DATA_SET_DIM(data_set);
-  diff = amitk_data_set_get_global_max(data_set) - amitk_data_set_get_global_min(data_set);
+  global_min = data_set->global_min;
+  diff = data_set->global_max - global_min;
   if (diff == 0.0)
     scale = 0.0;
   else
@@ -109,7 +154,7 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
   distribution = amitk_raw_data_new_with_data(AMITK_FORMAT_DOUBLE, distribution_dim);
   if (distribution == NULL) {
     g_warning(_("couldn't allocate memory space for the data set structure to hold distribution data"));
-    return;
+    return NULL;
   }
 
   /* initialize the distribution array */
@@ -120,7 +165,7 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
     continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
     g_free(temp_string);
   }
-  total_planes = AMITK_DATA_SET_TOTAL_PLANES(data_set);
+  total_planes = data_set_dim.t*data_set_dim.g*((data_set_dim.z+stride-1)/stride);
   divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
 
   /* now "bin" the data */
@@ -128,16 +173,16 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
   i_plane=0;
   for (i.t = 0; (i.t < data_set_dim.t) && continue_work; i.t++) {
     for (i.g = 0; (i.g < data_set_dim.g) && continue_work; i.g++) {
-      for ( i.z = 0; (i.z < data_set_dim.z) && continue_work; i.z++, i_plane++) {
+      for ( i.z = 0; (i.z < data_set_dim.z) && continue_work; i.z += stride, i_plane++) {
 	if (update_func != NULL) {
 	  x = div(i_plane,divider);
 	  if (x.rem == 0)
 	    continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
 	}
 
-	for (i.y = 0; i.y < data_set_dim.y; i.y++) 
-	  for (i.x = 0; i.x < data_set_dim.x; i.x++) {
-	    j.x = scale*(AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,i)-amitk_data_set_get_global_min(data_set));
+	for (i.y = 0; i.y < data_set_dim.y; i.y += stride) 
+	  for (i.x = 0; i.x < data_set_dim.x; i.x += stride) {
+	    j.x = scale*(AMITK_DATA_SET_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'CONTENT(data_set,i)-global_min);
 	    AMITK_RAW_DATA_DOUBLE_SET_CONTENT(distribution,j) += 1.0;
 	  }
       }
@@ -145,22 +190,21 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_`'m4_Intercept`'calc_d
   }
 
   if (update_func != NULL) /* remove progress bar */
-    continue_work = (*update_func)(update_data, NULL, (gdouble) 2.0); 
+    continue_work = (*update_func)(update_data, NULL, (gdouble) 2.0) && continue_work; 
 
   if (!continue_work) {   /* if we quit, get out of here */
     g_object_unref(distribution);
-    return;
+    return NULL;
   }
   
+
   /* do some log scaling so the distribution is more meaningful, and doesn't get
      swamped by outlyers */
   for (j.x = 0; j.x < distribution_dim.x ; j.x++) 
     AMITK_RAW_DATA_DOUBLE_SET_CONTENT(distribution,j) = 
       log10(AMITK_RAW_DATA_DOUBLE_CONTENT(distribution,j)+1.0);
 
-  /* and store the distribution with the data set */
-  data_set->distribution = distribution;
-  return;
+  return distribution;
 }
 
 
@@ -83,12 +83,30 @@ void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_calc_slice_m
 										       const amide_intpoint_t z,
 										       amitk_format_DOUBLE_t * pmin,
 										       amitk_format_DOUBLE_t * pmax);
-void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_calc_distribution(AmitkDataSet * data_set,
-									     AmitkUpdateFunc update_func,
-									    gpointer update_data);
-void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_calc_distribution(AmitkDataSet * data_set,
-										      AmitkUpdateFunc update_func,
-										      gpointer update_data);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_get_plane(const AmitkDataSet * data_set,
+								     const amide_intpoint_t frame,
+								     const amide_intpoint_t gate,
+								     const amide_intpoint_t z,
+								     amide_data_t * values);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_get_plane(const AmitkDataSet * data_set,
+									       const amide_intpoint_t frame,
+									       const amide_intpoint_t gate,
+									       const amide_intpoint_t z,
+									       amide_data_t * values);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_get_voxel_series(const AmitkDataSet * data_set,
+									    const AmitkVoxel voxel,
+									    amide_data_t * values);
+void amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_get_voxel_series(const AmitkDataSet * data_set,
+										      const AmitkVoxel voxel,
+										      amide_data_t * values);
+AmitkRawData * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_bin_distribution(const AmitkDataSet * data_set,
+										     const amide_intpoint_t stride,
+										     AmitkUpdateFunc update_func,
+										     gpointer update_data);
+AmitkRawData * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_INTERCEPT_bin_distribution(const AmitkDataSet * data_set,
+											       const amide_intpoint_t stride,
+											       AmitkUpdateFunc update_func,
+											       gpointer update_data);
 AmitkDataSet * amitk_data_set_`'m4_Variable_Type`'_`'m4_Scale_Dim`'_get_slice(AmitkDataSet * data_set,
 									      const amide_time_t start_time,
 									      const amide_time_t duration,
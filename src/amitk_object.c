@@ -1190,6 +1190,7 @@ void amitk_objects_write_xml(GList * objects, xmlNodePtr node_list, FILE * study
   guint64 size;
 
   if (objects == NULL) return;
+  if (amitk_raw_data_write_cancelled()) return; /* save's been abandoned */
 
   amitk_object_write_xml(objects->data, study_file, &object_filename, 
 			 &location, &size);
@@ -1211,28 +1212,26 @@ void amitk_objects_write_xml(GList * objects, xmlNodePtr node_list, FILE * study
 
 GList * amitk_objects_read_xml(xmlNodePtr node_list, FILE * study_file, gchar **perror_buf) {
 
-  GList * objects;
+  GList * objects=NULL;
   AmitkObject * object;
-  gchar * filename=NULL;
+  gchar * filename;
   guint64 location;
   guint64 size;
 
-  if (node_list == NULL) return NULL;
-
-  /* recurse */
-  objects = amitk_objects_read_xml(node_list->next, study_file, perror_buf);
-
-  /* and add this node */
-  if (study_file == NULL)
-    filename = xml_get_string(node_list, "object_file");
-  else
-    xml_get_location_and_size(node_list, "object_location_and_size", &location, &size, perror_buf);
-
-  object = amitk_object_read_xml(filename, study_file, location, size, perror_buf);
-  if (object != NULL) objects = g_list_prepend(objects, object);
-  if (filename != NULL) g_free(filename);
+  /* iterate rather than recurse, studies can have a lot of objects */
+  for (; node_list != NULL; node_list = node_list->next) {
+    filename = NULL;
+    if (study_file == NULL)
+      filename = xml_get_string(node_list, "object_file");
+    else
+      xml_get_location_and_size(node_list, "object_location_and_size", &location, &size, perror_buf);
+
+    object = amitk_object_read_xml(filename, study_file, location, size, perror_buf);
+    if (object != NULL) objects = g_list_prepend(objects, object);
+    if (filename != NULL) g_free(filename);
+  }
   
-  return objects;
+  return g_list_reverse(objects);
 }
 
 
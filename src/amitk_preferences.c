@@ -153,6 +153,11 @@ static void preferences_init (AmitkPreferences * preferences) {
   preferences->prompt_for_save_on_exit = 
     amide_gconf_get_bool_with_default(GCONF_AMIDE_MISC,"prompt-for-save-on-exit", AMITK_PREFERENCES_DEFAULT_PROMPT_FOR_SAVE_ON_EXIT);
 
+  preferences->save_xif_compressed = 
+    amide_gconf_get_bool_with_default(GCONF_AMIDE_MISC,"save-xif-compressed", AMITK_PREFERENCES_DEFAULT_SAVE_XIF_COMPRESSED);
+  amitk_raw_data_set_xif_compression(preferences->save_xif_compressed ? 
+				     AMITK_RAW_COMPRESSION_ZLIB_SHUFFLE : AMITK_RAW_COMPRESSION_NONE);
+
   preferences->which_default_directory = 
     amide_gconf_get_int_with_default(GCONF_AMIDE_MISC,"which-default-directory", AMITK_PREFERENCES_DEFAULT_WHICH_DEFAULT_DIRECTORY);
 
@@ -335,6 +340,20 @@ void amitk_preferences_set_prompt_for_save_on_exit(AmitkPreferences * preference
   return;
 }
 
+void amitk_preferences_set_xif_compressed(AmitkPreferences * preferences, gboolean new_value) {
+
+  g_return_if_fail(AMITK_IS_PREFERENCES(preferences));
+
+  if (AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(preferences) != new_value) {
+    preferences->save_xif_compressed = new_value;
+    amide_gconf_set_bool(GCONF_AMIDE_MISC,"save-xif-compressed",new_value);
+    amitk_raw_data_set_xif_compression(new_value ? 
+				       AMITK_RAW_COMPRESSION_ZLIB_SHUFFLE : AMITK_RAW_COMPRESSION_NONE);
+    g_signal_emit(G_OBJECT(preferences), preferences_signals[MISC_PREFERENCES_CHANGED], 0);
+  }
+  return;
+}
+
 void amitk_preferences_set_which_default_directory(AmitkPreferences * preferences, AmitkWhichDefaultDirectory new_value) {
 
   g_return_if_fail(AMITK_IS_PREFERENCES(preferences));
@@ -43,6 +43,7 @@ G_BEGIN_DECLS
 #define AMITK_PREFERENCES_WARNINGS_TO_CONSOLE(object)     (AMITK_PREFERENCES(object)->warnings_to_console)
 
 #define AMITK_PREFERENCES_PROMPT_FOR_SAVE_ON_EXIT(object) (AMITK_PREFERENCES(object)->prompt_for_save_on_exit)
+#define AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(object)     (AMITK_PREFERENCES(object)->save_xif_compressed)
 #define AMITK_PREFERENCES_WHICH_DEFAULT_DIRECTORY(object) (AMITK_PREFERENCES(object)->which_default_directory)
 #define AMITK_PREFERENCES_DEFAULT_DIRECTORY(object)       (AMITK_PREFERENCES(object)->default_directory)
 
@@ -73,6 +74,7 @@ typedef enum {
 #define AMITK_PREFERENCES_DEFAULT_WARNINGS_TO_CONSOLE FALSE
 #define AMITK_PREFERENCES_DEFAULT_PROMPT_FOR_SAVE_ON_EXIT TRUE
 #define AMITK_PREFERENCES_DEFAULT_SAVE_XIF_AS_DIRECTORY FALSE
+#define AMITK_PREFERENCES_DEFAULT_SAVE_XIF_COMPRESSED FALSE
 #define AMITK_PREFERENCES_DEFAULT_WHICH_DEFAULT_DIRECTORY AMITK_WHICH_DEFAULT_DIRECTORY_NONE
 #define AMITK_PREFERENCES_DEFAULT_DEFAULT_DIRECTORY NULL
 #define AMITK_PREFERENCES_DEFAULT_THRESHOLD_STYLE AMITK_THRESHOLD_STYLE_MIN_MAX
@@ -97,6 +99,7 @@ struct _AmitkPreferences {
   /* file saving preferences */
   gboolean prompt_for_save_on_exit;
   gboolean save_xif_as_directory;
+  gboolean save_xif_compressed;
   AmitkWhichDefaultDirectory which_default_directory;
   gchar * default_directory;
 
@@ -151,6 +154,8 @@ void                amitk_preferences_set_prompt_for_save_on_exit(AmitkPreferenc
 								  gboolean new_value);
 void                amitk_preferences_set_xif_as_directory       (AmitkPreferences * preferences,
 							          gboolean new_value);
+void                amitk_preferences_set_xif_compressed         (AmitkPreferences * preferences,
+							          gboolean new_value);
 void                amitk_preferences_set_which_default_directory(AmitkPreferences * preferences,
 								  const AmitkWhichDefaultDirectory which_default_directory);
 void                amitk_preferences_set_default_directory      (AmitkPreferences * preferences,
@@ -27,13 +27,31 @@
 
 #include <sys/stat.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <gio/gio.h>
 
 #include "amitk_raw_data.h"
 #include "amitk_marshal.h"
 #include "amitk_type_builtins.h"
 #include "amide.h"
 
-#define DATA_CONTENT(data, dim, voxel) ((data)[(voxel).x + (dim).x*(voxel).y])
+/* how much of an ascii file to buffer at a time */
+#define RAW_DATA_ASCII_BUFFER_SIZE 0x100000
+
+/* zlib level used for compressed raw data, low levels are much faster and 
+   still squeeze out the empty background that makes up most of a study */
+#define RAW_DATA_COMPRESSION_LEVEL 3
+
+/* roughly how much data to (de)compress in one go */
+#define RAW_DATA_COMPRESSION_BATCH_BYTES 0x4000000
+
+/* how raw data currently gets written into xif files */
+static AmitkRawCompression xif_compression = AMITK_RAW_COMPRESSION_NONE;
+
+/* lets whoever's writing out raw data from a given thread (e.g. a background
+   study save) abandon the write partway through, see amitk_raw_data_set_write_cancel_flag */
+static GPrivate write_cancel_flag = G_PRIVATE_INIT(NULL);
 
 /* external variables */
 guint amitk_format_sizes[] = {
@@ -214,6 +232,10 @@ static void raw_data_init (AmitkRawData * raw_data) {
   raw_data->dim = zero_voxel;
   raw_data->data = NULL;
   raw_data->format = AMITK_FORMAT_DOUBLE;
+  raw_data->modification = 0;
+  raw_data->shared_from = NULL;
+  raw_data->num_shares = 0;
+  amitk_raw_data_set_modified(raw_data);
 
   return;
 }
@@ -223,6 +245,13 @@ static void raw_data_finalize (GObject *object) {
 
   AmitkRawData * raw_data = AMITK_RAW_DATA(object);
 
+  if (raw_data->shared_from != NULL) { /* the data isn't ours */
+    g_atomic_int_add(&(raw_data->shared_from->num_shares), -1);
+    g_object_unref(raw_data->shared_from);
+    raw_data->shared_from = NULL;
+    raw_data->data = NULL;
+  }
+
   if (raw_data->data != NULL) {
 #ifdef AMIDE_DEBUG
     //g_print("\tfreeing raw data\n");
@@ -323,6 +352,223 @@ AmitkRawData* amitk_raw_data_new_with_data0(AmitkFormat format, AmitkVoxel dim)
 }
 
 
+/* makes a separate copy in memory of the raw data, returns NULL if there
+   isn't enough memory for it */
+AmitkRawData * amitk_raw_data_copy(const AmitkRawData * raw_data) {
+
+  AmitkRawData * copy;
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(raw_data), NULL);
+
+  if ((copy = amitk_raw_data_new_with_data(raw_data->format, raw_data->dim)) == NULL)
+    return NULL;
+  memcpy(copy->data, raw_data->data, (gsize) amitk_raw_data_size_data_mem(raw_data));
+
+  copy->xif_file_dev = raw_data->xif_file_dev;
+  copy->xif_file_ino = raw_data->xif_file_ino;
+  copy->xif_location = raw_data->xif_location;
+  copy->xif_size = raw_data->xif_size;
+
+  return copy;
+}
+
+/* makes a stand in for raw data that's already stored in an xif flat file, for
+   writing out a study that gets appended to that file.  It has the dimensions,
+   format and location of the original, but none of the data itself */
+AmitkRawData * amitk_raw_data_copy_xif_reference(const AmitkRawData * raw_data) {
+
+  AmitkRawData * copy;
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(raw_data), NULL);
+  g_return_val_if_fail(raw_data->xif_size != 0, NULL);
+
+  copy = amitk_raw_data_new();
+  copy->format = raw_data->format;
+  copy->dim = raw_data->dim;
+  copy->xif_file_dev = raw_data->xif_file_dev;
+  copy->xif_file_ino = raw_data->xif_file_ino;
+  copy->xif_location = raw_data->xif_location;
+  copy->xif_size = raw_data->xif_size;
+
+  return copy;
+}
+
+
+
+
+/* makes a read only view of the raw data, for writing it out from another
+   thread without copying it.  While any view is around, the raw data counts
+   as shared (AMITK_RAW_DATA_SHARED), and anything that wants to change the
+   data in place needs to switch over to its own copy first */
+AmitkRawData * amitk_raw_data_share(AmitkRawData * raw_data) {
+
+  AmitkRawData * view;
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(raw_data), NULL);
+
+  view = amitk_raw_data_new();
+  view->format = raw_data->format;
+  view->dim = raw_data->dim;
+  view->data = raw_data->data;
+  view->xif_file_dev = raw_data->xif_file_dev;
+  view->xif_file_ino = raw_data->xif_file_ino;
+  view->xif_location = raw_data->xif_location;
+  view->xif_size = raw_data->xif_size;
+
+  view->shared_from = g_object_ref(raw_data);
+  g_atomic_int_inc(&(raw_data->num_shares));
+
+  return view;
+}
+
+
+/* in place byte order conversions, written as plain loops over whole 
+   planes so the compiler can vectorize them */
+static void raw_data_swap_16(guint16 * data, gsize num_units) {
+
+  gsize i;
+
+  for (i=0; i < num_units; i++)
+    data[i] = GUINT16_SWAP_LE_BE(data[i]);
+
+  return;
+}
+
+static void raw_data_swap_32(guint32 * data, gsize num_units) {
+
+  gsize i;
+
+  for (i=0; i < num_units; i++)
+    data[i] = GUINT32_SWAP_LE_BE(data[i]);
+
+  return;
+}
+
+static void raw_data_swap_64(guint64 * data, gsize num_units) {
+
+  gsize i;
+
+  for (i=0; i < num_units; i++)
+    data[i] = GUINT64_SWAP_LE_BE(data[i]);
+
+  return;
+}
+
+static void raw_data_swap_32_pdp(guint32 * data, gsize num_units) {
+
+  gsize i;
+
+  for (i=0; i < num_units; i++)
+    data[i] = GUINT32_FROM_PDP(data[i]);
+
+  return;
+}
+
+/* reverses the byte order of each voxel */
+static void raw_data_swap_bytes(guchar * data, gsize num_units, gsize bytes_per_unit) {
+
+  switch(bytes_per_unit) {
+  case 2:
+    raw_data_swap_16((guint16 *) data, num_units);
+    break;
+  case 4:
+    raw_data_swap_32((guint32 *) data, num_units);
+    break;
+  case 8:
+    raw_data_swap_64((guint64 *) data, num_units);
+    break;
+  default:
+    break;
+  }
+
+  return;
+}
+
+/* converts data read straight off disk in the given raw format into our in memory format, in place */
+static void raw_data_convert_in_place(gpointer data, gsize num_units, AmitkRawFormat raw_format) {
+
+  switch(raw_format) {
+  case AMITK_RAW_FORMAT_UINT_32_PDP:
+  case AMITK_RAW_FORMAT_SINT_32_PDP:
+  case AMITK_RAW_FORMAT_FLOAT_32_PDP:
+    raw_data_swap_32_pdp(data, num_units);
+    break;
+  case AMITK_RAW_FORMAT_UBYTE_8_NE:
+  case AMITK_RAW_FORMAT_SBYTE_8_NE:
+  case AMITK_RAW_FORMAT_ASCII_8_NE:
+    break;
+  default:
+    /* everything else is just little or big endian */
+    if (raw_format != amitk_format_to_raw_format(amitk_raw_format_to_format(raw_format)))
+      raw_data_swap_bytes(data, num_units, amitk_raw_format_sizes[raw_format]);
+    break;
+  }
+
+  return;
+}
+
+
+/* buffered reader for whitespace separated ascii numbers, a good deal faster than fscanf */
+typedef struct {
+  FILE * file;
+  gchar * buffer; /* has room for a terminating null */
+  gsize size;
+  gsize pos;
+  gboolean eof;
+} raw_data_ascii_reader_t;
+
+static void raw_data_ascii_reader_fill(raw_data_ascii_reader_t * reader) {
+
+  gsize remaining;
+
+  /* keep whatever we haven't used yet */
+  remaining = reader->size - reader->pos;
+  memmove(reader->buffer, reader->buffer+reader->pos, remaining);
+  reader->size = remaining;
+  reader->pos = 0;
+
+  reader->size += fread(reader->buffer+reader->size, 1, RAW_DATA_ASCII_BUFFER_SIZE-reader->size, reader->file);
+  if (reader->size < RAW_DATA_ASCII_BUFFER_SIZE) reader->eof = TRUE;
+  reader->buffer[reader->size] = '\0';
+
+  return;
+}
+
+/* reads the next number, returns FALSE on EOF or if the next thing isn't a number */
+static gboolean raw_data_ascii_reader_next(raw_data_ascii_reader_t * reader, gdouble * pvalue) {
+
+  gsize end;
+  gchar * endptr;
+  gchar saved;
+
+  /* skip whitespace */
+  do {
+    while ((reader->pos < reader->size) && g_ascii_isspace(reader->buffer[reader->pos]))
+      reader->pos++;
+    if ((reader->pos == reader->size) && !reader->eof) 
+      raw_data_ascii_reader_fill(reader);
+  } while ((reader->pos == reader->size) && !reader->eof);
+  if (reader->pos == reader->size) return FALSE;
+
+  /* make sure we've got the whole token in the buffer */
+  end = reader->pos;
+  while ((end < reader->size) && !g_ascii_isspace(reader->buffer[end])) end++;
+  if ((end == reader->size) && !reader->eof) {
+    end -= reader->pos;
+    raw_data_ascii_reader_fill(reader);
+    while ((end < reader->size) && !g_ascii_isspace(reader->buffer[end])) end++;
+  }
+
+  saved = reader->buffer[end];
+  reader->buffer[end] = '\0';
+  *pvalue = g_ascii_strtod(reader->buffer+reader->pos, &endptr);
+  reader->buffer[end] = saved;
+
+  if (endptr == reader->buffer+reader->pos) return FALSE;
+  reader->pos = endptr - reader->buffer;
+
+  return TRUE;
+}
 
 
 /* reads the contents of a raw data file into an amide raw data structure,
@@ -332,6 +578,8 @@ AmitkRawData* amitk_raw_data_new_with_data0(AmitkFormat format, AmitkVoxel dim)
    1. file_offset is bytes for a binary file, lines for an ascii file
    2. either file_name, of existing_file need to be specified.  
       If existing_file is not being used, it must be NULL
+   3. binary data is read straight into the raw data in large chunks of 
+      planes, and then converted in place
 */
 AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name, 
 					      FILE * existing_file,
@@ -343,27 +591,31 @@ AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name,
 
   FILE * new_file_pointer=NULL;
   FILE * file_pointer=NULL;
-  void * file_buffer=NULL;
-  size_t bytes_per_slice=0;
-  size_t bytes_read;
-  AmitkVoxel i;
-  gint error_code, j;
+  raw_data_ascii_reader_t reader;
   AmitkRawData * raw_data=NULL;;
   gchar * temp_string;
-  gint total_planes;
-  gint i_plane;
-  div_t x;
-  gint divider;
+  guint64 total_planes;
+  guint64 i_plane;
+  guint64 divider;
+  guint64 planes_per_read, num_planes;
+  guint64 i_voxel, voxels_per_plane;
+  guint64 bytes_per_plane;
+  gsize bytes_to_read, bytes_read;
+  gdouble value;
+  guchar * plane;
+  gint j;
   gboolean continue_work = TRUE;
 
   g_return_val_if_fail((file_name != NULL) || (existing_file != NULL), NULL);
 
+  reader.buffer = NULL;
+
   if (update_func != NULL) {
     temp_string = g_strdup_printf(_("Reading: %s"), (file_name != NULL) ? file_name : "raw data");
     continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
     g_free(temp_string);
   }
-  total_planes = dim.z*dim.t*dim.g;
+  total_planes = ((guint64) dim.z)*((guint64) dim.t)*((guint64) dim.g);
   divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
 
   raw_data = amitk_raw_data_new_with_data(amitk_raw_format_to_format(raw_format), dim);
@@ -390,368 +642,73 @@ AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name,
     file_pointer = existing_file;
   }
   
-  /* jump forward by the given offset */
+  voxels_per_plane = ((guint64) dim.x)*((guint64) dim.y);
+
   if (raw_format == AMITK_RAW_FORMAT_ASCII_8_NE) {
+    reader.file = file_pointer;
+    reader.size = reader.pos = 0;
+    reader.eof = FALSE;
+    if ((reader.buffer = g_try_malloc(RAW_DATA_ASCII_BUFFER_SIZE+1)) == NULL) {
+      g_warning(_("couldn't malloc %zd bytes for file buffer\n"), (gsize) RAW_DATA_ASCII_BUFFER_SIZE+1);
+      goto error_condition;
+    }
+
+    /* jump forward by the given offset */
     for (j=0; j<file_offset; j++)
-      if ((error_code = fscanf(file_pointer, "%*f")) < 0) { /*EOF is usually -1 */
-	g_warning(_("could not step forward %d elements in raw data file:\n\treturned error: %d"),
-		  j+1, error_code);
+      if (!raw_data_ascii_reader_next(&reader, &value)) {
+	g_warning(_("could not step forward %d elements in raw data file"), j+1);
 	goto error_condition;
+      }
+
+    /* and read in the values */
+    for (i_plane=0; (i_plane < total_planes) && (continue_work); i_plane++) {
+      if ((update_func != NULL) && ((i_plane % divider) == 0))
+	continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
+
+      for (i_voxel=i_plane*voxels_per_plane; i_voxel < (i_plane+1)*voxels_per_plane; i_voxel++) {
+	if (!raw_data_ascii_reader_next(&reader, &value)) {
+	  g_warning(_("could not read ascii file after %" G_GUINT64_FORMAT " elements, file or parameters are erroneous"),
+		    i_voxel);
+	  goto error_condition;
+	}
+	if (raw_data->format == AMITK_FORMAT_DOUBLE)
+	  ((amitk_format_DOUBLE_t *) raw_data->data)[i_voxel] = value;
+	else // (raw_data->format == FLOAT)
+	  ((amitk_format_FLOAT_t *) raw_data->data)[i_voxel] = value;
+      }
     }
+
   } else { /* binary */
     if (fseek(file_pointer, file_offset, SEEK_SET) != 0) {
       g_warning(_("could not seek forward %ld bytes in raw data file"),file_offset);
       goto error_condition;
     }
-  }
-    
-  /* read in the contents of the file */
-  if (raw_format != AMITK_RAW_FORMAT_ASCII_8_NE) { /* ASCII handled in the loop below */
-    bytes_per_slice = amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format);
-    if ((file_buffer = (void *) g_try_malloc(bytes_per_slice)) == NULL) {
-      g_warning(_("couldn't malloc %zd bytes for file buffer\n"), bytes_per_slice);
-      goto error_condition;
-    }
-  }
 
-  /* iterate over the # of frames */
-  error_code = 1;
-  i_plane=0;
-  for (i.t = 0; (i.t < dim.t) && (error_code >= 0) && (continue_work); i.t++) {
-    for (i.g = 0; (i.g < dim.g) && (error_code >= 0) && (continue_work); i.g++) {
-      for (i.z = 0; (i.z < dim.z) && (error_code >= 0) && (continue_work);  i.z++, i_plane++) {
-
-	if (update_func != NULL) {
-	  
-	  x = div(i_plane,divider);
-	  if (x.rem == 0)
-	    continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
-	}
+    /* read as many planes at a time as fit within a read chunk (<=16MB, see
+       amitk_raw_data_write_xml), straight into place */
+    bytes_per_plane = amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format);
+    planes_per_read = MAX(1, 0x1000000/bytes_per_plane);
+    planes_per_read = MIN(planes_per_read, divider);
 
-	/* read in the contents of the file */
-	if (raw_format != AMITK_RAW_FORMAT_ASCII_8_NE) { /* ASCII handled in the loop below */
-	  bytes_read = fread(file_buffer, 1, bytes_per_slice, file_pointer );
-	  if (bytes_read != bytes_per_slice) {
-	    g_warning(_("read wrong # of elements from raw data, expected %zd, got %zd"), bytes_per_slice, bytes_read);
-	    goto error_condition;
-	  }
-	}
-	
-	
-	/* and convert the data */
-	switch (raw_format) {
-	  
-	case AMITK_RAW_FORMAT_ASCII_8_NE:
-	  
-	  /* copy this frame into the data set */
-	  i.x = 0;
-	  for (i.y = 0; (i.y < dim.y) && (error_code >= 0); i.y++) {
-	    for (i.x = 0; (i.x < dim.x) && (error_code >= 0); i.x++) {
-	      if (raw_data->format == AMITK_FORMAT_DOUBLE)
-		error_code = fscanf(file_pointer, "%lf", AMITK_RAW_DATA_DOUBLE_POINTER(raw_data,i));
-	      else // (raw_data->format == FLOAT)
-		error_code = fscanf(file_pointer, "%f", AMITK_RAW_DATA_FLOAT_POINTER(raw_data,i));
-	      if (error_code == 0) error_code = EOF; /* if we couldn't read, may as well be EOF*/
-	    }
-	  }
-	  
-	  if (error_code < 0) { /* EOF = -1 (usually) */
-	    g_warning(_("could not read ascii file after %d elements, file or parameters are erroneous"),
-		      i.x + 
-		      dim.x*i.y +
-		      dim.x*dim.y*i_plane);
-	    goto error_condition;
-	  }
-	
-	  break;
-	
-	case AMITK_RAW_FORMAT_FLOAT_32_PDP:
-	  {
-	    guint32 * data = file_buffer;
-	    guint32 temp;
-	    gfloat * float_p;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-		/* keep compiler from generating bad code with a noop,occurs with gcc 3.0.3 */
-		if (i.x == -1) g_print("no_op\n");
-		
-		temp = GUINT32_FROM_PDP(DATA_CONTENT(data, dim,i));
-		float_p = (void *) &temp;
-		AMITK_RAW_DATA_FLOAT_SET_CONTENT(raw_data,i) = *float_p;
-	      }
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_SINT_32_PDP:
-	  {
-	    gint32 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_SINT_SET_CONTENT(raw_data,i) = 
-		  GINT32_FROM_PDP(DATA_CONTENT(data, dim,i));
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_UINT_32_PDP:
-	  {
-	    guint32 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-		/* keep compiler from generating bad code with a noop,occurs with gcc 3.0.3 */
-		if (i.x == -1) g_print("no_op\n");
-		
-		AMITK_RAW_DATA_UINT_SET_CONTENT(raw_data,i) = 
-		  GUINT32_FROM_PDP(DATA_CONTENT(data, dim,i));
-	      }
-	  }
-	  break;
-	  
-	case AMITK_RAW_FORMAT_DOUBLE_64_BE: 
-	  {
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-	    guint64 * data = file_buffer;
-	    guint64 temp;
-	    gdouble * double_p;
-#else
-#if (G_BYTE_ORDER == G_BIG_ENDIAN)
-	    gdouble * data = file_buffer;
-#else
-#error "need to specify G_BIG_ENDIAN or G_LITTLE_ENDIAN"	
-#endif
-#endif
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-		temp = GUINT64_FROM_BE(DATA_CONTENT(data, dim, i));
-		double_p = (void *) &temp;
-		if (i.x == -1) g_print("no op\n"); /* gets around compiler bug in gcc 4.1.2-27 */
-		AMITK_RAW_DATA_DOUBLE_SET_CONTENT(raw_data,i) = *double_p;
-#else /* G_BIG_ENDIAN */
-		AMITK_RAW_DATA_DOUBLE_SET_CONTENT(raw_data,i) = DATA_CONTENT(data, dim, i);
-#endif
-              }
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_FLOAT_32_BE:
-	  {
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-	    guint32 * data = file_buffer;
-	    guint32 temp;
-	    gfloat * float_p;
-#else /* (G_BYTE_ORDER == G_BIG_ENDIAN) */
-	    gfloat * data = file_buffer;
-#endif
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-		/* keep compiler from generating bad code with a noop, occurs with gcc 3.0.3 */
-		if (i.x == -1) g_print("no op\n");
-		
-#if (G_BYTE_ORDER == G_LITTLE_ENDIAN)
-		temp = GUINT32_FROM_BE(DATA_CONTENT(data, dim, i));
-		float_p = (void *) &temp;
-		if (i.x == -1) g_print("no op\n"); /* gets around compiler bug in gcc 4.1.2-27 */
-		AMITK_RAW_DATA_FLOAT_SET_CONTENT(raw_data,i) = *float_p;
-#else /* G_BIG_ENDIAN */
-		AMITK_RAW_DATA_FLOAT_SET_CONTENT(raw_data,i) = DATA_CONTENT(data, dim, i);
-#endif
-	      }
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_SINT_32_BE:
-	  {
-	    gint32 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_SINT_SET_CONTENT(raw_data,i) = 
-		  GINT32_FROM_BE(DATA_CONTENT(data, dim, i));
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_UINT_32_BE:
-	  {
-	    guint32 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-		/* keep compiler from generating bad code with a noop occurs with gcc 3.0.3 */
-		if (i.x == -1) g_print("no op\n");
-		
-		AMITK_RAW_DATA_UINT_SET_CONTENT(raw_data,i) = 
-		  GUINT32_FROM_BE(DATA_CONTENT(data, dim, i));
-	      }
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_SSHORT_16_BE:
-	  {
-	    gint16 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_SSHORT_SET_CONTENT(raw_data,i) = 
-		  GINT16_FROM_BE(DATA_CONTENT(data, dim, i));
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_USHORT_16_BE:
-	  {
-	    guint16 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_USHORT_SET_CONTENT(raw_data,i) =
-		  GUINT16_FROM_BE(DATA_CONTENT(data, dim, i));
-	  }
-	  break;
-	  
-	  
-	  
-	  
-	case AMITK_RAW_FORMAT_DOUBLE_64_LE:
-	  {
-#if (G_BYTE_ORDER == G_BIG_ENDIAN)
-	    guint64 * data = file_buffer;
-	    guint64 temp;
-	    gdouble * double_p;
-#else /* (G_BYTE_ORDER == G_LITTLE_ENDIAN) */
-	    gdouble * data = file_buffer;
-#endif
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-#if (G_BYTE_ORDER == G_BIG_ENDIAN)
-		temp = GUINT64_FROM_LE(DATA_CONTENT(data, dim, i));
-		double_p = (void *) &temp;
-		if (i.x == -1) g_print("no op\n"); /* gets around compiler bug in gcc 4.1.2-27 */
-		AMITK_RAW_DATA_DOUBLE_SET_CONTENT(raw_data,i) = *double_p;
-#else /* G_LITTLE_ENDIAN */
-		AMITK_RAW_DATA_DOUBLE_SET_CONTENT(raw_data,i) = DATA_CONTENT(data, dim, i);
-#endif
-	      }
-
-	  }
-	  break;
-	  
-	  
-	  
-	  
-	case AMITK_RAW_FORMAT_FLOAT_32_LE:
-	  {
-#if (G_BYTE_ORDER == G_BIG_ENDIAN)
-	    guint32 * data = file_buffer;
-	    guint32 temp;
-	    gfloat * float_p;
-#else /* (G_BYTE_ORDER == G_LITTLE_ENDIAN) */
-	    gfloat * data = file_buffer;
-#endif
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-		
-		/* keep compiler from generating bad code with a noop,occurs with gcc 3.0.3 */
-		if (i.x == -1) g_print("no op\n");
-		
-#if (G_BYTE_ORDER == G_BIG_ENDIAN)
-		temp = GUINT32_FROM_LE(DATA_CONTENT(data, dim, i));
-		float_p = (void *) &temp;
-		if (i.x == -1) g_print("no op\n"); /* gets around compiler bug in gcc 4.1.2-27 */
-		AMITK_RAW_DATA_FLOAT_SET_CONTENT(raw_data,i) = *float_p;
-#else /* G_LITTLE_ENDIAN */
-		AMITK_RAW_DATA_FLOAT_SET_CONTENT(raw_data,i) = DATA_CONTENT(data, dim, i);
-#endif
-	      }
-	  }
-	  break;
-	  
-
-	  
-	  
-	case AMITK_RAW_FORMAT_SINT_32_LE:
-	  {
-	    gint32 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_SINT_SET_CONTENT(raw_data,i) =
-		  GINT32_FROM_LE(DATA_CONTENT(data, dim, i));
-	    
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_UINT_32_LE:
-	  {
-	    guint32 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++) {
-		/* keep compiler from generating bad code with a noop,occurs with gcc 3.0.3 */
-		if (i.x == -1) g_print("no_op\n");
-		
-		AMITK_RAW_DATA_UINT_SET_CONTENT(raw_data,i) = 
-		  GUINT32_FROM_LE(DATA_CONTENT(data, dim, i));
-	      }
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_SSHORT_16_LE:
-	  {
-	    gint16 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_SSHORT_SET_CONTENT(raw_data,i) =
-		  GINT16_FROM_LE(DATA_CONTENT(data, dim, i));
-	    
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_USHORT_16_LE:
-	  {
-	    guint16 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_USHORT_SET_CONTENT(raw_data,i) =
-		  GUINT16_FROM_LE(DATA_CONTENT(data, dim, i));
-	    
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_SBYTE_8_NE:
-	  {
-	    gint8 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_SBYTE_SET_CONTENT(raw_data,i) = DATA_CONTENT(data, dim, i);
-	  }
-	  break;
-	case AMITK_RAW_FORMAT_UBYTE_8_NE:
-	default:
-	  {
-	    guint8 * data=file_buffer;
-	    
-	    /* copy this frame into the data set */
-	    for (i.y = 0; i.y < dim.y; i.y++) 
-	      for (i.x = 0; i.x < dim.x; i.x++)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(raw_data,i) = DATA_CONTENT(data, dim, i);
-	  }
-	  break;
-	}   
+    for (i_plane=0; (i_plane < total_planes) && (continue_work); i_plane += num_planes) {
+      if (update_func != NULL)
+	continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
+
+      num_planes = MIN(planes_per_read, total_planes-i_plane);
+      if (num_planes*bytes_per_plane > G_MAXSIZE) {
+	g_warning(_("raw data slice too large to read on this platform"));
+	goto error_condition;
       }
+      bytes_to_read = num_planes*bytes_per_plane;
+      plane = ((guchar *) raw_data->data) + i_plane*bytes_per_plane;
+
+      bytes_read = fread(plane, 1, bytes_to_read, file_pointer);
+      if (bytes_read != bytes_to_read) {
+	g_warning(_("read wrong # of elements from raw data, expected %zd, got %zd"), bytes_to_read, bytes_read);
+	goto error_condition;
+      }
+
+      raw_data_convert_in_place(plane, num_planes*voxels_per_plane, raw_format);
     }
   }
 
@@ -774,8 +731,8 @@ AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name,
   if (new_file_pointer != NULL)
     fclose(new_file_pointer);
 
-  if (file_buffer != NULL)
-    g_free(file_buffer);
+  if (reader.buffer != NULL)
+    g_free(reader.buffer);
 
   if (update_func != NULL) 
     (*update_func)(update_data, NULL, (gdouble) 2.0); 
@@ -785,8 +742,514 @@ AmitkRawData * amitk_raw_data_import_raw_file(const gchar * file_name,
 }
 
 
+/* figures out which file on disk a stream refers to, returns FALSE if
+   we can't tell (e.g. win32, where st_ino is always 0) */
+static gboolean raw_data_get_file_id(FILE * file, guint64 * pdev, guint64 * pino) {
+
+  struct stat file_info;
+
+  if (fstat(fileno(file), &file_info) != 0) return FALSE;
+  if (file_info.st_ino == 0) return FALSE;
+
+  *pdev = file_info.st_dev;
+  *pino = file_info.st_ino;
+
+  return TRUE;
+}
+
+/* remember where in an xif flat file this raw data lives */
+static void raw_data_set_xif_location(AmitkRawData * raw_data, FILE * study_file, 
+				      guint64 location, guint64 size) {
+
+  if (raw_data_get_file_id(study_file, &(raw_data->xif_file_dev), &(raw_data->xif_file_ino))) {
+    raw_data->xif_location = location;
+    raw_data->xif_size = size;
+  } else {
+    amitk_raw_data_set_modified(raw_data);
+  }
+
+  return;
+}
+
+/* needs to be called whenever the contents of the raw data are changed in place,
+   so we don't refer back to an out of date copy of the data when saving */
+void amitk_raw_data_set_modified(AmitkRawData * raw_data) {
+
+  g_return_if_fail(AMITK_IS_RAW_DATA(raw_data));
+
+  amitk_raw_data_clear_xif_location(raw_data);
+  raw_data->modification++;
+
+  return;
+}
+
+/* forgets where in an xif flat file this raw data was stored.  Files are only
+   told apart by device and inode, and a new file can get the inode of one 
+   that's been deleted, so this needs to be called before writing into a new file */
+void amitk_raw_data_clear_xif_location(AmitkRawData * raw_data) {
+
+  g_return_if_fail(AMITK_IS_RAW_DATA(raw_data));
+
+  raw_data->xif_file_dev = 0;
+  raw_data->xif_file_ino = 0;
+  raw_data->xif_location = 0;
+  raw_data->xif_size = 0;
+
+  return;
+}
+
+/* records that raw_data is stored wherever a copy of it (saved_raw_data) was just
+   written out to.  Only call if raw_data hasn't been modified since the copy was made */
+void amitk_raw_data_copy_xif_location(AmitkRawData * raw_data, const AmitkRawData * saved_raw_data) {
+
+  g_return_if_fail(AMITK_IS_RAW_DATA(raw_data));
+  g_return_if_fail(AMITK_IS_RAW_DATA(saved_raw_data));
+
+  raw_data->xif_file_dev = saved_raw_data->xif_file_dev;
+  raw_data->xif_file_ino = saved_raw_data->xif_file_ino;
+  raw_data->xif_location = saved_raw_data->xif_location;
+  raw_data->xif_size = saved_raw_data->xif_size;
+
+  return;
+}
+
+/* returns TRUE if an unmodified copy of the raw data is already in the given xif flat file */
+gboolean amitk_raw_data_stored_in_file(const AmitkRawData * raw_data, FILE * study_file) {
+
+  guint64 dev, ino;
+
+  g_return_val_if_fail(AMITK_IS_RAW_DATA(raw_data), FALSE);
+
+  if ((study_file == NULL) || (raw_data->xif_size == 0)) return FALSE;
+  if (!raw_data_get_file_id(study_file, &dev, &ino)) return FALSE;
+
+  return ((dev == raw_data->xif_file_dev) && (ino == raw_data->xif_file_ino));
+}
+
+
+/* sets how raw data gets encoded when it's written into xif files from here on out */
+void amitk_raw_data_set_xif_compression(AmitkRawCompression compression) {
+
+  g_return_if_fail(compression < AMITK_RAW_COMPRESSION_NUM);
+  xif_compression = compression;
+
+  return;
+}
+
+AmitkRawCompression amitk_raw_data_get_xif_compression(void) {
+  return xif_compression;
+}
+
+/* writes of raw data from the calling thread will stop at the next chunk once
+   *cancel_flag gets (atomically) set to TRUE, pass NULL to clear.  A write that
+   fails sets the flag itself, so the rest of the save gets abandoned as well */
+void amitk_raw_data_set_write_cancel_flag(gint * cancel_flag) {
+  g_private_set(&write_cancel_flag, cancel_flag);
+}
+
+/* a write from the calling thread failed, abandon the rest of the save */
+static void raw_data_write_failed(void) {
+
+  gint * cancel_flag;
+
+  if ((cancel_flag = g_private_get(&write_cancel_flag)) != NULL)
+    g_atomic_int_set(cancel_flag, TRUE);
+
+  return;
+}
+
+/* returns TRUE if writes from the calling thread should be abandoned */
+gboolean amitk_raw_data_write_cancelled(void) {
+
+  gint * cancel_flag;
+
+  cancel_flag = g_private_get(&write_cancel_flag);
+
+  return ((cancel_flag != NULL) && g_atomic_int_get(cancel_flag));
+}
+
+
+/* splits the bytes of each voxel apart, so that e.g. all the exponent bytes of 
+   a float plane end up next to each other, which zlib does much better on */
+static void raw_data_shuffle(const guchar * in, guchar * out, gsize num_units, gsize bytes_per_unit) {
+
+  gsize i_unit, i_byte;
+
+  for (i_byte=0; i_byte < bytes_per_unit; i_byte++)
+    for (i_unit=0; i_unit < num_units; i_unit++)
+      out[i_byte*num_units+i_unit] = in[i_unit*bytes_per_unit+i_byte];
+
+  return;
+}
+
+/* undoes raw_data_shuffle, optionally reversing the byte order of each voxel
+   for data written on a machine of the other endianness */
+static void raw_data_unshuffle(const guchar * in, guchar * out, gsize num_units, gsize bytes_per_unit,
+			       gboolean swap) {
+
+  gsize i_unit, i_byte, out_byte;
+
+  for (i_byte=0; i_byte < bytes_per_unit; i_byte++) {
+    out_byte = swap ? bytes_per_unit-1-i_byte : i_byte;
+    for (i_unit=0; i_unit < num_units; i_unit++)
+      out[i_unit*bytes_per_unit+out_byte] = in[i_byte*num_units+i_unit];
+  }
+
+  return;
+}
+
+/* runs a zlib (de)compressor over a whole buffer.  Returns the number of 
+   bytes written out, or 0 if the output didn't fit or the input was bad */
+static gsize raw_data_zlib_convert(GConverter * converter, const guchar * in, gsize in_size, 
+				   guchar * out, gsize out_size) {
+
+  gsize total_read=0, total_written=0;
+  gsize bytes_read, bytes_written;
+  GConverterResult result;
+  GError * error=NULL;
+
+  g_converter_reset(converter);
+  do {
+    result = g_converter_convert(converter, in+total_read, in_size-total_read, 
+				 out+total_written, out_size-total_written,
+				 G_CONVERTER_INPUT_AT_END, &bytes_read, &bytes_written, &error);
+    if (result == G_CONVERTER_ERROR) {
+      g_error_free(error);
+      return 0;
+    }
+    total_read += bytes_read;
+    total_written += bytes_written;
+    if ((result != G_CONVERTER_FINISHED) && (bytes_read == 0) && (bytes_written == 0))
+      return 0;
+  } while (result != G_CONVERTER_FINISHED);
+
+  return total_written;
+}
+
+typedef struct {
+  const guchar * data;      /* start of the first plane */
+  guchar * compressed;      /* plane_size bytes reserved for each plane */
+  guint64 * compressed_sizes;
+  gsize plane_size;
+  gsize bytes_per_unit;
+  gint failed;
+} raw_data_compress_t;
+
+/* compresses planes [start,end).  Planes that don't get any smaller are stored as is, 
+   which is flagged by a compressed size equal to the plane size */
+static void raw_data_compress_planes(guint64 start, guint64 end, gpointer data) {
+
+  raw_data_compress_t * compress = data;
+  GConverter * compressor;
+  guchar * shuffled;
+  const guchar * plane;
+  guchar * compressed;
+  gsize compressed_size;
+  guint64 i_plane;
+
+  if ((shuffled = g_try_malloc(compress->plane_size)) == NULL) {
+    g_atomic_int_set(&(compress->failed), TRUE);
+    return;
+  }
+  compressor = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, RAW_DATA_COMPRESSION_LEVEL));
+
+  for (i_plane=start; i_plane < end; i_plane++) {
+    plane = compress->data + i_plane*compress->plane_size;
+    compressed = compress->compressed + i_plane*compress->plane_size;
+
+    raw_data_shuffle(plane, shuffled, compress->plane_size/compress->bytes_per_unit, 
+		     compress->bytes_per_unit);
+    compressed_size = raw_data_zlib_convert(compressor, shuffled, compress->plane_size, 
+					    compressed, compress->plane_size-1);
+    if (compressed_size == 0) {
+      memcpy(compressed, plane, compress->plane_size);
+      compressed_size = compress->plane_size;
+    }
+    compress->compressed_sizes[i_plane] = compressed_size;
+  }
+
+  g_object_unref(compressor);
+  g_free(shuffled);
+
+  return;
+}
+
+/* writes the raw data out as a table of the (little endian guint64) compressed
+   size of each plane, followed by the compressed planes.  Having each plane 
+   compressed by itself lets them be (de)compressed in parallel, and lets a
+   reader find any given frame from the table without inflating the rest. */
+static gboolean raw_data_write_compressed(AmitkRawData * raw_data, FILE * file_pointer) {
+
+  raw_data_compress_t compress;
+  guint64 total_planes, i_plane, j_plane;
+  guint64 batch_planes, num_planes;
+  guint64 * compressed_sizes=NULL;
+  guchar * compressed=NULL;
+  long table_location;
+  gboolean okay=FALSE;
+
+  total_planes = ((guint64) raw_data->dim.z)*((guint64) raw_data->dim.g)*((guint64) raw_data->dim.t);
+  compress.bytes_per_unit = amitk_format_sizes[AMITK_RAW_DATA_FORMAT(raw_data)];
+  compress.plane_size = ((gsize) raw_data->dim.x)*((gsize) raw_data->dim.y)*compress.bytes_per_unit;
+  compress.failed = FALSE;
+
+  /* compress enough planes at a time to keep all the processors busy, within reason */
+  batch_planes = 4*amitk_get_num_threads();
+  batch_planes = MAX(1, MIN(batch_planes, RAW_DATA_COMPRESSION_BATCH_BYTES/compress.plane_size));
+  batch_planes = MIN(batch_planes, total_planes);
+
+  if ((compressed_sizes = g_try_new0(guint64, total_planes)) == NULL) goto exit_condition;
+  if ((compressed = g_try_malloc(batch_planes*compress.plane_size)) == NULL) goto exit_condition;
+
+  /* leave room for the table, we'll fill it in at the end */
+  table_location = ftell(file_pointer);
+  if (fwrite(compressed_sizes, sizeof(guint64), total_planes, file_pointer) != total_planes)
+    goto exit_condition;
+
+  for (i_plane=0; i_plane < total_planes; i_plane += num_planes) {
+    if (amitk_raw_data_write_cancelled()) goto exit_condition;
+    num_planes = MIN(batch_planes, total_planes-i_plane);
+    compress.data = ((guchar *) raw_data->data) + i_plane*compress.plane_size;
+    compress.compressed = compressed;
+    compress.compressed_sizes = compressed_sizes + i_plane;
+    amitk_parallel_for(num_planes, 1, raw_data_compress_planes, &compress);
+    if (compress.failed) goto exit_condition;
+
+    for (j_plane=0; j_plane < num_planes; j_plane++)
+      if (fwrite(compressed+j_plane*compress.plane_size, 1, compressed_sizes[i_plane+j_plane],
+		 file_pointer) != compressed_sizes[i_plane+j_plane]) 
+	goto exit_condition;
+  }
+
+  for (i_plane=0; i_plane < total_planes; i_plane++)
+    compressed_sizes[i_plane] = GUINT64_TO_LE(compressed_sizes[i_plane]);
+  if (fseek(file_pointer, table_location, SEEK_SET) != 0) goto exit_condition;
+  if (fwrite(compressed_sizes, sizeof(guint64), total_planes, file_pointer) != total_planes)
+    goto exit_condition;
+  if (fseek(file_pointer, 0, SEEK_END) != 0) goto exit_condition;
+
+  okay = TRUE;
+
+ exit_condition:
+  if (compressed_sizes != NULL) g_free(compressed_sizes);
+  if (compressed != NULL) g_free(compressed);
+
+  return okay;
+}
+
+typedef struct {
+  const guchar * compressed;
+  const guint64 * offsets;   /* of each plane in compressed */
+  const guint64 * compressed_sizes;
+  guchar * data;             /* where the first plane goes */
+  gsize plane_size;
+  gsize bytes_per_unit;
+  gboolean swap;
+  gint failed;
+} raw_data_decompress_t;
+
+static void raw_data_decompress_planes(guint64 start, guint64 end, gpointer data) {
+
+  raw_data_decompress_t * decompress = data;
+  GConverter * decompressor;
+  guchar * shuffled;
+  guchar * plane;
+  const guchar * compressed;
+  guint64 i_plane;
+  gsize num_units;
+
+  if ((shuffled = g_try_malloc(decompress->plane_size)) == NULL) {
+    g_atomic_int_set(&(decompress->failed), TRUE);
+    return;
+  }
+  decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+  num_units = decompress->plane_size/decompress->bytes_per_unit;
+
+  for (i_plane=start; i_plane < end; i_plane++) {
+    plane = decompress->data + i_plane*decompress->plane_size;
+    compressed = decompress->compressed + decompress->offsets[i_plane];
+
+    if (decompress->compressed_sizes[i_plane] == decompress->plane_size) { /* stored as is */
+      memcpy(plane, compressed, decompress->plane_size);
+      if (decompress->swap)
+	raw_data_swap_bytes(plane, num_units, decompress->bytes_per_unit);
+    } else if (raw_data_zlib_convert(decompressor, compressed, decompress->compressed_sizes[i_plane],
+				     shuffled, decompress->plane_size) == decompress->plane_size) {
+      raw_data_unshuffle(shuffled, plane, num_units, decompress->bytes_per_unit, decompress->swap);
+    } else {
+      g_atomic_int_set(&(decompress->failed), TRUE);
+      break;
+    }
+  }
+
+  g_object_unref(decompressor);
+  g_free(shuffled);
+
+  return;
+}
+
+/* reads in raw data written out by raw_data_write_compressed.  The planes are
+   read in a batch at a time, and each batch is decompressed in parallel. */
+static AmitkRawData * raw_data_import_compressed(const gchar * file_name, 
+						 FILE * existing_file,
+						 AmitkRawFormat raw_format,
+						 AmitkVoxel dim,
+						 long file_offset,
+						 AmitkUpdateFunc update_func,
+						 gpointer update_data) {
+
+  FILE * new_file_pointer=NULL;
+  FILE * file_pointer;
+  AmitkRawData * raw_data=NULL;
+  raw_data_decompress_t decompress;
+  guint64 total_planes, i_plane, j_plane;
+  guint64 batch_planes, num_planes;
+  guint64 * compressed_sizes=NULL;
+  guint64 * offsets=NULL;
+  guint64 batch_bytes;
+  guchar * compressed=NULL;
+  gsize compressed_buffer_size=0;
+  gchar * temp_string;
+  gboolean continue_work=TRUE;
+
+  if ((raw_format == AMITK_RAW_FORMAT_ASCII_8_NE) ||
+      (raw_format == AMITK_RAW_FORMAT_UINT_32_PDP) ||
+      (raw_format == AMITK_RAW_FORMAT_SINT_32_PDP) ||
+      (raw_format == AMITK_RAW_FORMAT_FLOAT_32_PDP)) {
+    g_warning(_("raw data format %s can't be compressed"), amitk_raw_format_get_name(raw_format));
+    return NULL;
+  }
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Reading: %s"), (file_name != NULL) ? file_name : "raw data");
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+
+  raw_data = amitk_raw_data_new_with_data(amitk_raw_format_to_format(raw_format), dim);
+  if (raw_data == NULL) {
+    g_warning(_("couldn't allocate memory space for the raw data set structure"));
+    goto error_condition;
+  }
+
+  if (existing_file == NULL) {
+    if ((new_file_pointer = fopen(file_name, "rb")) == NULL) {
+      g_warning(_("couldn't open raw data file %s"), file_name);
+      goto error_condition;
+    }
+    file_pointer = new_file_pointer;
+  } else {
+    file_pointer = existing_file;
+  }
+
+  if (fseek(file_pointer, file_offset, SEEK_SET) != 0) {
+    g_warning(_("could not seek forward %ld bytes in raw data file"),file_offset);
+    goto error_condition;
+  }
+
+  if (amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format) > G_MAXSIZE) {
+    g_warning(_("raw data slice too large to read on this platform"));
+    goto error_condition;
+  }
+
+  total_planes = ((guint64) dim.z)*((guint64) dim.g)*((guint64) dim.t);
+  decompress.bytes_per_unit = amitk_raw_format_sizes[raw_format];
+  decompress.plane_size = amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format);
+  decompress.swap = (raw_format != amitk_format_to_raw_format(raw_data->format));
+  decompress.failed = FALSE;
+
+  /* read in the table of compressed plane sizes */
+  if (((compressed_sizes = g_try_new(guint64, total_planes)) == NULL) ||
+      ((offsets = g_try_new(guint64, total_planes)) == NULL)) {
+    g_warning(_("couldn't allocate memory space for the compressed plane table"));
+    goto error_condition;
+  }
+  if (fread(compressed_sizes, sizeof(guint64), total_planes, file_pointer) != total_planes) {
+    g_warning(_("couldn't read the compressed plane table"));
+    goto error_condition;
+  }
+  for (i_plane=0; i_plane < total_planes; i_plane++) {
+    compressed_sizes[i_plane] = GUINT64_FROM_LE(compressed_sizes[i_plane]);
+    if ((compressed_sizes[i_plane] == 0) || (compressed_sizes[i_plane] > decompress.plane_size)) {
+      g_warning(_("compressed raw data is corrupt"));
+      goto error_condition;
+    }
+  }
+
+  batch_planes = 4*amitk_get_num_threads();
+  batch_planes = MAX(1, MIN(batch_planes, RAW_DATA_COMPRESSION_BATCH_BYTES/decompress.plane_size));
+
+  for (i_plane=0; (i_plane < total_planes) && continue_work; i_plane += num_planes) {
+
+    if (update_func != NULL) 
+      continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble) total_planes));
+
+    /* read in a batch of planes */
+    num_planes = MIN(batch_planes, total_planes-i_plane);
+    batch_bytes = 0;
+    for (j_plane=0; j_plane < num_planes; j_plane++) {
+      offsets[i_plane+j_plane] = batch_bytes;
+      batch_bytes += compressed_sizes[i_plane+j_plane];
+    }
+    if (batch_bytes > compressed_buffer_size) {
+      g_free(compressed);
+      compressed_buffer_size = batch_bytes;
+      if ((compressed = g_try_malloc(compressed_buffer_size)) == NULL) {
+	g_warning(_("couldn't malloc %zd bytes for file buffer\n"), compressed_buffer_size);
+	goto error_condition;
+      }
+    }
+    if (fread(compressed, 1, batch_bytes, file_pointer) != batch_bytes) {
+      g_warning(_("read wrong # of elements from raw data, expected %" G_GUINT64_FORMAT), batch_bytes);
+      goto error_condition;
+    }
+
+    /* and decompress it */
+    decompress.compressed = compressed;
+    decompress.offsets = offsets + i_plane;
+    decompress.compressed_sizes = compressed_sizes + i_plane;
+    decompress.data = ((guchar *) raw_data->data) + i_plane*decompress.plane_size;
+    amitk_parallel_for(num_planes, 1, raw_data_decompress_planes, &decompress);
+    if (decompress.failed) {
+      g_warning(_("compressed raw data is corrupt"));
+      goto error_condition;
+    }
+  }
+
+  if (continue_work) goto exit_condition;
+
+ error_condition:
+
+  if (raw_data != NULL)
+    g_object_unref(raw_data);
+  raw_data = NULL;
+
+ exit_condition:
+
+  if (new_file_pointer != NULL)
+    fclose(new_file_pointer);
+
+  if (compressed_sizes != NULL) g_free(compressed_sizes);
+  if (offsets != NULL) g_free(offsets);
+  if (compressed != NULL) g_free(compressed);
+
+  if (update_func != NULL) 
+    (*update_func)(update_data, NULL, (gdouble) 2.0); 
+
+  return raw_data;
+}
+
+
 /* function to write out the information content of a raw_data set into an xml
-   file.  Returns a string containing the name of the file. */
+   file.  Returns a string containing the name of the file. 
+
+   If we're writing into an xif flat file that already holds an unmodified copy
+   of this data (i.e. we're appending to an existing file), the location of
+   that copy gets returned instead of writing the data out again. 
+
+   If the data can't be written out, the location and size are set to 0 (and the
+   filename to NULL), and the write cancel flag (if any, see 
+   amitk_raw_data_set_write_cancel_flag) gets set so the caller knows the save failed */
 void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name, 
 			      FILE *study_file, gchar ** output_filename, guint64 * plocation,
 			      guint64 * psize) {
@@ -799,11 +1262,24 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
   FILE * file_pointer;
   guint64 location, size;
   size_t num_wrote;
-  size_t num_to_write;
+  guint64 num_to_write;
   size_t num_to_write_this_time;
   size_t bytes_per_unit;
-  size_t total_to_write;
-  size_t total_wrote = 0;
+  guint64 total_to_write;
+  guint64 total_wrote = 0;
+  AmitkRawCompression compression;
+
+  if (output_filename != NULL) *output_filename = NULL;
+  if (study_file != NULL) {
+    *plocation = 0;
+    *psize = 0;
+  }
+
+  if (amitk_raw_data_stored_in_file(raw_data, study_file)) {
+    *plocation = raw_data->xif_location;
+    *psize = raw_data->xif_size;
+    return;
+  }
 
   if (study_file == NULL) {
     /* make a guess as to our filename */
@@ -830,6 +1306,7 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
       g_warning(_("couldn't save raw data file: %s"),raw_filename);
       g_free(xml_filename);
       g_free(raw_filename);
+      raw_data_write_failed();
       return;
     }
   } else {
@@ -838,31 +1315,55 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
   
   /* write it on out.  */
   location = ftell(file_pointer);
-  num_to_write = amitk_raw_data_num_voxels(raw_data);
+  compression = xif_compression;
+  if (compression == AMITK_RAW_COMPRESSION_ZLIB_SHUFFLE) {
+    if (!raw_data_write_compressed(raw_data, file_pointer)) {
+      if (amitk_raw_data_write_cancelled()) 
+	goto error_condition;
+
+      /* we're always writing at the end of the file, so drop the partial
+	 compressed block and store the data uncompressed instead */
+      g_warning(_("couldn't save compressed raw data, saving uncompressed instead, file: %s"), 
+		(raw_filename != NULL) ? raw_filename : "study");
+      if ((fflush(file_pointer) != 0) ||
+	  (ftruncate(fileno(file_pointer), location) != 0) ||
+	  (fseek(file_pointer, location, SEEK_SET) != 0)) {
+	g_warning(_("couldn't drop partially saved compressed raw data, file: %s"),
+		  (raw_filename != NULL) ? raw_filename : "study");
+	goto error_condition;
+      }
+      compression = AMITK_RAW_COMPRESSION_NONE;
+    }
+  }
+
+  if (compression == AMITK_RAW_COMPRESSION_NONE)
+    num_to_write = amitk_raw_data_num_voxels(raw_data);
+  else
+    num_to_write = 0;
   bytes_per_unit = amitk_format_sizes[AMITK_RAW_DATA_FORMAT(raw_data)]; 
   total_to_write = num_to_write;
    
   /* write in small chunks (<=16MB) to get around a bad samba/cygwin interaction */
   while(num_to_write > 0) {
-    if (num_to_write*bytes_per_unit > 0x1000000) 
+    if (amitk_raw_data_write_cancelled()) 
+      goto error_condition;
+
+    if (num_to_write*((guint64) bytes_per_unit) > 0x1000000) 
       num_to_write_this_time = 0x1000000/bytes_per_unit;
     else
       num_to_write_this_time = num_to_write;
     num_to_write -= num_to_write_this_time;
     
-    num_wrote = fwrite((raw_data->data + total_wrote*bytes_per_unit),
+    num_wrote = fwrite(((guchar *) raw_data->data) + total_wrote*bytes_per_unit,
 		       bytes_per_unit, num_to_write_this_time, file_pointer);
     total_wrote += num_wrote;
     
     if (num_wrote != num_to_write_this_time) {
-      g_warning(_("incomplete save of raw data, wrote %zd (bytes), needed %zd (bytes), file: %s"),
+      g_warning(_("incomplete save of raw data, wrote %" G_GUINT64_FORMAT " (bytes), needed %" G_GUINT64_FORMAT " (bytes), file: %s"),
 		total_wrote*bytes_per_unit, 
 		total_to_write*bytes_per_unit,
-		raw_filename);
-      g_free(xml_filename);
-      g_free(raw_filename);
-      if (study_file == NULL) fclose(file_pointer);
-      return;
+		(raw_filename != NULL) ? raw_filename : "study");
+      goto error_condition;
     }
   }
  
@@ -876,6 +1377,8 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
   amitk_voxel_write_xml(doc->children, "dim", raw_data->dim);
   xml_save_string(doc->children,"raw_format", 
 		  amitk_raw_format_get_name(amitk_format_to_raw_format(raw_data->format)));
+  if (compression != AMITK_RAW_COMPRESSION_NONE)
+    xml_save_string(doc->children,"raw_compression", amitk_raw_compression_get_name(compression));
 
   /* store the info on our associated data */
   if (study_file == NULL) {
@@ -894,12 +1397,21 @@ void amitk_raw_data_write_xml(AmitkRawData * raw_data, const gchar * name,
     *plocation = ftell(study_file);
     xmlDocDump(study_file, doc);
     *psize = ftell(study_file)-*plocation;
+    raw_data_set_xif_location(raw_data, study_file, *plocation, *psize);
   }
 
   /* and we're done with the xml stuff*/
   xmlFreeDoc(doc);
 
 
+  return;
+
+ error_condition:
+  g_free(xml_filename);
+  g_free(raw_filename);
+  if (study_file == NULL) fclose(file_pointer);
+  raw_data_write_failed();
+
   return;
 }
 
@@ -917,6 +1429,7 @@ AmitkRawData * amitk_raw_data_read_xml(gchar * xml_filename,
   AmitkRawData * raw_data;
   xmlNodePtr nodes;
   AmitkRawFormat i_raw_format, raw_format;
+  AmitkRawCompression i_compression, compression;
   gchar * temp_string;
   gchar * raw_filename=NULL;
   guint64 offset, dummy;
@@ -957,6 +1470,23 @@ AmitkRawData * amitk_raw_data_read_xml(gchar * xml_filename,
       raw_format = i_raw_format;
 
   g_free(temp_string);
+
+  /* and whether it's been compressed */
+  compression = AMITK_RAW_COMPRESSION_NONE;
+  temp_string = xml_get_string(nodes, "raw_compression");
+  if (temp_string != NULL) {
+    compression = AMITK_RAW_COMPRESSION_NUM;
+    for (i_compression=0; i_compression < AMITK_RAW_COMPRESSION_NUM; i_compression++)
+      if (g_ascii_strcasecmp(temp_string, amitk_raw_compression_get_name(i_compression)) == 0)
+	compression = i_compression;
+    if (compression == AMITK_RAW_COMPRESSION_NUM) {
+      amitk_append_str_with_newline(perror_buf, _("Unknown raw data compression: %s"), temp_string);
+      g_free(temp_string);
+      xmlFreeDoc(doc);
+      return NULL;
+    }
+    g_free(temp_string);
+  }
   
   /* get the filename or location of our associated data */
   if (study_file == NULL) {
@@ -977,8 +1507,14 @@ AmitkRawData * amitk_raw_data_read_xml(gchar * xml_filename,
   }
 
 
-  raw_data = amitk_raw_data_import_raw_file(raw_filename, study_file, raw_format, dim, offset_long, 
-					    update_func, update_data);
+  if (compression == AMITK_RAW_COMPRESSION_ZLIB_SHUFFLE)
+    raw_data = raw_data_import_compressed(raw_filename, study_file, raw_format, dim, offset_long, 
+					  update_func, update_data);
+  else
+    raw_data = amitk_raw_data_import_raw_file(raw_filename, study_file, raw_format, dim, offset_long, 
+					      update_func, update_data);
+  if ((raw_data != NULL) && (study_file != NULL))
+    raw_data_set_xif_location(raw_data, study_file, location, size);
 
   /* and we're done */
   if (raw_filename != NULL) g_free(raw_filename);
@@ -1186,6 +1722,17 @@ const gchar * amitk_raw_format_get_name(const AmitkRawFormat raw_format) {
   return enum_value->value_nick;
 }
 
+const gchar * amitk_raw_compression_get_name(const AmitkRawCompression compression) {
+
+  GEnumClass * enum_class;
+  GEnumValue * enum_value;
+
+  enum_class = g_type_class_ref(AMITK_TYPE_RAW_COMPRESSION);
+  enum_value = g_enum_get_value(enum_class, compression);
+  g_type_class_unref(enum_class);
+
+  return enum_value->value_nick;
+}
 
 
 
@@ -41,6 +41,8 @@ G_BEGIN_DECLS
 
 
 #define AMITK_RAW_DATA_FORMAT(rd)         (AMITK_RAW_DATA(rd)->format)
+#define AMITK_RAW_DATA_MODIFICATION(rd)   (AMITK_RAW_DATA(rd)->modification)
+#define AMITK_RAW_DATA_SHARED(rd)         (g_atomic_int_get(&(AMITK_RAW_DATA(rd)->num_shares)) > 0)
 #define AMITK_RAW_DATA_DIM(rd)            (AMITK_RAW_DATA(rd)->dim)
 #define AMITK_RAW_DATA_DIM_X(rd)          (AMITK_RAW_DATA(rd)->dim.x)
 #define AMITK_RAW_DATA_DIM_Y(rd)          (AMITK_RAW_DATA(rd)->dim.y)
@@ -110,6 +112,15 @@ typedef enum {
 
 
 
+/* how the raw data is encoded when it's written into a xif file */
+typedef enum {
+  AMITK_RAW_COMPRESSION_NONE,
+  AMITK_RAW_COMPRESSION_ZLIB_SHUFFLE, /* per plane zlib, with the bytes of each voxel shuffled apart */
+  AMITK_RAW_COMPRESSION_NUM
+} AmitkRawCompression;
+
+
+
 typedef struct _AmitkRawDataClass AmitkRawDataClass;
 typedef struct _AmitkRawData      AmitkRawData;
 
@@ -121,6 +132,21 @@ struct _AmitkRawData {
   AmitkVoxel dim;
   gpointer data;
   AmitkFormat format;
+
+  /* where this data was last read from/written to in an xif flat file,
+     lets an appending save refer to it instead of writing it out again */
+  guint64 xif_file_dev;
+  guint64 xif_file_ino;
+  guint64 xif_location;
+  guint64 xif_size;
+
+  /* bumped by every amitk_raw_data_set_modified */
+  guint modification;
+
+  /* a read only view made by amitk_raw_data_share points to the raw data
+     that owns the data, which counts how many views are still around */
+  AmitkRawData * shared_from;
+  gint num_shares;
   
 };
 
@@ -142,10 +168,17 @@ struct _AmitkRawDataClass
 						  ((vox).z >= (rd)->dim.z) ||  \
 						  ((vox).g >= (rd)->dim.g) ||  \
 						  ((vox).t >= (rd)->dim.t)))
-#define amitk_raw_data_num_voxels(rd) ((rd)->dim.x * (rd)->dim.y * (rd)->dim.z * (rd)->dim.g * (rd)->dim.t)
-#define amitk_raw_data_size_data_mem(rd) (amitk_raw_data_num_voxels(rd) * amitk_format_sizes[(rd)->format])
-#define amitk_raw_data_get_data_mem(rd) (g_try_malloc(amitk_raw_data_size_data_mem(rd)))
-#define amitk_raw_data_get_data_mem0(rd) (g_try_malloc0(amitk_raw_data_size_data_mem(rd)))
+/* voxel counts and byte sizes are done in 64bit, as the product of the
+   16bit dimensions easily overflows a 32bit integer on large data sets */
+#define amitk_raw_data_num_voxels(rd) (((guint64) (rd)->dim.x) * ((guint64) (rd)->dim.y) * \
+				       ((guint64) (rd)->dim.z) * ((guint64) (rd)->dim.g) * \
+				       ((guint64) (rd)->dim.t))
+#define amitk_raw_data_size_data_mem(rd) (amitk_raw_data_num_voxels(rd) * ((guint64) amitk_format_sizes[(rd)->format]))
+/* returns NULL if the data won't fit in the address space (e.g. 32bit platforms) */
+#define amitk_raw_data_get_data_mem(rd) ((amitk_raw_data_size_data_mem(rd) > G_MAXSIZE) ? NULL : \
+					 g_try_malloc((gsize) amitk_raw_data_size_data_mem(rd)))
+#define amitk_raw_data_get_data_mem0(rd) ((amitk_raw_data_size_data_mem(rd) > G_MAXSIZE) ? NULL : \
+					  g_try_malloc0((gsize) amitk_raw_data_size_data_mem(rd)))
 
 
 /* ------------ external functions ---------- */
@@ -163,6 +196,9 @@ AmitkRawData *  amitk_raw_data_new_3D_with_data0    (AmitkFormat format,
 						     amide_intpoint_t z_dim, 
 						     amide_intpoint_t y_dim, 
 						     amide_intpoint_t x_dim);
+AmitkRawData *  amitk_raw_data_copy                 (const AmitkRawData * raw_data);
+AmitkRawData *  amitk_raw_data_copy_xif_reference   (const AmitkRawData * raw_data);
+AmitkRawData *  amitk_raw_data_share                (AmitkRawData * raw_data);
 AmitkRawData *  amitk_raw_data_import_raw_file      (const gchar * file_name, 
 						     FILE * existing_file,
 						     AmitkRawFormat raw_format,
@@ -180,6 +216,16 @@ AmitkRawData *  amitk_raw_data_read_xml             (gchar * xml_filename,
 						     gchar ** perror_buf,
 						     AmitkUpdateFunc update_func,
 						     gpointer update_data);
+void            amitk_raw_data_set_modified         (AmitkRawData * raw_data);
+void            amitk_raw_data_clear_xif_location   (AmitkRawData * raw_data);
+gboolean        amitk_raw_data_stored_in_file       (const AmitkRawData * raw_data,
+						     FILE * study_file);
+void            amitk_raw_data_copy_xif_location    (AmitkRawData * raw_data,
+						     const AmitkRawData * saved_raw_data);
+void            amitk_raw_data_set_xif_compression  (AmitkRawCompression compression);
+AmitkRawCompression amitk_raw_data_get_xif_compression(void);
+void            amitk_raw_data_set_write_cancel_flag(gint * cancel_flag);
+gboolean        amitk_raw_data_write_cancelled      (void);
 amide_data_t    amitk_raw_data_get_value            (const AmitkRawData * rd, 
 						     const AmitkVoxel i);
 gpointer        amitk_raw_data_get_pointer          (const AmitkRawData * rd,
@@ -188,10 +234,11 @@ gpointer        amitk_raw_data_get_pointer          (const AmitkRawData * rd,
 AmitkFormat    amitk_raw_format_to_format(AmitkRawFormat raw_format);
 AmitkRawFormat amitk_format_to_raw_format(AmitkFormat data_format);
 
-#define amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format) ((dim).x*(dim).y*amitk_raw_format_sizes[raw_format])
-#define amitk_raw_format_calc_num_bytes(dim, raw_format) ((dim).z*(dim).g*(dim).t*amitk_raw_format_calc_num_bytes_per_slice(dim,raw_format))
+#define amitk_raw_format_calc_num_bytes_per_slice(dim, raw_format) (((guint64) (dim).x)*((guint64) (dim).y)*((guint64) amitk_raw_format_sizes[raw_format]))
+#define amitk_raw_format_calc_num_bytes(dim, raw_format) (((guint64) (dim).z)*((guint64) (dim).g)*((guint64) (dim).t)*amitk_raw_format_calc_num_bytes_per_slice(dim,raw_format))
 
 const gchar * amitk_raw_format_get_name(const AmitkRawFormat raw_format);
+const gchar * amitk_raw_compression_get_name(const AmitkRawCompression compression);
 
 /* external variables */
 extern guint amitk_format_sizes[];
@@ -37,26 +37,26 @@
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+(i).t)
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_2D_SCALING_POINTER(amitk_raw_data,i) \
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+ \
-   (((((i).t) * ((amitk_raw_data)->dim.g) + \
-      (i).g) * ((amitk_raw_data)->dim.z)) + \
+   (((((gssize) (i).t) * ((gssize) (amitk_raw_data)->dim.g) + \
+      (i).g) * ((gssize) (amitk_raw_data)->dim.z)) + \
     (i).z))
 
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_POINTER(amitk_raw_data,i) \
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+ \
-   ((((((((((i).t) * ((amitk_raw_data)->dim.g)) + \
-	  (i).g) * ((amitk_raw_data)->dim.z)) + \
-	(i).z) * ((amitk_raw_data)->dim.y)) + \
-      (i).y) * ((amitk_raw_data)->dim.x)) + \
+   ((((((((((gssize) (i).t) * ((gssize) (amitk_raw_data)->dim.g)) + \
+	  (i).g) * ((gssize) (amitk_raw_data)->dim.z)) + \
+	(i).z) * ((gssize) (amitk_raw_data)->dim.y)) + \
+      (i).y) * ((gssize) (amitk_raw_data)->dim.x)) + \
     (i).x))
 
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_3D_POINTER(amitk_raw_data,iz,iy,ix) \
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+ \
-   ((((((iz)) * ((amitk_raw_data)->dim.y)) + \
-      (iy)) * ((amitk_raw_data)->dim.x)) + \
+   ((((((gssize) (iz)) * ((gssize) (amitk_raw_data)->dim.y)) + \
+      (iy)) * ((gssize) (amitk_raw_data)->dim.x)) + \
     (ix)))
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_2D_POINTER(amitk_raw_data,iy,ix) \
   (((amitk_format_`'m4_Variable_Type`'_t *) (amitk_raw_data)->data)+ \
-   ((((iy)) * ((amitk_raw_data)->dim.x)) + \
+   ((((gssize) (iy)) * ((gssize) (amitk_raw_data)->dim.x)) + \
     (ix)))
 
 #define AMITK_RAW_DATA_`'m4_Variable_Type`'_SET_CONTENT(amitk_raw_data,i) \
@@ -70,6 +70,11 @@ enum {
 static void          roi_class_init          (AmitkRoiClass *klass);
 static void          roi_init                (AmitkRoi      *roi);
 static void          roi_finalize            (GObject          *object);
+static void          roi_space_changed       (AmitkSpace        *space);
+static void          roi_volume_changed      (AmitkVolume      *volume);
+static void          roi_changed             (AmitkRoi         *roi);
+static void          roi_mask_free           (AmitkRoiMask     *mask);
+static void          roi_free_masks          (AmitkRoi         *roi);
 static void          roi_scale               (AmitkSpace        *space,
 					      AmitkPoint        *ref_point,
 					      AmitkPoint        *scaling);
@@ -129,6 +134,7 @@ static void roi_class_init (AmitkRoiClass * class) {
   parent_class = g_type_class_peek_parent(class);
 
   space_class->space_scale = roi_scale;
+  space_class->space_changed = roi_space_changed;
 
   object_class->object_copy = roi_copy;
   object_class->object_copy_in_place = roi_copy_in_place;
@@ -136,6 +142,9 @@ static void roi_class_init (AmitkRoiClass * class) {
   object_class->object_read_xml = roi_read_xml;
 
   volume_class->volume_get_center = roi_get_center;
+  volume_class->volume_changed = roi_volume_changed;
+
+  class->roi_changed = roi_changed;
 
   gobject_class->finalize = roi_finalize;
 
@@ -170,6 +179,8 @@ static void roi_init (AmitkRoi * roi) {
   roi->isocontour_min_value = 0.0;
   roi->isocontour_max_value = 0.0;
   roi->isocontour_range = AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN;
+
+  roi->masks = NULL;
 }
 
 
@@ -177,6 +188,8 @@ static void roi_finalize (GObject *object)
 {
   AmitkRoi * roi = AMITK_ROI(object);
 
+  roi_free_masks(roi);
+
   if (roi->map_data != NULL) {
     g_object_unref(roi->map_data);
     roi->map_data = NULL;
@@ -185,6 +198,47 @@ static void roi_finalize (GObject *object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* any change to the roi's position, orientation or shape invalidates the masks */
+static void roi_space_changed(AmitkSpace * space) {
+
+  g_return_if_fail(AMITK_IS_ROI(space));
+  roi_free_masks(AMITK_ROI(space));
+
+  if (AMITK_SPACE_CLASS(parent_class)->space_changed)
+    AMITK_SPACE_CLASS(parent_class)->space_changed (space);
+}
+
+static void roi_volume_changed(AmitkVolume * volume) {
+
+  g_return_if_fail(AMITK_IS_ROI(volume));
+  roi_free_masks(AMITK_ROI(volume));
+
+  if (AMITK_VOLUME_CLASS(parent_class)->volume_changed)
+    AMITK_VOLUME_CLASS(parent_class)->volume_changed (volume);
+}
+
+static void roi_changed(AmitkRoi * roi) {
+
+  roi_free_masks(roi);
+}
+
+static void roi_mask_free(AmitkRoiMask * mask) {
+
+  g_object_unref(mask->space);
+  g_array_free(mask->elements, TRUE);
+  g_free(mask);
+}
+
+static void roi_free_masks(AmitkRoi * roi) {
+
+  GList * masks;
+
+  for (masks = roi->masks; masks != NULL; masks = masks->next) 
+    roi_mask_free(masks->data);
+  g_list_free(roi->masks);
+  roi->masks = NULL;
+}
+
 static void roi_scale(AmitkSpace *space, AmitkPoint *ref_point, AmitkPoint *scaling) {
 
   AmitkRoi * roi;
@@ -244,6 +298,7 @@ static void roi_copy_in_place (AmitkObject * dest_object, const AmitkObject * sr
       g_object_unref(dest_roi->map_data);
     dest_roi->map_data = g_object_ref(src_roi->map_data);
   }
+  roi_free_masks(dest_roi);
 
   dest_roi->center_of_mass_calculated = src_roi->center_of_mass_calculated;
   dest_roi->center_of_mass = src_roi->center_of_mass;
@@ -636,6 +691,8 @@ void amitk_roi_set_isocontour(AmitkRoi * roi, AmitkDataSet * ds, AmitkVoxel star
 /* only works for isocontour and freehand roi's */
 void amitk_roi_manipulate_area(AmitkRoi * roi, gboolean erase, AmitkVoxel voxel, gint area_size) {
 
+  AmitkRawData * map_data;
+
   g_return_if_fail(AMITK_ROI_TYPE_ISOCONTOUR(roi) || AMITK_ROI_TYPE_FREEHAND(roi));
   
   /* if we're drawing a single point, do a quick check to see if we're already done */
@@ -655,6 +712,17 @@ void amitk_roi_manipulate_area(AmitkRoi * roi, gboolean erase, AmitkVoxel voxel,
     }
   }
 
+  /* the map might be getting written out in the background, in which case
+     the roi needs its own copy before it can be changed */
+  if ((roi->map_data != NULL) && AMITK_RAW_DATA_SHARED(roi->map_data)) {
+    if ((map_data = amitk_raw_data_copy(roi->map_data)) == NULL) {
+      g_warning(_("couldn't allocate memory space for a copy of the roi being saved, roi not changed"));
+      return;
+    }
+    g_object_unref(roi->map_data);
+    roi->map_data = map_data;
+  }
+
   switch(AMITK_ROI_TYPE(roi)) {
   case AMITK_ROI_TYPE_ISOCONTOUR_2D:
     amitk_roi_ISOCONTOUR_2D_manipulate_area(roi, erase, voxel, area_size);
@@ -672,6 +740,7 @@ void amitk_roi_manipulate_area(AmitkRoi * roi, gboolean erase, AmitkVoxel voxel,
     g_error("unexpected case in %s at line %d\n", __FILE__, __LINE__);
     break;
   }
+  if (roi->map_data != NULL) amitk_raw_data_set_modified(roi->map_data);
   roi->center_of_mass_calculated = FALSE;
 
   g_signal_emit(G_OBJECT(roi), roi_signals[ROI_CHANGED], 0);
@@ -799,6 +868,74 @@ void amitk_roi_calculate_on_data_set(const AmitkRoi * roi,
   return;
 }
 
+static void record_mask(AmitkVoxel voxel, 
+			amide_data_t value, 
+			amide_real_t voxel_fraction, 
+			gpointer data) {
+
+  GArray * elements = data;
+  AmitkRoiMaskElement element;
+
+  if (voxel_fraction > 0.0) {
+    element.voxel = voxel;
+    element.voxel.t = element.voxel.g = 0;
+    element.weight = voxel_fraction;
+    g_array_append_val(elements, element);
+  }
+
+  return;
+}
+
+/* returns the voxels of the data set's geometry that are inside the roi, along
+   with the fraction of each that's inside.  The geometry doesn't depend on the
+   frame or gate, so the mask is computed once and cached on the roi until the
+   roi changes.  The mask is owned by the roi and shouldn't be freed. */
+const AmitkRoiMask * amitk_roi_get_mask(AmitkRoi * roi, 
+					const AmitkDataSet * ds,
+					const gboolean accurate) {
+
+  GList * masks;
+  AmitkRoiMask * mask;
+
+  g_return_val_if_fail(AMITK_IS_ROI(roi), NULL);
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+
+  /* check if we've already got this one */
+  for (masks = roi->masks; masks != NULL; masks = masks->next) {
+    mask = masks->data;
+    if ((mask->accurate == accurate) &&
+	VOXEL_EQUAL(mask->dim, AMITK_DATA_SET_DIM(ds)) &&
+	POINT_EQUAL(mask->voxel_size, AMITK_DATA_SET_VOXEL_SIZE(ds)) &&
+	amitk_space_equal(mask->space, AMITK_SPACE(ds))) {
+      /* move it to the front */
+      roi->masks = g_list_remove_link(roi->masks, masks);
+      roi->masks = g_list_concat(masks, roi->masks);
+      return mask;
+    }
+  }
+
+  mask = g_new(AmitkRoiMask, 1);
+  mask->space = amitk_space_copy(AMITK_SPACE(ds));
+  mask->voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ds);
+  mask->dim = AMITK_DATA_SET_DIM(ds);
+  mask->accurate = accurate;
+  mask->elements = g_array_new(FALSE, FALSE, sizeof(AmitkRoiMaskElement));
+
+  amitk_roi_calculate_on_data_set(roi, ds, 0, 0, FALSE, accurate, record_mask, mask->elements);
+
+  roi->masks = g_list_prepend(roi->masks, mask);
+
+  /* drop the least recently used mask if we're holding too many */
+  if (g_list_length(roi->masks) > AMITK_ROI_MAX_CACHED_MASKS) {
+    masks = g_list_last(roi->masks);
+    roi->masks = g_list_remove_link(roi->masks, masks);
+    roi_mask_free(masks->data);
+    g_list_free(masks);
+  }
+
+  return mask;
+}
+
 static void erase_volume(AmitkVoxel voxel, 
 			 amide_data_t value, 
 			 amide_real_t voxel_fraction, 
@@ -55,6 +55,7 @@ G_BEGIN_DECLS
 /* for iterative algorithms, how many subvoxels should we break the problem up into */
 #define AMITK_ROI_GRANULARITY 4 /* # subvoxels in one dimension, so 1/64 is grain size */
 //#define AMITK_ROI_GRANULARITY 10 - takes way to long
+#define AMITK_ROI_MAX_CACHED_MASKS 8 /* # of data set geometries to remember voxel masks for */
 
 typedef enum {
   AMITK_ROI_TYPE_ELLIPSOID, 
@@ -79,6 +80,25 @@ typedef struct _AmitkRoiClass AmitkRoiClass;
 typedef struct _AmitkRoi AmitkRoi;
 
 
+/* one data set voxel that is at least partially inside an roi */
+typedef struct {
+  AmitkVoxel voxel; /* frame and gate are left at 0 */
+  amide_real_t weight; /* fraction of the voxel inside the roi */
+} AmitkRoiMaskElement;
+
+/* the voxels of a data set geometry covered by an roi, in the order
+   amitk_roi_calculate_on_data_set visits them */
+typedef struct {
+  /* the data set geometry the mask was computed for */
+  AmitkSpace * space;
+  AmitkPoint voxel_size;
+  AmitkVoxel dim;
+  gboolean accurate;
+
+  GArray * elements; /* AmitkRoiMaskElement's */
+} AmitkRoiMask;
+
+
 struct _AmitkRoi
 {
   AmitkVolume parent;
@@ -99,6 +119,9 @@ struct _AmitkRoi
   amide_data_t isocontour_max_value; /* what the user draws may lie outside of this range */
   AmitkRoiIsocontourRange isocontour_range;
 
+  /* cached AmitkRoiMask's, most recently used first */
+  GList * masks;
+
 };
 
 struct _AmitkRoiClass
@@ -151,6 +174,9 @@ void            amitk_roi_calculate_on_data_set   (const AmitkRoi * roi,
 						   const gboolean accurate,
 						   void (* calculation)(AmitkVoxel, amide_data_t, amide_real_t, gpointer),
 						   gpointer data);
+const AmitkRoiMask * amitk_roi_get_mask          (AmitkRoi * roi,
+						   const AmitkDataSet * ds,
+						   const gboolean accurate);
 void            amitk_roi_erase_volume            (const AmitkRoi * roi, 
 						   AmitkDataSet * ds,
 						   const gboolean outside,
@@ -41,7 +41,11 @@
 
 
 #if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
-static GSList * append_intersection_point(GSList * points_list, AmitkPoint new_point);
+
+/* limits on how many segments we'll chop a conic outline into */
+#define MIN_CONIC_SEGMENTS 8
+#define MAX_CONIC_SEGMENTS 2048
+
 static GSList * prepend_intersection_point(GSList * points_list, AmitkPoint new_point);
 
 
@@ -49,33 +53,60 @@ static GSList * prepend_intersection_point(GSList * points_list, AmitkPoint new_
 
 
 
-static GSList * append_intersection_point(GSList * points_list, AmitkPoint new_point) {
+static GSList * prepend_intersection_point(GSList * points_list, AmitkPoint new_point) {
   AmitkPoint * ppoint;
 
   ppoint = g_try_new(AmitkPoint,1);
   if (ppoint != NULL) {
     *ppoint = new_point;
-    return  g_slist_append(points_list, ppoint);
+    return  g_slist_prepend(points_list, ppoint);
   } else {
     g_warning(_("Out of Memory"));
     return points_list;
   }
 }
-static GSList * prepend_intersection_point(GSList * points_list, AmitkPoint new_point) {
-  AmitkPoint * ppoint;
 
-  ppoint = g_try_new(AmitkPoint,1);
-  if (ppoint != NULL) {
-    *ppoint = new_point;
-    return  g_slist_prepend(points_list, ppoint);
-  } else {
-    g_warning(_("Out of Memory"));
-    return points_list;
+/* clips a convex polygon (an array of AmitkPoint's, of which only x and y are
+   used) against the half plane h0 + hx*x + hy*y >= 0.  The passed in array is
+   freed, and the clipped polygon returned */
+static GArray * clip_polygon(GArray * polygon, amide_real_t h0, amide_real_t hx, amide_real_t hy) {
+
+  GArray * clipped;
+  AmitkPoint p, q, r;
+  amide_real_t dp, dq;
+  guint i;
+
+  clipped = g_array_sized_new(FALSE, FALSE, sizeof(AmitkPoint), polygon->len+1);
+
+  for (i=0; i < polygon->len; i++) {
+    p = g_array_index(polygon, AmitkPoint, i);
+    q = g_array_index(polygon, AmitkPoint, (i+1) % polygon->len);
+    dp = h0 + hx*p.x + hy*p.y;
+    dq = h0 + hx*q.x + hy*q.y;
+
+    if (dp >= 0.0)
+      g_array_append_val(clipped, p);
+    if ((dp >= 0.0) != (dq >= 0.0)) { /* edge crosses the line */
+      r = point_add(p, point_cmult(dp/(dp-dq), point_sub(q,p)));
+      g_array_append_val(clipped, r);
+    }
   }
+
+  g_array_free(polygon, TRUE);
+
+  return clipped;
 }
 
 /* returns a singly linked list of intersection points between the roi
    and the given canvas slice.  returned points are in the canvas's coordinate space.
+
+   The outline is calculated analytically: the canvas plane is mapped into the
+   roi's space, where the intersection with an ellipsoid or an elliptic cylinder
+   is a conic (an ellipse, or for a cylinder lying in the plane, a strip), and
+   with a box or the ends of a cylinder is a set of half planes.  Conics are
+   tessellated finely enough to be within a quarter pixel of the true outline, and
+   everything is clipped to the canvas.  Since all these intersections are convex,
+   the result is a single closed polygon.
 */
 GSList * amitk_roi_`'m4_Variable_Type`'_get_intersection_line(const AmitkRoi * roi, 
 							      const AmitkVolume * canvas_slice,
@@ -83,15 +114,24 @@ GSList * amitk_roi_`'m4_Variable_Type`'_get_intersection_line(const AmitkRoi * r
 
 
   GSList * return_points = NULL;
-  AmitkPoint view_point,temp_point;
+  GArray * polygon;
   AmitkCorners slice_corners;
-  AmitkPoint canvas_corner;
-  AmitkPoint * temp_pointp;
-  AmitkVoxel i;
-  AmitkVoxel canvas_dim;
-  gboolean voxel_in=FALSE, prev_voxel_intersection, saved=TRUE;
+  AmitkPoint plane_origin, plane_x, plane_y;
+  AmitkPoint point;
+  amide_real_t slice_z;
+  guint i;
+#if defined(ROI_TYPE_BOX)
+  AmitkAxis i_axis;
+  AmitkPoint roi_corner;
+#endif
 #if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
   AmitkPoint center, radius;
+  AmitkPoint d0, a, b;
+  amide_real_t qa, qb, qc, ga, gb, e;
+  amide_real_t det, k, lambda1, lambda2, discriminant;
+  amide_real_t axis1, axis2, max_axis, tolerance, theta;
+  AmitkPoint w0, e1, e2;
+  guint num_segments;
 #endif
 #if defined(ROI_TYPE_CYLINDER)
   amide_real_t height;
@@ -100,11 +140,6 @@ GSList * amitk_roi_`'m4_Variable_Type`'_get_intersection_line(const AmitkRoi * r
   /* make sure we've already defined this guy */
   g_return_val_if_fail(!AMITK_ROI_UNDRAWN(roi), NULL);
 
-#ifdef AMIDE_DEBUG
-  //  g_print("roi %s --------------------\n",AMITK_OBJECT_NAME(roi));
-  //  point_print("\t\tcorner", AMITK_VOLUME_CORNER(roi));
-#endif
-
 #if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
   radius = point_cmult(0.5, AMITK_VOLUME_CORNER(roi));
   center = amitk_space_b2s(AMITK_SPACE(roi), amitk_volume_get_center(AMITK_VOLUME(roi)));
@@ -114,75 +149,149 @@ GSList * amitk_roi_`'m4_Variable_Type`'_get_intersection_line(const AmitkRoi * r
 #endif
 
   /* get the corners of the canvas slice */
-  canvas_corner = AMITK_VOLUME_CORNER(canvas_slice);
   slice_corners[0] = amitk_space_b2s(AMITK_SPACE(canvas_slice), 
 				     AMITK_SPACE_OFFSET(canvas_slice));
-  slice_corners[1] = canvas_corner;
-
-  /* iterate through the slice, putting all edge points in the list */
-  i.t = i.g = i.z=0;
-  view_point.z = (slice_corners[0].z+slice_corners[1].z)/2.0;
-  view_point.y = slice_corners[0].y+pixel_dim/2.0;
-
-  canvas_dim.t = 0;
-  canvas_dim.z = ceil((canvas_corner.z)/AMITK_VOLUME_Z_CORNER(canvas_slice));
-  canvas_dim.y = ceil((canvas_corner.y)/pixel_dim);
-  canvas_dim.x = ceil((canvas_corner.x)/pixel_dim);
-  g_return_val_if_fail(canvas_dim.z == 1, NULL);
-
-  for (i.y=0; i.y < canvas_dim.y ; i.y++) {
+  slice_corners[1] = AMITK_VOLUME_CORNER(canvas_slice);
+  slice_z = (slice_corners[0].z+slice_corners[1].z)/2.0;
+
+  /* the canvas plane in the roi's space is plane_origin + x*plane_x + y*plane_y,
+     with x and y in the canvas's coordinates */
+  point.x = point.y = 0.0;
+  point.z = slice_z;
+  plane_origin = amitk_space_s2s(AMITK_SPACE(canvas_slice), AMITK_SPACE(roi), point);
+  point.x = 1.0;
+  plane_x = point_sub(amitk_space_s2s(AMITK_SPACE(canvas_slice), AMITK_SPACE(roi), point), plane_origin);
+  point.x = 0.0;
+  point.y = 1.0;
+  plane_y = point_sub(amitk_space_s2s(AMITK_SPACE(canvas_slice), AMITK_SPACE(roi), point), plane_origin);
+
+  polygon = g_array_new(FALSE, FALSE, sizeof(AmitkPoint));
+  point.z = slice_z;
 
-    view_point.x = slice_corners[0].x+pixel_dim/2.0;
-    prev_voxel_intersection = FALSE;
+#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
+  /* write the conic as w'Qw + 2g'w + e <= 0, with w=(x,y) on the canvas plane,
+     by scaling the roi's space so the ellipsoid/cylinder has unit radius */
+  d0 = point_div(point_sub(plane_origin, center), radius);
+  a = point_div(plane_x, radius);
+  b = point_div(plane_y, radius);
+#if defined(ROI_TYPE_CYLINDER)
+  d0.z = a.z = b.z = 0.0; /* the cylinder's radius doesn't depend on z */
+#endif
+  qa = point_dot_product(a,a);
+  qb = point_dot_product(a,b);
+  qc = point_dot_product(b,b);
+  ga = point_dot_product(a,d0);
+  gb = point_dot_product(b,d0);
+  e = point_dot_product(d0,d0) - 1.0;
+
+  det = qa*qc-qb*qb;
+  lambda1 = (qa+qc)/2.0 + sqrt((qa-qc)*(qa-qc)/4.0 + qb*qb);
+  lambda2 = (qa+qc)/2.0 - sqrt((qa-qc)*(qa-qc)/4.0 + qb*qb);
+
+  /* e1 is the eigenvector of lambda1, e2 of lambda2 */
+  if (fabs(qb) > EPSILON*(qa+qc)) {
+    e1.x = lambda1-qc;
+    e1.y = qb;
+    e1 = point_cmult(1.0/sqrt(e1.x*e1.x+e1.y*e1.y), e1);
+  } else {
+    e1.x = (qa >= qc) ? 1.0 : 0.0;
+    e1.y = (qa >= qc) ? 0.0 : 1.0;
+  }
+  e1.z = 0.0;
+  e2.x = -e1.y;
+  e2.y = e1.x;
+  e2.z = 0.0;
+
+  if (det > EPSILON*lambda1*lambda1) { 
+    /* an ellipse, centered at w0 */
+    w0.x = -(qc*ga - qb*gb)/det;
+    w0.y = -(qa*gb - qb*ga)/det;
+    w0.z = slice_z;
+    k = e + ga*w0.x + gb*w0.y;
+
+    if (k < 0.0) {
+      axis1 = sqrt(-k/lambda1);
+      axis2 = sqrt(-k/lambda2);
+      max_axis = MAX(axis1, axis2);
+
+      /* enough segments that the chords stay within tolerance of the ellipse */
+      tolerance = pixel_dim/4.0;
+      if (tolerance >= max_axis)
+	num_segments = MIN_CONIC_SEGMENTS;
+      else
+	num_segments = ceil(M_PI/acos(1.0-tolerance/max_axis));
+      num_segments = CLAMP(num_segments, MIN_CONIC_SEGMENTS, MAX_CONIC_SEGMENTS);
+
+      for (i=0; i < num_segments; i++) {
+	theta = 2.0*M_PI*i/num_segments;
+	point = point_add(w0, point_add(point_cmult(axis1*cos(theta), e1),
+					point_cmult(axis2*sin(theta), e2)));
+	g_array_append_val(polygon, point);
+      }
+    }
+  } else {
+    /* the plane runs along the cylinder, giving a strip s_lo <= e1'w <= s_hi,
+       which gets cut down to size by the canvas and the ends of the cylinder */
+    ga = ga*e1.x + gb*e1.y;
+    discriminant = ga*ga - lambda1*e;
+    if ((discriminant >= 0.0) && (lambda1 > 0.0)) {
+      point.x = slice_corners[0].x; point.y = slice_corners[0].y; g_array_append_val(polygon, point);
+      point.x = slice_corners[1].x; point.y = slice_corners[0].y; g_array_append_val(polygon, point);
+      point.x = slice_corners[1].x; point.y = slice_corners[1].y; g_array_append_val(polygon, point);
+      point.x = slice_corners[0].x; point.y = slice_corners[1].y; g_array_append_val(polygon, point);
+      polygon = clip_polygon(polygon, (ga+sqrt(discriminant))/lambda1, e1.x, e1.y);
+      polygon = clip_polygon(polygon, (-ga+sqrt(discriminant))/lambda1, -e1.x, -e1.y);
+    }
+  }
+#endif
 
-    for (i.x=0; i.x < canvas_dim.x ; i.x++) {
-      temp_point = amitk_space_s2s(AMITK_SPACE(canvas_slice), AMITK_SPACE(roi), view_point);
-      
-#ifdef ROI_TYPE_BOX
-      voxel_in = point_in_box(temp_point, AMITK_VOLUME_CORNER(roi));
+#if defined(ROI_TYPE_BOX)
+  point.x = slice_corners[0].x; point.y = slice_corners[0].y; g_array_append_val(polygon, point);
+  point.x = slice_corners[1].x; point.y = slice_corners[0].y; g_array_append_val(polygon, point);
+  point.x = slice_corners[1].x; point.y = slice_corners[1].y; g_array_append_val(polygon, point);
+  point.x = slice_corners[0].x; point.y = slice_corners[1].y; g_array_append_val(polygon, point);
+
+  /* 0 <= p <= corner along each of the box's axes */
+  roi_corner = AMITK_VOLUME_CORNER(roi);
+  for (i_axis=0; i_axis < AMITK_AXIS_NUM; i_axis++) {
+    polygon = clip_polygon(polygon, point_get_component(plane_origin, i_axis),
+			   point_get_component(plane_x, i_axis), 
+			   point_get_component(plane_y, i_axis));
+    polygon = clip_polygon(polygon, 
+			   point_get_component(roi_corner, i_axis)-point_get_component(plane_origin, i_axis),
+			   -point_get_component(plane_x, i_axis), 
+			   -point_get_component(plane_y, i_axis));
+  }
 #endif
-#ifdef ROI_TYPE_CYLINDER
-      voxel_in = point_in_elliptic_cylinder(temp_point, center, height, radius);
+
+#if defined(ROI_TYPE_CYLINDER)
+  /* the ends of the cylinder */
+  polygon = clip_polygon(polygon, plane_origin.z-(center.z-height/2.0), plane_x.z, plane_y.z);
+  polygon = clip_polygon(polygon, (center.z+height/2.0)-plane_origin.z, -plane_x.z, -plane_y.z);
 #endif
-#ifdef ROI_TYPE_ELLIPSOID
-      voxel_in = point_in_ellipsoid(temp_point,center,radius);
+
+#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
+  /* and keep it on the canvas */
+  polygon = clip_polygon(polygon, -slice_corners[0].x, 1.0, 0.0);
+  polygon = clip_polygon(polygon, slice_corners[1].x, -1.0, 0.0);
+  polygon = clip_polygon(polygon, -slice_corners[0].y, 0.0, 1.0);
+  polygon = clip_polygon(polygon, slice_corners[1].y, 0.0, -1.0);
 #endif
-	
-      /* is it an edge */
-      if (voxel_in != prev_voxel_intersection) {
-
-	/* than save the point */
-	saved = TRUE;
-
-	temp_point = view_point;
-	if (voxel_in ) {
-	  return_points = prepend_intersection_point(return_points, temp_point);
-	} else { /* previous voxel should be returned */
-	  temp_point.x = view_point.x - pixel_dim; /* backup one voxel */
-	  return_points = append_intersection_point(return_points, temp_point);
-	}
-      } else {
-	saved = FALSE;
-      }
-      
-      prev_voxel_intersection = voxel_in;
-      view_point.x += pixel_dim; /* advance one voxel */
-    }
-    
-    /* check if the edge of this row is still in the roi, if it is, add it as
-       a point */
-    if ((voxel_in) && !(saved))
-      return_points = append_intersection_point(return_points, view_point);
 
-    view_point.y += pixel_dim; /* advance one row */
+  /* build the list backwards, with the first point repeated at the end so the two ends meet */
+  if (polygon->len > 0) {
+    point = g_array_index(polygon, AmitkPoint, 0);
+    point.z = slice_z;
+    return_points = prepend_intersection_point(return_points, point);
   }
-  
-  /* make sure the two ends meet */
-  temp_pointp = g_slist_nth_data(return_points, 0);
-  if (return_points != NULL)
-    return_points = append_intersection_point(return_points, *temp_pointp);
-					      
-  
+  for (i=polygon->len; i > 0; i--) {
+    point = g_array_index(polygon, AmitkPoint, i-1);
+    point.z = slice_z;
+    return_points = prepend_intersection_point(return_points, point);
+  }
+
+  g_array_free(polygon, TRUE);
+
   return return_points;
 }
 
@@ -418,122 +527,286 @@ AmitkDataSet * amitk_roi_`'m4_Variable_Type`'_get_intersection_slice(const Amitk
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) 
 /* the data in temp_rd is setup as follows:
    bit 1 -> is the voxel in the isocontour
-   bit 2 -> has the voxel been checked 
-   bit 3 -> increment x for backup
-   bit 4 -> decrement x for backup
-   bit 5 -> increment y for backup
-   bit 6 -> decrement y for backup
-   bit 7 -> increment z for backup
-   bit 8 -> decrement z for backup
+   bit 2 -> is the voxel within the isocontour's value range 
 */
-static void isocontour_consider(const AmitkDataSet * ds,
-				const AmitkRawData * temp_rd, 
-				AmitkVoxel ds_voxel, 
-				const amide_data_t iso_min_value,
-				const amide_data_t iso_max_value,
-				const AmitkRoiIsocontourRange iso_range) {
+#define ISO_IN_RANGE 0x02
+#define ISO_FILLED 0x03
 
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+/* a run of in range voxels along x */
+typedef struct {
+  gint y;
+  gint x0; /* first voxel of the run */
+  gint x1; /* last voxel of the run */
+} isocontour_run_t;
+#endif
 
-  AmitkVoxel i_voxel;
-  AmitkVoxel roi_voxel;
-  gboolean found;
-  gboolean done;
-  amide_data_t voxel_value;
+typedef struct {
+  const AmitkDataSet * ds;
+  AmitkRawData * temp_rd;
+  AmitkVoxel seed; /* in data set voxel coordinates */
+  amide_data_t iso_min_value;
+  amide_data_t iso_max_value;
+  AmitkRoiIsocontourRange iso_range;
+  gsize plane_size;
+  gint failed;
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+  GArray ** runs; /* the runs of each plane, in row order */
+  guint ** row_start; /* for each plane, the index of the first run of each row, plus the end */
+  guint * run_offset; /* index of each plane's first run in parent */
+  guint * parent; /* union-find forest over all the runs */
+  guint root; /* the set containing the seed */
+#endif
+} isocontour_t;
 
-  roi_voxel = ds_voxel;
-  roi_voxel.t = roi_voxel.g = 0;
-  i_voxel =roi_voxel;
-  done=FALSE;
+/* marks the voxels within the value range in planes [start,end) of temp_rd, and
+   for 3D, collects the runs of in range voxels in each plane */
+static void isocontour_classify_planes(guint64 start, guint64 end, gpointer data) {
 
-  /* the starting point is in by definition */
-  AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd, roi_voxel) |= 0x03;
+  isocontour_t * iso = data;
+  const AmitkVoxel dim = iso->temp_rd->dim;
+  amide_data_t * values;
+  guint8 * mask;
+  amide_data_t value;
+  guint64 z;
+  gsize i;
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+  isocontour_run_t run;
+  gint y;
+#endif
 
-  /* while we still have neighbor voxels to check */
-  while (!done) {
+  if ((values = g_try_new(amide_data_t, iso->plane_size)) == NULL) {
+    g_atomic_int_set(&(iso->failed), TRUE);
+    return;
+  }
 
-    found = FALSE;
+  for (z = start; z < end; z++) {
+#if defined(ROI_TYPE_ISOCONTOUR_2D)
+    amitk_data_set_get_plane(iso->ds, iso->seed.t, iso->seed.g, iso->seed.z, values);
+#elif defined(ROI_TYPE_ISOCONTOUR_3D)
+    amitk_data_set_get_plane(iso->ds, iso->seed.t, iso->seed.g, z, values);
+#endif
+    mask = AMITK_RAW_DATA_UBYTE_2D_POINTER(iso->temp_rd, 0, 0) + z*iso->plane_size;
+
+    for (i = 0; i < iso->plane_size; i++) {
+      value = values[i];
+      if (((iso->iso_range == AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN) && (value >= iso->iso_min_value)) ||
+	  ((iso->iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BELOW_MAX) && (value <= iso->iso_max_value)) ||
+	  ((iso->iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BETWEEN_MIN_MAX) && 
+	   (value >= iso->iso_min_value) && (value <= iso->iso_max_value)))
+	mask[i] = ISO_IN_RANGE;
+    }
 
-    /* find a neighbor to check, consider the 8 adjoining voxels, or 26 in the case of 3D */
-#ifdef ROI_TYPE_ISOCONTOUR_3D
-    for (i_voxel.z = (roi_voxel.z >= 1) ? roi_voxel.z-1 : 0;
-	 (i_voxel.z < temp_rd->dim.z) && (i_voxel.z <= roi_voxel.z+1) && (!found);
-	 i_voxel.z++)
-#endif
-      for (i_voxel.y = (roi_voxel.y >= 1) ? roi_voxel.y-1 : 0;
-	   (i_voxel.y < temp_rd->dim.y) && (i_voxel.y <= roi_voxel.y+1) && (!found);
-	   i_voxel.y++)
-	for (i_voxel.x = (roi_voxel.x >= 1) ? roi_voxel.x-1 : 0;
-	     (i_voxel.x < temp_rd->dim.x) && (i_voxel.x <= roi_voxel.x+1) && (!found);
-	     i_voxel.x++) 
-	  if (!(AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, i_voxel) & 0x02)) { /* don't recheck something we've already checked */
-	    AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x02; /* it's been checked */
-
-	    ds_voxel.z = i_voxel.z;
-	    ds_voxel.y = i_voxel.y;
-	    ds_voxel.x = i_voxel.x;
-
-	    voxel_value = amitk_data_set_get_value(ds, ds_voxel);
-	    if (((iso_range == AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN) && (voxel_value >= iso_min_value)) ||
-		((iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BELOW_MAX) && (voxel_value <= iso_max_value)) ||
-		((iso_range == AMITK_ROI_ISOCONTOUR_RANGE_BETWEEN_MIN_MAX) && (voxel_value >= iso_min_value) && (voxel_value <= iso_max_value))) {
-
-	      AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x01; /* it's in */
-
-	      /* store backup info */
-#ifdef ROI_TYPE_ISOCONTOUR_3D
-	      if (i_voxel.z > roi_voxel.z)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x40;
-	      else if (i_voxel.z < roi_voxel.z)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x80;
-#endif
-	      if (i_voxel.y > roi_voxel.y)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x10;
-	      else if (i_voxel.y < roi_voxel.y)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x20;
-	      if (i_voxel.x > roi_voxel.x)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x04;
-	      else if (i_voxel.x < roi_voxel.x)
-		AMITK_RAW_DATA_UBYTE_SET_CONTENT(temp_rd,i_voxel) |= 0x08;
-	      
-	      /* start next iteration at this voxel */
-	      roi_voxel = i_voxel; 
-	      found = TRUE;
-	    }
-	  }
+    /* the starting point is in by definition */
+#if defined(ROI_TYPE_ISOCONTOUR_2D)
+    mask[iso->seed.y*dim.x+iso->seed.x] = ISO_IN_RANGE;
+#elif defined(ROI_TYPE_ISOCONTOUR_3D)
+    if (z == iso->seed.z)
+      mask[iso->seed.y*dim.x+iso->seed.x] = ISO_IN_RANGE;
+
+    /* and pull out the runs */
+    for (y = 0; y < dim.y; y++) {
+      iso->row_start[z][y] = iso->runs[z]->len;
+      run.y = y;
+      for (run.x0 = 0; run.x0 < dim.x; run.x0 = run.x1+1) {
+	if (mask[y*dim.x+run.x0] != ISO_IN_RANGE) {
+	  run.x1 = run.x0;
+	  continue;
+	}
+	for (run.x1 = run.x0; (run.x1+1 < dim.x) && (mask[y*dim.x+run.x1+1] == ISO_IN_RANGE); run.x1++);
+	g_array_append_val(iso->runs[z], run);
+      }
+    }
+    iso->row_start[z][dim.y] = iso->runs[z]->len;
+#endif
+  }
 
-        
-    if (!found) { /* all neighbors exhaustively checked, backup */
+  g_free(values);
 
-      /* backup to previous voxel */
-      i_voxel = roi_voxel;
-#ifdef ROI_TYPE_ISOCONTOUR_3D
-      if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x80)
-	i_voxel.z++;
-      else if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x40)
-	i_voxel.z--;
-#endif
+  return;
+}
 
-      if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x20)
-	i_voxel.y++;
-      else if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x10)
-	i_voxel.y--;
 
-      if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x08)
-	i_voxel.x++;
-      else if (AMITK_RAW_DATA_UBYTE_CONTENT(temp_rd, roi_voxel) & 0x04)
-	i_voxel.x--;
+#if defined(ROI_TYPE_ISOCONTOUR_2D)
 
-      /* the inital voxel will backup to itself, which is why we get out of the loop */
-      if (VOXEL_EQUAL(roi_voxel, i_voxel)) 
-	done = TRUE;
-      else
-	roi_voxel = i_voxel;
+/* scanline fill of the connected (8 neighbor) in range voxels, starting from the seed */
+static void isocontour_fill(isocontour_t * iso) {
+
+  const AmitkVoxel dim = iso->temp_rd->dim;
+  guint8 * mask = AMITK_RAW_DATA_UBYTE_2D_POINTER(iso->temp_rd, 0, 0);
+  guint8 * row;
+  guint8 * next_row;
+  GArray * stack;
+  AmitkVoxel voxel;
+  gint x0, x1, x, y, next_y;
+
+  stack = g_array_new(FALSE, FALSE, sizeof(AmitkVoxel));
+  voxel = zero_voxel;
+  voxel.x = iso->seed.x;
+  voxel.y = iso->seed.y;
+  g_array_append_val(stack, voxel);
+
+  while (stack->len > 0) {
+    voxel = g_array_index(stack, AmitkVoxel, stack->len-1);
+    g_array_set_size(stack, stack->len-1);
+
+    y = voxel.y;
+    row = mask + y*dim.x;
+    if (row[voxel.x] != ISO_IN_RANGE) continue; /* already filled */
+
+    /* fill out the span */
+    for (x0 = voxel.x; (x0 > 0) && (row[x0-1] == ISO_IN_RANGE); x0--);
+    for (x1 = voxel.x; (x1+1 < dim.x) && (row[x1+1] == ISO_IN_RANGE); x1++);
+    for (x = x0; x <= x1; x++) 
+      row[x] = ISO_FILLED;
+
+    /* and queue up the start of every unfilled span touching it in the rows above and below */
+    for (next_y = y-1; next_y <= y+1; next_y += 2) {
+      if ((next_y < 0) || (next_y >= dim.y)) continue;
+      next_row = mask + next_y*dim.x;
+      for (x = MAX(x0-1, 0); x <= MIN(x1+1, dim.x-1); x++) 
+	if ((next_row[x] == ISO_IN_RANGE) && ((x == MAX(x0-1,0)) || (next_row[x-1] != ISO_IN_RANGE))) {
+	  voxel.x = x;
+	  voxel.y = next_y;
+	  g_array_append_val(stack, voxel);
+	}
     }
   }
 
+  g_array_free(stack, TRUE);
+
   return;
 }
-  
+
+#elif defined(ROI_TYPE_ISOCONTOUR_3D)
+
+static guint isocontour_find(guint * parent, guint i) {
+  while (parent[i] != i) {
+    parent[i] = parent[parent[i]]; /* path halving */
+    i = parent[i];
+  }
+  return i;
+}
+
+/* the lower index always becomes the root, so the result doesn't depend on the order of the unions */
+static void isocontour_union(guint * parent, guint i, guint j) {
+  i = isocontour_find(parent, i);
+  j = isocontour_find(parent, j);
+  if (i < j) parent[j] = i;
+  else if (j < i) parent[i] = j;
+}
+
+/* unions the runs of row y0 in plane z0 with the (26 neighbor) touching runs of row y1 in plane z1 */
+static void isocontour_union_rows(isocontour_t * iso, gint z0, gint y0, gint z1, gint y1) {
+
+  const isocontour_run_t * runs0 = (isocontour_run_t *) iso->runs[z0]->data;
+  const isocontour_run_t * runs1 = (isocontour_run_t *) iso->runs[z1]->data;
+  guint i0, i1, end0, end1;
+
+  i0 = iso->row_start[z0][y0];
+  end0 = iso->row_start[z0][y0+1];
+  i1 = iso->row_start[z1][y1];
+  end1 = iso->row_start[z1][y1+1];
+
+  /* both rows are sorted along x, so step through them together */
+  while ((i0 < end0) && (i1 < end1)) {
+    if ((runs0[i0].x0 <= runs1[i1].x1+1) && (runs1[i1].x0 <= runs0[i0].x1+1))
+      isocontour_union(iso->parent, iso->run_offset[z0]+i0, iso->run_offset[z1]+i1);
+    if (runs0[i0].x1 < runs1[i1].x1) i0++;
+    else i1++;
+  }
+
+  return;
+}
+
+/* unions the runs within each of planes [start,end), these only touch their own plane's
+   part of the forest */
+static void isocontour_union_within_planes(guint64 start, guint64 end, gpointer data) {
+
+  isocontour_t * iso = data;
+  guint64 z;
+  gint y;
+
+  for (z = start; z < end; z++) 
+    for (y = 1; y < iso->temp_rd->dim.y; y++) 
+      isocontour_union_rows(iso, z, y, z, y-1);
+
+  return;
+}
+
+/* fills in the runs of planes [start,end) that are in the seed's set */
+static void isocontour_mark_planes(guint64 start, guint64 end, gpointer data) {
+
+  isocontour_t * iso = data;
+  const isocontour_run_t * runs;
+  guint8 * row;
+  guint64 z;
+  guint i;
+  gint x;
+
+  for (z = start; z < end; z++) {
+    runs = (isocontour_run_t *) iso->runs[z]->data;
+    for (i = 0; i < iso->runs[z]->len; i++) 
+      if (iso->parent[iso->run_offset[z]+i] == iso->root) {
+	row = AMITK_RAW_DATA_UBYTE_2D_POINTER(iso->temp_rd, 0, 0) + 
+	  z*iso->plane_size + runs[i].y*iso->temp_rd->dim.x;
+	for (x = runs[i].x0; x <= runs[i].x1; x++) 
+	  row[x] = ISO_FILLED;
+      }
+  }
+
+  return;
+}
+
+/* connected components over the runs of in range voxels. The runs are found and
+   joined within each plane in parallel, then joined between planes */
+static void isocontour_fill(isocontour_t * iso) {
+
+  const AmitkVoxel dim = iso->temp_rd->dim;
+  const isocontour_run_t * runs;
+  guint total_runs, i, seed_run;
+  gint z, y, dy;
+
+  /* lay out the forest */
+  if ((iso->run_offset = g_try_new(guint, dim.z)) == NULL) {
+    iso->failed = TRUE;
+    return;
+  }
+  total_runs = 0;
+  for (z = 0; z < dim.z; z++) {
+    iso->run_offset[z] = total_runs;
+    total_runs += iso->runs[z]->len;
+  }
+  if ((iso->parent = g_try_new(guint, total_runs)) == NULL) {
+    iso->failed = TRUE;
+    return;
+  }
+  for (i = 0; i < total_runs; i++)
+    iso->parent[i] = i;
+
+  amitk_parallel_for(dim.z, 1, isocontour_union_within_planes, iso);
+
+  for (z = 1; z < dim.z; z++)
+    for (y = 0; y < dim.y; y++)
+      for (dy = -1; dy <= 1; dy++)
+	if ((y+dy >= 0) && (y+dy < dim.y))
+	  isocontour_union_rows(iso, z, y, z-1, y+dy);
+
+  /* flatten the forest, so the marking can be done in parallel with just reads */
+  for (i = 0; i < total_runs; i++)
+    iso->parent[i] = isocontour_find(iso->parent, i);
+
+  /* find the run with the seed in it */
+  runs = (isocontour_run_t *) iso->runs[iso->seed.z]->data;
+  seed_run = iso->row_start[iso->seed.z][iso->seed.y];
+  while (runs[seed_run].x1 < iso->seed.x) seed_run++;
+  iso->root = iso->parent[iso->run_offset[iso->seed.z]+seed_run];
+
+  amitk_parallel_for(dim.z, 1, isocontour_mark_planes, iso);
+
+  return;
+}
+#endif
 
 
 
@@ -546,7 +819,10 @@ void amitk_roi_`'m4_Variable_Type`'_set_isocontour(AmitkRoi * roi, AmitkDataSet
   AmitkRawData * temp_rd;
   AmitkPoint temp_point;
   AmitkVoxel min_voxel, max_voxel, i_voxel;
-  amide_data_t temp_min_value, temp_max_value;
+  isocontour_t iso;
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+  gint z;
+#endif
 
   g_return_if_fail(roi->type == AMITK_ROI_TYPE_`'m4_Variable_Type`');
 
@@ -562,12 +838,49 @@ void amitk_roi_`'m4_Variable_Type`'_set_isocontour(AmitkRoi * roi, AmitkDataSet
   temp_rd = amitk_raw_data_new_3D_with_data0(AMITK_FORMAT_UBYTE, ds->raw_data->dim.z, ds->raw_data->dim.y, ds->raw_data->dim.x);
 #endif
 
+  iso.ds = ds;
+  iso.temp_rd = temp_rd;
+  iso.seed = iso_voxel;
+  iso.iso_range = iso_range;
+  iso.plane_size = ((gsize) temp_rd->dim.x)*((gsize) temp_rd->dim.y);
+  iso.failed = FALSE;
+
   /* epsilon guards for floating point rounding */
-  temp_min_value = roi->isocontour_min_value-EPSILON*fabs(roi->isocontour_min_value); 
-  temp_max_value = roi->isocontour_max_value+EPSILON*fabs(roi->isocontour_max_value); 
+  iso.iso_min_value = roi->isocontour_min_value-EPSILON*fabs(roi->isocontour_min_value); 
+  iso.iso_max_value = roi->isocontour_max_value+EPSILON*fabs(roi->isocontour_max_value); 
+
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+  iso.run_offset = NULL;
+  iso.parent = NULL;
+  iso.runs = g_new(GArray *, temp_rd->dim.z);
+  iso.row_start = g_new(guint *, temp_rd->dim.z);
+  for (z = 0; z < temp_rd->dim.z; z++) {
+    iso.runs[z] = g_array_new(FALSE, FALSE, sizeof(isocontour_run_t));
+    iso.row_start[z] = g_new(guint, temp_rd->dim.y+1);
+  }
+#endif
 
   /* fill in the data set */
-  isocontour_consider(ds, temp_rd, iso_voxel, temp_min_value, temp_max_value, iso_range);
+  amitk_parallel_for(temp_rd->dim.z, 1, isocontour_classify_planes, &iso);
+  if (!iso.failed)
+    isocontour_fill(&iso);
+
+#ifdef ROI_TYPE_ISOCONTOUR_3D
+  for (z = 0; z < temp_rd->dim.z; z++) {
+    g_array_free(iso.runs[z], TRUE);
+    g_free(iso.row_start[z]);
+  }
+  g_free(iso.runs);
+  g_free(iso.row_start);
+  g_free(iso.run_offset);
+  g_free(iso.parent);
+#endif
+
+  if (iso.failed) {
+    g_warning(_("couldn't allocate memory space for the isocontour"));
+    g_object_unref(temp_rd);
+    return;
+  }
   
   /* figure out the min and max dimensions */
   min_voxel = max_voxel = iso_voxel;
@@ -801,6 +1114,264 @@ void amitk_roi_`'m4_Variable_Type`'_calc_center_of_mass(AmitkRoi * roi) {
 
 
 
+/* amitk_space_s2s is affine, so the point at data set voxel coordinates (x,y,z)
+   maps into the roi's space as origin + x*step[X] + y*step[Y] + z*step[Z] */
+static void ds_to_roi_steps(const AmitkRoi * roi, const AmitkDataSet * ds,
+			    AmitkPoint * origin, AmitkAxes step) {
+
+  AmitkPoint ds_voxel_size;
+  AmitkPoint ds_pt;
+  AmitkAxis i_axis;
+
+  ds_voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ds);
+  *origin = amitk_space_s2s(AMITK_SPACE(ds), AMITK_SPACE(roi), zero_point);
+
+  for (i_axis=0; i_axis<AMITK_AXIS_NUM; i_axis++) {
+    ds_pt = zero_point;
+    point_set_component(&ds_pt, i_axis, point_get_component(ds_voxel_size, i_axis));
+    step[i_axis] = point_sub(amitk_space_s2s(AMITK_SPACE(ds), AMITK_SPACE(roi), ds_pt), *origin);
+  }
+
+  return;
+}
+
+/* the roi space point at data set voxel coordinates (x,y,z) */
+static AmitkPoint ds_to_roi_point(const AmitkPoint origin, const AmitkAxes step,
+				  const amide_real_t x, const amide_real_t y, const amide_real_t z) {
+
+  AmitkPoint roi_pt;
+
+  roi_pt.x = origin.x + x*step[AMITK_AXIS_X].x + y*step[AMITK_AXIS_Y].x + z*step[AMITK_AXIS_Z].x;
+  roi_pt.y = origin.y + x*step[AMITK_AXIS_X].y + y*step[AMITK_AXIS_Y].y + z*step[AMITK_AXIS_Z].y;
+  roi_pt.z = origin.z + x*step[AMITK_AXIS_X].z + y*step[AMITK_AXIS_Y].z + z*step[AMITK_AXIS_Z].z;
+
+  return roi_pt;
+}
+
+
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+
+/* the shape of a geometric roi, in the roi's space */
+typedef struct {
+#if defined(ROI_TYPE_BOX)
+  AmitkPoint box_corner;
+#endif
+#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
+  AmitkPoint center;
+  AmitkPoint radius;
+#endif
+#if defined(ROI_TYPE_CYLINDER)
+  amide_real_t height;
+#endif
+} roi_shape_t;
+
+static void roi_shape_init(const AmitkRoi * roi, roi_shape_t * shape) {
+
+#if defined (ROI_TYPE_BOX)
+  shape->box_corner = AMITK_VOLUME_CORNER(roi);
+#endif
+#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
+  shape->center = amitk_space_b2s(AMITK_SPACE(roi), amitk_volume_get_center(AMITK_VOLUME(roi)));
+  shape->radius = point_cmult(0.5, AMITK_VOLUME_CORNER(roi));
+#endif
+#if defined(ROI_TYPE_CYLINDER)
+  shape->height = AMITK_VOLUME_Z_CORNER(roi);
+#endif
+
+  return;
+}
+
+/* narrows [t0,t1] to the part of the line p0+t*d with lower <= p <= upper */
+static gboolean span_clip_slab(const amide_real_t p0, const amide_real_t d,
+			       const amide_real_t lower, const amide_real_t upper,
+			       amide_real_t * t0, amide_real_t * t1) {
+
+  amide_real_t t_lower, t_upper, temp;
+
+  if (d == 0.0) 
+    return ((p0 >= lower) && (p0 <= upper));
+
+  t_lower = (lower-p0)/d;
+  t_upper = (upper-p0)/d;
+  if (t_lower > t_upper) {
+    temp = t_lower;
+    t_lower = t_upper;
+    t_upper = temp;
+  }
+
+  if (t_lower > *t0) *t0 = t_lower;
+  if (t_upper < *t1) *t1 = t_upper;
+
+  return (*t0 <= *t1);
+}
+
+#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
+/* narrows [t0,t1] to the part of the line p0+t*d inside the ellipse/ellipsoid,
+   the z component is ignored for cylinders */
+static gboolean span_clip_ellipsoid(const AmitkPoint p0, const AmitkPoint d,
+				    const AmitkPoint center, const AmitkPoint radius,
+				    const gboolean use_z,
+				    amide_real_t * t0, amide_real_t * t1) {
+
+  AmitkPoint diff;
+  amide_real_t a, b, c;
+  amide_real_t discriminant, root;
+  AmitkAxis i_axis;
+  AmitkAxis num_axes;
+
+  diff = point_sub(p0, center);
+  a = b = 0.0;
+  c = -1.0;
+
+  num_axes = use_z ? AMITK_AXIS_NUM : AMITK_AXIS_Z;
+  for (i_axis=0; i_axis < num_axes; i_axis++) {
+    amide_real_t r2 = point_get_component(radius, i_axis);
+    r2 *= r2;
+    a += point_get_component(d, i_axis)*point_get_component(d, i_axis)/r2;
+    b += 2.0*point_get_component(diff, i_axis)*point_get_component(d, i_axis)/r2;
+    c += point_get_component(diff, i_axis)*point_get_component(diff, i_axis)/r2;
+  }
+
+  /* the line runs parallel to the ellipse's axis */
+  if (a == 0.0) 
+    return (c <= 0.0);
+
+  discriminant = b*b-4.0*a*c;
+  if (discriminant < 0.0) 
+    return FALSE;
+  root = sqrt(discriminant);
+
+  if ((-b-root)/(2.0*a) > *t0) *t0 = (-b-root)/(2.0*a);
+  if ((-b+root)/(2.0*a) < *t1) *t1 = (-b+root)/(2.0*a);
+
+  return (*t0 <= *t1);
+}
+#endif
+
+/* geometric rois are convex, so the points p0+t*d of a line that lie in the roi
+   form the single interval [t0,t1].  An empty span is returned as t0 > t1. */
+static void roi_shape_span(const roi_shape_t * shape, const AmitkPoint p0, const AmitkPoint d,
+			   amide_real_t * t0, amide_real_t * t1) {
+
+  gboolean hit;
+
+  *t0 = -G_MAXDOUBLE;
+  *t1 = G_MAXDOUBLE;
+
+#if defined (ROI_TYPE_BOX)
+  hit = (span_clip_slab(p0.x, d.x, 0.0, shape->box_corner.x, t0, t1) &&
+	 span_clip_slab(p0.y, d.y, 0.0, shape->box_corner.y, t0, t1) &&
+	 span_clip_slab(p0.z, d.z, 0.0, shape->box_corner.z, t0, t1));
+#endif
+#if defined(ROI_TYPE_CYLINDER)
+  hit = (span_clip_slab(p0.z, d.z, shape->center.z-shape->height/2.0, 
+			shape->center.z+shape->height/2.0, t0, t1) &&
+	 span_clip_ellipsoid(p0, d, shape->center, shape->radius, FALSE, t0, t1));
+#endif
+#if defined(ROI_TYPE_ELLIPSOID)
+  hit = span_clip_ellipsoid(p0, d, shape->center, shape->radius, TRUE, t0, t1);
+#endif
+
+  if (!hit) {
+    *t0 = G_MAXDOUBLE;
+    *t1 = -G_MAXDOUBLE;
+  }
+
+  return;
+}
+
+/* the number of integers in [lower, upper] that fall in the span [t0,t1] */
+static gint span_count(const amide_real_t t0, const amide_real_t t1, gint lower, gint upper) {
+
+  if (t0 > lower) lower = ceil(MIN(t0, upper+1.0));
+  if (t1 < upper) upper = floor(MAX(t1, lower-1.0));
+
+  return (upper >= lower) ? upper-lower+1 : 0;
+}
+
+#define NUM_SUB_LINES (AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY)
+
+/* computes the spans of the roi along the sub-voxel lines running in x through the
+   data set row (y,z).  Sub-voxel kx of voxel x lies at t = x*AMITK_ROI_GRANULARITY+kx. */
+static void roi_shape_row_spans(const roi_shape_t * shape, 
+				const AmitkPoint origin, const AmitkAxes step,
+				const gint y, const gint z,
+				amide_real_t t0[NUM_SUB_LINES], amide_real_t t1[NUM_SUB_LINES]) {
+
+  AmitkPoint p0, d;
+  gint ky, kz;
+
+  d = point_cmult(1.0/AMITK_ROI_GRANULARITY, step[AMITK_AXIS_X]);
+
+  for (kz=0; kz<AMITK_ROI_GRANULARITY; kz++)
+    for (ky=0; ky<AMITK_ROI_GRANULARITY; ky++) {
+      p0 = ds_to_roi_point(origin, step, 0.5/AMITK_ROI_GRANULARITY,
+			   y+(ky+0.5)/AMITK_ROI_GRANULARITY,
+			   z+(kz+0.5)/AMITK_ROI_GRANULARITY);
+      roi_shape_span(shape, p0, d, &(t0[kz*AMITK_ROI_GRANULARITY+ky]), &(t1[kz*AMITK_ROI_GRANULARITY+ky]));
+    }
+
+  return;
+}
+
+/* the number of sub-voxels of voxel x in the row that lie in the roi */
+static gint roi_shape_voxel_count(const amide_real_t t0[NUM_SUB_LINES], const amide_real_t t1[NUM_SUB_LINES], 
+				  const gint x) {
+
+  gint i_line;
+  gint count=0;
+
+  for (i_line=0; i_line < NUM_SUB_LINES; i_line++)
+    count += span_count(t0[i_line], t1[i_line], 
+			x*AMITK_ROI_GRANULARITY, (x+1)*AMITK_ROI_GRANULARITY-1);
+
+  return count;
+}
+
+#endif
+
+#if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
+static gboolean map_includes_point(const AmitkRoi * roi, const AmitkPoint roi_voxel_size, const AmitkPoint roi_pt) {
+
+  AmitkVoxel roi_voxel;
+
+  POINT_TO_VOXEL(roi_pt, roi_voxel_size, 0, 0, roi_voxel);
+  return (amitk_raw_data_includes_voxel(roi->map_data, roi_voxel) &&
+	  (AMITK_RAW_DATA_UBYTE_CONTENT(roi->map_data, roi_voxel) != 0));
+}
+
+/* the number of sub-voxels of data set voxel j that lie in the roi */
+static gint map_voxel_count(const AmitkRoi * roi, const AmitkPoint roi_voxel_size,
+			    const AmitkPoint origin, const AmitkAxes step, const AmitkVoxel j) {
+
+  AmitkPoint sub_step;
+  AmitkPoint fine_roi_pt;
+  AmitkVoxel k;
+  gint count=0;
+
+  sub_step = point_cmult(1.0/AMITK_ROI_GRANULARITY, step[AMITK_AXIS_X]);
+
+  for (k.z = 0;k.z<AMITK_ROI_GRANULARITY;k.z++) {
+    for (k.y = 0;k.y<AMITK_ROI_GRANULARITY;k.y++) {
+
+      /* fine_roi_pt gets advanced at bottom of loop */
+      fine_roi_pt = ds_to_roi_point(origin, step, j.x+0.5/AMITK_ROI_GRANULARITY,
+				    j.y+(k.y+0.5)/AMITK_ROI_GRANULARITY,
+				    j.z+(k.z+0.5)/AMITK_ROI_GRANULARITY);
+
+      for (k.x = 0;k.x<AMITK_ROI_GRANULARITY;k.x++) {
+	if (map_includes_point(roi, roi_voxel_size, fine_roi_pt))
+	  count++;
+	POINT_ADD(fine_roi_pt, sub_step, fine_roi_pt);
+      } /* k.x loop */
+    } /* k.y loop */
+  } /* k.z loop */
+
+  return count;
+}
+#endif
+
+
 /* iterates over the voxels in the given data set that are inside the given roi,
    and performs the specified calculation function for those points */
 /* calulation should be a function taking the following arguments:
@@ -813,8 +1384,8 @@ void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_fast(const AmitkRoi *
 							       void (* calculation)(AmitkVoxel, amide_data_t, amide_real_t, gpointer),
 							       gpointer data) {
 
-  AmitkPoint roi_pt_corner, roi_pt_center, fine_roi_pt;
-  AmitkPoint fine_ds_pt, far_ds_pt, center_ds_pt;
+  AmitkPoint roi_origin;
+  AmitkAxes roi_step;
   amide_data_t value;
   amide_real_t voxel_fraction;
   AmitkVoxel i,j, k;
@@ -825,35 +1396,29 @@ void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_fast(const AmitkRoi *
   gboolean small_dimensions;
   AmitkCorners intersection_corners;
   AmitkPoint ds_voxel_size;
-  AmitkPoint sub_voxel_size;
   amide_real_t grain_size;
+  gint count;
 
-#if defined (ROI_TYPE_BOX)
-  AmitkPoint box_corner;
-  box_corner = AMITK_VOLUME_CORNER(roi);
-#endif
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+  roi_shape_t shape;
+  amide_real_t corner_t0, corner_t1;
+  amide_real_t center_t0, center_t1;
+  amide_real_t sub_t0[NUM_SUB_LINES], sub_t1[NUM_SUB_LINES];
+  gboolean sub_spans_valid;
 
-#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
-  AmitkPoint center;
-  AmitkPoint radius;
-#if defined(ROI_TYPE_CYLINDER)
-  amide_real_t height;
-  height = AMITK_VOLUME_Z_CORNER(roi);
-#endif  
-  center = amitk_space_b2s(AMITK_SPACE(roi), amitk_volume_get_center(AMITK_VOLUME(roi)));
-  radius = point_cmult(0.5, AMITK_VOLUME_CORNER(roi));
+  roi_shape_init(roi, &shape);
 #endif
 
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
   AmitkPoint roi_voxel_size;
-  AmitkVoxel roi_voxel;
+  AmitkPoint roi_pt_corner, roi_pt_center;
 
   roi_voxel_size = AMITK_ROI_VOXEL_SIZE(roi);
 #endif
 
   ds_voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ds);
-  sub_voxel_size = point_cmult(1.0/AMITK_ROI_GRANULARITY, ds_voxel_size);
   ds_dim = AMITK_DATA_SET_DIM(ds);
+  ds_to_roi_steps(roi, ds, &roi_origin, roi_step);
 
   grain_size = 1.0/(AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY);
 
@@ -914,45 +1479,37 @@ void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_fast(const AmitkRoi *
   i.t = k.t = i.g = k.g = 0;
   for (i.z = 0; i.z < dim.z; i.z++) {
     j.z = i.z+start.z;
-    far_ds_pt.z = (j.z+1)*ds_voxel_size.z;
-    center_ds_pt.z = (j.z+0.5)*ds_voxel_size.z;
     
     for (i.y = 0; i.y < dim.y; i.y++) {
       j.y = i.y+start.y;
-      far_ds_pt.y = (j.y+1)*ds_voxel_size.y;
-      center_ds_pt.y = (j.y+0.5)*ds_voxel_size.y;
+
+      /* the far corners and the centers of this row of voxels lie on two lines 
+	 in the roi's space, stepping by roi_step[AMITK_AXIS_X] per voxel */
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+      roi_shape_span(&shape, ds_to_roi_point(roi_origin, roi_step, 1.0, j.y+1.0, j.z+1.0),
+		     roi_step[AMITK_AXIS_X], &corner_t0, &corner_t1);
+      roi_shape_span(&shape, ds_to_roi_point(roi_origin, roi_step, 0.5, j.y+0.5, j.z+0.5),
+		     roi_step[AMITK_AXIS_X], &center_t0, &center_t1);
+      sub_spans_valid = FALSE;
+#endif
+#if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
+      roi_pt_corner = ds_to_roi_point(roi_origin, roi_step, start.x+1.0, j.y+1.0, j.z+1.0);
+      roi_pt_center = ds_to_roi_point(roi_origin, roi_step, start.x+0.5, j.y+0.5, j.z+0.5);
+#endif
       
       for (i.x = 0; i.x < dim.x; i.x++) {
 	j.x = i.x+start.x;
-	far_ds_pt.x = (j.x+1)*ds_voxel_size.x;
-	center_ds_pt.x = (j.x+0.5)*ds_voxel_size.x;
 	
 	/* figure out if the center and the next far corner is in the roi or not */
-	/* get the corresponding roi points */
-	roi_pt_corner = amitk_space_s2s(AMITK_SPACE(ds),  AMITK_SPACE(roi), far_ds_pt);
-	roi_pt_center = amitk_space_s2s(AMITK_SPACE(ds),  AMITK_SPACE(roi), center_ds_pt);
-
-	/* calculate the one corner of the voxel "box" to determine if it's in or not */
-	/* along with the center of the voxel */
-#if defined (ROI_TYPE_BOX)
-	corner_in = point_in_box(roi_pt_corner, box_corner);
-	center_in = point_in_box(roi_pt_center, box_corner);
-#endif
-#if defined(ROI_TYPE_CYLINDER)
-	corner_in = point_in_elliptic_cylinder(roi_pt_corner, center, height, radius);
-	center_in = point_in_elliptic_cylinder(roi_pt_center, center, height, radius);
-#endif
-#if defined(ROI_TYPE_ELLIPSOID)
-	corner_in = point_in_ellipsoid(roi_pt_corner,center,radius);
-	center_in = point_in_ellipsoid(roi_pt_center,center,radius);
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+	corner_in = ((j.x >= corner_t0) && (j.x <= corner_t1));
+	center_in = ((j.x >= center_t0) && (j.x <= center_t1));
 #endif
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
-	POINT_TO_VOXEL(roi_pt_corner, roi_voxel_size, 0, 0,roi_voxel);
-	corner_in = (amitk_raw_data_includes_voxel(roi->map_data, roi_voxel) &&
-		     (AMITK_RAW_DATA_UBYTE_CONTENT(roi->map_data, roi_voxel) != 0));
-	POINT_TO_VOXEL(roi_pt_center, roi_voxel_size, 0, 0,roi_voxel);
-	center_in = (amitk_raw_data_includes_voxel(roi->map_data, roi_voxel) &&
-		     (AMITK_RAW_DATA_UBYTE_CONTENT(roi->map_data, roi_voxel) != 0));
+	corner_in = map_includes_point(roi, roi_voxel_size, roi_pt_corner);
+	center_in = map_includes_point(roi, roi_voxel_size, roi_pt_center);
+	POINT_ADD(roi_pt_corner, roi_step[AMITK_AXIS_X], roi_pt_corner);
+	POINT_ADD(roi_pt_center, roi_step[AMITK_AXIS_X], roi_pt_center);
 #endif
 
 	AMITK_RAW_DATA_UBYTE_2D_SET_CONTENT(next_plane_in,i.y+1,i.x+1)=corner_in;
@@ -986,38 +1543,19 @@ void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_fast(const AmitkRoi *
 	  /* this voxel is partially in the ROI, will need to do subvoxel analysis */
 
 	  value = amitk_data_set_get_value(ds,j);
-	  voxel_fraction=0;
 
-	  for (k.z = 0;k.z<AMITK_ROI_GRANULARITY;k.z++) {
-	    fine_ds_pt.z = j.z*ds_voxel_size.z+ (k.z+0.5)*sub_voxel_size.z;
-
-	    for (k.y = 0;k.y<AMITK_ROI_GRANULARITY;k.y++) {
-	      fine_ds_pt.y = j.y*ds_voxel_size.y+ (k.y+0.5)*sub_voxel_size.y;
-
-	      for (k.x = 0;k.x<AMITK_ROI_GRANULARITY;k.x++) {
-		fine_ds_pt.x = j.x*ds_voxel_size.x+(k.x+0.5)*sub_voxel_size.x;
-		
-		fine_roi_pt = amitk_space_s2s(AMITK_SPACE(ds), AMITK_SPACE(roi), fine_ds_pt);
-
-		/* calculate the one corner of the voxel "box" to determine if it's in or not */
-#if defined (ROI_TYPE_BOX)
-		if (point_in_box(fine_roi_pt, box_corner)) voxel_fraction += grain_size;
-#endif
-#if defined(ROI_TYPE_CYLINDER)
-		if (point_in_elliptic_cylinder(fine_roi_pt, center, height, radius)) voxel_fraction += grain_size;
-#endif
-#if defined(ROI_TYPE_ELLIPSOID)
-		if (point_in_ellipsoid(fine_roi_pt,center,radius)) voxel_fraction += grain_size;
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+	  /* the sub-voxel spans are shared by all the partial voxels in this row */
+	  if (!sub_spans_valid) {
+	    roi_shape_row_spans(&shape, roi_origin, roi_step, j.y, j.z, sub_t0, sub_t1);
+	    sub_spans_valid = TRUE;
+	  }
+	  count = roi_shape_voxel_count(sub_t0, sub_t1, j.x);
 #endif
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
-		POINT_TO_VOXEL(fine_roi_pt, roi_voxel_size, 0, 0, roi_voxel);
-		if (amitk_raw_data_includes_voxel(roi->map_data, roi_voxel) &&
-		    (AMITK_RAW_DATA_UBYTE_CONTENT(roi->map_data, roi_voxel) != 0))
-		  voxel_fraction += grain_size;
+	  count = map_voxel_count(roi, roi_voxel_size, roi_origin, roi_step, j);
 #endif
-	      } /* k.x loop */
-	    } /* k.y loop */
-	  } /* k.z loop */
+	  voxel_fraction = count*grain_size;
 
 	  if (!inverse) {
 	    (*calculation)(j, value, voxel_fraction, data);
@@ -1062,42 +1600,36 @@ void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_accurate(const AmitkRo
 								   void (* calculation)(AmitkVoxel, amide_data_t, amide_real_t, gpointer),
 								   gpointer data) {
 
-  AmitkPoint fine_roi_pt, fine_ds_pt;
+  AmitkPoint roi_origin;
+  AmitkAxes roi_step;
   amide_data_t value;
   amide_real_t voxel_fraction;
-  AmitkVoxel j, k;
+  AmitkVoxel j;
   AmitkVoxel start, end, ds_dim;
+  AmitkVoxel row_start, row_end;
   AmitkCorners intersection_corners;
   AmitkPoint ds_voxel_size;
-  AmitkPoint sub_voxel_size;
   amide_real_t grain_size;
+  gint count;
 
-#if defined (ROI_TYPE_BOX)
-  AmitkPoint box_corner;
-  box_corner = AMITK_VOLUME_CORNER(roi);
-#endif
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+  roi_shape_t shape;
+  amide_real_t sub_t0[NUM_SUB_LINES], sub_t1[NUM_SUB_LINES];
+  amide_real_t span_start, span_end;
+  gint i_line;
 
-#if defined(ROI_TYPE_ELLIPSOID) || defined(ROI_TYPE_CYLINDER)
-  AmitkPoint center;
-  AmitkPoint radius;
-#if defined(ROI_TYPE_CYLINDER)
-  amide_real_t height;
-  height = AMITK_VOLUME_Z_CORNER(roi);
-#endif  
-  center = amitk_space_b2s(AMITK_SPACE(roi), amitk_volume_get_center(AMITK_VOLUME(roi)));
-  radius = point_cmult(0.5, AMITK_VOLUME_CORNER(roi));
+  roi_shape_init(roi, &shape);
 #endif
 
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
   AmitkPoint roi_voxel_size;
-  AmitkVoxel roi_voxel;
 
   roi_voxel_size = AMITK_ROI_VOXEL_SIZE(roi);
 #endif
 
   ds_voxel_size = AMITK_DATA_SET_VOXEL_SIZE(ds);
-  sub_voxel_size = point_cmult(1.0/AMITK_ROI_GRANULARITY, ds_voxel_size);
   ds_dim = AMITK_DATA_SET_DIM(ds);
+  ds_to_roi_steps(roi, ds, &roi_origin, roi_step);
 
   grain_size = 1.0/(AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY*AMITK_ROI_GRANULARITY);
 
@@ -1134,60 +1666,58 @@ void amitk_roi_`'m4_Variable_Type`'_calculate_on_data_set_accurate(const AmitkRo
 
   j.t = frame;
   j.g = gate;
-  k.t = k.g = 0;
+  row_start = start;
+  row_end = end;
 
   for (j.z = start.z; j.z <= end.z; j.z++) {
     for (j.y = start.y; j.y <= end.y; j.y++) {
-      for (j.x = start.x; j.x <= end.x; j.x++) {
-
-	value = amitk_data_set_get_value(ds,j);
-	voxel_fraction=0;
-
-	for (k.z = 0;k.z<AMITK_ROI_GRANULARITY;k.z++) {
-	  fine_ds_pt.z = j.z*ds_voxel_size.z+ (k.z+0.5)*sub_voxel_size.z;
 
-	  for (k.y = 0;k.y<AMITK_ROI_GRANULARITY;k.y++) {
-	    fine_ds_pt.y = j.y*ds_voxel_size.y+ (k.y+0.5)*sub_voxel_size.y;
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+      roi_shape_row_spans(&shape, roi_origin, roi_step, j.y, j.z, sub_t0, sub_t1);
+
+      /* voxels outside of all the spans contribute nothing, so only the
+	 part of the row covered by the spans needs visiting */
+      if (!inverse) {
+	span_start = G_MAXDOUBLE;
+	span_end = -G_MAXDOUBLE;
+	for (i_line=0; i_line < NUM_SUB_LINES; i_line++) 
+	  if (sub_t0[i_line] <= sub_t1[i_line]) {
+	    span_start = MIN(span_start, sub_t0[i_line]);
+	    span_end = MAX(span_end, sub_t1[i_line]);
+	  }
+	if (span_start > span_end) continue; /* row misses the roi */
 
-	    /* fine_ds_pt.x gets advanced at bottom of loop */
-	    fine_ds_pt.x = j.x*ds_voxel_size.x+0.5*sub_voxel_size.x;
+	span_start = floor(span_start/AMITK_ROI_GRANULARITY);
+	span_end = floor(span_end/AMITK_ROI_GRANULARITY);
+	row_start.x = (span_start > start.x) ? span_start : start.x;
+	row_end.x = (span_end < end.x) ? span_end : end.x;
+      }
+#endif
 
-	    for (k.x = 0;k.x<AMITK_ROI_GRANULARITY;k.x++) {
-	      fine_roi_pt = amitk_space_s2s(AMITK_SPACE(ds), AMITK_SPACE(roi), fine_ds_pt);
+      for (j.x = row_start.x; j.x <= row_end.x; j.x++) {
 
-	      /* is this point in */
-#if defined (ROI_TYPE_BOX)
-	      if (point_in_box(fine_roi_pt, box_corner)) voxel_fraction+=grain_size;
-#endif
-#if defined(ROI_TYPE_CYLINDER)
-	      if (point_in_elliptic_cylinder(fine_roi_pt, center, height, radius)) voxel_fraction+=grain_size;
-#endif
-#if defined(ROI_TYPE_ELLIPSOID)
-	      if (point_in_ellipsoid(fine_roi_pt,center,radius)) voxel_fraction+=grain_size;
+#if defined(ROI_TYPE_CYLINDER) || defined(ROI_TYPE_ELLIPSOID) || defined (ROI_TYPE_BOX)
+	count = roi_shape_voxel_count(sub_t0, sub_t1, j.x);
 #endif
 #if defined(ROI_TYPE_ISOCONTOUR_2D) || defined(ROI_TYPE_ISOCONTOUR_3D) || defined(ROI_TYPE_FREEHAND_2D) || defined(ROI_TYPE_FREEHAND_3D)
-	      POINT_TO_VOXEL(fine_roi_pt, roi_voxel_size, 0, 0, roi_voxel);
-	      if (amitk_raw_data_includes_voxel(roi->map_data, roi_voxel) &&
-		  (AMITK_RAW_DATA_UBYTE_CONTENT(roi->map_data, roi_voxel) != 0)) 
-		voxel_fraction+=grain_size;
+	count = map_voxel_count(roi, roi_voxel_size, roi_origin, roi_step, j);
 #endif
-	      fine_ds_pt.x += sub_voxel_size.x;
-	    } /* k.x loop */
-	  } /* k.y loop */
-	} /* k.z loop */
+	voxel_fraction = count*grain_size;
 
 	if (!inverse) {
 	  if (voxel_fraction > 0.0) {
+	    value = amitk_data_set_get_value(ds,j);
 	    (*calculation)(j, value, voxel_fraction, data);
 	  }
 	} else {
 	  if (voxel_fraction < 1.0) {
+	    value = amitk_data_set_get_value(ds,j);
 	    (*calculation)(j, value, 1.0-voxel_fraction, data);
 	  }
 	}
-      } /* i.x loop */
-    } /* i.y loop */
-  } /* i.z loop */
+      } /* j.x loop */
+    } /* j.y loop */
+  } /* j.z loop */
 
   return;
 }
@@ -38,6 +38,10 @@
 #include "legacy.h"
 #include "amide.h"
 
+/* once more than this fraction of a flat file is taken up by stale data,
+   saves rewrite (compact) the file instead of appending to it */
+#define AMITK_STUDY_MAX_STALE_FRACTION 0.5
+
 
 enum {
   FILENAME_CHANGED,
@@ -1074,104 +1078,625 @@ AmitkStudy * amitk_study_load_xml(const gchar * study_filename) {
 
 
 
-/* function to writeout the study to disk in an xif file */
-gboolean amitk_study_save_xml(AmitkStudy * study, const gchar * study_filename,
-			      gboolean save_as_directory) {
+/* removes the files amide wrote into an xif directory, and optionally the directory itself */
+static gboolean study_remove_xif_directory(const gchar * dir_name, gboolean remove_dir) {
 
-  gchar * old_dir=NULL;
-  struct stat file_info;
   gchar * temp_string;
   DIR * directory;
   struct dirent * directory_entry;
-  guint64 location, size;
-  guint64 location_le, size_le;
-  FILE * study_file=NULL;
 
-  /* see if the filename already exists, remove stuff if needed */
-  if (stat(study_filename, &file_info) == 0) {
+  if ((directory = opendir(dir_name)) == NULL) {
+    g_warning(_("Couldn't open directory: %s"), dir_name);
+    return FALSE;
+  }
 
-    /* and start deleting everything in the filename/directory */
-    if (S_ISDIR(file_info.st_mode)) {
-      directory = opendir(study_filename);
-      while ((directory_entry = readdir(directory)) != NULL) {
-	temp_string = 
-	  g_strdup_printf("%s%s%s", study_filename,G_DIR_SEPARATOR_S, directory_entry->d_name);
+  while ((directory_entry = readdir(directory)) != NULL) {
+    temp_string = 
+      g_strdup_printf("%s%s%s", dir_name,G_DIR_SEPARATOR_S, directory_entry->d_name);
+    
+    if ((g_pattern_match_simple("*.xml",directory_entry->d_name)) ||
+	(g_pattern_match_simple("*.dat",directory_entry->d_name)))
+      if (unlink(temp_string) != 0)
+	g_warning(_("Couldn't unlink file: %s"),temp_string);
+    
+    g_free(temp_string);
+  }
+  closedir(directory);
 
-	if ((g_pattern_match_simple("*.xml",directory_entry->d_name)) ||
-	    (g_pattern_match_simple("*.dat",directory_entry->d_name)))
-	  if (unlink(temp_string) != 0)
-	    g_warning(_("Couldn't unlink file: %s"),temp_string);
+  if (remove_dir)
+    if (rmdir(dir_name) != 0) {
+      g_warning(_("Couldn't remove directory: %s"), dir_name);
+      return FALSE;
+    }
 
-	g_free(temp_string);
-      }
-      if (!save_as_directory) /* get rid of the directory too if we're overwriting with a file*/
-	if (rmdir(study_filename) != 0) {
-	  g_warning(_("Couldn't remove directory: %s"), study_filename);
-	  return FALSE;
-	}
+  return TRUE;
+}
+
+/* moves a freshly written xif file/directory over whatever is at study_filename.
+   The new study is only put in place once it's been completely written, so 
+   a failure while saving never costs us the previous copy of the study. */
+static gboolean study_replace_xif(const gchar * temp_filename, const gchar * study_filename) {
 
+  struct stat file_info;
+  gchar * old_filename=NULL;
+  gboolean return_val=TRUE;
+
+  if (stat(study_filename, &file_info) == 0) {
+    if (S_ISDIR(file_info.st_mode)) {
+      /* directories can't be renamed over, so move the old one out of the way first */
+      old_filename = g_strdup_printf("%s.old", study_filename);
+      if (stat(old_filename, &file_info) == 0)
+	study_remove_xif_directory(old_filename, TRUE);
+      if (g_rename(study_filename, old_filename) != 0) {
+	g_warning(_("Couldn't move aside old study: %s"), study_filename);
+	g_free(old_filename);
+	return FALSE;
+      }
     } else if (S_ISREG(file_info.st_mode)) {
+#ifdef G_PLATFORM_WIN32
+      /* rename won't overwrite an existing file on win32 */
       if (unlink(study_filename) != 0) {
 	g_warning(_("Couldn't unlink file: %s"),study_filename);
 	return FALSE;
       }
-
+#endif
     } else {
       g_warning(_("Unrecognized file type for file: %s, couldn't delete"),study_filename);
       return FALSE;
     }
-  } 
+  }
 
-  if (save_as_directory) {
-    if (stat(study_filename, &file_info) != 0) {
-      /* make the directory if needed */
-      if (g_mkdir(study_filename, 0766) != 0) 
-	{
-	  g_warning(_("Couldn't create amide directory: %s"),study_filename);
-	  return FALSE;
-	}
-    }
+  if (g_rename(temp_filename, study_filename) != 0) {
+    g_warning(_("Couldn't rename %s to %s"), temp_filename, study_filename);
+    if (old_filename != NULL) /* try to put the old study back */
+      g_rename(old_filename, study_filename);
+    return_val = FALSE;
+  } else if (old_filename != NULL) {
+    study_remove_xif_directory(old_filename, TRUE);
+  }
+
+  g_free(old_filename);
+  return return_val;
+}
+
+/* the name we write to before moving the study into place */
+static gchar * study_temp_filename(const gchar * study_filename) {
+
+  gchar * temp_filename;
+  gchar * stripped_filename;
+  struct stat file_info;
+
+  stripped_filename = g_strdup(study_filename);
+  while (g_str_has_suffix(stripped_filename, G_DIR_SEPARATOR_S) && (strlen(stripped_filename) > 1))
+    stripped_filename[strlen(stripped_filename)-1] = '\0';
+
+  temp_filename = g_strdup_printf("%s.tmp", stripped_filename);
+  g_free(stripped_filename);
+
+  /* get rid of anything left behind by a previously interrupted save */
+  if (stat(temp_filename, &file_info) == 0) {
+    if (S_ISDIR(file_info.st_mode)) 
+      study_remove_xif_directory(temp_filename, TRUE);
+    else
+      unlink(temp_filename);
+  }
+
+  return temp_filename;
+}
+
+/* opens up an xif flat file for writing, and puts down the header */
+static FILE * study_open_flat_file(const gchar * filename) {
+
+  FILE * study_file;
+
+  if ((study_file = fopen(filename, "wb")) == NULL) {
+    g_warning(_("Couldn't open file %s\n"), filename);
+    return NULL;
   }
+  fprintf(study_file, "%s Version %s", 
+	  AMITK_FLAT_FILE_MAGIC_STRING,
+	  AMITK_FILE_VERSION);
+  fseek(study_file, 64+2*sizeof(guint64), SEEK_SET);
 
-  /* remember the name of the xif file/directory of this study */
-  amitk_study_set_filename(study, study_filename);
+  return study_file;
+}
+
+/* how many bytes of the study file an appending save gets to reuse for this raw data */
+static guint64 study_raw_data_reused_bytes(AmitkRawData * rd, FILE * study_file) {
+
+  if (rd == NULL) return 0;
+  if (!amitk_raw_data_stored_in_file(rd, study_file)) return 0;
+
+  /* the size of the block on disk, which is smaller than in memory if compressed */
+  return rd->xif_size;
+}
+
+/* a full save writes everything into a new file, make sure none of the raw data
+   gets mistaken as already being in it (see amitk_raw_data_clear_xif_location) */
+static void study_clear_xif_locations(AmitkStudy * study) {
+
+  GList * objects, * temp_objects;
+  AmitkDataSet * ds;
+  AmitkRoi * roi;
+
+  objects = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_DATA_SET, TRUE);
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    ds = AMITK_DATA_SET(temp_objects->data);
+    if (ds->raw_data != NULL) amitk_raw_data_clear_xif_location(ds->raw_data);
+    if (ds->internal_scaling_factor != NULL) amitk_raw_data_clear_xif_location(ds->internal_scaling_factor);
+    if (ds->internal_scaling_intercept != NULL) amitk_raw_data_clear_xif_location(ds->internal_scaling_intercept);
+    if (ds->distribution != NULL) amitk_raw_data_clear_xif_location(ds->distribution);
+  }
+  amitk_objects_unref(objects);
+
+  objects = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_ROI, TRUE);
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    roi = AMITK_ROI(temp_objects->data);
+    if (roi->map_data != NULL) amitk_raw_data_clear_xif_location(roi->map_data);
+  }
+  amitk_objects_unref(objects);
+
+  return;
+}
+
+/* tries to open up an existing xif flat file so the study can be appended to it.  
+   Raw data that's already in the file doesn't get written out again (see
+   amitk_raw_data_write_xml), so saving e.g. a few moved ROI's only costs
+   writing the object xml.  The old blocks stay in the file until a full save.
+
+   Returns NULL if a full save should be done instead: the file isn't where this
+   study was loaded from/saved to, none of the raw data in it is still
+   good, or enough of the file has gone stale that it should be compacted.
+   On success, *pend gets set to where the file originally ended */
+static FILE * study_open_flat_file_for_append(AmitkStudy * study, const gchar * filename, 
+					      guint64 * pend) {
+
+  struct stat file_info;
+  FILE * study_file;
+  gchar magic[sizeof(AMITK_FLAT_FILE_MAGIC_STRING)];
+  GList * objects, * temp_objects;
+  AmitkDataSet * ds;
+  guint64 reused_bytes=0;
+
+  if (AMITK_STUDY_FILENAME(study) == NULL) return NULL;
+  if (strcmp(AMITK_STUDY_FILENAME(study), filename) != 0) return NULL;
+  if (stat(filename, &file_info) != 0) return NULL;
+  if (!S_ISREG(file_info.st_mode)) return NULL;
+
+  if ((study_file = fopen(filename, "r+b")) == NULL) return NULL;
+
+  /* make sure it's an xif flat file */
+  if ((fread(magic, 1, strlen(AMITK_FLAT_FILE_MAGIC_STRING), study_file) != strlen(AMITK_FLAT_FILE_MAGIC_STRING)) ||
+      (strncmp(magic, AMITK_FLAT_FILE_MAGIC_STRING, strlen(AMITK_FLAT_FILE_MAGIC_STRING)) != 0)) {
+    fclose(study_file);
+    return NULL;
+  }
+
+  /* figure out how much of the file we can reuse */
+  objects = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_DATA_SET, TRUE);
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    ds = AMITK_DATA_SET(temp_objects->data);
+    reused_bytes += study_raw_data_reused_bytes(ds->raw_data, study_file);
+    reused_bytes += study_raw_data_reused_bytes(ds->internal_scaling_factor, study_file);
+    reused_bytes += study_raw_data_reused_bytes(ds->internal_scaling_intercept, study_file);
+    reused_bytes += study_raw_data_reused_bytes(ds->distribution, study_file);
+  }
+  amitk_objects_unref(objects);
+
+  objects = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_ROI, TRUE);
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) 
+    reused_bytes += study_raw_data_reused_bytes(AMITK_ROI(temp_objects->data)->map_data, study_file);
+  amitk_objects_unref(objects);
+
+  reused_bytes = MIN(reused_bytes, (guint64) file_info.st_size);
+  if ((reused_bytes == 0) || 
+      (((gdouble) (file_info.st_size - reused_bytes)) > AMITK_STUDY_MAX_STALE_FRACTION*file_info.st_size)) {
+    fclose(study_file);
+    return NULL;
+  }
+
+  if (fseek(study_file, 0, SEEK_END) != 0) {
+    fclose(study_file);
+    return NULL;
+  }
+  *pend = ftell(study_file);
+
+  return study_file;
+}
+
+/* writes the study into the flat file and records the location of the study object xml.
+   Returns FALSE on any write error or if the write was cancelled (see 
+   amitk_raw_data_set_write_cancel_flag), in which case the header isn't touched */
+static gboolean study_write_flat_file(AmitkStudy * study, FILE * study_file) {
+
+  guint64 location, size;
+  guint64 location_le, size_le;
+  gboolean okay;
+
+  amitk_object_write_xml(AMITK_OBJECT(study), study_file, NULL, &location, &size);
+  if (amitk_raw_data_write_cancelled())
+    return FALSE;
+
+  /* make sure everything's out before pointing the header at the new study xml */
+  if ((fflush(study_file) != 0) || (ferror(study_file) != 0))
+    return FALSE;
+
+  /* record location of study object xml, always little endian */
+  fseek(study_file, 64, SEEK_SET);
+  location_le = GUINT64_TO_LE(location);
+  size_le = GUINT64_TO_LE(size);
+  fwrite(&location_le, 1, sizeof(guint64), study_file);
+  fwrite(&size_le, 1, sizeof(guint64), study_file);
+
+  okay = (fflush(study_file) == 0);
+  if (ferror(study_file) != 0) okay = FALSE;
+
+  return okay;
+}
+
+
+/* does the actual work for amitk_study_save_xml */
+static gboolean study_save_xml(AmitkStudy * study, const gchar * study_filename,
+			       gboolean save_as_directory) {
+
+  gchar * old_dir=NULL;
+  gchar * temp_filename;
+  FILE * study_file=NULL;
+  gboolean okay=TRUE;
+  guint64 end;
+
+  /* see if we can just add the changes onto the existing file */
+  if (!save_as_directory) {
+    if ((study_file = study_open_flat_file_for_append(study, study_filename, &end)) != NULL) {
+      okay = study_write_flat_file(study, study_file);
+      if (!okay) /* drop whatever we partially wrote */
+	if (ftruncate(fileno(study_file), end) != 0)
+	  g_warning(_("Couldn't truncate file: %s"), study_filename);
+      if (fclose(study_file) != 0) okay = FALSE;
+      return okay;
+    }
+  }
 
+  /* write everything out to a temporary file/directory first */
+  temp_filename = study_temp_filename(study_filename);
 
-  /* get into the output directory/create output file */
   if (save_as_directory) {
+    /* make the directory */
+    if (g_mkdir(temp_filename, 0766) != 0) {
+      g_warning(_("Couldn't create amide directory: %s"),temp_filename);
+      g_free(temp_filename);
+      return FALSE;
+    }
+
+    /* get into the output directory */
     old_dir = g_get_current_dir();
-    if (chdir(study_filename) != 0) {
+    if (chdir(temp_filename) != 0) {
       g_warning(_("Couldn't change directories in writing study, study not saved"));
+      study_remove_xif_directory(temp_filename, TRUE);
+      g_free(temp_filename);
+      g_free(old_dir);
       return FALSE;
     }
+
+    /* save the study */
+    amitk_object_write_xml(AMITK_OBJECT(study), NULL, NULL, NULL, NULL);
+    if (amitk_raw_data_write_cancelled()) /* some of the raw data didn't get written */
+      okay = FALSE;
+
+    if (chdir(old_dir) != 0) {
+      g_warning(_("Couldn't return to previous directory in load study"));
+      okay = FALSE;
+    }
+    g_free(old_dir);
+
   } else { /* flat file */
-    if ((study_file = fopen(study_filename, "wb")) == NULL) {
-      g_warning(_("Couldn't open file %s\n"), study_filename);
+    if ((study_file = study_open_flat_file(temp_filename)) == NULL) {
+      g_free(temp_filename);
       return FALSE;
     }
-    fprintf(study_file, "%s Version %s", 
-	    AMITK_FLAT_FILE_MAGIC_STRING,
-	    AMITK_FILE_VERSION);
-    fseek(study_file, 64+2*sizeof(guint64), SEEK_SET);
+    study_clear_xif_locations(study);
+    okay = study_write_flat_file(study, study_file);
+    if (fclose(study_file) != 0) okay = FALSE;
   }
 
-  /* save the study */
-  amitk_object_write_xml(AMITK_OBJECT(study), study_file, NULL, &location, &size);
+  /* and move the new study into place */
+  if (okay) 
+    okay = study_replace_xif(temp_filename, study_filename);
 
-  if (save_as_directory) {
-    if (chdir(old_dir) != 0) {
-      g_warning(_("Couldn't return to previous directory in load study"));
-      study = amitk_object_unref(study);
+  if (!okay) {
+    if (save_as_directory) 
+      study_remove_xif_directory(temp_filename, TRUE);
+    else
+      unlink(temp_filename);
+  } else {
+    /* remember the name of the xif file/directory of this study */
+    amitk_study_set_filename(study, study_filename);
+  }
+
+  g_free(temp_filename);
+
+  return okay;
+}
+
+
+/* function to writeout the study to disk in an xif file */
+gboolean amitk_study_save_xml(AmitkStudy * study, const gchar * study_filename,
+			      gboolean save_as_directory) {
+
+  gint failed=FALSE;
+  gboolean okay;
+
+  /* gets set if writing out any of the raw data fails */
+  amitk_raw_data_set_write_cancel_flag(&failed);
+  okay = study_save_xml(study, study_filename, save_as_directory);
+  amitk_raw_data_set_write_cancel_flag(NULL);
+
+  return okay;
+}
+
+
+/* stuff for saving a study in the background */
+typedef struct {
+  AmitkRawData * original; /* in the study the user is working with */
+  AmitkRawData * copy; /* what the worker thread writes out */
+  guint modification; /* of the original when the copy was made */
+} study_save_raw_data_t;
+
+typedef struct {
+  AmitkStudy * study; /* the study the user is working with */
+  AmitkStudy * snapshot; /* copy of the object tree that the worker thread writes out */
+  GPtrArray * raw_data; /* study_save_raw_data_t's, for each raw data in the snapshot */
+  gchar * study_filename;
+  gchar * temp_filename; /* NULL if we're appending to study_filename */
+  FILE * study_file;
+  guint64 start_offset;
+  guint64 total_bytes;
+  gboolean okay;
+  gint cancelled; /* set from the main loop, polled by the worker, so atomic access only */
+  gboolean reporting; /* inside update_func, which may run the main loop */
+  GThread * thread;
+  guint progress_id;
+  AmitkUpdateFunc update_func;
+  gpointer update_data;
+  AmitkStudySaveFunc done_func;
+  gpointer done_data;
+} study_save_t;
+
+static gboolean study_save_finish(gpointer data);
+
+/* runs in the worker thread, only touches the snapshot */
+static gpointer study_save_thread(gpointer data) {
+
+  study_save_t * save = data;
+
+  amitk_raw_data_set_write_cancel_flag(&(save->cancelled));
+  save->okay = study_write_flat_file(save->snapshot, save->study_file);
+  amitk_raw_data_set_write_cancel_flag(NULL);
+
+  g_idle_add(study_save_finish, save);
+
+  return NULL;
+}
+
+/* runs in the main loop, reports how far along the worker is */
+static gboolean study_save_progress(gpointer data) {
+
+  study_save_t * save = data;
+  gdouble fraction;
+  long position;
+
+  if (save->update_func == NULL) return TRUE;
+
+  /* stdio locks the stream, so it's safe to ask where the worker's at */
+  position = ftell(save->study_file);
+  if ((save->total_bytes == 0) || (position < 0))
+    fraction = -1.0; /* pulse */
+  else
+    fraction = CLAMP(((gdouble) (position-save->start_offset))/((gdouble) save->total_bytes), 0.0, 1.0);
+
+  save->reporting = TRUE;
+  if (!(*save->update_func)(save->update_data, NULL, fraction))
+    g_atomic_int_set(&(save->cancelled), TRUE);
+  save->reporting = FALSE;
+
+  return TRUE;
+}
+
+/* runs in the main loop once the worker is done */
+static gboolean study_save_finish(gpointer data) {
+
+  study_save_t * save = data;
+  study_save_raw_data_t * entry;
+  gboolean okay;
+  guint i;
+
+  /* the progress dialog iterates the main loop, wait until we're back out of it */
+  if (save->reporting) return TRUE;
+
+  g_thread_join(save->thread);
+  g_source_remove(save->progress_id);
+
+  /* the progress callback polls the file, so only close it once that's been removed */
+  if (save->temp_filename == NULL) { 
+    /* appended to the old file, on failure or cancel cut it back to where it was */
+    okay = save->okay && !g_atomic_int_get(&(save->cancelled));
+    if (!okay) 
+      if (ftruncate(fileno(save->study_file), save->start_offset) != 0)
+	g_warning(_("Couldn't truncate file: %s"), save->study_filename);
+    if (fclose(save->study_file) != 0) okay = FALSE;
+
+  } else {
+    okay = save->okay && !g_atomic_int_get(&(save->cancelled));
+    if (fclose(save->study_file) != 0) okay = FALSE;
+    if (okay) 
+      okay = study_replace_xif(save->temp_filename, save->study_filename);
+    
+    if (okay) 
+      amitk_study_set_filename(save->study, save->study_filename);
+    else
+      unlink(save->temp_filename);
+  }
+
+  /* now that the file's in place, remember where the raw data ended up in it, 
+     unless it's been changed in the meantime */
+  if (okay) 
+    for (i=0; i < save->raw_data->len; i++) {
+      entry = g_ptr_array_index(save->raw_data, i);
+      if (AMITK_RAW_DATA_MODIFICATION(entry->original) == entry->modification) 
+	amitk_raw_data_copy_xif_location(entry->original, entry->copy);
     }
-  } else { /* flat file */
-    /* record location of study object xml, always little endian */
-    fseek(study_file, 64, SEEK_SET);
-    location_le = GUINT64_TO_LE(location);
-    size_le = GUINT64_TO_LE(size);
-    fwrite(&location_le, 1, sizeof(guint64), study_file);
-    fwrite(&size_le, 1, sizeof(guint64), study_file);
-    fclose(study_file);
+
+  if (save->update_func != NULL) /* remove progress bar */
+    (*save->update_func)(save->update_data, NULL, (gdouble) 2.0); 
+
+  if (save->done_func != NULL)
+    (*save->done_func)(save->study, save->study_filename, okay, save->done_data);
+
+  g_ptr_array_free(save->raw_data, TRUE);
+  amitk_object_unref(save->snapshot);
+  amitk_object_unref(save->study);
+  g_free(save->study_filename);
+  g_free(save->temp_filename);
+  g_free(save);
+
+  return FALSE;
+}
+
+static void study_save_raw_data_free(gpointer data) {
+
+  study_save_raw_data_t * entry = data;
+
+  g_object_unref(entry->original);
+  g_object_unref(entry->copy);
+  g_free(entry);
+
+  return;
+}
+
+/* points *prd at a read only view of the raw data for the snapshot, so the
+   data itself doesn't get copied.  Anything that changes the originals in
+   place (ROI painting, setting voxel values) switches over to its own copy
+   while the view is around (see amitk_raw_data_share), and the worker records
+   where it put each view in the view, so nothing the main loop uses gets
+   touched from the worker thread.  Raw data that's already in the file only
+   gets referred to, so only where it's stored gets copied */
+static void study_save_share_raw_data(study_save_t * save, AmitkRawData ** prd) {
+
+  study_save_raw_data_t * entry;
+  AmitkRawData * copy;
+
+  if (*prd == NULL) return;
+
+  /* a new file might have the inode of a deleted one, so only trust the
+     location of the raw data when appending */
+  if ((save->temp_filename == NULL) && amitk_raw_data_stored_in_file(*prd, save->study_file)) {
+    copy = amitk_raw_data_copy_xif_reference(*prd);
+  } else {
+    copy = amitk_raw_data_share(*prd);
+    amitk_raw_data_clear_xif_location(copy);
+    save->total_bytes += amitk_raw_data_size_data_mem(copy);
+  }
+
+  entry = g_new(study_save_raw_data_t, 1);
+  entry->original = *prd; /* takes over the snapshot's reference */
+  entry->copy = g_object_ref(copy);
+  entry->modification = AMITK_RAW_DATA_MODIFICATION(*prd);
+  g_ptr_array_add(save->raw_data, entry);
+
+  *prd = copy;
+
+  return;
+}
+
+/* gives the snapshot its own view of all the raw data the worker will be writing */
+static void study_save_share_snapshot_raw_data(study_save_t * save) {
+
+  GList * objects, * temp_objects;
+  AmitkDataSet * ds;
+  AmitkRoi * roi;
+
+  objects = amitk_object_get_children_of_type(AMITK_OBJECT(save->snapshot), AMITK_OBJECT_TYPE_DATA_SET, TRUE);
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    ds = AMITK_DATA_SET(temp_objects->data);
+    study_save_share_raw_data(save, &(ds->raw_data));
+    study_save_share_raw_data(save, &(ds->internal_scaling_factor));
+    study_save_share_raw_data(save, &(ds->internal_scaling_intercept));
+    study_save_share_raw_data(save, &(ds->distribution));
   }
+  amitk_objects_unref(objects);
+
+  objects = amitk_object_get_children_of_type(AMITK_OBJECT(save->snapshot), AMITK_OBJECT_TYPE_ROI, TRUE);
+  for (temp_objects = objects; temp_objects != NULL; temp_objects = temp_objects->next) {
+    roi = AMITK_ROI(temp_objects->data);
+    study_save_share_raw_data(save, &(roi->map_data));
+  }
+  amitk_objects_unref(objects);
+
+  return;
+}
+
+/* saves the study as an xif flat file without blocking the main loop.
+
+   A copy of the object tree is made, sharing the raw data read only
+   (see study_save_share_raw_data), and the copy gets written out to
+   a temporary file from a worker thread.  Once the file is complete, it
+   gets renamed over the old one and done_func is called from the main loop.
+   update_func gets called periodically from the main loop with the progress,
+   returning FALSE from it cancels the save.  
+
+   Returns FALSE if the save couldn't be started. */
+gboolean amitk_study_save_xml_in_background(AmitkStudy * study, 
+					    const gchar * study_filename,
+					    AmitkUpdateFunc update_func,
+					    gpointer update_data,
+					    AmitkStudySaveFunc done_func,
+					    gpointer done_data) {
+
+  study_save_t * save;
+  gchar * temp_string;
+
+  g_return_val_if_fail(AMITK_IS_STUDY(study), FALSE);
+  g_return_val_if_fail(study_filename != NULL, FALSE);
+
+  save = g_try_new(study_save_t, 1);
+  g_return_val_if_fail(save != NULL, FALSE);
+
+  save->study_filename = g_strdup(study_filename);
+  save->temp_filename = NULL;
+  save->start_offset = 0;
+  if ((save->study_file = study_open_flat_file_for_append(study, study_filename, 
+							  &(save->start_offset))) == NULL) {
+    save->temp_filename = study_temp_filename(study_filename);
+    if ((save->study_file = study_open_flat_file(save->temp_filename)) == NULL) {
+      g_free(save->study_filename);
+      g_free(save->temp_filename);
+      g_free(save);
+      return FALSE;
+    }
+  }
+
+  save->snapshot = AMITK_STUDY(amitk_object_copy(AMITK_OBJECT(study)));
+  save->raw_data = g_ptr_array_new_with_free_func(study_save_raw_data_free);
+  save->total_bytes = 0; /* about how much we'll be writing */
+  study_save_share_snapshot_raw_data(save);
+
+  save->study = amitk_object_ref(study);
+  save->okay = FALSE;
+  g_atomic_int_set(&(save->cancelled), FALSE);
+  save->reporting = FALSE;
+  save->update_func = update_func;
+  save->update_data = update_data;
+  save->done_func = done_func;
+  save->done_data = done_data;
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Saving: %s"), study_filename);
+    (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+
+  save->progress_id = g_timeout_add(100, study_save_progress, save);
+  save->thread = g_thread_new("amitk_study_save", study_save_thread, save);
 
   return TRUE;
 }
@@ -138,6 +138,9 @@ struct _AmitkStudyClass
 
 
 
+typedef void (*AmitkStudySaveFunc) (AmitkStudy * study, const gchar * study_filename, 
+				    gboolean saved, gpointer data);
+
 /* Application-level methods */
 
 GType	        amitk_study_get_type	             (void);
@@ -187,6 +190,12 @@ AmitkStudy *    amitk_study_load_xml                (const gchar * study_filenam
 gboolean        amitk_study_save_xml                (AmitkStudy * study, 
 						     const gchar * study_filename,
 						     const gboolean save_as_directory);
+gboolean        amitk_study_save_xml_in_background  (AmitkStudy * study,
+						     const gchar * study_filename,
+						     AmitkUpdateFunc update_func,
+						     gpointer update_data,
+						     AmitkStudySaveFunc done_func,
+						     gpointer done_data);
 
 const gchar *   amitk_fuse_type_get_name            (const AmitkFuseType fuse_type);
 const gchar *   amitk_view_mode_get_name            (const AmitkViewMode view_mode);
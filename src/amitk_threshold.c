@@ -44,6 +44,9 @@
 #define THRESHOLD_TRIANGLE_WIDTH 16.0
 #define THRESHOLD_TRIANGLE_HEIGHT 12.0
 
+/* about how many voxels go into the quick histogram we show while the full one's calculated */
+#define THRESHOLD_HISTOGRAM_SAMPLES (1<<20)
+
 
 /* internal variables */
 static gchar * thresholding_names[] = {
@@ -79,6 +82,7 @@ static void threshold_add_data_set(AmitkThreshold * threshold, AmitkDataSet * ds
 static void threshold_remove_data_set(AmitkThreshold * threshold);
 static gint threshold_visible_refs(AmitkDataSet * data_set);
 static void threshold_update_histogram(AmitkThreshold * threshold);
+static void threshold_cancel_histogram(AmitkThreshold * threshold);
 static void threshold_update_spin_buttons(AmitkThreshold * threshold);
 static void threshold_update_arrow(AmitkThreshold * threshold, AmitkThresholdArrow arrow);
 static void threshold_update_color_scale(AmitkThreshold * threshold, AmitkThresholdScale scale);
@@ -184,6 +188,7 @@ static void threshold_init (AmitkThreshold *threshold)
       threshold->connector_line[i_ref][i_line] = NULL;
   }
   threshold->histogram_image = NULL;
+  threshold->histogram_job = NULL;
 
   if (threshold_cursor == NULL)
     threshold_cursor = gdk_cursor_new_for_display(gdk_display_get_default(),
@@ -655,6 +660,7 @@ static void threshold_remove_data_set(AmitkThreshold * threshold) {
   AmitkStudy * study;
 
   if (threshold->data_set == NULL) return;
+  threshold_cancel_histogram(threshold);
   study = AMITK_STUDY(amitk_object_get_parent_of_type(AMITK_OBJECT(threshold->data_set), AMITK_OBJECT_TYPE_STUDY)); /* unreferenced pointer */
 
   AMITK_OBJECT(threshold->data_set)->dialog = NULL;
@@ -683,8 +689,21 @@ static gint threshold_visible_refs(AmitkDataSet * data_set) {
     return 1;
 }
 
-/* refresh what's on the histogram */
-static void threshold_update_histogram(AmitkThreshold * threshold) {
+/* stuff for calculating the histogram in the background */
+typedef struct {
+  AmitkThreshold * threshold; /* NULL if the threshold has moved on without us */
+  AmitkDataSet * data_set;
+  AmitkDataSet * snapshot; /* copy of data_set that the worker bins, so the scaling
+			      can be changed on the main thread in the meantime */
+  AmitkRawData * raw_data; /* data_set's raw data when we started... */
+  guint modification; /* ...and its modification count */
+  AmitkRawData * distribution;
+  gint cancelled; /* set from the main thread, read from the worker */
+  GThread * thread;
+} threshold_histogram_t;
+
+/* put the given distribution up on the histogram canvas */
+static void threshold_show_distribution(AmitkThreshold * threshold, AmitkRawData * distribution) {
 
   rgb_t fg;
   AmitkCanvasItem * root;
@@ -692,8 +711,6 @@ static void threshold_update_histogram(AmitkThreshold * threshold) {
   GdkPixbuf * pixbuf;
   GdkRGBA rgba;
 
-  if (threshold->minimal) return; /* no histogram in minimal configuration */
-
   /* figure out what colors to use for the distribution image */
   /* GTK 3 returns white color for the threshold widget, while GTK 2
      returns black.  So use the progress dialog (should be the same).  */
@@ -708,9 +725,7 @@ static void threshold_update_histogram(AmitkThreshold * threshold) {
   fg.g = (int)(0.5 + CLAMP(rgba.green, 0., 1.) * 255.);
   fg.b = (int)(0.5 + CLAMP(rgba.blue, 0., 1.) * 255.);
 
-  pixbuf = image_of_distribution(threshold->data_set, fg, 
-				 amitk_progress_dialog_update, 
-				 threshold->progress_dialog);
+  pixbuf = image_from_distribution(distribution, fg);
 
   root = amitk_simple_canvas_get_root_item(AMITK_SIMPLE_CANVAS(threshold->histogram));
   if (pixbuf != NULL) {
@@ -726,6 +741,130 @@ static void threshold_update_histogram(AmitkThreshold * threshold) {
   return;
 }
 
+/* update_func for the worker, just tells it whether to keep going */
+static gboolean threshold_histogram_continue(gpointer data, char * message, gdouble fraction) {
+
+  threshold_histogram_t * job = data;
+
+  return !g_atomic_int_get(&job->cancelled);
+}
+
+/* runs in the main loop once the worker's done */
+static gboolean threshold_histogram_finish(gpointer data) {
+
+  threshold_histogram_t * job = data;
+
+  g_thread_join(job->thread);
+
+  /* throw out the distribution if the data's been changed since we started */
+  if ((job->distribution != NULL) &&
+      ((AMITK_DATA_SET_RAW_DATA(job->data_set) != job->raw_data) ||
+       (AMITK_RAW_DATA_MODIFICATION(job->raw_data) != job->modification))) {
+    g_object_unref(job->distribution);
+    job->distribution = NULL;
+  }
+
+  /* even if we got cancelled, a finished and up to date distribution is still good for the data set */
+  if ((job->distribution != NULL) && !amitk_data_set_has_distribution(job->data_set))
+    amitk_data_set_set_distribution(job->data_set, job->distribution);
+
+  if (job->threshold != NULL) {
+    job->threshold->histogram_job = NULL;
+    if (job->distribution != NULL)
+      threshold_show_distribution(job->threshold, job->distribution);
+  }
+
+  if (job->distribution != NULL)
+    g_object_unref(job->distribution);
+  g_object_unref(job->raw_data);
+  amitk_object_unref(job->snapshot);
+  amitk_object_unref(job->data_set);
+  g_free(job);
+
+  return FALSE;
+}
+
+/* runs in the worker thread, only reads from the snapshot */
+static gpointer threshold_histogram_thread(gpointer data) {
+
+  threshold_histogram_t * job = data;
+
+  job->distribution = amitk_data_set_bin_distribution(job->snapshot, 1,
+						      threshold_histogram_continue, job);
+  g_idle_add(threshold_histogram_finish, job);
+
+  return NULL;
+}
+
+/* stop waiting on the background histogram, the worker cleans up after itself */
+static void threshold_cancel_histogram(AmitkThreshold * threshold) {
+
+  threshold_histogram_t * job = threshold->histogram_job;
+
+  if (job == NULL) return;
+
+  g_atomic_int_set(&job->cancelled, TRUE);
+  job->threshold = NULL;
+  threshold->histogram_job = NULL;
+
+  return;
+}
+
+/* refresh what's on the histogram.  If the distribution hasn't been
+   calculated yet, put up one from a sample of the voxels, and fill
+   in the full one from a worker thread when it's ready */
+static void threshold_update_histogram(AmitkThreshold * threshold) {
+
+  AmitkDataSet * ds;
+  AmitkRawData * distribution;
+  threshold_histogram_t * job;
+  AmitkVoxel dim;
+  gdouble num_voxels;
+  amide_intpoint_t stride;
+
+  if (threshold->minimal) return; /* no histogram in minimal configuration */
+
+  threshold_cancel_histogram(threshold);
+  ds = threshold->data_set;
+
+  if (amitk_data_set_has_distribution(ds)) {
+    threshold_show_distribution(threshold, AMITK_DATA_SET_DISTRIBUTION(ds));
+    return;
+  }
+
+  /* small data sets aren't worth the thread */
+  dim = AMITK_DATA_SET_DIM(ds);
+  num_voxels = ((gdouble) dim.x)*dim.y*dim.z*dim.g*dim.t;
+  if (num_voxels <= THRESHOLD_HISTOGRAM_SAMPLES) {
+    amitk_data_set_calc_distribution(ds, amitk_progress_dialog_update, threshold->progress_dialog);
+    threshold_show_distribution(threshold, AMITK_DATA_SET_DISTRIBUTION(ds));
+    return;
+  }
+
+  /* the worker needs the min/max ahead of time */
+  amitk_data_set_calc_min_max_if_needed(ds, amitk_progress_dialog_update, threshold->progress_dialog);
+
+  /* quick look from every stride'th voxel in x, y, and z */
+  stride = ceil(cbrt(num_voxels/THRESHOLD_HISTOGRAM_SAMPLES));
+  distribution = amitk_data_set_bin_distribution(ds, stride, NULL, NULL);
+  threshold_show_distribution(threshold, distribution);
+  if (distribution != NULL)
+    g_object_unref(distribution);
+
+  job = g_new0(threshold_histogram_t, 1);
+  job->threshold = threshold;
+  job->data_set = amitk_object_ref(ds);
+  job->snapshot = AMITK_DATA_SET(amitk_object_copy(AMITK_OBJECT(ds)));
+  job->raw_data = g_object_ref(AMITK_DATA_SET_RAW_DATA(ds));
+  job->modification = AMITK_RAW_DATA_MODIFICATION(job->raw_data);
+  job->distribution = NULL;
+  job->cancelled = FALSE;
+  threshold->histogram_job = job;
+  job->thread = g_thread_new("amitk_threshold_histogram", threshold_histogram_thread, job);
+
+  return;
+}
+
 /* function to update the spin button widgets */
 static void threshold_update_spin_buttons(AmitkThreshold * threshold) {
 
@@ -123,6 +123,7 @@ struct _AmitkThreshold
   amide_data_t threshold_min[2]; 
 
   GtkWidget * progress_dialog;
+  gpointer histogram_job; /* distribution being calculated in the background, if any */
 
   AmitkDataSet * data_set; /* what data set this threshold corresponds to */
 };
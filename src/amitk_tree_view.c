@@ -85,11 +85,6 @@ enum {
   NUM_COLUMNS
 };
 
-typedef struct {
-  AmitkObject * object;
-  GtkTreeIter iter;
-  gboolean found;
-} tree_view_find_t;
 
 static void tree_view_class_init (AmitkTreeViewClass *klass);
 static void tree_view_init (AmitkTreeView *tree_view);
@@ -151,7 +146,6 @@ static void tree_view_object_update_cb(AmitkObject * object, gpointer tree_view)
 static void tree_view_data_set_color_table_cb(AmitkDataSet * data_set, AmitkViewMode view_mode, gpointer tree_view);
 static void tree_view_object_add_child_cb(AmitkObject * parent, AmitkObject * child, gpointer tree_view);
 static void tree_view_object_remove_child_cb(AmitkObject * parent, AmitkObject * child, gpointer tree_view);
-static gboolean tree_view_find_recurse(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, gpointer data);
 static gboolean tree_view_find_object(AmitkTreeView * tree_view, AmitkObject * object, GtkTreeIter * iter);
 static void tree_view_add_object(AmitkTreeView * tree_view, AmitkObject * object);
 static void tree_view_remove_object(AmitkTreeView * tree_view, AmitkObject * object);
@@ -278,6 +272,12 @@ static void tree_view_init (AmitkTreeView * tree_view)
   tree_view->drag_begin_possible = FALSE;
   tree_view->src_object = NULL;
   tree_view->dest_object = NULL;
+
+  /* GtkTreeStore iters persist for the life of their row, so they can be 
+     kept around to find an object's row without searching the store */
+  tree_view->store = NULL;
+  tree_view->object_rows = g_hash_table_new_full(g_direct_hash, g_direct_equal, 
+						 NULL, (GDestroyNotify) gtk_tree_iter_free);
   //  tree_view->drag_list = gtk_target_list_new(drag_types, G_N_ELEMENTS(drag_types));
 
   /* setup ability to do drag-n-drop */
@@ -322,6 +322,16 @@ static void tree_view_destroy (GtkWidget * object) {
     tree_view->study = NULL;
   }
 
+  if (tree_view->object_rows != NULL) {
+    g_hash_table_destroy(tree_view->object_rows);
+    tree_view->object_rows = NULL;
+  }
+
+  if (tree_view->store != NULL) {
+    g_object_unref(tree_view->store);
+    tree_view->store = NULL;
+  }
+
   if (tree_view->preferences != NULL) {
     g_object_unref(tree_view->preferences);
     tree_view->preferences = NULL;
@@ -1174,7 +1184,7 @@ static void tree_view_object_update_cb(AmitkObject * object, gpointer data) {
   g_return_if_fail(AMITK_IS_OBJECT(object));
 
   if (tree_view_find_object(tree_view, object, &iter)) {
-    model = gtk_tree_view_get_model(GTK_TREE_VIEW(tree_view));
+    model = GTK_TREE_MODEL(tree_view->store);
     pixbuf = tree_view_get_object_pixbuf(tree_view, object);
     gtk_tree_store_set(GTK_TREE_STORE(model), &iter,
 		       COLUMN_ICON, pixbuf,
@@ -1233,43 +1243,21 @@ static void tree_view_object_remove_child_cb(AmitkObject * parent, AmitkObject *
   return;
 }
 
-static gboolean tree_view_find_recurse(GtkTreeModel *model, GtkTreePath *path, 
-				  GtkTreeIter *iter, gpointer data) {
-  tree_view_find_t * tree_view_find=data;
-  AmitkObject * object;
-
-  gtk_tree_model_get(model, iter, COLUMN_OBJECT, &object, -1);
-
-  g_return_val_if_fail(object != NULL, FALSE);
-
-  if (object == tree_view_find->object) {
-    tree_view_find->iter = *iter;
-    tree_view_find->found = TRUE;
-    return TRUE;
-  } else {
-    return FALSE;
-  }
-
-}
-
 static gboolean tree_view_find_object(AmitkTreeView * tree_view, AmitkObject * object, GtkTreeIter * iter) {
 
-  GtkTreeModel * model;
-  tree_view_find_t tree_view_find;
+  GtkTreeIter * object_iter;
 
   g_return_val_if_fail(AMITK_IS_TREE_VIEW(tree_view),FALSE);
 
-  model = gtk_tree_view_get_model(GTK_TREE_VIEW(tree_view));
-  tree_view_find.object = object;
-  tree_view_find.found = FALSE;
-
-  gtk_tree_model_foreach(model, tree_view_find_recurse, &tree_view_find);
+  if (tree_view->object_rows == NULL) 
+    return FALSE;
 
-  if (tree_view_find.found) {
-    *iter = tree_view_find.iter;
-    return TRUE;
-  } else 
+  object_iter = g_hash_table_lookup(tree_view->object_rows, object);
+  if (object_iter == NULL) 
     return FALSE;
+
+  *iter = *object_iter;
+  return TRUE;
 }
 
 
@@ -1290,7 +1278,7 @@ static void tree_view_add_object(AmitkTreeView * tree_view, AmitkObject * object
     tree_view->study = AMITK_STUDY(object);
     tree_view_set_view_mode(tree_view, AMITK_STUDY_VIEW_MODE(object));
   }
-  model = gtk_tree_view_get_model(GTK_TREE_VIEW(tree_view));
+  model = GTK_TREE_MODEL(tree_view->store);
 
   if (AMITK_OBJECT_PARENT(object) == NULL) 
     gtk_tree_store_append (GTK_TREE_STORE(model), &iter, NULL);  /* Acquire a top-level iterator */
@@ -1313,6 +1301,7 @@ static void tree_view_add_object(AmitkTreeView * tree_view, AmitkObject * object
 		     COLUMN_NAME, AMITK_OBJECT_NAME(object),
 		     COLUMN_OBJECT, object, -1);
   g_object_unref(pixbuf);
+  g_hash_table_replace(tree_view->object_rows, object, gtk_tree_iter_copy(&iter));
 
   g_signal_connect(G_OBJECT(object), "object_name_changed", G_CALLBACK(tree_view_object_update_cb), tree_view);
   g_signal_connect(G_OBJECT(object), "object_selection_changed", G_CALLBACK(tree_view_object_update_cb), tree_view);
@@ -1370,7 +1359,8 @@ static void tree_view_remove_object(AmitkTreeView * tree_view, AmitkObject * obj
   }
   
   /* remove the object */
-  model = gtk_tree_view_get_model(GTK_TREE_VIEW(tree_view));
+  model = GTK_TREE_MODEL(tree_view->store);
+  g_hash_table_remove(tree_view->object_rows, object);
   gtk_tree_store_remove(GTK_TREE_STORE(model), &iter);
   
   /* and unref */
@@ -1421,7 +1411,7 @@ GtkWidget* amitk_tree_view_new (AmitkTreeViewMode tree_mode,
 			     G_TYPE_STRING, 
 			     G_TYPE_POINTER);
   gtk_tree_view_set_model (GTK_TREE_VIEW(tree_view), GTK_TREE_MODEL (store));
-  g_object_unref(store);
+  tree_view->store = store; /* keep our reference, the store is detached while loading a study */
 
   renderer = gtk_cell_renderer_toggle_new ();
   column = gtk_tree_view_column_new_with_attributes("", renderer, /* "visible" */
@@ -1489,7 +1479,11 @@ void amitk_tree_view_set_study(AmitkTreeView * tree_view, AmitkStudy * study) {
   g_return_if_fail(AMITK_IS_TREE_VIEW(tree_view));
   g_return_if_fail(AMITK_IS_STUDY(study));
 
+  /* detach the store while the study's rows go in, so the view isn't
+     updated for each of what may be hundreds of rows */
+  gtk_tree_view_set_model(GTK_TREE_VIEW(tree_view), NULL);
   tree_view_add_object(tree_view, AMITK_OBJECT(study));
+  gtk_tree_view_set_model(GTK_TREE_VIEW(tree_view), GTK_TREE_MODEL(tree_view->store));
 
   return;
 }
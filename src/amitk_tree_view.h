@@ -64,6 +64,8 @@ struct _AmitkTreeView
   gint mouse_x; /* the current mouse position */
   gint mouse_y; 
   GtkTreePath * current_path;
+  GtkTreeStore * store;
+  GHashTable * object_rows; /* AmitkObject -> GtkTreeIter of its row */
 
   /* drag-n-drop info */
   gboolean drag_begin_possible;
@@ -60,8 +60,11 @@ static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds,
 					      gdouble subfraction, 
 					      gdouble threshold_percentage,
 					      gdouble threshold_value);
+static analysis_frame_t * analysis_frame_init_moments(AmitkRoi * roi, AmitkDataSet * ds,
+						      gboolean accurate);
 static analysis_volume_t * analysis_volume_unref(analysis_volume_t *volume_analysis);
 static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * volumes, 
+						gboolean moments_only,
 						analysis_calculation_t calculation_type,
 						gboolean accurate,
 						gdouble subfraction, 
@@ -90,8 +93,10 @@ static analysis_gate_t * analysis_gate_unref(analysis_gate_t * gate_analysis) {
   /* if we've removed all reference's, free the roi */
   if (gate_analysis->ref_count == 0) {
 
-    g_ptr_array_foreach(gate_analysis->data_array, free_array_element, NULL); /* free the elements */
-    g_ptr_array_free(gate_analysis->data_array, TRUE); /* TRUE frees the array of pointers to elements as well */
+    if (gate_analysis->data_array != NULL) { /* NULL if we only calculated the moments */
+      g_ptr_array_foreach(gate_analysis->data_array, free_array_element, NULL); /* free the elements */
+      g_ptr_array_free(gate_analysis->data_array, TRUE); /* TRUE frees the array of pointers to elements as well */
+    }
 
     /* recursively delete rest of list */
     return_list = analysis_gate_unref(gate_analysis->next_gate_analysis);
@@ -201,6 +206,9 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
   analysis_element_t * element;
   gdouble max;
   gboolean done;
+  const AmitkRoiMask * mask;
+  const AmitkRoiMaskElement * mask_element;
+  AmitkVoxel ds_voxel;
 #ifdef AMIDE_DEBUG
   struct timeval tv1;
   struct timeval tv2;
@@ -227,7 +235,16 @@ static analysis_gate_t * analysis_gate_init_recurse(AmitkRoi * roi,
      If I used a partial sort, I'd have to iterate over the subfraction to find the 
      max and min, and I'd have to do another partial sort to find the median 
   */
-  amitk_roi_calculate_on_data_set(roi, ds, frame, gate,FALSE, accurate, record_stats, data_array);
+  /* the roi's voxel mask only depends on the data set's geometry, so it's
+     computed on the first frame/gate and gathered from after that */
+  mask = amitk_roi_get_mask(roi, ds, accurate);
+  for (i=0; i<mask->elements->len; i++) {
+    mask_element = &g_array_index(mask->elements, AmitkRoiMaskElement, i);
+    ds_voxel = mask_element->voxel;
+    ds_voxel.t = frame;
+    ds_voxel.g = gate;
+    record_stats(ds_voxel, amitk_data_set_get_value(ds, ds_voxel), mask_element->weight, data_array);
+  }
   g_ptr_array_sort(data_array, array_comparison);
   
   switch(calculation_type) {
@@ -464,6 +481,195 @@ static analysis_frame_t * analysis_frame_init(AmitkRoi * roi, AmitkDataSet *ds,
 
 
 
+/* running sums for one frame/gate, for when we only need the moments */
+typedef struct {
+  amide_data_t total; /* sum of weight*value */
+  amide_data_t total_squares; /* sum of weight*value^2 */
+  amide_real_t weights;
+  amide_real_t weights_squared;
+  amide_data_t min;
+  amide_data_t max;
+  guint voxels;
+} analysis_moments_t;
+
+typedef struct {
+  const AmitkDataSet * ds;
+  const AmitkRoiMaskElement * elements;
+  guint * plane_start; /* where each plane starts in elements, num_planes+1 long */
+  guint num_series; /* frames*gates */
+  analysis_moments_t * partials; /* num_series for each plane */
+} analysis_moments_work_t;
+
+/* sums up the moments of each plane of the mask in every frame/gate */
+static void analysis_moments_sum_planes(guint64 start, guint64 end, gpointer data) {
+
+  analysis_moments_work_t * work = data;
+  analysis_moments_t * moments;
+  const AmitkRoiMaskElement * element;
+  amide_data_t * values;
+  amide_data_t value;
+  amide_real_t weight;
+  guint64 plane;
+  guint i, j;
+
+  values = g_new(amide_data_t, work->num_series);
+
+  for (plane=start; plane<end; plane++) {
+    moments = work->partials + plane*work->num_series;
+    for (i=work->plane_start[plane]; i<work->plane_start[plane+1]; i++) {
+      element = work->elements+i;
+      weight = element->weight;
+      if (weight <= 0.0) continue;
+
+      amitk_data_set_get_voxel_series(work->ds, element->voxel, values);
+      for (j=0; j<work->num_series; j++) {
+	value = values[j];
+	moments[j].total += weight*value;
+	moments[j].total_squares += weight*value*value;
+	moments[j].weights += weight;
+	moments[j].weights_squared += weight*weight;
+	if ((moments[j].voxels == 0) || (value < moments[j].min)) moments[j].min = value;
+	if ((moments[j].voxels == 0) || (value > moments[j].max)) moments[j].max = value;
+	moments[j].voxels++;
+      }
+    }
+  }
+
+  g_free(values);
+
+  return;
+}
+
+/* same as analysis_frame_init, but only fills in the moments (no median or data
+   arrays), going over the roi's voxels once for all the frames and gates at once */
+static analysis_frame_t * analysis_frame_init_moments(AmitkRoi * roi, AmitkDataSet * ds,
+						      gboolean accurate) {
+
+  const AmitkRoiMask * mask;
+  analysis_moments_work_t work;
+  analysis_moments_t * moments;
+  analysis_moments_t * partial;
+  analysis_frame_t * frame_analyses = NULL;
+  analysis_frame_t ** pframe;
+  analysis_gate_t ** pgate;
+  analysis_gate_t * analysis;
+  guint num_planes, plane;
+  guint num_frames, num_gates;
+  guint frame, gate;
+  guint i, j;
+  amide_data_t factor;
+
+  /* sanity checks */
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+
+  if (AMITK_ROI_UNDRAWN(roi)) {
+    g_warning(_("ROI: %s appears not to have been drawn"), AMITK_OBJECT_NAME(roi));
+    return NULL;
+  }
+
+  mask = amitk_roi_get_mask(roi, ds, accurate);
+  g_return_val_if_fail(mask != NULL, NULL);
+
+  num_frames = AMITK_DATA_SET_NUM_FRAMES(ds);
+  num_gates = AMITK_DATA_SET_NUM_GATES(ds);
+  work.ds = ds;
+  work.elements = (const AmitkRoiMaskElement *) mask->elements->data;
+  work.num_series = num_frames*num_gates;
+
+  /* split the mask up into runs of voxels on the same plane */
+  work.plane_start = g_new(guint, mask->elements->len+1);
+  num_planes = 0;
+  for (i=0; i<mask->elements->len; i++) 
+    if ((i == 0) || (work.elements[i].voxel.z != work.elements[i-1].voxel.z))
+      work.plane_start[num_planes++] = i;
+  work.plane_start[num_planes] = mask->elements->len;
+
+  work.partials = g_new0(analysis_moments_t, MAX(num_planes,1)*work.num_series);
+  amitk_parallel_for(num_planes, 1, analysis_moments_sum_planes, &work);
+
+  /* add up the planes in order, so we get the same answer however it was split up */
+  moments = work.partials;
+  for (plane=1; plane<num_planes; plane++) {
+    for (j=0; j<work.num_series; j++) {
+      partial = work.partials + plane*work.num_series + j;
+      if (partial->voxels == 0) continue;
+      if ((moments[j].voxels == 0) || (partial->min < moments[j].min)) moments[j].min = partial->min;
+      if ((moments[j].voxels == 0) || (partial->max > moments[j].max)) moments[j].max = partial->max;
+      moments[j].total += partial->total;
+      moments[j].total_squares += partial->total_squares;
+      moments[j].weights += partial->weights;
+      moments[j].weights_squared += partial->weights_squared;
+      moments[j].voxels += partial->voxels;
+    }
+  }
+
+  /* and build up the frame/gate lists */
+  pframe = &frame_analyses;
+  for (frame=0; frame<num_frames; frame++) {
+    if ((*pframe = g_try_new(analysis_frame_t,1)) == NULL) {
+      g_warning(_("couldn't allocate memory space for roi analysis of frames"));
+      break;
+    }
+    (*pframe)->ref_count = 1;
+    (*pframe)->gate_analyses = NULL;
+    (*pframe)->next_frame_analysis = NULL;
+
+    pgate = &((*pframe)->gate_analyses);
+    for (gate=0; gate<num_gates; gate++) {
+      if ((analysis = g_try_new(analysis_gate_t,1)) == NULL) {
+	g_warning(_("couldn't allocate memory space for roi analysis of frame %d/gate %d"), frame, gate);
+	break;
+      }
+      j = frame*num_gates+gate;
+
+      analysis->ref_count = 1;
+      analysis->data_array = NULL;
+      analysis->duration = amitk_data_set_get_frame_duration(ds, frame);
+      analysis->time_midpoint = amitk_data_set_get_midpt_time(ds, frame);
+      analysis->gate_time = amitk_data_set_get_gate_time(ds, gate);
+      analysis->correction = 0.0;
+      analysis->median = NAN; /* needs the sorted values */
+      analysis->voxels = moments[j].voxels;
+      analysis->total = moments[j].total;
+      analysis->fractional_voxels = moments[j].weights;
+
+      if (moments[j].voxels == 0) { /* roi not in data set */
+	analysis->max = 0.0;
+	analysis->min = 0.0;
+	analysis->mean = 0.0;
+	analysis->var = 0.0;
+      } else {
+	analysis->max = moments[j].max;
+	analysis->min = moments[j].min;
+	analysis->mean = moments[j].total/moments[j].weights;
+
+	/* same weighted N/(N-1) variance as wvariance */
+	if (moments[j].voxels < 2) {
+	  analysis->var = NAN;
+	} else {
+	  factor = (moments[j].weights*moments[j].weights)/
+	    (moments[j].weights*moments[j].weights-moments[j].weights_squared);
+	  analysis->var = factor*MAX(moments[j].total_squares/moments[j].weights - 
+				     analysis->mean*analysis->mean, 0.0);
+	}
+      }
+
+      analysis->next_gate_analysis = NULL;
+      *pgate = analysis;
+      pgate = &(analysis->next_gate_analysis);
+    }
+
+    pframe = &((*pframe)->next_frame_analysis);
+  }
+
+  g_free(work.partials);
+  g_free(work.plane_start);
+
+  return frame_analyses;
+}
+
+
+
 /* free up an roi analysis over a data set */
 static analysis_volume_t * analysis_volume_unref(analysis_volume_t * volume_analysis) {
 
@@ -496,6 +702,7 @@ static analysis_volume_t * analysis_volume_unref(analysis_volume_t * volume_anal
 
 /* returns an initialized roi analysis of a list of volumes */
 static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * data_sets, 
+						gboolean moments_only,
 						analysis_calculation_t calculation_type,
 						gboolean accurate,
 						gdouble subfraction,
@@ -518,13 +725,17 @@ static analysis_volume_t * analysis_volume_init(AmitkRoi * roi, GList * data_set
   temp_volume_analysis->data_set = amitk_object_ref(data_sets->data);
 
   /* calculate this one */
-  temp_volume_analysis->frame_analyses = 
-    analysis_frame_init(roi, temp_volume_analysis->data_set, calculation_type, accurate,
-			subfraction, threshold_percentage, threshold_value);
+  if (moments_only)
+    temp_volume_analysis->frame_analyses = 
+      analysis_frame_init_moments(roi, temp_volume_analysis->data_set, accurate);
+  else
+    temp_volume_analysis->frame_analyses = 
+      analysis_frame_init(roi, temp_volume_analysis->data_set, calculation_type, accurate,
+			  subfraction, threshold_percentage, threshold_value);
 
   /* recurse */
   temp_volume_analysis->next_volume_analysis = 
-    analysis_volume_init(roi, data_sets->next, calculation_type, accurate,
+    analysis_volume_init(roi, data_sets->next, moments_only, calculation_type, accurate,
 			 subfraction, threshold_percentage, threshold_value);
 
   
@@ -595,9 +806,11 @@ analysis_roi_t * analysis_roi_init(AmitkStudy * study, GList * rois,
   temp_roi_analysis->threshold_percentage = threshold_percentage;
   temp_roi_analysis->threshold_value = threshold_value;
 
+  temp_roi_analysis->moments_only = FALSE;
+
   /* calculate this one */
   temp_roi_analysis->volume_analyses = 
-    analysis_volume_init(temp_roi_analysis->roi, data_sets, calculation_type, accurate,
+    analysis_volume_init(temp_roi_analysis->roi, data_sets, FALSE, calculation_type, accurate,
 			 subfraction, threshold_percentage, threshold_value);
 
   /* recurse */
@@ -610,4 +823,41 @@ analysis_roi_t * analysis_roi_init(AmitkStudy * study, GList * rois,
 }
 
 
+/* returns an initialized list of roi analyses over all the voxels, only
+   filling in the mean, variance, min, max, and totals.  The median and
+   data arrays are left out, which lets each roi/data set pair be
+   calculated in one pass over all the frames and gates */
+analysis_roi_t * analysis_roi_init_moments(AmitkStudy * study, GList * rois, 
+					   GList * data_sets, 
+					   gboolean accurate) {
+  
+  analysis_roi_t * temp_roi_analysis;
+  
+  if (rois == NULL)  return NULL;
+
+  if ((temp_roi_analysis =  g_try_new(analysis_roi_t,1)) == NULL) {
+    g_warning(_("couldn't allocate memory space for roi analyses"));
+    return NULL;
+  }
+
+  temp_roi_analysis->ref_count = 1;
+  temp_roi_analysis->roi = amitk_object_ref(rois->data);
+  temp_roi_analysis->study = amitk_object_ref(study);
+  temp_roi_analysis->calculation_type = ALL_VOXELS;
+  temp_roi_analysis->accurate = accurate;
+  temp_roi_analysis->subfraction = 0.0;
+  temp_roi_analysis->threshold_percentage = 0.0;
+  temp_roi_analysis->threshold_value = 0.0;
+  temp_roi_analysis->moments_only = TRUE;
+
+  /* calculate this one */
+  temp_roi_analysis->volume_analyses = 
+    analysis_volume_init(temp_roi_analysis->roi, data_sets, TRUE, ALL_VOXELS, accurate,
+			 0.0, 0.0, 0.0);
 
+  /* recurse */
+  temp_roi_analysis->next_roi_analysis = 
+    analysis_roi_init_moments(study, rois->next, data_sets, accurate);
+  
+  return temp_roi_analysis;
+}
@@ -103,6 +103,7 @@ struct _analysis_roi_t {
   gdouble subfraction;
   gdouble threshold_percentage;
   gdouble threshold_value;
+  gboolean moments_only; /* no median or data arrays */
   analysis_volume_t * volume_analyses;
   guint ref_count;
   analysis_roi_t * next_roi_analysis;
@@ -123,6 +124,13 @@ analysis_roi_t * analysis_roi_init(AmitkStudy * study,
 				   gdouble threshold_percentage, 
 				   gdouble threshold_value);
 
+/* same as analysis_roi_init with ALL_VOXELS, but only the moments are calculated.
+   median is NAN, and data_array is NULL */
+analysis_roi_t * analysis_roi_init_moments(AmitkStudy * study,
+					   GList * rois,
+					   GList * volumes,
+					   gboolean accurate);
+
 #endif /* __ANALYSIS_H__ */
 
 
@@ -792,7 +792,8 @@ static AmitkDataSet * read_dicom_file(const gchar * filename,
 
       /* note, we've already flipped the coordinate axis, so reading in the data straight is correct */
       ds_pointer = amitk_raw_data_get_pointer(AMITK_DATA_SET_RAW_DATA(ds), i);
-      memcpy(ds_pointer, (guchar *) buffer, format_size*ds->raw_data->dim.x*ds->raw_data->dim.y*ds->raw_data->dim.z);
+      memcpy(ds_pointer, (guchar *) buffer, ((gsize) format_size)*((gsize) ds->raw_data->dim.x)*
+	     ((gsize) ds->raw_data->dim.y)*((gsize) ds->raw_data->dim.z));
       if (valid_J2K) { /* Free allocated buffer */
         g_free((gpointer)buffer);
         buffer=NULL;
@@ -28,6 +28,7 @@
 #include <time.h>
 #include <glib.h>
 #include <gsl/gsl_linalg.h>
+#include <gsl/gsl_eigen.h>
 #include <gsl/gsl_multimin.h>
 #include "fads.h"
 #include "amitk_data_set_FLOAT_0D_SCALING.h"
@@ -44,6 +45,11 @@ gchar * fads_minimizer_algorithm_name[NUM_FADS_MINIMIZERS] = {
 };
 
 
+gchar * fads_svd_method_name[NUM_FADS_SVD_METHODS] = {
+  N_("Gram matrix (fast)"),
+  N_("Full decomposition (reference)")
+};
+
 gchar * fads_type_name[] = {
   N_("Principle Component Analysis"),
   N_("Penalized Least Squares Factor Analysis"),
@@ -79,27 +85,263 @@ static gint perform_svd(gsl_matrix * a, gsl_matrix * v, gsl_vector * s) {
   return status;
 }
 
-void fads_svd_factors(AmitkDataSet * data_set, 
-		      gint * pnum_factors,
-		      gdouble ** pfactors) {
+
+/* The Gram method: the right singular vectors and singular values of A (voxels x frames)
+   are the eigenvectors and the square root of the eigenvalues of At*A, which is only 
+   frames x frames, and can be summed up by streaming through the data set.  The left 
+   singular vectors, if wanted, follow from U = A*V*inv(S).  This squares the condition
+   number, so the trailing (tiny) singular values lose precision, but the leading ones
+   that are used as factors are fine */
+
+/* at most this many partial Gram matrices get summed, so the block size, and therefore
+   the answer, doesn't depend on the number of threads */
+#define GRAM_MAX_BLOCKS 256
+#define GRAM_MIN_BLOCK_VOXELS 1024
+
+typedef struct {
+  AmitkDataSet * data_set;
+  AmitkVoxel dim;
+  guint64 num_voxels;
+  guint64 block_voxels;
+  gint num_frames;
+  gint num_factors;
+  gdouble * partials; /* [num_blocks*N*N], only the upper triangle is used */
+  const gsl_matrix * v;
+  const gsl_vector * s;
+  gsl_matrix * u;
+} gram_svd_t;
+
+static inline void gram_get_voxel_values(gram_svd_t * g, guint64 k, gdouble * values) {
+
+  AmitkVoxel i_voxel;
+
+  i_voxel.x = k % g->dim.x;
+  k /= g->dim.x;
+  i_voxel.y = k % g->dim.y;
+  k /= g->dim.y;
+  i_voxel.z = k % g->dim.z;
+  i_voxel.g = k / g->dim.z;
+
+  for (i_voxel.t=0; i_voxel.t<g->num_frames; i_voxel.t++)
+    values[i_voxel.t] = amitk_data_set_get_value(g->data_set, i_voxel);
+
+  return;
+}
+
+static void gram_sum_blocks(guint64 start, guint64 end, gpointer data) {
+
+  gram_svd_t * g = data;
+  guint64 block, k, end_voxel;
+  gint n, i, j;
+  gdouble * partial;
+  gdouble * values;
+
+  n = g->num_frames;
+  values = g_new(gdouble, n);
+
+  for (block=start; block<end; block++) {
+    partial = g->partials + block*n*n;
+    for (i=0; i<n*n; i++) 
+      partial[i] = 0.0;
+
+    end_voxel = MIN((block+1)*g->block_voxels, g->num_voxels);
+    for (k=block*g->block_voxels; k<end_voxel; k++) {
+      gram_get_voxel_values(g, k, values);
+      for (i=0; i<n; i++)
+	for (j=i; j<n; j++)
+	  partial[i*n+j] += values[i]*values[j];
+    }
+  }
+
+  g_free(values);
+
+  return;
+}
+
+static void gram_calc_u_voxels(guint64 start, guint64 end, gpointer data) {
+
+  gram_svd_t * g = data;
+  guint64 k;
+  gint f, j;
+  gdouble * values;
+  gdouble total, s;
+
+  values = g_new(gdouble, g->num_frames);
+
+  for (k=start; k<end; k++) {
+    gram_get_voxel_values(g, k, values);
+    for (f=0; f<g->num_factors; f++) {
+      s = gsl_vector_get(g->s, f);
+      total = 0.0;
+      if (s > 0.0) {
+	for (j=0; j<g->num_frames; j++)
+	  total += values[j]*gsl_matrix_get(g->v, j, f);
+	total /= s;
+      }
+      gsl_matrix_set(g->u, k, f, total);
+    }
+  }
+
+  g_free(values);
+
+  return;
+}
+
+/* computes the singular values (return_s, size N), the right singular vectors 
+   (return_v, NxN), and the first num_factors left singular vectors (return_u, 
+   MxNum_factors) of the data set, without ever forming the MxN matrix.  
+   return_u and return_v can be NULL if not wanted */
+static gint perform_gram_svd(AmitkDataSet * data_set,
+			     gint num_factors,
+			     gsl_matrix ** return_u,
+			     gsl_vector ** return_s,
+			     gsl_matrix ** return_v) {
+
+  gram_svd_t g;
+  guint64 num_blocks, block;
+  gint n, i, j;
+  gsl_matrix * gram=NULL;
+  gsl_matrix * v=NULL;
+  gsl_vector * s=NULL;
+  gsl_eigen_symmv_workspace * w=NULL;
+  gint status=-1;
+
+  g.data_set = data_set;
+  g.dim = AMITK_DATA_SET_DIM(data_set);
+  g.num_frames = n = g.dim.t;
+  g.num_factors = num_factors;
+  g.num_voxels = ((guint64) g.dim.x)*g.dim.y*g.dim.z*g.dim.g;
+  g.block_voxels = MAX(GRAM_MIN_BLOCK_VOXELS, (g.num_voxels+GRAM_MAX_BLOCKS-1)/GRAM_MAX_BLOCKS);
+  g.partials = NULL;
+  g.u = NULL;
+  num_blocks = (g.num_voxels+g.block_voxels-1)/g.block_voxels;
+
+  if ((g.partials = g_try_new(gdouble, num_blocks*n*n)) == NULL) {
+    g_warning(_("Failed to allocate %dx%d array"), (gint) num_blocks, n*n);
+    goto ending;
+  }
+
+  if ((gram = gsl_matrix_alloc(n,n)) == NULL) {
+    g_warning(_("Failed to allocate %dx%d array"), n,n);
+    goto ending;
+  }
+
+  if ((v = gsl_matrix_alloc(n,n)) == NULL) {
+    g_warning(_("Failed to allocate %dx%d array"), n,n);
+    goto ending;
+  }
+
+  if ((s = gsl_vector_alloc(n)) == NULL) {
+    g_warning(_("Failed to allocate %d vector"), n);
+    goto ending;
+  }
+
+  if ((w = gsl_eigen_symmv_alloc(n)) == NULL) {
+    g_warning(_("Failed to allocate eigen workspace for %dx%d array"), n, n);
+    goto ending;
+  }
+
+  /* At*A, summing the blocks up in order */
+  amitk_parallel_for(num_blocks, 1, gram_sum_blocks, &g);
+  gsl_matrix_set_zero(gram);
+  for (block=0; block<num_blocks; block++) 
+    for (i=0; i<n; i++)
+      for (j=i; j<n; j++)
+	gsl_matrix_set(gram, i, j, gsl_matrix_get(gram, i, j) + g.partials[block*n*n+i*n+j]);
+  for (i=0; i<n; i++)
+    for (j=0; j<i; j++)
+      gsl_matrix_set(gram, i, j, gsl_matrix_get(gram, j, i));
+
+  /* eigenvalues of At*A are the squares of the singular values */
+  status = gsl_eigen_symmv(gram, s, v, w);
+  if (status != 0) {
+    g_warning(_("eigen decomposition returned error: %s"), gsl_strerror(status));
+    goto ending;
+  }
+  gsl_eigen_symmv_sort(s, v, GSL_EIGEN_SORT_VAL_DESC);
+  for (j=0; j<n; j++)
+    gsl_vector_set(s, j, sqrt(MAX(gsl_vector_get(s, j), 0.0)));
+
+  /* and the left singular vectors */
+  if (return_u != NULL) {
+    if ((g.u = gsl_matrix_alloc(g.num_voxels, num_factors)) == NULL) {
+      g_warning(_("failed to alloc matrix, size %dx%d"), (gint) g.num_voxels, num_factors);
+      status = -1;
+      goto ending;
+    }
+    g.v = v;
+    g.s = s;
+    amitk_parallel_for(g.num_voxels, GRAM_MIN_BLOCK_VOXELS, gram_calc_u_voxels, &g);
+    *return_u = g.u;
+    g.u = NULL;
+  }
+
+  if (return_s != NULL) {
+    *return_s = s;
+    s = NULL;
+  }
+
+  if (return_v != NULL) {
+    *return_v = v;
+    v = NULL;
+  }
+
+ ending:
+
+  if (g.partials != NULL) {
+    g_free(g.partials);
+    g.partials = NULL;
+  }
+
+  if (g.u != NULL) {
+    gsl_matrix_free(g.u);
+    g.u = NULL;
+  }
+
+  if (gram != NULL) {
+    gsl_matrix_free(gram);
+    gram = NULL;
+  }
+
+  if (v != NULL) {
+    gsl_matrix_free(v);
+    v = NULL;
+  }
+
+  if (s != NULL) {
+    gsl_vector_free(s);
+    s = NULL;
+  }
+
+  if (w != NULL) {
+    gsl_eigen_symmv_free(w);
+    w = NULL;
+  }
+
+  return status;
+}
+
+/* the reference method, the full singular value decomposition of the voxels x frames 
+   matrix -> A = U*S*Vt.  return_u (MxN) and return_v (NxN) can be NULL if not wanted.
+   Much slower and needs all of A in memory, but doesn't square the condition number */
+static gint perform_full_svd(AmitkDataSet * data_set,
+			     gsl_matrix ** return_u,
+			     gsl_vector ** return_s,
+			     gsl_matrix ** return_v) {
 
   gsl_matrix * matrix_a=NULL;
   gsl_matrix * matrix_v=NULL;
   gsl_vector * vector_s=NULL;
   AmitkVoxel dim, i_voxel;
   gint m,n, i;
-  amide_data_t value;
-  gdouble * factors;
-  gint status;
-
-  g_return_if_fail(AMITK_IS_DATA_SET(data_set));
+  gint status=-1;
 
   dim = AMITK_DATA_SET_DIM(data_set);
   n = dim.t;
   m = dim.x*dim.y*dim.z*dim.g;
 
-  if (n == 1) {
-    g_warning(_("need dynamic data set in order to perform factor analysis"));
+  if (m < n) {
+    g_warning(_("Full singular value decomposition needs at least as many voxels as frames"));
     goto ending;
   }
 
@@ -125,10 +367,8 @@ void fads_svd_factors(AmitkDataSet * data_set,
     for (i_voxel.g = 0; i_voxel.g < dim.g; i_voxel.g++) {
       for (i_voxel.z = 0; i_voxel.z < dim.z; i_voxel.z++)
 	for (i_voxel.y = 0; i_voxel.y < dim.y; i_voxel.y++)
-	  for (i_voxel.x = 0; i_voxel.x < dim.x; i_voxel.x++, i++) {
-	    value = amitk_data_set_get_value(data_set, i_voxel);
-	    gsl_matrix_set(matrix_a, i, i_voxel.t, value);
-	  }
+	  for (i_voxel.x = 0; i_voxel.x < dim.x; i_voxel.x++, i++) 
+	    gsl_matrix_set(matrix_a, i, i_voxel.t, amitk_data_set_get_value(data_set, i_voxel));
     }
   }
 
@@ -140,6 +380,110 @@ void fads_svd_factors(AmitkDataSet * data_set,
   status = perform_svd(matrix_a, matrix_v, vector_s);
   if (status != 0) g_warning(_("SV decomp returned error: %s"), gsl_strerror(status));
 
+  if (return_u != NULL) {
+    *return_u = matrix_a;
+    matrix_a = NULL;
+  }
+
+  if (return_s != NULL) {
+    *return_s = vector_s;
+    vector_s = NULL;
+  }
+
+  if (return_v != NULL) {
+    *return_v = matrix_v;
+    matrix_v = NULL;
+  }
+
+ ending:
+
+  /* garbage collection */
+
+  if (matrix_a != NULL) {
+    gsl_matrix_free(matrix_a);
+    matrix_a = NULL;
+  }
+
+  if (matrix_v != NULL) {
+    gsl_matrix_free(matrix_v);
+    matrix_v = NULL;
+  }
+
+  if (vector_s != NULL) {
+    gsl_vector_free(vector_s);
+    vector_s = NULL;
+  }
+
+  return status;
+}
+
+/* check the Gram method against the reference decomposition, for data sets
+   small enough that the full decomposition is cheap next to everything else.  Squaring 
+   the condition number costs the trailing singular values about sqrt(machine epsilon) 
+   relative to the largest, so anything well above that means the Gram matrix went wrong */
+#define SVD_CHECK_MAX_ELEMENTS 0x100000
+#define SVD_CHECK_TOLERANCE 1e-6
+static void check_gram_svd(AmitkDataSet * data_set, const gsl_vector * gram_s) {
+
+  gsl_vector * full_s=NULL;
+  AmitkVoxel dim;
+  gint j;
+  gdouble diff, max_diff;
+
+  dim = AMITK_DATA_SET_DIM(data_set);
+  if (((gint64) dim.x)*dim.y*dim.z*dim.g*dim.t > SVD_CHECK_MAX_ELEMENTS) return;
+  if (((gint64) dim.x)*dim.y*dim.z*dim.g < dim.t) return; /* gsl's SV decomp needs M >= N */
+
+  if (perform_full_svd(data_set, NULL, &full_s, NULL) != 0) goto ending;
+
+  /* the trailing singular values are expected to be off, compare relative to the largest */
+  max_diff = 0.0;
+  for (j=0; j<dim.t; j++) {
+    diff = fabs(gsl_vector_get(full_s, j) - gsl_vector_get(gram_s, j));
+    if (diff > max_diff) max_diff = diff;
+  }
+  if (gsl_vector_get(full_s, 0) > 0.0) max_diff /= gsl_vector_get(full_s, 0);
+  if (max_diff > SVD_CHECK_TOLERANCE)
+    g_warning(_("Singular values differ from the full decomposition by %g (relative to the largest), try the full singular value decomposition"),
+	      max_diff);
+
+ ending:
+  if (full_s != NULL) {
+    gsl_vector_free(full_s);
+    full_s = NULL;
+  }
+
+  return;
+}
+
+void fads_svd_factors(AmitkDataSet * data_set, 
+		      fads_svd_method_t svd_method,
+		      gint * pnum_factors,
+		      gdouble ** pfactors) {
+
+  gsl_vector * vector_s=NULL;
+  AmitkVoxel dim;
+  gint n, i;
+  gdouble * factors;
+
+  g_return_if_fail(AMITK_IS_DATA_SET(data_set));
+
+  dim = AMITK_DATA_SET_DIM(data_set);
+  n = dim.t;
+
+  if (n == 1) {
+    g_warning(_("need dynamic data set in order to perform factor analysis"));
+    goto ending;
+  }
+
+  if (svd_method == FADS_SVD_FULL) {
+    perform_full_svd(data_set, NULL, &vector_s, NULL);
+  } else {
+    perform_gram_svd(data_set, 0, NULL, &vector_s, NULL);
+    if (vector_s != NULL) check_gram_svd(data_set, vector_s);
+  }
+  if (vector_s == NULL) goto ending;
+
   /* transferring data */
   if (pnum_factors != NULL)
     *pnum_factors = n;
@@ -159,16 +503,6 @@ void fads_svd_factors(AmitkDataSet * data_set,
 
   /* garbage collection */
 
-  if (matrix_a != NULL) {
-    gsl_matrix_free(matrix_a);
-    matrix_a = NULL;
-  }
-
-  if (matrix_v != NULL) {
-    gsl_matrix_free(matrix_v);
-    matrix_v = NULL;
-  }
-
   if (vector_s != NULL) {
     gsl_vector_free(vector_s);
     vector_s = NULL;
@@ -234,11 +568,12 @@ static gsl_multimin_fdfminimizer * alloc_fdfminimizer(fads_minimizer_algorithm_t
 
 static void perform_pca(AmitkDataSet * data_set, 
 			gint num_factors,
+			fads_svd_method_t svd_method,
 			gsl_matrix ** return_u,
 			gsl_vector ** return_s, 
 			gsl_matrix ** return_v) {
 
-  AmitkVoxel dim, i_voxel;
+  AmitkVoxel dim;
   guint num_voxels, num_frames;
   gsl_matrix * u = NULL;
   gsl_matrix * v = NULL;
@@ -247,42 +582,18 @@ static void perform_pca(AmitkDataSet * data_set,
   gsl_matrix * small_v;
   gsl_vector * small_s;
   guint i, f, j;
-  gint status;
   gdouble total;
 
   dim = AMITK_DATA_SET_DIM(data_set);
   num_voxels = dim.x*dim.y*dim.z*dim.g;
   num_frames = dim.t;
 
-  u = gsl_matrix_alloc(num_voxels, num_frames);
-  if (u == NULL) {
-    g_warning(_("failed to alloc matrix, size %dx%d"), num_voxels, num_frames);
-    goto ending;
-  }
-
-  if ((v = gsl_matrix_alloc(num_frames,num_frames)) == NULL) {
-    g_warning(_("Failed to allocate %dx%d array"), num_frames, num_frames);
-    goto ending;
-  }
-
-  if ((s = gsl_vector_alloc(num_frames)) == NULL) {
-    g_warning(_("Failed to allocate %d vector"), num_frames);
-    goto ending;
-  }
-
-  /* copy the info into the matrix */
-  for (i_voxel.t = 0; i_voxel.t < num_frames; i_voxel.t++) {
-    i = 0;
-    for (i_voxel.g = 0; i_voxel.g < dim.g; i_voxel.g++)
-      for (i_voxel.z = 0; i_voxel.z < dim.z; i_voxel.z++)
-	for (i_voxel.y = 0; i_voxel.y < dim.y; i_voxel.y++)
-	  for (i_voxel.x = 0; i_voxel.x < dim.x; i_voxel.x++, i++) 
-	    gsl_matrix_set(u, i, i_voxel.t, amitk_data_set_get_value(data_set, i_voxel));
-  }
-
   /* do Singular Value decomposition */
-  status = perform_svd(u, v, s);
-  if (status != 0) g_warning(_("SV decomp returned error: %s"), gsl_strerror(status));
+  if (svd_method == FADS_SVD_FULL) 
+    perform_full_svd(data_set, (return_u != NULL) ? &u : NULL, &s, &v);
+  else
+    perform_gram_svd(data_set, num_factors, (return_u != NULL) ? &u : NULL, &s, &v);
+  if ((s == NULL) || (v == NULL) || ((return_u != NULL) && (u == NULL))) goto ending;
 
   /* do some obvious flipping */
   for (f=0; f<num_factors; f++) {
@@ -292,8 +603,9 @@ static void perform_pca(AmitkDataSet * data_set,
     if (total < 0) {
       for (j=0; j<num_frames; j++)
 	gsl_matrix_set(v, j, f, -1*gsl_matrix_get(v, j, f));
-      for (i=0; i<num_voxels; i++)
-	gsl_matrix_set(u, i, f, -1*gsl_matrix_get(u, i, f));
+      if (u != NULL)
+	for (i=0; i<num_voxels; i++)
+	  gsl_matrix_set(u, i, f, -1*gsl_matrix_get(u, i, f));
     } 
   }
 
@@ -308,9 +620,9 @@ static void perform_pca(AmitkDataSet * data_set,
       for (i=0; i<num_voxels; i++)
 	gsl_matrix_set(small_u, i, f, gsl_matrix_get(u, i, f));
     *return_u = small_u;
+    gsl_matrix_free(u);
+    u = NULL;
   }
-  gsl_matrix_free(u);
-  u = NULL;
 
   if (return_s != NULL) {
     small_s = gsl_vector_alloc(num_factors);
@@ -362,6 +674,7 @@ static void perform_pca(AmitkDataSet * data_set,
 
 void fads_pca(AmitkDataSet * data_set, 
 	      gint num_factors,
+	      fads_svd_method_t svd_method,
 	      gchar * output_filename,
 	      AmitkUpdateFunc update_func,
 	      gpointer update_data) {
@@ -391,7 +704,7 @@ void fads_pca(AmitkDataSet * data_set,
     g_free(temp_string);
   }
 
-  perform_pca(data_set, num_factors, &u, &s, &v);
+  perform_pca(data_set, num_factors, svd_method, &u, &s, &v);
 
 
 
@@ -545,6 +858,235 @@ gdouble * calc_weights(AmitkDataSet * ds) {
 
 
 
+/* both the penalized least squares and the two compartment models have a
+   forward problem of the form alpha(voxel, factor) * basis(factor, frame), 
+   the stuff below evaluates the least squares part of their objective
+   functions and gradients.  The work is split over threads by voxel, 
+   reductions over voxels are summed up in fixed blocks (so the answer doesn't 
+   depend on the number of threads) */
+
+/* voxels per reduction block */
+#define FADS_BLOCK_VOXELS 1024
+
+#define fads_num_blocks(num_voxels) (((num_voxels)+FADS_BLOCK_VOXELS-1)/FADS_BLOCK_VOXELS)
+
+typedef struct {
+  const gsl_vector * v;
+  gsl_vector * df;
+  gsize num_voxels;
+  gint num_frames;
+  gint num_factors;
+  gint alpha_offset;
+  const gfloat * data; /* [M*N] */
+  const gdouble * basis; /* [F*N] */
+  const gdouble * weight;
+  gdouble * forward_error; /* [M*N] */
+  gdouble * partials; /* [num_blocks*F*N] */
+
+  /* constraints on the alpha's */
+  gdouble mu;
+  const gdouble * lmi_a;
+  gboolean sum_factors_equal_one;
+  const gdouble * ec_a;
+  const gdouble * lme_a;
+} fads_lsq_t;
+
+
+/* pulls the data set into a float matrix, one row per voxel and one column per frame,
+   so the minimizers don't have to go through amitk_data_set_get_value.  
+   Returned array needs to be free'd */
+static gfloat * fads_get_data_matrix(AmitkDataSet * ds) {
+
+  gfloat * data;
+  AmitkVoxel i_voxel, dim;
+  gint num_frames;
+  gsize k;
+
+  dim = AMITK_DATA_SET_DIM(ds);
+  num_frames = dim.t;
+
+  data = g_try_new(gfloat, ((gsize) dim.g)*dim.z*dim.y*dim.x*num_frames);
+  if (data == NULL) return NULL;
+
+  for (i_voxel.t=0; i_voxel.t<dim.t; i_voxel.t++) {
+    k=0;
+    for (i_voxel.g=0; i_voxel.g<dim.g; i_voxel.g++) 
+      for (i_voxel.z=0; i_voxel.z<dim.z; i_voxel.z++) 
+	for (i_voxel.y=0; i_voxel.y<dim.y; i_voxel.y++) 
+	  for (i_voxel.x=0; i_voxel.x<dim.x; i_voxel.x++, k+=num_frames) 
+	    data[k+i_voxel.t] = amitk_data_set_get_value(ds, i_voxel);
+  }
+
+  return data;
+}
+
+static void fads_forward_error_voxels(guint64 start, guint64 end, gpointer data) {
+
+  fads_lsq_t * r = data;
+  gsize i;
+  gint j, f;
+  gdouble alpha;
+  gdouble * forward_error;
+  const gfloat * voxel_data;
+  const gdouble * basis;
+
+  for (i=start; i<end; i++) {
+    forward_error = r->forward_error + i*r->num_frames;
+    voxel_data = r->data + i*r->num_frames;
+    for (j=0; j<r->num_frames; j++)
+      forward_error[j] = -voxel_data[j];
+
+    for (f=0; f<r->num_factors; f++) {
+      alpha = gsl_vector_get(r->v, r->alpha_offset+i*r->num_factors+f);
+      basis = r->basis + f*r->num_frames;
+      for (j=0; j<r->num_frames; j++)
+	forward_error[j] += alpha*basis[j];
+    }
+  }
+
+  return;
+}
+
+/* forward_error = alpha*basis - data */
+static void fads_calc_forward_error(fads_lsq_t * r) {
+  amitk_parallel_for(r->num_voxels, FADS_BLOCK_VOXELS, fads_forward_error_voxels, r);
+  return;
+}
+
+static void fads_ls_blocks(guint64 start, guint64 end, gpointer data) {
+
+  fads_lsq_t * r = data;
+  guint64 block;
+  gsize i, end_voxel;
+  gint j;
+  gdouble total, temp;
+
+  for (block=start; block<end; block++) {
+    total = 0.0;
+    end_voxel = MIN((block+1)*FADS_BLOCK_VOXELS, r->num_voxels);
+    for (i=block*FADS_BLOCK_VOXELS; i<end_voxel; i++) 
+      for (j=0; j<r->num_frames; j++) {
+	temp = r->forward_error[i*r->num_frames+j];
+	total += r->weight[j]*temp*temp;
+      }
+    r->partials[block] = total;
+  }
+
+  return;
+}
+
+/* the weighted least squares objective, sum of weight*forward_error^2 */
+static gdouble fads_calc_ls(fads_lsq_t * r) {
+
+  gsize block, num_blocks;
+  gdouble total=0.0;
+
+  num_blocks = fads_num_blocks(r->num_voxels);
+  amitk_parallel_for(num_blocks, 1, fads_ls_blocks, r);
+  for (block=0; block<num_blocks; block++)
+    total += r->partials[block];
+
+  return total;
+}
+
+static void fads_projection_blocks(guint64 start, guint64 end, gpointer data) {
+
+  fads_lsq_t * r = data;
+  guint64 block;
+  gsize i, end_voxel;
+  gint j, f;
+  gdouble alpha;
+  gdouble * partial;
+  const gdouble * forward_error;
+
+  for (block=start; block<end; block++) {
+    partial = r->partials + block*r->num_factors*r->num_frames;
+    for (j=0; j<r->num_factors*r->num_frames; j++) 
+      partial[j] = 0.0;
+
+    end_voxel = MIN((block+1)*FADS_BLOCK_VOXELS, r->num_voxels);
+    for (i=block*FADS_BLOCK_VOXELS; i<end_voxel; i++) {
+      forward_error = r->forward_error + i*r->num_frames;
+      for (f=0; f<r->num_factors; f++) {
+	alpha = gsl_vector_get(r->v, r->alpha_offset+i*r->num_factors+f);
+	for (j=0; j<r->num_frames; j++)
+	  partial[f*r->num_frames+j] += alpha*forward_error[j];
+      }
+    }
+  }
+
+  return;
+}
+
+/* projection[f*N+j] = weight[j] * sum over voxels of alpha(voxel,f)*forward_error(voxel,j),
+   which is what the derivatives wrt the basis curves are built from */
+static void fads_calc_projection(fads_lsq_t * r, gdouble * projection) {
+
+  gsize block, num_blocks;
+  gint j, f, size;
+
+  size = r->num_factors*r->num_frames;
+  num_blocks = fads_num_blocks(r->num_voxels);
+  amitk_parallel_for(num_blocks, 1, fads_projection_blocks, r);
+
+  for (j=0; j<size; j++)
+    projection[j] = 0.0;
+  for (block=0; block<num_blocks; block++)
+    for (j=0; j<size; j++)
+      projection[j] += r->partials[block*size+j];
+  for (f=0; f<r->num_factors; f++)
+    for (j=0; j<r->num_frames; j++)
+      projection[f*r->num_frames+j] *= r->weight[j];
+
+  return;
+}
+
+static void fads_alpha_derivative_voxels(guint64 start, guint64 end, gpointer data) {
+
+  fads_lsq_t * r = data;
+  gsize i, index;
+  gint j, f;
+  gdouble ls_answer, neg_answer, alpha, lambda;
+  const gdouble * forward_error;
+
+  for (i=start; i<end; i++) {
+    forward_error = r->forward_error + i*r->num_frames;
+    for (f=0; f<r->num_factors; f++) {
+      index = r->alpha_offset+i*r->num_factors+f;
+      alpha = gsl_vector_get(r->v, index);
+
+      /* the Least Squares objective */
+      ls_answer = 0.0;
+      for (j=0; j<r->num_frames; j++)
+	ls_answer += r->weight[j]*forward_error[j]*r->basis[f*r->num_frames+j];
+      ls_answer *= 2.0;
+
+      /* the non-negativity and <= 1 objective */
+      lambda = r->lmi_a[i*r->num_factors+f];
+      if ((alpha-r->mu*lambda) < 0.0)
+	neg_answer = alpha/r->mu-lambda;
+      else
+	neg_answer = 0.0;
+
+      /* the sum of alpha's == 1 constraint */
+      if (r->sum_factors_equal_one)
+	neg_answer += r->ec_a[i]/r->mu - r->lme_a[i];
+
+      gsl_vector_set(r->df, index, ls_answer+neg_answer);
+    }
+  }
+
+  return;
+}
+
+/* fills in the derivatives wrt the alpha's */
+static void fads_calc_alpha_derivative(fads_lsq_t * r) {
+  amitk_parallel_for(r->num_voxels, FADS_BLOCK_VOXELS, fads_alpha_derivative_voxels, r);
+  return;
+}
+
+
+
 typedef struct pls_params_t {
   AmitkDataSet * data_set;
   AmitkVoxel dim;
@@ -556,10 +1098,14 @@ typedef struct pls_params_t {
   gint alpha_offset; /* num_factors*num_frames */
   gint num_variables; /* alpha_offset+num_voxels*num_factors*/
 
+  gfloat * data; /* the data set, [M*N] */
   gdouble * forward_error; /* our estimated data (the forward problem), subtracted by the actual data */
   gdouble * weight; /* the appropriate weight (frame dependent) */
   gdouble * ec_a; /* used for sum alpha == 1.0 */
   gdouble * ec_bc;
+  gdouble * basis; /* the factors, [F*N] */
+  gdouble * projection; /* see fads_calc_projection, [F*N] */
+  gdouble * partials; /* scratch space for the reductions */
   
   /* lagrange multipliers - equality */
   gdouble * lme_a; /* used for sum alpha == 1.0 */
@@ -609,33 +1155,40 @@ static void pls_calc_constraints(pls_params_t * p, const gsl_vector *v) {
 
 }
 
+static void pls_setup_lsq(pls_params_t * p, const gsl_vector *v, gsl_vector * df, fads_lsq_t * r) {
+
+  r->v = v;
+  r->df = df;
+  r->num_voxels = p->num_voxels;
+  r->num_frames = p->num_frames;
+  r->num_factors = p->num_factors;
+  r->alpha_offset = p->alpha_offset;
+  r->data = p->data;
+  r->basis = p->basis;
+  r->weight = p->weight;
+  r->forward_error = p->forward_error;
+  r->partials = p->partials;
+  r->mu = p->mu;
+  r->lmi_a = p->lmi_a;
+  r->sum_factors_equal_one = p->sum_factors_equal_one;
+  r->ec_a = p->ec_a;
+  r->lme_a = p->lme_a;
+
+  return;
+}
+
 static void pls_calc_forward_error(pls_params_t * p, const gsl_vector *v) {
 
-  gint i, k, f;
-  AmitkVoxel i_voxel;
-  gdouble inner;
-  gdouble alpha;
-  gdouble factor;
+  fads_lsq_t r;
+  gint f, j;
 
-  for (i_voxel.t=0; i_voxel.t<p->dim.t; i_voxel.t++) {
-    i=p->alpha_offset; /* what to skip in v to get to the coefficients */
-    k=0;
-    for (i_voxel.g=0; i_voxel.g<p->dim.g; i_voxel.g++) {
-      for (i_voxel.z=0; i_voxel.z<p->dim.z; i_voxel.z++) {
-	for (i_voxel.y=0; i_voxel.y<p->dim.y; i_voxel.y++) {
-	  for (i_voxel.x=0; i_voxel.x<p->dim.x; i_voxel.x++, i+=p->num_factors, k+=p->num_frames) {
-	    inner = 0.0;
-	    for (f=0;  f< p->num_factors; f++) {
-	      alpha = gsl_vector_get(v, i+f);
-	      factor = gsl_vector_get(v, f*p->num_frames+i_voxel.t);
-	      inner += alpha*factor;
-	    }
-	    p->forward_error[k+i_voxel.t] = inner - amitk_data_set_get_value(p->data_set,i_voxel);
-	  }
-	}
-      }
-    }
-  }
+  /* the basis curves are just the factors */
+  for (f=0; f<p->num_factors; f++)
+    for (j=0; j<p->num_frames; j++)
+      p->basis[f*p->num_frames+j] = gsl_vector_get(v, f*p->num_frames+j);
+
+  pls_setup_lsq(p, v, NULL, &r);
+  fads_calc_forward_error(&r);
 
   return;
 }
@@ -647,17 +1200,13 @@ static gdouble pls_calc_function(pls_params_t * p, const gsl_vector *v) {
   gdouble neg_answer=0.0;
   gdouble orth_answer=0.0;
   gdouble blood_answer=0.0;
-  gdouble temp, lambda, factor, alpha;
+  gdouble lambda, factor, alpha;
   gint i, j, f, l;
+  fads_lsq_t r;
 
   /* the Least Squares objective */
-  ls_answer = 0.0;
-  for (j=0; j<p->num_frames; j++) {
-    for (i=0; i<p->num_voxels; i++) {
-      temp = p->forward_error[i*p->num_frames+j];
-      ls_answer += p->weight[j]*temp*temp;
-    }
-  }
+  pls_setup_lsq(p, v, NULL, &r);
+  ls_answer = fads_calc_ls(&r);
   p->ls = ls_answer;
 
   /* the non-negativity constraints */
@@ -716,11 +1265,13 @@ static void pls_calc_derivative(pls_params_t * p, const gsl_vector *v, gsl_vecto
 
   gdouble ls_answer=0.0;
   gdouble neg_answer=0.0;
-  gdouble orth_answer;
   gdouble blood_answer=0.0;
-  gdouble factor, alpha, lambda;
-  gint i, j, k, l, q; //f
+  gdouble factor, lambda;
+  gint i, j, q;
+  fads_lsq_t r;
 
+  pls_setup_lsq(p, v, df, &r);
+  fads_calc_projection(&r, p->projection);
 
   /* calculate first for the factor variables */
   for (q= 0; q < p->num_factors; q++) {
@@ -728,13 +1279,7 @@ static void pls_calc_derivative(pls_params_t * p, const gsl_vector *v, gsl_vecto
       factor = gsl_vector_get(v, q*p->num_frames+j);
       
       /* the Least Squares objective */
-      ls_answer = 0.0;
-      /* p->coef_offset is what to skip in v to get to the coefficients */
-      for (i=p->alpha_offset, k=0; k < p->num_frames*p->num_voxels; i+=p->num_factors, k+=p->num_frames) {
-	alpha = gsl_vector_get(v, i+q);
-	ls_answer += alpha*p->forward_error[k+j];
-      }
-      ls_answer *= 2.0*p->weight[j];
+      ls_answer = 2.0*p->projection[q*p->num_frames+j];
 
       /* the non-negativity objective */
       lambda = p->lmi_f[q*p->num_frames+j];
@@ -754,43 +1299,9 @@ static void pls_calc_derivative(pls_params_t * p, const gsl_vector *v, gsl_vecto
     }
   }
 
-  /* now calculate for the coefficient variables */
-  for (q= 0; q < p->num_factors; q++) {
-
-    for (i=p->alpha_offset, k=0, l=0; i < p->num_variables; i+=p->num_factors, k+=p->num_frames, l++) {
-      alpha = gsl_vector_get(v, i+q);
-
-      /* the Least Squares objective */
-      ls_answer = 0;
-      for (j=0; j<p->num_frames; j++) {
-	factor = gsl_vector_get(v, q*p->num_frames+j);
-	ls_answer += p->weight[j]*p->forward_error[k+j]*factor;
-      }
-      ls_answer *= 2.0;
-
-      /* the non-negativity and <= 1 objective */
-      lambda = p->lmi_a[l*p->num_factors+q];
-      if ((alpha-p->mu*lambda) < 0.0)
-	neg_answer = alpha/p->mu-lambda;
-      else
-	neg_answer = 0;
-
-      /* the sum of alpha's == 1 constraint */
-      if (p->sum_factors_equal_one) {
-	neg_answer += p->ec_a[l]/p->mu - p->lme_a[l];
-      }
-	
-      /* the orthogonality objective */
-#if 0
-      if ((p->coef_total[l] < 1.0) && (p->coef_total[l] > 0))
-	orth_answer = p->b*(1.0-alpha-p->coef_total[l]);
-      else
-#endif
-	orth_answer = 0;
-      
-      gsl_vector_set(df, i+q, ls_answer+neg_answer+orth_answer);
-    }
-  }
+  /* now calculate for the coefficient variables.  note, the orthogonality
+     objective is currently disabled, see pls_calc_function */
+  fads_calc_alpha_derivative(&r);
 
   return;
 }
@@ -945,8 +1456,12 @@ void fads_pls(AmitkDataSet * data_set,
   p.num_blood_curve_constraints = num_blood_curve_constraints;
   p.blood_curve_constraint_frame = blood_curve_constraint_frame;
   p.blood_curve_constraint_val = blood_curve_constraint_val;
+  p.data = NULL;
   p.forward_error = NULL;
   p.weight = NULL;
+  p.basis = NULL;
+  p.projection = NULL;
+  p.partials = NULL;
   p.ec_a = NULL;
   p.ec_bc = NULL;
   p.lme_a = NULL;
@@ -967,12 +1482,26 @@ void fads_pls(AmitkDataSet * data_set,
     }
   }
 
-  p.forward_error = g_try_new(gdouble, p.num_frames*p.num_voxels);
+  p.forward_error = g_try_new(gdouble, ((gsize) p.num_frames)*p.num_voxels);
   if (p.forward_error == NULL) {
     g_warning(_("failed forward error malloc"));
     goto ending;
   }
 
+  p.data = fads_get_data_matrix(p.data_set);
+  if (p.data == NULL) {
+    g_warning(_("failed data matrix malloc"));
+    goto ending;
+  }
+
+  p.basis = g_try_new(gdouble, p.num_factors*p.num_frames);
+  p.projection = g_try_new(gdouble, p.num_factors*p.num_frames);
+  p.partials = g_try_new(gdouble, fads_num_blocks((gsize) p.num_voxels)*p.num_factors*p.num_frames);
+  if ((p.basis == NULL) || (p.projection == NULL) || (p.partials == NULL)) {
+    g_warning(_("failed malloc for least squares work space"));
+    goto ending;
+  }
+
   /* calculate the weights and magnitude */
   p.weight = calc_weights(p.data_set);
   if (p.weight == NULL) {
@@ -1015,7 +1544,7 @@ void fads_pls(AmitkDataSet * data_set,
   for (i=0; i<p.num_blood_curve_constraints; i++)
     p.lme_bc[i] = 0.0;
 
-  p.lmi_a = g_try_new(gdouble, p.num_voxels*p.num_factors);
+  p.lmi_a = g_try_new(gdouble, ((gsize) p.num_voxels)*p.num_factors);
   if (p.lmi_a == NULL) {
     g_warning(_("failed malloc for inequality lagrange multiplier - alpha"));
     goto ending;
@@ -1073,7 +1602,7 @@ void fads_pls(AmitkDataSet * data_set,
 
 
     /* setting the factors to the principle components */
-    perform_pca(p.data_set, p.num_factors, &u, &s, &v);
+    perform_pca(p.data_set, p.num_factors, FADS_SVD_GRAM, &u, &s, &v);
     
     /* need to initialize the factors, picking some quasi-exponential curves */
     /* use a time constant of 100th of the study length, as a guess */
@@ -1387,6 +1916,26 @@ void fads_pls(AmitkDataSet * data_set,
     p.forward_error = NULL;
   }
 
+  if (p.data != NULL) {
+    g_free(p.data);
+    p.data = NULL;
+  }
+
+  if (p.basis != NULL) {
+    g_free(p.basis);
+    p.basis = NULL;
+  }
+
+  if (p.projection != NULL) {
+    g_free(p.projection);
+    p.projection = NULL;
+  }
+
+  if (p.partials != NULL) {
+    g_free(p.partials);
+    p.partials = NULL;
+  }
+
   if (p.ec_a != NULL) {
     g_free(p.ec_a);
     p.ec_a = NULL;
@@ -1447,6 +1996,10 @@ typedef struct two_comp_params_t {
   /* tc_unscaled[f]*k21(f) would be our estimate for compartment 2 (tissue component) */
   gdouble * tc_unscaled; 
 
+  gfloat * data; /* the data set, [M*N] */
+  gdouble * basis; /* k21*tc_unscaled for the tissues, followed by the blood curve, [F*N] */
+  gdouble * projection; /* see fads_calc_projection, [F*N] */
+  gdouble * partials; /* scratch space for the reductions */
   gdouble * forward_error; /* our estimated data (the forward problem), subtracted by the actual data */
   gdouble * weight; /* the appropriate weight (frame dependent) */
   gdouble * start; /* start time of each frame */
@@ -1540,40 +2093,45 @@ static void two_comp_calc_compartments(two_comp_params_t * p, const gsl_vector *
 }
 
 
+static void two_comp_setup_lsq(two_comp_params_t * p, const gsl_vector *v, gsl_vector * df, fads_lsq_t * r) {
+
+  r->v = v;
+  r->df = df;
+  r->num_voxels = p->num_voxels;
+  r->num_frames = p->num_frames;
+  r->num_factors = p->num_factors;
+  r->alpha_offset = p->alpha_offset;
+  r->data = p->data;
+  r->basis = p->basis;
+  r->weight = p->weight;
+  r->forward_error = p->forward_error;
+  r->partials = p->partials;
+  r->mu = p->mu;
+  r->lmi_a = p->lmi_a;
+  r->sum_factors_equal_one = p->sum_factors_equal_one;
+  r->ec_a = p->ec_a;
+  r->lme_a = p->lme_a;
+
+  return;
+}
+
 static void two_comp_calc_forward_error(two_comp_params_t * p, const gsl_vector *v) {
 
-  gint i, k, t;
-  AmitkVoxel i_voxel;
-  gdouble bc;
+  fads_lsq_t r;
+  gint j, t;
   gdouble k21;
-  gdouble inner, alpha;
 
-
-  for (i_voxel.t=0; i_voxel.t<p->dim.t; i_voxel.t++) {
-    i=p->alpha_offset;
-    k=0;
-    bc = gsl_vector_get(v, p->bc_offset+i_voxel.t);
-    for (i_voxel.g=0; i_voxel.g<p->dim.g; i_voxel.g++) {
-      for (i_voxel.z=0; i_voxel.z<p->dim.z; i_voxel.z++) {
-	for (i_voxel.y=0; i_voxel.y<p->dim.y; i_voxel.y++) {
-	  for (i_voxel.x=0; i_voxel.x<p->dim.x; i_voxel.x++, k++, i+=p->num_factors) {
-	    
-	    inner=0;
-	    for (t=0; t < p->num_tissues; t++) {
-	      k21 = gsl_vector_get(v, p->k21_offset+t);
-	      alpha = gsl_vector_get(v, i+t);
-	      inner += alpha*k21*p->tc_unscaled[i_voxel.t*p->num_tissues+t];
-	    }
-	    
-	    alpha = gsl_vector_get(v, i+p->num_tissues);
-	    p->forward_error[k*p->num_frames+i_voxel.t] = 
-	      alpha*bc+inner-amitk_data_set_get_value(p->data_set,i_voxel);
-	    
-	  }
-	}
-      }
-    }
+  /* the tissue curves, and then the blood curve */
+  for (t=0; t < p->num_tissues; t++) {
+    k21 = gsl_vector_get(v, p->k21_offset+t);
+    for (j=0; j<p->num_frames; j++)
+      p->basis[t*p->num_frames+j] = k21*p->tc_unscaled[j*p->num_tissues+t];
   }
+  for (j=0; j<p->num_frames; j++)
+    p->basis[p->num_tissues*p->num_frames+j] = gsl_vector_get(v, p->bc_offset+j);
+
+  two_comp_setup_lsq(p, v, NULL, &r);
+  fads_calc_forward_error(&r);
 
   return;
 }
@@ -1584,17 +2142,13 @@ static gdouble two_comp_calc_function(two_comp_params_t * p, const gsl_vector *v
   gdouble ls_answer=0.0;
   gdouble neg_answer=0.0;
   gdouble blood_answer=0.0;
-  gdouble temp, bc, k12, k21, alpha, lambda;
+  gdouble bc, k12, k21, alpha, lambda;
   gint i, k, j, f, t;
+  fads_lsq_t r;
 
   /* the Least Squares objective */
-  ls_answer = 0.0;
-  for (i=0; i<p->num_voxels; i++) {
-    for (j=0; j<p->num_frames; j++) {
-      temp = p->forward_error[i*p->num_frames+j];
-      ls_answer += p->weight[j]*temp*temp;
-    }
-  }
+  two_comp_setup_lsq(p, v, NULL, &r);
+  ls_answer = fads_calc_ls(&r);
 
 
   neg_answer = 0.0;
@@ -1660,13 +2214,21 @@ static gdouble two_comp_calc_function(two_comp_params_t * p, const gsl_vector *v
   return ls_answer+neg_answer+blood_answer;
 }
 
+/* the least squares parts of the derivatives are all written in terms of
+   projection[f*N+j], the weighted sum over voxels of alpha(voxel,f)*forward_error(voxel,j),
+   as the compartment kernels don't depend on the voxel */
 static void two_comp_calc_derivative(two_comp_params_t * p, const gsl_vector *v, gsl_vector *df) {
 
   gdouble ls_answer, neg_answer, blood_answer;
-  gint f, i, j, k, t;
-  gdouble k12, k21,  bc, inner, kernel, alpha;
+  gint i, j, k, t;
+  gdouble k12, k21,  bc, inner, kernel;
   gdouble delta1, delta2, lambda;
+  const gdouble * projection;
+  fads_lsq_t r;
   
+  two_comp_setup_lsq(p, v, df, &r);
+  fads_calc_projection(&r, p->projection);
+  projection = p->projection;
 
   /* partial derivative of f wrt to the k12's */
   for (t=0; t<p->num_tissues; t++) {
@@ -1674,36 +2236,33 @@ static void two_comp_calc_derivative(two_comp_params_t * p, const gsl_vector *v,
     k21 = gsl_vector_get(v, p->k21_offset+t);
 
     ls_answer=0;
-    for (i=0; i<p->num_voxels; i++) {
-      for (j=0; j<p->num_frames; j++) {
-
-	inner = 0;
-	for (k=0; k<j ; k++) {
-	  delta1 = p->midpt[j]-p->end[k];
-	  delta2 = p->midpt[j]-p->start[k];
-	  if (fabs(k12) < EPSILON) 
-	    kernel = 0.5*(delta1*delta1-delta2*delta2);
-	  else
-	    kernel = (-delta1*exp(-k12*delta1)+delta2*exp(-k12*delta2))/k12;
-	  bc = gsl_vector_get(v, p->bc_offset+k);
-	  inner += bc*kernel;
-	}
+    for (j=0; j<p->num_frames; j++) {
 
-	/* k == j */
-	delta2 = p->midpt[j]-p->start[j];
+      inner = 0;
+      for (k=0; k<j ; k++) {
+	delta1 = p->midpt[j]-p->end[k];
+	delta2 = p->midpt[j]-p->start[k];
 	if (fabs(k12) < EPSILON) 
-	  kernel = -0.5*(delta2*delta2);
+	  kernel = 0.5*(delta1*delta1-delta2*delta2);
 	else
-	  kernel = (delta2*exp(-k12*delta2))/k12;
-	bc = gsl_vector_get(v, p->bc_offset+j);
+	  kernel = (-delta1*exp(-k12*delta1)+delta2*exp(-k12*delta2))/k12;
+	bc = gsl_vector_get(v, p->bc_offset+k);
 	inner += bc*kernel;
+      }
 
-	if (fabs(k12) > EPSILON) 
-	  inner -= p->tc_unscaled[j*p->num_tissues+t]/k12;
+      /* k == j */
+      delta2 = p->midpt[j]-p->start[j];
+      if (fabs(k12) < EPSILON) 
+	kernel = -0.5*(delta2*delta2);
+      else
+	kernel = (delta2*exp(-k12*delta2))/k12;
+      bc = gsl_vector_get(v, p->bc_offset+j);
+      inner += bc*kernel;
 
-	alpha = gsl_vector_get(v, p->alpha_offset+i*p->num_factors+t);
-	ls_answer += p->weight[j]*p->forward_error[i*p->num_frames+j] * alpha*k21*inner;
-      }
+      if (fabs(k12) > EPSILON) 
+	inner -= p->tc_unscaled[j*p->num_tissues+t]/k12;
+
+      ls_answer += projection[t*p->num_frames+j]*k21*inner;
     }
     ls_answer *=2;
 
@@ -1722,16 +2281,8 @@ static void two_comp_calc_derivative(two_comp_params_t * p, const gsl_vector *v,
     k21 = gsl_vector_get(v, p->k21_offset+t);
 
     ls_answer=0;
-    for (i=0; i<p->num_voxels; i++) {
-      alpha = gsl_vector_get(v, p->alpha_offset+i*p->num_factors +t);
-      for (j=0; j<p->num_frames; j++) {
-	ls_answer += 
-	  p->weight[j]*
-	  p->forward_error[i*p->num_frames+j] *
-	  alpha*
-	  p->tc_unscaled[j*p->num_tissues+t];
-      }
-    }
+    for (j=0; j<p->num_frames; j++) 
+      ls_answer += projection[t*p->num_frames+j]*p->tc_unscaled[j*p->num_tissues+t];
     ls_answer *=2;
 
     /* the non-negatvity objective */
@@ -1748,42 +2299,29 @@ static void two_comp_calc_derivative(two_comp_params_t * p, const gsl_vector *v,
   for (j=0; j<p->num_frames; j++) {
     bc = gsl_vector_get(v, p->bc_offset+j);
 
-    ls_answer=0;
-    for (i=0; i<p->num_voxels; i++) {
+    /* k == j, directly from the blood component */
+    ls_answer = projection[p->num_tissues*p->num_frames+j];
 
-      /* k == j */
-      inner = gsl_vector_get(v, p->alpha_offset+i*p->num_factors+p->num_tissues);
-      for (t=0; t< p->num_tissues; t++) {
-	alpha = gsl_vector_get(v, p->alpha_offset+i*p->num_factors+t);
-	k12 = gsl_vector_get(v, p->k12_offset+t);
-	k21 = gsl_vector_get(v, p->k21_offset+t);
-	if (fabs(k12) < EPSILON) {
-	  kernel = p->midpt[j]-p->start[j];
-	} else {
-	  kernel = (1-exp(-k12*(p->midpt[j]-p->start[j])))/k12;
-	}
-	inner += alpha*k21*kernel;
-      }
-      ls_answer += p->weight[j]*p->forward_error[i*p->num_frames+j]*inner;
+    for (t=0; t< p->num_tissues; t++) {
+      k12 = gsl_vector_get(v, p->k12_offset+t);
+      k21 = gsl_vector_get(v, p->k21_offset+t);
 
+      /* k == j */
+      if (fabs(k12) < EPSILON) 
+	kernel = p->midpt[j]-p->start[j];
+      else 
+	kernel = (1-exp(-k12*(p->midpt[j]-p->start[j])))/k12;
+      inner = projection[t*p->num_frames+j]*kernel;
 
       /* k > j */
       for (k=j+1; k<p->num_frames; k++) {
-	
-	inner = 0;
-	for (t=0; t< p->num_tissues; t++) {
-	  alpha = gsl_vector_get(v, p->alpha_offset+i*p->num_factors+t);
-	  k12 = gsl_vector_get(v, p->k12_offset+t);
-	  k21 = gsl_vector_get(v, p->k21_offset+t);
-	  if (fabs(k12) < EPSILON) {
-	    kernel = p->end[j]-p->start[j];
-	  } else {
-	    kernel = (exp(-k12*(p->midpt[k]-p->end[j]))-exp(-k12*(p->midpt[k]-p->start[j])))/k12;
-	  }
-	  inner += alpha*k21*kernel;
-	}
-	ls_answer += p->weight[k]*p->forward_error[i*p->num_frames+k]*inner;
+	if (fabs(k12) < EPSILON) 
+	  kernel = p->end[j]-p->start[j];
+	else 
+	  kernel = (exp(-k12*(p->midpt[k]-p->end[j]))-exp(-k12*(p->midpt[k]-p->start[j])))/k12;
+	inner += projection[t*p->num_frames+k]*kernel;
       }
+      ls_answer += k21*inner;
     }
     ls_answer *= 2;
 
@@ -1805,38 +2343,7 @@ static void two_comp_calc_derivative(two_comp_params_t * p, const gsl_vector *v,
 
 
   /* partial derivative of f wrt to the alpha's */
-  for (i=0; i<p->num_voxels; i++) {
-    for (f=0; f< p->num_factors; f++) {
-      alpha = gsl_vector_get(v, p->alpha_offset+i*p->num_factors+f);
-
-      ls_answer = 0;
-      for (j=0; j< p->num_frames; j++) {
-	if (f < p->num_tissues) {
-	  k21 = gsl_vector_get(v, p->k21_offset+f);
-	  inner = k21*p->tc_unscaled[j*p->num_tissues+f];
-	} else {
-	  bc = gsl_vector_get(v, p->bc_offset+j);
-	  inner = bc;
-	}
-	ls_answer += p->weight[j]*p->forward_error[i*p->num_frames+j]*inner;
-      }
-      ls_answer *=2;
-
-      /* the non-negatvity and <= 1 objective */
-      lambda = p->lmi_a[i*p->num_factors+f];
-      if ((alpha - p->mu*lambda) < 0.0)
-	neg_answer = alpha/p->mu - lambda;
-      else
-	neg_answer = 0.0;
-
-      /* the sum of alpha's == 1 constraint */
-      if (p->sum_factors_equal_one) {
-	neg_answer += p->ec_a[i]/p->mu - p->lme_a[i];
-      }
-
-      gsl_vector_set(df, p->alpha_offset+i*p->num_factors+f, ls_answer + neg_answer);
-    }
-  }
+  fads_calc_alpha_derivative(&r);
 
   return;
 }
@@ -1978,6 +2485,10 @@ void fads_two_comp(AmitkDataSet * data_set,
   p.alpha_offset = p.bc_offset+p.num_frames;
   p.num_variables = p.alpha_offset + p.num_factors*p.num_voxels;
   p.tc_unscaled = NULL;
+  p.data = NULL;
+  p.basis = NULL;
+  p.projection = NULL;
+  p.partials = NULL;
   p.forward_error = NULL;
   p.start = NULL;
   p.end = NULL;
@@ -2006,7 +2517,21 @@ void fads_two_comp(AmitkDataSet * data_set,
     goto ending;
   }
 
-  p.forward_error = g_try_new(gdouble, p.num_frames*p.num_voxels);
+  p.data = fads_get_data_matrix(p.data_set);
+  if (p.data == NULL) {
+    g_warning(_("failed data matrix malloc"));
+    goto ending;
+  }
+
+  p.basis = g_try_new(gdouble, p.num_factors*p.num_frames);
+  p.projection = g_try_new(gdouble, p.num_factors*p.num_frames);
+  p.partials = g_try_new(gdouble, fads_num_blocks((gsize) p.num_voxels)*p.num_factors*p.num_frames);
+  if ((p.basis == NULL) || (p.projection == NULL) || (p.partials == NULL)) {
+    g_warning(_("failed malloc for least squares work space"));
+    goto ending;
+  }
+
+  p.forward_error = g_try_new(gdouble, ((gsize) p.num_frames)*p.num_voxels);
   if (p.forward_error == NULL) {
     g_warning(_("failed to allocate intermediate data storage for forward error"));
     goto ending;
@@ -2068,7 +2593,7 @@ void fads_two_comp(AmitkDataSet * data_set,
   for (i=0; i<p.num_blood_curve_constraints; i++)
     p.lme_bc[i] = 0.0;
 
-  p.lmi_a = g_try_new(gdouble, p.num_voxels*p.num_factors);
+  p.lmi_a = g_try_new(gdouble, ((gsize) p.num_voxels)*p.num_factors);
   if (p.lmi_a == NULL) {
     g_warning(_("failed malloc for inequality lagrange multiplier - alpha"));
     goto ending;
@@ -2426,6 +2951,26 @@ void fads_two_comp(AmitkDataSet * data_set,
     p.tc_unscaled = NULL;
   }
 
+  if (p.data != NULL) {
+    g_free(p.data);
+    p.data = NULL;
+  }
+
+  if (p.basis != NULL) {
+    g_free(p.basis);
+    p.basis = NULL;
+  }
+
+  if (p.projection != NULL) {
+    g_free(p.projection);
+    p.projection = NULL;
+  }
+
+  if (p.partials != NULL) {
+    g_free(p.partials);
+    p.partials = NULL;
+  }
+
   if (p.start != NULL) {
     g_free(p.start);
     p.start = NULL;
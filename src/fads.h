@@ -46,16 +46,25 @@ typedef enum {
   NUM_FADS_MINIMIZERS
 } fads_minimizer_algorithm_t;
 
+typedef enum {
+  FADS_SVD_GRAM, /* eigenvectors of the frames x frames Gram matrix */
+  FADS_SVD_FULL, /* full decomposition of the voxels x frames matrix, for reference */
+  NUM_FADS_SVD_METHODS
+} fads_svd_method_t;
+
 
 extern gchar * fads_minimizer_algorithm_name[];
+extern gchar * fads_svd_method_name[];
 extern gchar * fads_type_name[];
 extern gchar * fads_type_explanation[];
 
 void fads_svd_factors(AmitkDataSet * data_set, 
+		      fads_svd_method_t svd_method,
 		      gint * pnum_factors,
 		      gdouble ** pfactors);
 void fads_pca(AmitkDataSet * data_set, 
 	      gint num_factors,
+	      fads_svd_method_t svd_method,
 	      gchar * output_filename,
 	      AmitkUpdateFunc update_func,
 	      gpointer update_data);
@@ -285,6 +285,19 @@ GdkPixbuf * image_from_8bit(const guchar * image,
 }
 
 #ifdef AMIDE_LIBVOLPACK_SUPPORT
+static void free_eye_images(guchar ** eye_images, guint num_images) {
+
+  guint i;
+
+  if (eye_images == NULL) return;
+
+  for (i=0; i<num_images; i++)
+    g_free(eye_images[i]);
+  g_free(eye_images);
+
+  return;
+}
+
 /* function returns a GdkPixbuf from a rendering context */
 GdkPixbuf * image_from_renderings(renderings_t * renderings, 
 				gint16 image_width, gint16 image_height,
@@ -301,15 +314,34 @@ GdkPixbuf * image_from_renderings(renderings_t * renderings,
   guint location;
   GdkPixbuf * temp_image;
   gint total_width;
-  gdouble rot;
   AmideEye i_eye;
   gint j;
+  guint num_renderings;
+  guchar ** eye_images=NULL;
+  guchar * context_image;
+  guint i_rendering;
 
   total_width = image_width+(eyes-1)*eye_width;
+  num_renderings = renderings_count(renderings);
+
+  /* for stereo, each eye of each context needs its own image to composite from */
+  if (eyes > 1) {
+    eye_images = g_new0(guchar *, num_renderings*eyes);
+    for (j=0; j<num_renderings*eyes; j++)
+      if ((eye_images[j] = g_try_new(guchar, image_width*image_height)) == NULL) {
+	g_warning(_("couldn't allocate memory for stereo rendering images"));
+	free_eye_images(eye_images, num_renderings*eyes);
+	return NULL;
+      }
+  }
+
+  /* render all the contexts (and eyes) */
+  renderings_render_eyes(renderings, eyes, eye_angle, eye_images, image_width*image_height);
 
   /* allocate and initialize space for a temporary storage buffer */
   if ((rgba16_data = g_try_new(rgba16_t,total_width * image_height)) == NULL) {
     g_warning(_("couldn't allocate memory for rgba16_data for transferring rendering to image"));
+    free_eye_images(eye_images, num_renderings*eyes);
     return NULL;
   }
   for (j=0; j<total_width*image_height; j++) {
@@ -319,27 +351,22 @@ GdkPixbuf * image_from_renderings(renderings_t * renderings,
     rgba16_data[j].a = 0;
   }
 
-  /* iterate through the eyes and rendering contexts, 
+  /* iterate through the eyes and rendering contexts, in order, 
      tranfering the image data into the temp storage buffer */
+  i_rendering = 0;
   while (renderings != NULL) {
 
     for (i_eye = 0; i_eye < eyes; i_eye ++) {
 
-      if (eyes == 1) {
-	rendering_render(renderings->rendering);
-      } else {
-	rot = (-0.5 + i_eye*1.0) * eye_angle;
-	rot = M_PI*rot/180; /* convert to radians */
-
-	rendering_set_rotation(renderings->rendering, AMITK_AXIS_Y, -rot);
-	rendering_render(renderings->rendering);
-	rendering_set_rotation(renderings->rendering, AMITK_AXIS_Y, rot);
-      }
+      if (eyes == 1)
+	context_image = renderings->rendering->image;
+      else
+	context_image = eye_images[i_rendering*eyes+i_eye];
 
       i.t = i.g = i.z = 0;
       for (i.y = 0; i.y < image_height; i.y++) 
 	for (i.x = 0; i.x < image_width; i.x++) {
-	  rgba_temp = amitk_color_table_lookup(renderings->rendering->image[i.x+i.y*image_width], 
+	  rgba_temp = amitk_color_table_lookup(context_image[i.x+i.y*image_width], 
 					       renderings->rendering->color_table, 
 					       0, RENDERING_DENSITY_MAX);
 	  /* compensate for the fact that X defines the origin as top left, not bottom left */
@@ -382,8 +409,11 @@ GdkPixbuf * image_from_renderings(renderings_t * renderings,
 	}
     }      
     renderings = renderings->next;
+    i_rendering++;
   }
 
+  free_eye_images(eye_images, num_renderings*eyes);
+
   /* allocate space for the true rgb buffer */
   if ((char_data = g_try_new(guchar,3*image_height * total_width)) == NULL) {
     g_warning(_("couldn't allocate memory for char_data for rendering image"));
@@ -415,17 +445,22 @@ GdkPixbuf * image_of_distribution(AmitkDataSet * ds, rgb_t fg,
 				  AmitkUpdateFunc update_func,
 				  gpointer update_data) {
 
+  /* make sure we have a distribution calculated */
+  amitk_data_set_calc_distribution(ds, update_func, update_data);
+
+  return image_from_distribution(AMITK_DATA_SET_DISTRIBUTION(ds), fg);
+}
+
+/* same as above, but for a distribution array we've already got, which may be NULL */
+GdkPixbuf * image_from_distribution(AmitkRawData * distribution, rgb_t fg) {
+
   GdkPixbuf * temp_image;
   guchar * rgba_data;
   amide_intpoint_t k,l;
   AmitkVoxel j;
   amide_data_t max, scale;
-  AmitkRawData * distribution;
   gint dim_x;
 
-  /* make sure we have a distribution calculated */
-  amitk_data_set_calc_distribution(ds, update_func, update_data);
-  distribution = AMITK_DATA_SET_DISTRIBUTION(ds);
   if(distribution==NULL) {
     dim_x = AMITK_DATA_SET_DISTRIBUTION_SIZE;
   } else {
@@ -596,6 +631,55 @@ GdkPixbuf * image_from_projection(AmitkDataSet * projection) {
 }
 
 
+/* colors float projection data (e.g. from mip_project) using the data set's
+   color table and thresholds, row 0 of the data is the bottom of the image.
+   NAN's are left black */
+GdkPixbuf * image_from_float_data(AmitkDataSet * ds,
+				  const gfloat * data,
+				  const amide_intpoint_t width,
+				  const amide_intpoint_t height,
+				  const amide_time_t start,
+				  const amide_time_t duration) {
+
+  guchar * rgb_data;
+  amide_intpoint_t x, y;
+  amide_data_t max,min;
+  rgba_t rgba_temp;
+  AmitkColorTable color_table;
+  guchar * row;
+  gfloat value;
+  
+  /* sanity checks */
+  g_return_val_if_fail(AMITK_IS_DATA_SET(ds), NULL);
+  g_return_val_if_fail(data != NULL, NULL);
+  
+  if ((rgb_data = g_try_new0(guchar,3*width*height)) == NULL) {
+    g_warning(_("couldn't allocate memory for rgba_data for projection image"));
+    return NULL;
+  }
+
+  amitk_data_set_get_thresholding_min_max(ds, ds, start, duration, &min, &max);
+  color_table = AMITK_DATA_SET_COLOR_TABLE(ds, AMITK_VIEW_MODE_SINGLE);
+
+  for (y = 0; y < height; y++) {
+    /* compensate for the fact that X defines the origin as top left, not bottom left */
+    row = rgb_data + (height-y-1)*width*3;
+    for (x = 0; x < width; x++) {
+      value = data[y*width+x];
+      if (isnan(value)) continue;
+      rgba_temp = amitk_color_table_lookup(value, color_table, min, max);
+      row[x*3+0] = rgba_temp.r;
+      row[x*3+1] = rgba_temp.g;
+      row[x*3+2] = rgba_temp.b;
+    }
+  }
+
+  return gdk_pixbuf_new_from_data(rgb_data, GDK_COLORSPACE_RGB,
+				  FALSE,8,width,height,width*3*sizeof(guchar),
+				  image_free_rgb_data, NULL);
+}
+
+
 GdkPixbuf * image_from_slice(AmitkDataSet * slice, AmitkViewMode view_mode) {
 
   guchar * rgba_data;
@@ -649,56 +733,53 @@ GdkPixbuf * image_from_slice(AmitkDataSet * slice, AmitkViewMode view_mode) {
   return temp_image;
 }
 
-/* note, generally call this function with gate -1, only use the gate
-   parameter if you want to override the data set's specified gate */
-GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
-				 GList ** pslice_cache,
-				 const gint max_slice_cache_size,
-				 GList * objects,
-				 const AmitkDataSet * active_ds,
-				 const amide_time_t start,
-				 const amide_time_t duration,
-				 const amide_intpoint_t gate,
-				 const amide_real_t pixel_size,
-				 const AmitkVolume * view_volume,
-				 const AmitkFuseType fuse_type,
-				 const AmitkViewMode view_mode) {
+/* blends the given slices into the rectangle (x,y,width,height) of an RGB
+   pixbuf of the same dimensions as the slices.  The rectangle is in pixbuf
+   coordinates, e.g. with the origin at the top left. */
+void image_composite_slices(GdkPixbuf * pixbuf,
+			    GList * slices,
+			    const AmitkDataSet * active_ds,
+			    const amide_time_t start,
+			    const amide_time_t duration,
+			    const AmitkFuseType fuse_type,
+			    const AmitkViewMode view_mode,
+			    const gint x,
+			    const gint y,
+			    const gint width,
+			    const gint height) {
 
   gint slice_num;
   guint32 total_alpha;
+  guchar * pixels;
   guchar * rgb_data;
+  gint rowstride;
   rgba16_t * rgba16_data;
   guint location;
   AmitkVoxel i;
   AmitkVoxel dim;
   amide_data_t max,min;
-  GdkPixbuf * temp_image;
   rgba_t rgba_temp;
-  GList * slices;
   GList * temp_slices;
   AmitkDataSet * slice;
   AmitkColorTable color_table;
   AmitkDataSet * overlay_slice = NULL;
-  gint j;
-  AmitkCanvasPoint pixel_size2;
-  
+  gint j, row, column;
 
   /* sanity checks */
-  g_return_val_if_fail(objects != NULL, NULL);
-
-  pixel_size2.x = pixel_size2.y = pixel_size;
-  slices = amitk_data_sets_get_slices(objects, pslice_cache, max_slice_cache_size,
-				      start, duration, gate, pixel_size2,view_volume);
-  g_return_val_if_fail(slices != NULL, NULL);
+  g_return_if_fail(slices != NULL);
+  g_return_if_fail(GDK_IS_PIXBUF(pixbuf));
 
-  /* get the dimensions.  since all slices have the same dimensions, we'll just get the first */
   dim = AMITK_DATA_SET_DIM(slices->data);
+  g_return_if_fail(gdk_pixbuf_get_width(pixbuf) == dim.x);
+  g_return_if_fail(gdk_pixbuf_get_height(pixbuf) == dim.y);
+  g_return_if_fail((x >= 0) && (y >= 0) && (x+width <= dim.x) && (y+height <= dim.y));
+  if ((width <= 0) || (height <= 0)) return;
 
   /* allocate and initialize space for a temporary storage buffer */
-  rgba16_data = g_try_new(rgba16_t,dim.y*dim.x);
-  g_return_val_if_fail(rgba16_data != NULL, NULL);
+  rgba16_data = g_try_new(rgba16_t,width*height);
+  g_return_if_fail(rgba16_data != NULL);
 
-  for (j=0; j<dim.y*dim.x; j++) {
+  for (j=0; j<width*height; j++) {
     rgba16_data[j].r = 0;
     rgba16_data[j].g = 0;
     rgba16_data[j].b = 0;
@@ -726,8 +807,9 @@ GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
       i.t = i.g = i.z = 0;
       location=0;
       /* compensate for the fact that X defines the origin as top left, not bottom left */
-      for (i.y = dim.y-1; i.y >= 0; i.y--) 
-	for (i.x = 0; i.x < dim.x; i.x++, location++) {
+      for (row = y; row < y+height; row++) {
+	i.y = dim.y-1-row;
+	for (i.x = x; i.x < x+width; i.x++, location++) {
 	  rgba_temp = 
 	    amitk_color_table_lookup(AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(slice,i), color_table,min, max);
 	  
@@ -760,23 +842,23 @@ GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
 	    rgba16_data[location].a = total_alpha;
 	  }
 	}
+      }
     }
     temp_slices = temp_slices->next;
   }
 
-  /* allocate space for the true rgb buffer */
-  rgb_data = g_try_new(guchar,3*dim.y*dim.x);
-  g_return_val_if_fail(rgb_data != NULL, NULL);
-
   /* now convert our temp rgb data to real rgb data */
-  i.z = 0;
+  pixels = gdk_pixbuf_get_pixels(pixbuf);
+  rowstride = gdk_pixbuf_get_rowstride(pixbuf);
   location=0;
-  for (i.y = 0; i.y < dim.y; i.y++) 
-    for (i.x = 0; i.x < dim.x; i.x++, location++) {
-      rgb_data[3*location+0] = rgba16_data[location].r < 0xFF ? rgba16_data[location].r : 0xFF;
-      rgb_data[3*location+1] = rgba16_data[location].g < 0xFF ? rgba16_data[location].g : 0xFF;
-      rgb_data[3*location+2] = rgba16_data[location].b < 0xFF ? rgba16_data[location].b : 0xFF;
+  for (row = y; row < y+height; row++) {
+    rgb_data = pixels + row*rowstride + 3*x;
+    for (column = 0; column < width; column++, location++) {
+      rgb_data[3*column+0] = rgba16_data[location].r < 0xFF ? rgba16_data[location].r : 0xFF;
+      rgb_data[3*column+1] = rgba16_data[location].g < 0xFF ? rgba16_data[location].g : 0xFF;
+      rgb_data[3*column+2] = rgba16_data[location].b < 0xFF ? rgba16_data[location].b : 0xFF;
     }
+  }
 
   /* if we have a data set we're overlaying, add it in now */
   if (overlay_slice != NULL) {
@@ -787,30 +869,75 @@ GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
       color_table = amitk_data_set_get_color_table_to_use(AMITK_DATA_SET_SLICE_PARENT(overlay_slice), view_mode);
 
       i.t = i.g = i.z = 0;
-      for (i.y = 0; i.y < dim.y; i.y++) 
-	for (i.x = 0; i.x < dim.x; i.x++) {
+      for (row = y; row < y+height; row++) {
+	/* compensate for the fact that X defines the origin as top left, not bottom left */
+	i.y = dim.y-1-row;
+	rgb_data = pixels + row*rowstride;
+	for (i.x = x; i.x < x+width; i.x++) {
 	  rgba_temp = 
 	    amitk_color_table_lookup(AMITK_DATA_SET_DOUBLE_0D_SCALING_CONTENT(overlay_slice,i), 
 				     color_table,min, max);
 
-	  /* compensate for the fact that X defines the origin as top left, not bottom left */
-	  location = (dim.y - i.y - 1)*dim.x+i.x;
 	  if (rgba_temp.a != 0) {
-	    rgb_data[3*location+0] = rgba_temp.r;
-	    rgb_data[3*location+1] = rgba_temp.g;
-	    rgb_data[3*location+2] = rgba_temp.b;
+	    rgb_data[3*i.x+0] = rgba_temp.r;
+	    rgb_data[3*i.x+1] = rgba_temp.g;
+	    rgb_data[3*i.x+2] = rgba_temp.b;
 	  }
 	}
+      }
   }
   
+  /* cleanup */
+  g_free(rgba16_data);
+
+  return;
+}
+
+/* note, generally call this function with gate -1, only use the gate
+   parameter if you want to override the data set's specified gate */
+GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
+				 GList ** pslice_cache,
+				 const gint max_slice_cache_size,
+				 GList * objects,
+				 const AmitkDataSet * active_ds,
+				 const amide_time_t start,
+				 const amide_time_t duration,
+				 const amide_intpoint_t gate,
+				 const amide_real_t pixel_size,
+				 const AmitkVolume * view_volume,
+				 const AmitkFuseType fuse_type,
+				 const AmitkViewMode view_mode) {
+
+  guchar * rgb_data;
+  AmitkVoxel dim;
+  GdkPixbuf * temp_image;
+  GList * slices;
+  AmitkCanvasPoint pixel_size2;
+  
+
+  /* sanity checks */
+  g_return_val_if_fail(objects != NULL, NULL);
+
+  pixel_size2.x = pixel_size2.y = pixel_size;
+  slices = amitk_data_sets_get_slices(objects, pslice_cache, max_slice_cache_size,
+				      start, duration, gate, pixel_size2,view_volume);
+  g_return_val_if_fail(slices != NULL, NULL);
+
+  /* get the dimensions.  since all slices have the same dimensions, we'll just get the first */
+  dim = AMITK_DATA_SET_DIM(slices->data);
+
+  /* allocate space for the true rgb buffer */
+  rgb_data = g_try_new(guchar,3*dim.y*dim.x);
+  g_return_val_if_fail(rgb_data != NULL, NULL);
 
   /* from the rgb_data, generate a GdkPixbuf */
   temp_image = gdk_pixbuf_new_from_data(rgb_data, GDK_COLORSPACE_RGB,
   					FALSE,8,dim.x,dim.y,dim.x*3*sizeof(guchar),
   					image_free_rgb_data, NULL);
 
-  /* cleanup */
-  g_free(rgba16_data);
+  /* and blend the slices into it */
+  image_composite_slices(temp_image, slices, active_ds, start, duration,
+			 fuse_type, view_mode, 0, 0, dim.x, dim.y);
 
   if (pdisp_slices != NULL) {
     amitk_objects_unref((*pdisp_slices));
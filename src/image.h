@@ -61,6 +61,7 @@ GdkPixbuf * image_from_renderings(renderings_t * renderings,
 GdkPixbuf * image_of_distribution(AmitkDataSet * ds, rgb_t fg,
 				  AmitkUpdateFunc update_func,
 				  gpointer update_data);
+GdkPixbuf * image_from_distribution(AmitkRawData * distribution, rgb_t fg);
 GdkPixbuf * image_from_colortable(const AmitkColorTable color_table,
 				  const amide_intpoint_t width, 
 				  const amide_intpoint_t height,
@@ -70,8 +71,25 @@ GdkPixbuf * image_from_colortable(const AmitkColorTable color_table,
 				  const amide_data_t data_set_max,
 				  const gboolean horizontal);
 GdkPixbuf * image_from_projection(AmitkDataSet * projection);
+GdkPixbuf * image_from_float_data(AmitkDataSet * ds,
+				  const gfloat * data,
+				  const amide_intpoint_t width,
+				  const amide_intpoint_t height,
+				  const amide_time_t start,
+				  const amide_time_t duration);
 GdkPixbuf * image_from_slice(AmitkDataSet * slice,
 			     AmitkViewMode view_mode);
+void        image_composite_slices(GdkPixbuf * pixbuf,
+				   GList * slices,
+				   const AmitkDataSet * active_ds,
+				   const amide_time_t start,
+				   const amide_time_t duration,
+				   const AmitkFuseType fuse_type,
+				   const AmitkViewMode view_mode,
+				   const gint x,
+				   const gint y,
+				   const gint width,
+				   const gint height);
 GdkPixbuf * image_from_data_sets(GList ** pdisp_slices,
 				 GList ** pslice_cache,
 				 const gint max_slice_cache_size,
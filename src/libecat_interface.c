@@ -29,6 +29,7 @@
 #include <time.h>
 #include <matrix.h>
 #include <locale.h>
+#include <string.h>
 #include "libecat_interface.h"
 
 static char * libecat_data_types[] = {
@@ -42,6 +43,47 @@ static char * libecat_data_types[] = {
   N_("Integer (32 bit), Big Endian") /* SunLong */
 }; /* NumMatrixDataTypes */
 
+/* state shared by the plane copying threads of libecat_import */
+typedef struct _libecat_copy_t {
+  MatrixData ** matrices;
+  guint planes_per_matrix;
+  guchar * data;
+  gsize bytes_per_row;
+  gsize bytes_per_plane;
+  gint num_rows;
+} libecat_copy_t;
+
+/* copies planes [start,end) of the current batch of matrices into the
+   data set's raw data.  libecat has already converted the data into
+   the native format, so this is just a row by row copy */
+static void libecat_copy_planes(guint64 start, guint64 end, gpointer data) {
+
+  libecat_copy_t * copy = data;
+  MatrixData * matrix;
+  guint64 plane;
+  guchar * src;
+  guchar * dest;
+  gint y;
+
+  for (plane = start; plane < end; plane++) {
+    matrix = copy->matrices[plane / copy->planes_per_matrix];
+    if (matrix == NULL) continue; /* counted as corrupted by the caller */
+
+    src = ((guchar *) matrix->data_ptr) + 
+      (plane % copy->planes_per_matrix)*copy->bytes_per_plane;
+    dest = copy->data + plane*copy->bytes_per_plane;
+
+    /* note, we compensate here for the fact that we define 
+       our origin as the bottom left, not top left like the CTI file */
+    for (y = 0; y < copy->num_rows; y++) 
+      memcpy(dest + copy->bytes_per_row*y, 
+	     src + copy->bytes_per_row*(copy->num_rows-y-1),
+	     copy->bytes_per_row);
+  }
+
+  return;
+}
+
 AmitkDataSet * libecat_import(const gchar * libecat_filename, 
 			      AmitkPreferences * preferences,
 			      AmitkUpdateFunc update_func,
@@ -62,9 +104,9 @@ AmitkDataSet * libecat_import(const gchar * libecat_filename,
   AmitkFormat format;
   AmitkVoxel dim;
   AmitkScalingType scaling_type;
-  div_t x;
-  gint divider;
-  gint total_planes, i_plane;
+  gint total_planes;
+  gint total_matrices, i_matrix, j_matrix, num_matrices, batch_matrices;
+  libecat_copy_t copy;
   gboolean continue_work=TRUE;
   gchar * temp_string;
   const gchar * bad_char;
@@ -325,104 +367,86 @@ AmitkDataSet * libecat_import(const gchar * libecat_filename,
     g_free(temp_string);
   }
   total_planes = dim.z*dim.g*dim.t;
-  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
-
-
-  /* and load in the data */
-  for (i.t = 0, i_plane=0; (i.t < AMITK_DATA_SET_NUM_FRAMES(ds)) && (continue_work); i.t++) {
-#ifdef AMIDE_DEBUG
-    g_print("\tloading frame:\t%d",i.t);
-#endif
-    for (i.g = 0; (i.g < AMITK_DATA_SET_NUM_GATES(ds)) && (continue_work); i.g++) {
-      for (slice=0; (slice < num_slices) && (continue_work) ; slice++) {
-	matnum=mat_numcod(i.t+1,slice+1,i.g+1,0,0);/* frame, plane, gate, data, bed */
+  total_matrices = dim.t*dim.g*num_slices;
+
+  copy.planes_per_matrix = dim.z/num_slices;
+  copy.bytes_per_row = amitk_format_sizes[format]*dim.x;
+  copy.bytes_per_plane = copy.bytes_per_row*dim.y;
+  copy.num_rows = dim.y;
+  batch_matrices = MAX(1, (4*amitk_get_num_threads())/copy.planes_per_matrix);
+  copy.matrices = g_new0(MatrixData *, batch_matrices);
+
+  /* and load in the data.  libecat reads through a single file handle, so
+     the matrices of each batch are read in here, and their planes are then
+     copied into the data set in parallel */
+  for (i_matrix = 0; (i_matrix < total_matrices) && (continue_work); i_matrix += num_matrices) {
+    num_matrices = MIN(batch_matrices, total_matrices-i_matrix);
+
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, 
+				     ((gdouble) i_matrix*copy.planes_per_matrix)/((gdouble) total_planes));
+
+    for (j_matrix = 0; j_matrix < num_matrices; j_matrix++) {
+      slice = (i_matrix+j_matrix) % num_slices;
+      i.g = ((i_matrix+j_matrix) / num_slices) % dim.g;
+      i.t = (i_matrix+j_matrix) / (num_slices*dim.g);
+      matnum=mat_numcod(i.t+1,slice+1,i.g+1,0,0);/* frame, plane, gate, data, bed */
       
-	/* read in the corresponding cti slice */
-	if ((matrix_slice = matrix_read(libecat_file, matnum, 0)) == NULL) {
-	  num_corrupted_planes+=dim.z/num_slices;
-	  /*	  g_warning(_("Libecat can't get image matrix %x in file %s"), matnum, libecat_filename); */
-	  /* goto error; */
-	} else {
+      /* read in the corresponding cti slice */
+      if ((matrix_slice = matrix_read(libecat_file, matnum, 0)) == NULL) {
+	num_corrupted_planes+=dim.z/num_slices;
+	/*	g_warning(_("Libecat can't get image matrix %x in file %s"), matnum, libecat_filename); */
+	/* goto error; */
+      } else {
       
-	  /* set the frame duration, note, CTI files specify time as integers in msecs */
-	  switch(libecat_file->mhptr->file_type) {
-	  case PetImage: 
-	  case PetVolume: 
-	  case InterfileImage:
-	    ish = (Image_subheader *) matrix_slice->shptr;
-	    ds->frame_duration[i.t] = ish->frame_duration/1000.0;
-	    break;
-	  case Normalization:
-	  case AttenCor:
-	    ds->frame_duration[i.t] = 1.0; /* doesn't mean anything */
-	    break;
-	  case Sinogram:
-	    ssh = (Scan_subheader *) matrix_slice->shptr;
-	    ds->frame_duration[i.t] = ssh->frame_duration/1000.0;
-	    break;
-	  default:
-	    break; /* should never get here */
-	  }
-	  
-	  for (i.z = slice*(dim.z/num_slices); 
-	       i.z < dim.z/num_slices + slice*(dim.z/num_slices); 
-	       i.z++, i_plane++) {
-	    
-	    if (update_func != NULL) {
-	      x = div(i_plane,divider);
-	      if (x.rem == 0)
-		continue_work = (*update_func)(update_data, NULL, ((gdouble) i_plane)/((gdouble)total_planes));
-	    }
-	  
-	    /* save the scale factor */
-	    j.x = j.y = 0;
-	    j.z = slice;
-	    j.g = i.g;
-	    j.t = i.t;
-	    if (scaling_type == AMITK_SCALING_TYPE_2D) 
-	      *AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_factor, j) = calibration_factor*matrix_slice->scale_factor;
-	    else if (i.z == 0)  /* AMITK_SCALING_TYPE_1D */
-	      *AMITK_RAW_DATA_DOUBLE_1D_SCALING_POINTER(ds->internal_scaling_factor, j) = calibration_factor*matrix_slice->scale_factor;
-	    
-	    switch (format) {
-	    case AMITK_FORMAT_SSHORT:
-	      /* copy the data into the volume */
-	      /* note, we compensate here for the fact that we define 
-		 our origin as the bottom left, not top left like the CTI file */
-	      for (i.y = 0; i.y < dim.y; i.y++) 
-		for (i.x = 0; i.x < dim.x; i.x++)
-		  AMITK_RAW_DATA_SSHORT_SET_CONTENT(ds->raw_data,i) =
-		    *(((amitk_format_SSHORT_t *) matrix_slice->data_ptr) + 
-		      (dim.y*dim.x*(i.z-slice*(dim.z/num_slices))
-		     +dim.x*(dim.y-i.y-1)
-		       +i.x));
-	      break;
-	    case AMITK_FORMAT_FLOAT:
-	      /* copy the data into the volume */
-	      /* note, we compensate here for the fact that we define 
-		 our origin as the bottom left, not top left like the CTI file */
-	      for (i.y = 0; i.y < dim.y; i.y++) 
-		for (i.x = 0; i.x < dim.x; i.x++)
-		  AMITK_RAW_DATA_FLOAT_SET_CONTENT(ds->raw_data,i) =
-		    *(((amitk_format_FLOAT_t *) matrix_slice->data_ptr) + 
-		      (dim.y*dim.x*(i.z-slice*(dim.z/num_slices))
-		     +dim.x*(dim.y-i.y-1)
-		       +i.x));
-	      break;
-	    default:
-	      g_error("unexpected case in %s at %d\n", __FILE__, __LINE__);
-	      goto error;
-	      break; 
-	    } /* format */
-	  } /* i.z */
-	  free_matrix_data(matrix_slice);
-	} /* matrix_slice != NULL */
-      } /* slice */
-    } /* i.g */
-#ifdef AMIDE_DEBUG
-    g_print("\tduration:\t%5.3f\n",ds->frame_duration[i.t]);
-#endif
-  } /* i.t */
+	/* set the frame duration, note, CTI files specify time as integers in msecs */
+	switch(libecat_file->mhptr->file_type) {
+	case PetImage: 
+	case PetVolume: 
+	case InterfileImage:
+	  ish = (Image_subheader *) matrix_slice->shptr;
+	  ds->frame_duration[i.t] = ish->frame_duration/1000.0;
+	  break;
+	case Normalization:
+	case AttenCor:
+	  ds->frame_duration[i.t] = 1.0; /* doesn't mean anything */
+	  break;
+	case Sinogram:
+	  ssh = (Scan_subheader *) matrix_slice->shptr;
+	  ds->frame_duration[i.t] = ssh->frame_duration/1000.0;
+	  break;
+	default:
+	  break; /* should never get here */
+	}
+	
+	/* save the scale factor */
+	j.x = j.y = 0;
+	j.z = slice;
+	j.g = i.g;
+	j.t = i.t;
+	if (scaling_type == AMITK_SCALING_TYPE_2D) 
+	  *AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_factor, j) = calibration_factor*matrix_slice->scale_factor;
+	else if (slice == 0)  /* AMITK_SCALING_TYPE_1D */
+	  *AMITK_RAW_DATA_DOUBLE_1D_SCALING_POINTER(ds->internal_scaling_factor, j) = calibration_factor*matrix_slice->scale_factor;
+      }
+      copy.matrices[j_matrix] = matrix_slice;
+      matrix_slice = NULL;
+    }
+
+    /* planes of consecutive matrices are consecutive in the data set */
+    copy.data = ((guchar *) ds->raw_data->data) + 
+      ((guint64) i_matrix)*copy.planes_per_matrix*copy.bytes_per_plane;
+    amitk_parallel_for(((guint64) num_matrices)*copy.planes_per_matrix, 1, 
+		       libecat_copy_planes, &copy);
+
+    for (j_matrix = 0; j_matrix < num_matrices; j_matrix++) {
+      if (copy.matrices[j_matrix] != NULL) {
+	free_matrix_data(copy.matrices[j_matrix]);
+	copy.matrices[j_matrix] = NULL;
+      }
+    }
+  }
+  g_free(copy.matrices);
 
   if (num_corrupted_planes > 0) 
     g_warning(_("Libecat returned %d blank planes... corrupted data file?  Use data with caution."), num_corrupted_planes);
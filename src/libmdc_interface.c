@@ -188,6 +188,81 @@ static gint libmdc_type_number(const AmitkFormat format) {
   }
 }
 
+/* state shared by the plane copying threads of libmdc_import */
+typedef struct _libmdc_copy_t {
+  FILEINFO * fi;
+  AmitkVoxel dim;
+  guint64 first_plane;
+  guchar * data;
+  gint format_size;
+  gsize bytes_per_row;
+  gsize bytes_per_plane;
+  gboolean swap;
+  gboolean salvage;
+  gboolean failed;
+} libmdc_copy_t;
+
+/* byte swaps, flips, and copies planes [start,end) of the current batch
+   straight into the data set's raw data.  Planes are in amide's
+   frames->gates->planes order, relative to copy->first_plane */
+static void libmdc_copy_planes(guint64 start, guint64 end, gpointer data) {
+
+  libmdc_copy_t * copy = data;
+  guint64 plane;
+  gint image_num;
+  Uint8 * buf;
+  Uint8 * conv_pointer;
+  guchar * dest;
+  gsize k;
+  gint y;
+
+  for (plane = copy->first_plane+start; plane < copy->first_plane+end; plane++) {
+
+    /* note, libmdc is gates->frames->planes, we're frames->gates->planes */
+    image_num = (plane % copy->dim.z) +
+      ((plane / (copy->dim.z*copy->dim.g)) * copy->dim.z) +
+      (((plane / copy->dim.z) % copy->dim.g) * copy->dim.z*copy->dim.t);
+    buf = copy->fi->image[image_num].buf;
+    if (buf == NULL) continue; /* counted as a corrupted plane by the caller */
+
+    /* handle endian issues */
+    if (copy->swap) {
+      if (copy->format_size == 2) {
+	guint16 * buf16 = (guint16 *) buf;
+	for (k=0; k < copy->bytes_per_plane/2; k++)
+	  buf16[k] = GUINT16_SWAP_LE_BE(buf16[k]);
+      } else if (copy->format_size == 4) {
+	guint32 * buf32 = (guint32 *) buf;
+	for (k=0; k < copy->bytes_per_plane/4; k++)
+	  buf32[k] = GUINT32_SWAP_LE_BE(buf32[k]);
+      }
+    }
+
+    if (copy->salvage) {
+      /* convert the image to a 32 bit float to begin with */
+      if ((conv_pointer = MdcGetImgFLT32(copy->fi, image_num)) == NULL) {
+	copy->failed = TRUE;
+	continue;
+      }
+    } else {
+      conv_pointer = buf;
+    }
+
+    /* flip as (X)MedCon stores data from anterior to posterior (top to bottom) */
+    dest = copy->data + plane*copy->bytes_per_plane;
+    for (y=0; y < copy->dim.y; y++) 
+      memcpy(dest + copy->bytes_per_row*y, 
+	     conv_pointer+copy->bytes_per_row*(copy->dim.y-y-1), 
+	     copy->bytes_per_row);
+
+    /* free up the buffer data */
+    if (copy->salvage) g_free(conv_pointer);
+    MdcFree(copy->fi->image[image_num].buf);
+  }
+
+  return;
+}
+
 AmitkDataSet * libmdc_import(const gchar * filename, 
 			     const libmdc_format_t libmdc_format,
 			     AmitkPreferences * preferences,
@@ -200,7 +275,6 @@ AmitkDataSet * libmdc_import(const gchar * filename,
   struct tm time_structure;
   AmitkVoxel i;
   gint j;
-  guint64 k;
   AmitkDataSet * ds=NULL;
   gchar * name;
   gchar * import_filename=NULL;
@@ -208,9 +282,10 @@ AmitkDataSet * libmdc_import(const gchar * filename,
   AmitkVoxel dim;
   AmitkFormat format;
   AmitkModality modality;
-  div_t x;
-  gint divider;
-  gint total_planes;
+  guint64 total_planes;
+  guint64 plane;
+  guint64 num_planes;
+  guint64 batch_planes;
   gboolean continue_work=TRUE;
   gboolean invalid_date;
   gchar * temp_string;
@@ -226,8 +301,7 @@ AmitkDataSet * libmdc_import(const gchar * filename,
   AmitkPoint new_offset;
   AmitkPoint shift;
   AmitkAxes new_axes;
-  void * ds_pointer;
-  Uint8 * conv_pointer;
+  libmdc_copy_t copy;
   gint format_size;
   gint bytes_per_plane;
   gint bytes_per_row;
@@ -692,16 +766,10 @@ AmitkDataSet * libmdc_import(const gchar * filename,
     g_free(temp_string);
   }
   total_planes = dim.z*dim.g*dim.t;
-  divider = ((total_planes/AMITK_UPDATE_DIVIDER) < 1) ? 1 : (total_planes/AMITK_UPDATE_DIVIDER);
-
-  /* and load in the data */
   i = zero_voxel;
-  for (i.t = 0; (i.t < dim.t) && (continue_work); i.t++) {
-#ifdef AMIDE_DEBUG
-    g_print("\tloading frame %d",i.t);
-#endif
 
-    /* set the frame duration, note, medcon/libMDC specifies time as float in msecs */
+  /* set the frame durations, note, medcon/libMDC specifies time as float in msecs */
+  for (i.t = 0; i.t < dim.t; i.t++) {
     if (libmdc_fi.dyndata != NULL)
       amitk_data_set_set_frame_duration(ds, i.t, libmdc_fi.dyndata[i.t].time_frame_duration/1000.0);
     else if (libmdc_fi.image[0].sdata != NULL) 
@@ -714,100 +782,75 @@ AmitkDataSet * libmdc_import(const gchar * filename,
     /* make sure it's not zero */
     if (amitk_data_set_get_frame_duration(ds,i.t) < EPSILON) 
       amitk_data_set_set_frame_duration(ds,i.t, EPSILON);
+#ifdef AMIDE_DEBUG
+    g_print("\tframe %d duration %5.3f\n", i.t, amitk_data_set_get_frame_duration(ds, i.t));
+#endif
+  }
 
-    for (i.g = 0; (i.g < ds->raw_data->dim.g) && (continue_work); i.g++) {
-
-      /* copy the data into the data set */
-      for (i.z = 0 ; (i.z < ds->raw_data->dim.z) && (continue_work); i.z++) {
-
-	/* note, libmdc is gates->frames->planes, we're frames->gates->planes */
-	image_num = i.z+i.t*dim.z+i.g*dim.z*dim.t;
-
-	if (update_func != NULL) {
-	  x = div(image_num,divider);
-	  if (x.rem == 0)
-	    continue_work = (*update_func)(update_data, NULL, ((gdouble) image_num)/((gdouble) total_planes));
-	}
-
-	/* read in the raw plane data if needed */
-	if (libmdc_fi.image[image_num].buf == NULL) {
-	  if ((error = MdcLoadPlane(&libmdc_fi, image_num)) != MDC_OK) {
-	    g_warning(_("Couldn't read plane %d in %s with libmdc/(X)MedCon"),image_num, filename);
-	    goto error;
-	  }
-	}
-
-	/* store the scaling factor... I think this is the right scaling factor... */
-	/* also needs to adjust, most formats libmdc reads are are y = m*x+b.
-	   amide, however, is y = m * (x+b); */
-	if (salvage)
-	  *AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_factor, i) = 1.0;
-	else {
-	  *AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_factor, i) = 
-	    libmdc_fi.image[image_num].quant_scale*
-	    libmdc_fi.image[image_num].calibr_fctr;
-	  *AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_intercept,i) =
-	    libmdc_fi.image[image_num].intercept/
-	    (libmdc_fi.image[image_num].quant_scale*
-	     libmdc_fi.image[image_num].calibr_fctr);
+  copy.fi = &libmdc_fi;
+  copy.dim = dim;
+  copy.data = ds->raw_data->data;
+  copy.format_size = format_size;
+  copy.bytes_per_row = bytes_per_row;
+  copy.bytes_per_plane = bytes_per_plane;
+  copy.swap = ((format_size > 1) && MdcDoSwap());
+  copy.salvage = salvage;
+  copy.failed = FALSE;
+
+  /* and load in the data.  Reading the planes off disk and setting the scaling factors
+     is done here, the planes of each batch are then converted and copied in parallel */
+  batch_planes = MAX(1, 4*amitk_get_num_threads());
+  for (plane = 0; (plane < total_planes) && (continue_work); plane += num_planes) {
+    num_planes = MIN(batch_planes, total_planes-plane);
+
+    if (update_func != NULL) 
+      continue_work = (*update_func)(update_data, NULL, ((gdouble) plane)/((gdouble) total_planes));
+
+    for (j=0; j < num_planes; j++) {
+      i.z = (plane+j) % dim.z;
+      i.g = ((plane+j) / dim.z) % dim.g;
+      i.t = (plane+j) / (dim.z*dim.g);
+
+      /* note, libmdc is gates->frames->planes, we're frames->gates->planes */
+      image_num = i.z+i.t*dim.z+i.g*dim.z*dim.t;
+
+      /* read in the raw plane data if needed */
+      if (libmdc_fi.image[image_num].buf == NULL) {
+	if ((error = MdcLoadPlane(&libmdc_fi, image_num)) != MDC_OK) {
+	  g_warning(_("Couldn't read plane %d in %s with libmdc/(X)MedCon"),image_num, filename);
+	  goto error;
 	}
+      }
+
+      /* store the scaling factor... I think this is the right scaling factor... */
+      /* also needs to adjust, most formats libmdc reads are are y = m*x+b.
+	 amide, however, is y = m * (x+b); */
+      if (salvage)
+	*AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_factor, i) = 1.0;
+      else {
+	*AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_factor, i) = 
+	  libmdc_fi.image[image_num].quant_scale*
+	  libmdc_fi.image[image_num].calibr_fctr;
+	*AMITK_RAW_DATA_DOUBLE_2D_SCALING_POINTER(ds->internal_scaling_intercept,i) =
+	  libmdc_fi.image[image_num].intercept/
+	  (libmdc_fi.image[image_num].quant_scale*
+	   libmdc_fi.image[image_num].calibr_fctr);
+      }
+
+      /* sanity check */
+      if (libmdc_fi.image[image_num].buf == NULL) 
+	num_corrupted_planes++;
+    }
 
-	/* sanity check */
-	if (libmdc_fi.image[image_num].buf == NULL) {
-	  num_corrupted_planes++;
-	} else {
-
-	  /* handle endian issues */
-	  switch(ds->raw_data->format) {
-	  case AMITK_FORMAT_SBYTE:
-	  case AMITK_FORMAT_UBYTE:
-	    break;
-	  case AMITK_FORMAT_SSHORT:
-	  case AMITK_FORMAT_USHORT:
-	    if (MdcDoSwap()) 
-	      for (k=0; k < bytes_per_plane; k+=2)
-		MdcSwapBytes(libmdc_fi.image[image_num].buf+k, 2);
-	    break;
-	  case AMITK_FORMAT_SINT:
-	  case AMITK_FORMAT_UINT:
-	  case AMITK_FORMAT_FLOAT: 
-	    if (MdcDoSwap()) 
-	      for (k=0; k < bytes_per_plane; k+=4)
-		MdcSwapBytes(libmdc_fi.image[image_num].buf+k, 4);
-	    break;
-	  default:
-	    g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
-	    goto error;
-	    break;
-	  }
-
-	  if (salvage) {
-	    /* convert the image to a 32 bit float to begin with */
-	    if ((conv_pointer = MdcGetImgFLT32(&libmdc_fi, image_num)) == NULL){
-	      g_warning(_("(X)MedCon couldn't convert to a float... out of memory?"));
-	      goto error;
-	    }
-	  } else {
-	    conv_pointer = libmdc_fi.image[image_num].buf;
-	  }
-
-	  /* flip as (X)MedCon stores data from anterior to posterior (top to bottom) */
-	  for (i.y=0; i.y < dim.y; i.y++) {
-	    ds_pointer = amitk_raw_data_get_pointer(AMITK_DATA_SET_RAW_DATA(ds), i);
-	    memcpy(ds_pointer, conv_pointer+bytes_per_row*(dim.y-i.y-1), format_size*ds->raw_data->dim.x);
-	  }
-
-	  /* free up the buffer data */
-	  if (salvage) g_free(conv_pointer);
-	  MdcFree(libmdc_fi.image[image_num].buf);
-	} /* .buf != NULL */
-      } /* i.z */
+    /* MdcGetImgFLT32 isn't known to be reentrant, so salvaged data is
+       converted on this thread */
+    copy.first_plane = plane;
+    amitk_parallel_for(num_planes, salvage ? num_planes : 1, libmdc_copy_planes, &copy);
+    if (copy.failed) {
+      g_warning(_("(X)MedCon couldn't convert to a float... out of memory?"));
+      goto error;
     }
-      
-#ifdef AMIDE_DEBUG
-    g_print("\tduration %5.3f\n", amitk_data_set_get_frame_duration(ds, i.t));
-#endif
-  } /* i.t */    
+  }
 
   if (num_corrupted_planes > 0) 
     g_warning(_("(X)MedCon returned %d blank planes... corrupted data file?  Use data with caution."), num_corrupted_planes);
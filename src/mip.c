@@ -0,0 +1,453 @@
+/* mip.c
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+ 
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+#include "amide_config.h"
+#include <math.h>
+#include <string.h>
+#include <glib.h>
+#include "amide.h"
+#include "mip.h"
+
+gchar * mip_type_name[NUM_MIP_TYPES] = {
+  N_("Maximum Intensity Projection"),
+  N_("Minimum Intensity Projection"),
+  N_("Average Intensity Projection")
+};
+
+/* the per-view stepping, all in voxel coordinates of the data set */
+typedef struct {
+  AmitkPoint origin; /* the first sample of the ray through image pixel (0,0) */
+  AmitkPoint du; /* step to the next image column */
+  AmitkPoint dv; /* step to the next image row */
+  AmitkPoint dray; /* step to the next sample along a ray */
+} mip_view_t;
+
+typedef struct {
+  const mip_t * mip;
+  const mip_view_t * views;
+  gfloat ** images;
+  guint num_steps;
+} mip_project_t;
+
+typedef struct {
+  mip_t * mip;
+  guint first_plane; /* of the current batch */
+  gint start_frame;
+  gint end_frame;
+  gint num_gates;
+  gboolean failed;
+} mip_load_t;
+
+
+mip_t * mip_unref(mip_t * mip) {
+
+  if (mip == NULL) return mip;
+
+  /* sanity checks */
+  g_return_val_if_fail(mip->ref_count > 0, NULL);
+
+  mip->ref_count--;
+
+  /* if we've removed all reference's, free the context */
+  if (mip->ref_count == 0) {
+    if (mip->data_set != NULL) {
+      amitk_object_unref(mip->data_set);
+      mip->data_set = NULL;
+    }
+
+    if (mip->view_space != NULL) {
+      g_object_unref(mip->view_space);
+      mip->view_space = NULL;
+    }
+
+    if (mip->volume != NULL) {
+      g_free(mip->volume);
+      mip->volume = NULL;
+    }
+
+    g_free(mip);
+    mip = NULL;
+  }
+
+  return mip;
+}
+
+
+/* the projection images are square, and big enough to hold the volume at
+   any orientation, so that the image size doesn't change as the view rotates */
+mip_t * mip_init(AmitkDataSet * data_set,
+		 AmitkSpace * view_space,
+		 const mip_type_t type) {
+
+  mip_t * mip;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(data_set), NULL);
+  g_return_val_if_fail(AMITK_IS_SPACE(view_space), NULL);
+
+  if ((mip = g_try_new(mip_t,1)) == NULL) {
+    g_warning(_("couldn't allocate memory space for mip_t"));
+    return NULL;
+  }
+
+  mip->ref_count = 1;
+  mip->data_set = amitk_object_ref(data_set);
+  mip->view_space = amitk_space_copy(view_space);
+  mip->type = type;
+  mip->dim = AMITK_DATA_SET_DIM(data_set);
+  mip->volume = NULL;
+  mip->start = 0.0;
+  mip->duration = 0.0;
+  mip->view_start_gate = 0;
+  mip->view_end_gate = 0;
+
+  mip->diagonal = POINT_MAGNITUDE(AMITK_VOLUME_CORNER(data_set));
+  mip->pixel_size = point_min_dim(AMITK_DATA_SET_VOXEL_SIZE(data_set));
+  mip->image_dim = ceil(mip->diagonal/mip->pixel_size);
+  if (mip->image_dim > MIP_MAX_IMAGE_DIM) {
+    mip->image_dim = MIP_MAX_IMAGE_DIM;
+    mip->pixel_size = mip->diagonal/mip->image_dim;
+  }
+  mip->image_dim += (mip->image_dim & 0x1); /* the movie encoder wants even sizes */
+
+  return mip;
+}
+
+
+/* collapses the frames and gates of planes [start, end) of the current batch
+   into the volume */
+static void load_planes(guint64 start, guint64 end, gpointer data) {
+
+  mip_load_t * l = data;
+  mip_t * mip = l->mip;
+  amide_data_t * plane;
+  gfloat * out;
+  gsize plane_size, i;
+  guint64 i_plane;
+  gint i_frame, i_gate, gate;
+  amide_data_t time_weight;
+  amide_time_t end_time;
+
+  plane_size = ((gsize) mip->dim.x)*mip->dim.y;
+  if ((plane = g_try_new(amide_data_t, plane_size)) == NULL) {
+    l->failed = TRUE;
+    return;
+  }
+  end_time = mip->start+mip->duration;
+
+  for (i_plane = start; i_plane < end; i_plane++) {
+    out = mip->volume + (l->first_plane+i_plane)*plane_size;
+    for (i=0; i<plane_size; i++)
+      out[i] = 0.0;
+
+    for (i_frame = l->start_frame; i_frame <= l->end_frame; i_frame++) {
+      /* weight the frames the same way slices are weighted */
+      if (l->end_frame-l->start_frame > 0) {
+	if (i_frame == l->start_frame)
+	  time_weight = (amitk_data_set_get_end_time(mip->data_set, i_frame)-mip->start)/(mip->duration*l->num_gates);
+	else if (i_frame == l->end_frame)
+	  time_weight = (end_time-amitk_data_set_get_start_time(mip->data_set, i_frame))/(mip->duration*l->num_gates);
+	else
+	  time_weight = amitk_data_set_get_frame_duration(mip->data_set, i_frame)/(mip->duration*l->num_gates);
+      } else
+	time_weight = 1.0/((gdouble) l->num_gates);
+
+      for (i_gate = 0; i_gate < l->num_gates; i_gate++) {
+	gate = (mip->view_start_gate+i_gate) % AMITK_DATA_SET_NUM_GATES(mip->data_set);
+	amitk_data_set_get_plane(mip->data_set, i_frame, gate, l->first_plane+i_plane, plane);
+	for (i=0; i<plane_size; i++)
+	  out[i] += time_weight*plane[i];
+      }
+    }
+  }
+
+  g_free(plane);
+  return;
+}
+
+
+/* extracts the data set over the given time window and its current view gates
+   into a single float volume.  This is only redone if the time window or
+   the gates have changed since the last call. */
+gboolean mip_load(mip_t * mip,
+		  const amide_time_t start,
+		  const amide_time_t duration,
+		  AmitkUpdateFunc update_func,
+		  gpointer update_data) {
+
+  mip_load_t l;
+  guint batch_planes, num_planes;
+  gboolean continue_work=TRUE;
+  gchar * temp_string;
+
+  g_return_val_if_fail(mip != NULL, FALSE);
+
+  if ((mip->volume != NULL) &&
+      REAL_EQUAL(mip->start, start) &&
+      REAL_EQUAL(mip->duration, duration) &&
+      (mip->view_start_gate == AMITK_DATA_SET_VIEW_START_GATE(mip->data_set)) &&
+      (mip->view_end_gate == AMITK_DATA_SET_VIEW_END_GATE(mip->data_set)))
+    return TRUE;
+
+  if (mip->volume == NULL) 
+    if ((mip->volume = g_try_new(gfloat, ((gsize) mip->dim.x)*mip->dim.y*mip->dim.z)) == NULL) {
+      g_warning(_("couldn't allocate memory space for the projection volume, wanted %dx%dx%d elements"),
+		mip->dim.x, mip->dim.y, mip->dim.z);
+      return FALSE;
+    }
+
+  mip->start = start;
+  mip->duration = duration;
+  mip->view_start_gate = AMITK_DATA_SET_VIEW_START_GATE(mip->data_set);
+  mip->view_end_gate = AMITK_DATA_SET_VIEW_END_GATE(mip->data_set);
+
+  l.mip = mip;
+  l.start_frame = amitk_data_set_get_frame(mip->data_set, start+EPSILON);
+  l.end_frame = amitk_data_set_get_frame(mip->data_set, start+duration-EPSILON);
+  l.num_gates = AMITK_DATA_SET_NUM_VIEW_GATES(mip->data_set);
+  l.failed = FALSE;
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Loading %s for projection"), AMITK_OBJECT_NAME(mip->data_set));
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+
+  /* do the planes in batches, so we can keep the progress bar going */
+  batch_planes = MAX(1, MIN(4*amitk_get_num_threads(), mip->dim.z));
+  for (l.first_plane = 0; 
+       (l.first_plane < mip->dim.z) && continue_work && !l.failed; 
+       l.first_plane += num_planes) {
+    num_planes = MIN(batch_planes, mip->dim.z-l.first_plane);
+    amitk_parallel_for(num_planes, 1, load_planes, &l);
+
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL, 
+				     (gdouble) (l.first_plane+num_planes)/mip->dim.z);
+  }
+
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0);
+
+  if (l.failed) 
+    g_warning(_("couldn't allocate memory space for the projection planes"));
+
+  if (l.failed || !continue_work) {
+    g_free(mip->volume);
+    mip->volume = NULL;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
+/* converts a direction in the view space into voxel units of the data set */
+static AmitkPoint view_to_voxel_dir(const mip_t * mip, const AmitkPoint dir) {
+
+  AmitkPoint base_dir;
+  AmitkPoint ds_dir;
+
+  base_dir = point_sub(amitk_space_s2b(mip->view_space, dir),
+		       amitk_space_s2b(mip->view_space, zero_point));
+  ds_dir = point_sub(amitk_space_b2s(AMITK_SPACE(mip->data_set), base_dir),
+		     amitk_space_b2s(AMITK_SPACE(mip->data_set), zero_point));
+
+  return point_div(ds_dir, AMITK_DATA_SET_VOXEL_SIZE(mip->data_set));
+}
+
+/* narrows [*lo, *hi] to the steps k where 0 <= p + k*d < dim along one axis */
+static void clip_axis(const amide_real_t p, const amide_real_t d, const amide_intpoint_t dim,
+		      amide_real_t * lo, amide_real_t * hi) {
+
+  amide_real_t t0, t1, temp;
+
+  if (fabs(d) < EPSILON) {
+    if ((p < 0.0) || (p >= dim)) {
+      *lo = 1.0;
+      *hi = 0.0;
+    }
+    return;
+  }
+
+  t0 = -p/d;
+  t1 = (dim-p)/d;
+  if (t0 > t1) {
+    temp = t0;
+    t0 = t1;
+    t1 = temp;
+  }
+  if (t0 > *lo) *lo = t0;
+  if (t1 < *hi) *hi = t1;
+
+  return;
+}
+
+#define SAMPLE_INSIDE(p, d, k, dim) \
+  (((p).x+(k)*(d).x >= 0.0) && ((p).x+(k)*(d).x < (dim).x) && \
+   ((p).y+(k)*(d).y >= 0.0) && ((p).y+(k)*(d).y < (dim).y) && \
+   ((p).z+(k)*(d).z >= 0.0) && ((p).z+(k)*(d).z < (dim).z))
+
+/* clips a ray against the volume so that every sample in [*k_start, *k_end]
+   lies inside it.  Samples are monotonic in k along each axis, so it's 
+   enough to check the two end points against rounding error. */
+static gboolean clip_ray(const AmitkPoint p, const AmitkPoint d, const AmitkVoxel dim,
+			 const guint num_steps, gint * k_start, gint * k_end) {
+
+  amide_real_t lo = 0.0;
+  amide_real_t hi = num_steps-1;
+
+  clip_axis(p.x, d.x, dim.x, &lo, &hi);
+  clip_axis(p.y, d.y, dim.y, &lo, &hi);
+  clip_axis(p.z, d.z, dim.z, &lo, &hi);
+  if (lo > hi) return FALSE;
+
+  *k_start = ceil(lo);
+  *k_end = floor(hi);
+  while ((*k_start <= *k_end) && !SAMPLE_INSIDE(p, d, *k_start, dim)) (*k_start)++;
+  while ((*k_end >= *k_start) && !SAMPLE_INSIDE(p, d, *k_end, dim)) (*k_end)--;
+
+  return (*k_start <= *k_end);
+}
+
+/* projects rows [start, end), rows are numbered view*image_dim+row */
+static void project_rows(guint64 start, guint64 end, gpointer data) {
+
+  mip_project_t * proj = data;
+  const mip_t * mip = proj->mip;
+  const mip_view_t * view;
+  const gfloat * volume = mip->volume;
+  const AmitkVoxel dim = mip->dim;
+  const gsize plane_size = ((gsize) dim.x)*dim.y;
+  guint64 i_item;
+  guint i_col, row;
+  gfloat * image_row;
+  AmitkPoint p, row_start;
+  AmitkPoint d;
+  gint k, k_start, k_end;
+  gfloat value, accum;
+
+  for (i_item = start; i_item < end; i_item++) {
+    view = &(proj->views[i_item / mip->image_dim]);
+    row = i_item % mip->image_dim;
+    image_row = proj->images[i_item / mip->image_dim] + row*mip->image_dim;
+    d = view->dray;
+    row_start = point_add(view->origin, point_cmult(row, view->dv));
+
+    for (i_col = 0; i_col < mip->image_dim; i_col++) {
+      p = point_add(row_start, point_cmult(i_col, view->du));
+
+      if (!clip_ray(p, d, dim, proj->num_steps, &k_start, &k_end)) {
+	image_row[i_col] = NAN; /* ray misses the volume */
+	continue;
+      }
+
+#define SAMPLE(k) (volume[((gint) (p.x+(k)*d.x)) + \
+			  ((gint) (p.y+(k)*d.y))*dim.x + \
+			  ((gint) (p.z+(k)*d.z))*plane_size])
+
+      accum = SAMPLE(k_start);
+      switch(mip->type) {
+      case MIP_TYPE_MINIMUM:
+	for (k=k_start+1; k <= k_end; k++) {
+	  value = SAMPLE(k);
+	  if (value < accum) accum = value;
+	}
+	break;
+      case MIP_TYPE_AVERAGE:
+	for (k=k_start+1; k <= k_end; k++) 
+	  accum += SAMPLE(k);
+	accum /= (k_end-k_start+1);
+	break;
+      case MIP_TYPE_MAXIMUM:
+      default:
+	for (k=k_start+1; k <= k_end; k++) {
+	  value = SAMPLE(k);
+	  if (value > accum) accum = value;
+	}
+	break;
+      }
+#undef SAMPLE
+
+      image_row[i_col] = accum;
+    }
+  }
+
+  return;
+}
+
+
+/* computes a projection for each of the views.  The rows of each view's axes
+   give, in the view space, the image's horizontal direction, the image's vertical
+   direction, and the direction of the rays.  The views are rotated about the
+   center of the data set.  Each of the images needs to be image_dim x image_dim,
+   and row 0 is the bottom of the image. Pixels whose rays miss the data set are
+   set to NAN. */
+gboolean mip_project(mip_t * mip,
+		     AmitkAxes * views,
+		     const guint num_views,
+		     gfloat ** images) {
+
+  mip_project_t proj;
+  mip_view_t * mip_views;
+  AmitkPoint center;
+  AmitkPoint u, v, ray;
+  amide_real_t half_width;
+  guint i_view;
+
+  g_return_val_if_fail(mip != NULL, FALSE);
+  g_return_val_if_fail(mip->volume != NULL, FALSE);
+
+  if ((mip_views = g_try_new(mip_view_t, num_views)) == NULL) {
+    g_warning(_("couldn't allocate memory space for the projection views"));
+    return FALSE;
+  }
+
+  center.x = mip->dim.x/2.0;
+  center.y = mip->dim.y/2.0;
+  center.z = mip->dim.z/2.0;
+  half_width = (mip->image_dim/2.0-0.5)*mip->pixel_size; /* to the middle of the edge pixels */
+
+  for (i_view = 0; i_view < num_views; i_view++) {
+    u = view_to_voxel_dir(mip, views[i_view][AMITK_AXIS_X]);
+    v = view_to_voxel_dir(mip, views[i_view][AMITK_AXIS_Y]);
+    ray = view_to_voxel_dir(mip, views[i_view][AMITK_AXIS_Z]);
+
+    mip_views[i_view].du = point_cmult(mip->pixel_size, u);
+    mip_views[i_view].dv = point_cmult(mip->pixel_size, v);
+    mip_views[i_view].dray = point_cmult(mip->pixel_size, ray);
+    mip_views[i_view].origin = point_sub(center, point_cmult(half_width, point_add(u, v)));
+    mip_views[i_view].origin = point_sub(mip_views[i_view].origin,
+					 point_cmult(mip->diagonal/2.0, ray));
+  }
+
+  proj.mip = mip;
+  proj.views = mip_views;
+  proj.images = images;
+  proj.num_steps = ceil(mip->diagonal/mip->pixel_size)+1;
+
+  amitk_parallel_for(((guint64) num_views)*mip->image_dim, 4, project_rows, &proj);
+
+  g_free(mip_views);
+
+  return TRUE;
+}
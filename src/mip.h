@@ -0,0 +1,74 @@
+/* mip.h
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+ 
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+#ifndef __MIP_H__
+#define __MIP_H__
+
+/* header files that are always needed with this file */
+#include "amitk_data_set.h"
+
+/* the largest projection image we'll generate in either direction */
+#define MIP_MAX_IMAGE_DIM 1024
+
+typedef enum {
+  MIP_TYPE_MAXIMUM,
+  MIP_TYPE_MINIMUM,
+  MIP_TYPE_AVERAGE,
+  NUM_MIP_TYPES
+} mip_type_t;
+
+/* a projection context for a single data set */
+typedef struct _mip_t {
+  AmitkDataSet * data_set;
+  AmitkSpace * view_space; /* the view axes are given relative to this space */
+  mip_type_t type;
+  AmitkVoxel dim; /* of the volume */
+  gfloat * volume; /* the time/gate averaged data, NULL until loaded */
+  amide_time_t start;
+  amide_time_t duration;
+  gint view_start_gate;
+  gint view_end_gate;
+  amide_real_t pixel_size; /* in mm, both for the image pixels and the ray steps */
+  amide_real_t diagonal; /* length of the volume's diagonal in mm */
+  guint image_dim; /* the projection images are image_dim x image_dim */
+  guint ref_count;
+} mip_t;
+
+extern gchar * mip_type_name[];
+
+/* external functions */
+mip_t * mip_unref(mip_t * mip);
+mip_t * mip_init(AmitkDataSet * data_set,
+		 AmitkSpace * view_space,
+		 const mip_type_t type);
+gboolean mip_load(mip_t * mip,
+		  const amide_time_t start,
+		  const amide_time_t duration,
+		  AmitkUpdateFunc update_func,
+		  gpointer update_data);
+gboolean mip_project(mip_t * mip,
+		     AmitkAxes * views,
+		     const guint num_views,
+		     gfloat ** images);
+
+#endif /* __MIP_H__ */
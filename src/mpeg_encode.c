@@ -45,85 +45,117 @@ typedef struct __yuv_t_ {
 
 
 
-#define RGB_TO_Y(pixels, loc) (0.29900 * pixels[loc] + 0.58700 * pixels[loc+1] + 0.11400 * pixels[loc+2])
-#define RGB_TO_U(pixels, loc)(-0.16874 * pixels[loc] - 0.33126 * pixels[loc+1] + 0.50000 * pixels[loc+2]+128.0)
-#define RGB_TO_V(pixels, loc) (0.50000 * pixels[loc] - 0.41869 * pixels[loc+1] - 0.08131 * pixels[loc+2]+128.0)
+/* BT.601 full range rgb to yuv coefficients, in 16 bit fixed point */
+#define Y_R  19595
+#define Y_G  38470
+#define Y_B   7471
+#define U_R -11059
+#define U_G -21709
+#define U_B  32768
+#define V_R  32768
+#define V_G -27439
+#define V_B  -5329
+
+#define RGB_TO_Y(r,g,b) ((Y_R*(r) + Y_G*(g) + Y_B*(b) + (1<<15)) >> 16)
+/* chroma takes the sum of r, g, and b over a 2x2 block */
+#define RGB_SUM_TO_U(r,g,b) ((U_R*(r) + U_G*(g) + U_B*(b) + (128<<18) + (1<<17)) >> 18)
+#define RGB_SUM_TO_V(r,g,b) ((V_R*(r) + V_G*(g) + V_B*(b) + (128<<18) + (1<<17)) >> 18)
+
+
+/* converts a 2x2 block at (x,y) where some of the pixels may be off the edge
+   of the pixbuf (NULL), these are treated as black */
+static void convert_edge_block(yuv_t * yuv, gint x, gint y, 
+			       guchar * p00, guchar * p01, guchar * p10, guchar * p11) {
+
+  guchar * p[4];
+  gint offset[4];
+  gint r=0, g=0, b=0;
+  gint i;
+
+  p[0] = p00; p[1] = p01; p[2] = p10; p[3] = p11;
+  offset[0] = x+y*yuv->w;
+  offset[1] = offset[0]+1;
+  offset[2] = offset[0]+yuv->w;
+  offset[3] = offset[2]+1;
+
+  for (i=0; i<4; i++) {
+    if (p[i] == NULL) {
+      yuv->y[offset[i]] = 0;
+    } else {
+      yuv->y[offset[i]] = RGB_TO_Y(p[i][0], p[i][1], p[i][2]);
+      r += p[i][0];
+      g += p[i][1];
+      b += p[i][2];
+    }
+  }
 
+  yuv->u[x/2 + y*yuv->w/4] = RGB_SUM_TO_U(r,g,b);
+  yuv->v[x/2 + y*yuv->w/4] = RGB_SUM_TO_V(r,g,b);
 
+  return;
+}
+
+/* integer conversion to YUV420, two rows at a time.  This is used when
+   libswscale isn't available. */
 static void convert_rgb_pixbuf_to_yuv(yuv_t * yuv, GdkPixbuf * pixbuf) {
 
-  gint x, y, location, location2;
-  gint inner_x, inner_y, half_location;
-  gfloat cr, cb;
+  gint x, y;
   gint pixbuf_xsize, pixbuf_ysize;
+  gint even_xsize, even_ysize;
   guchar * pixels;
-  gint row_stride;
-  gboolean x_odd, y_odd;
+  guchar * row0;
+  guchar * row1;
+  guchar * y0;
+  guchar * y1;
+  guchar * u;
+  guchar * v;
+  gint row_stride, n_channels;
+  gint r, g, b;
 
   pixbuf_xsize = gdk_pixbuf_get_width(pixbuf);
   pixbuf_ysize = gdk_pixbuf_get_height(pixbuf);
   pixels = gdk_pixbuf_get_pixels(pixbuf);
   row_stride = gdk_pixbuf_get_rowstride(pixbuf);
+  n_channels = gdk_pixbuf_get_n_channels(pixbuf);
 
-  y_odd = (pixbuf_ysize & 0x1);
-  x_odd = (pixbuf_xsize & 0x1);
+  even_xsize = pixbuf_xsize & ~0x1;
+  even_ysize = pixbuf_ysize & ~0x1;
 
   /* note, the Cr and Cb info is subsampled by 2x2 */
-  for (y=0; y<pixbuf_ysize-1; y+=2) {
-    for (x=0; x<pixbuf_xsize-1; x+=2) {
-      cb = 0.0;
-      cr = 0.0;
-      for (inner_y = y; inner_y < y+2; inner_y++)
-	for (inner_x = x; inner_x < x+2; inner_x++) {
-	  location = inner_y*row_stride+3*inner_x;
-	  yuv->y[inner_x+inner_y*yuv->w] = RGB_TO_Y(pixels, location);
-	  cb += RGB_TO_U(pixels, location);
-	  cr += RGB_TO_V(pixels, location);
-	}
-      half_location = x/2 + y*yuv->w/4;
-      yuv->u[half_location] = cb/4.0;
-      yuv->v[half_location] = cr/4.0;
-    }
-    if (x_odd) {
-      location = y*row_stride+3*x;
-      location2 = (y+1)*row_stride+3*x;
-
-      yuv->y[x+y*yuv->w] = RGB_TO_Y(pixels, location);
-      yuv->y[x+1+y*yuv->w] = 0;
-      yuv->y[x+(y+1)*yuv->w] = RGB_TO_Y(pixels, location2);
-      yuv->y[x+1+(y+1)*yuv->w] = 0;
-
-      half_location = x/2 + y*yuv->w/4;
-      yuv->u[half_location] = (RGB_TO_U(pixels, location)+RGB_TO_U(pixels, location2)+256)/4.0;
-      yuv->v[half_location] = (RGB_TO_V(pixels, location)+RGB_TO_V(pixels, location2)+256)/4.0;
-    }
-  }
-  if (y_odd) {
-    for (x=0; x<pixbuf_xsize-1; x+=2) {
-      location = y*row_stride+3*x;
-      location2 = y*row_stride+3*(x+1);
-
-      yuv->y[x+y*yuv->w] = RGB_TO_Y(pixels, location);
-      yuv->y[x+1+y*yuv->w] = RGB_TO_Y(pixels, location2);
-      yuv->y[x+(y+1)*yuv->w] = 0;
-      yuv->y[x+1+(y+1)*yuv->w] = 0;
-
-      half_location = x/2 + y*yuv->w/4;
-      yuv->u[half_location] = (RGB_TO_U(pixels, location)+RGB_TO_U(pixels, location2)+256)/4.0;
-      yuv->v[half_location] = (RGB_TO_V(pixels, location)+RGB_TO_V(pixels, location2)+256)/4.0;
+  for (y=0; y<even_ysize; y+=2) {
+    row0 = pixels + y*row_stride;
+    row1 = row0 + row_stride;
+    y0 = yuv->y + y*yuv->w;
+    y1 = y0 + yuv->w;
+    u = yuv->u + y*yuv->w/4;
+    v = yuv->v + y*yuv->w/4;
+
+    for (x=0; x<even_xsize; x+=2) {
+      y0[x]   = RGB_TO_Y(row0[0], row0[1], row0[2]);
+      y0[x+1] = RGB_TO_Y(row0[n_channels], row0[n_channels+1], row0[n_channels+2]);
+      y1[x]   = RGB_TO_Y(row1[0], row1[1], row1[2]);
+      y1[x+1] = RGB_TO_Y(row1[n_channels], row1[n_channels+1], row1[n_channels+2]);
+
+      r = row0[0] + row0[n_channels]   + row1[0] + row1[n_channels];
+      g = row0[1] + row0[n_channels+1] + row1[1] + row1[n_channels+1];
+      b = row0[2] + row0[n_channels+2] + row1[2] + row1[n_channels+2];
+      u[x/2] = RGB_SUM_TO_U(r,g,b);
+      v[x/2] = RGB_SUM_TO_V(r,g,b);
+
+      row0 += 2*n_channels;
+      row1 += 2*n_channels;
     }
-    if (x_odd) {
-      location = y*row_stride+3*x;
 
-      yuv->y[x+y*yuv->w] = RGB_TO_Y(pixels, location);
-      yuv->y[x+1+y*yuv->w] = 0;
-      yuv->y[x+(y+1)*yuv->w] = 0;
-      yuv->y[x+1+(y+1)*yuv->w] = 0;
+    if (pixbuf_xsize & 0x1)
+      convert_edge_block(yuv, x, y, row0, NULL, row1, NULL);
+  }
 
-      half_location = x/2 + y*yuv->w/4;
-      yuv->u[half_location] = (RGB_TO_U(pixels, location)+384)/4.0;
-      yuv->v[half_location] = (RGB_TO_V(pixels, location)+384)/4.0;
-    }
+  if (pixbuf_ysize & 0x1) {
+    row0 = pixels + y*row_stride;
+    for (x=0; x<even_xsize; x+=2, row0 += 2*n_channels)
+      convert_edge_block(yuv, x, y, row0, row0+n_channels, NULL, NULL);
+    if (pixbuf_xsize & 0x1)
+      convert_edge_block(yuv, x, y, row0, NULL, NULL, NULL);
   }
 
   return;
@@ -143,6 +175,9 @@ static void convert_rgb_pixbuf_to_yuv(yuv_t * yuv, GdkPixbuf * pixbuf) {
 #ifdef AMIDE_FFMPEG_SUPPORT
 
 #include <libavcodec/avcodec.h>
+#ifdef AMIDE_LIBSWSCALE_SUPPORT
+#include <libswscale/swscale.h>
+#endif
 
 
 
@@ -155,6 +190,9 @@ typedef struct {
   gint output_buffer_size;
   gint size; /* output frame width * height */
   FILE * output_file;
+#ifdef AMIDE_LIBSWSCALE_SUPPORT
+  struct SwsContext * sws_context;
+#endif
 } encode_t;
 
 
@@ -202,6 +240,13 @@ static encode_t * encode_free(encode_t * encode) {
     encode->output_file = NULL;
   }
 
+#ifdef AMIDE_LIBSWSCALE_SUPPORT
+  if (encode->sws_context != NULL) {
+    sws_freeContext(encode->sws_context);
+    encode->sws_context = NULL;
+  }
+#endif
+
   g_free(encode);
 
   return NULL;
@@ -228,7 +273,7 @@ static void mpeg_encoding_init(void) {
 
 
 
-gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsize, gint ysize) {
+static gpointer encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsize, gint ysize) {
 
   encode_t * encode;
   gint codec_type;
@@ -256,6 +301,9 @@ gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsi
   encode->yuv=NULL;
   encode->output_buffer=NULL;
   encode->output_file=NULL;
+#ifdef AMIDE_LIBSWSCALE_SUPPORT
+  encode->sws_context=NULL;
+#endif
 
   /* find the mpeg1 video encoder */
   encode->codec = avcodec_find_encoder(codec_type);
@@ -372,11 +420,54 @@ gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsi
 }
 
 
-gboolean mpeg_encode_frame(gpointer data, GdkPixbuf * pixbuf) {
+#ifdef AMIDE_LIBSWSCALE_SUPPORT
+/* let libswscale do the colour conversion, it has SIMD versions for most platforms */
+static gboolean encode_convert_pixbuf(encode_t * encode, GdkPixbuf * pixbuf) {
+
+  struct SwsContext * sws_context;
+  const uint8_t * src[1];
+  int src_stride[1];
+  gint width, height;
+
+  width = gdk_pixbuf_get_width(pixbuf);
+  height = gdk_pixbuf_get_height(pixbuf);
+
+  sws_context = sws_getCachedContext(encode->sws_context, 
+				     width, height,
+				     gdk_pixbuf_get_has_alpha(pixbuf) ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGB24,
+				     width, height, AV_PIX_FMT_YUV420P,
+				     SWS_AREA, NULL, NULL, NULL);
+  if (sws_context == NULL) {
+    encode->sws_context = NULL;
+    return FALSE;
+  }
+
+  /* match the full range output of convert_rgb_pixbuf_to_yuv, which also averages
+     each 2x2 block for the chroma planes (SWS_AREA above) */
+  if (sws_context != encode->sws_context)
+    sws_setColorspaceDetails(sws_context, 
+			     sws_getCoefficients(SWS_CS_ITU601), 1,
+			     sws_getCoefficients(SWS_CS_ITU601), 1,
+			     0, 1<<16, 1<<16);
+  encode->sws_context = sws_context;
+
+  src[0] = gdk_pixbuf_get_pixels(pixbuf);
+  src_stride[0] = gdk_pixbuf_get_rowstride(pixbuf);
+  sws_scale(encode->sws_context, src, src_stride, 0, height, 
+	    encode->picture->data, encode->picture->linesize);
+
+  return TRUE;
+}
+#endif
+
+static gboolean encode_frame(gpointer data, GdkPixbuf * pixbuf) {
   encode_t * encode = data;
   //  gint out_size;
 
-  convert_rgb_pixbuf_to_yuv(encode->yuv, pixbuf);
+#ifdef AMIDE_LIBSWSCALE_SUPPORT
+  if (!encode_convert_pixbuf(encode, pixbuf))
+#endif
+    convert_rgb_pixbuf_to_yuv(encode->yuv, pixbuf);
 
   /* encode the image */
   //  out_size = avcodec_encode_video(encode->context, encode->output_buffer, encode->output_buffer_size, encode->picture);
@@ -416,7 +507,7 @@ gboolean mpeg_encode_frame(gpointer data, GdkPixbuf * pixbuf) {
 };
 
 /* close everything up */
-gpointer mpeg_encode_close(gpointer data) {
+static void encode_close(gpointer data) {
   encode_t * encode = data;
 
   /* add sequence end code to have a real mpeg file */
@@ -429,7 +520,7 @@ gpointer mpeg_encode_close(gpointer data) {
   /* free encode struct/close out_file */
   encode_free(encode); 
 
-  return NULL;
+  return;
 }
 
 
@@ -519,7 +610,7 @@ static context_t * context_free(context_t * context) {
 
 
 /* setup the mpeg encoding process */
-gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsize, gint ysize) {
+static gpointer encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsize, gint ysize) {
 
   fame_parameters_t default_fame_parameters =  FAME_PARAMETERS_INITIALIZER;
   context_t * context;
@@ -623,7 +714,7 @@ gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsi
 
 
 /* encode a frame of data */
-gboolean mpeg_encode_frame(gpointer data, GdkPixbuf * pixbuf) {
+static gboolean encode_frame(gpointer data, GdkPixbuf * pixbuf) {
   
   context_t * context = data;
   gint length;
@@ -646,12 +737,12 @@ gboolean mpeg_encode_frame(gpointer data, GdkPixbuf * pixbuf) {
 
 
 /* close everything up */
-gpointer mpeg_encode_close(gpointer data) {
+static void encode_close(gpointer data) {
   context_t * context = data;
 
   context_free(context); /* free context */
 
-  return NULL;
+  return;
 }
 
 
@@ -661,3 +752,118 @@ gpointer mpeg_encode_close(gpointer data) {
 
 #endif /* AMIDE_LIBFAME_SUPPORT */
 
+
+
+
+
+/* -------------------------------------------------------- */
+/* ------------- threaded front end, shared --------------- */
+/* -------------------------------------------------------- */
+#if (AMIDE_FFMPEG_SUPPORT || AMIDE_LIBFAME_SUPPORT)
+
+/* how many frames can be waiting on the encoder before mpeg_encode_frame blocks */
+#define MPEG_ENCODE_QUEUE_LENGTH 4
+
+typedef struct {
+  gpointer encoder; /* the library specific context */
+  GThread * thread;
+  GAsyncQueue * frames;
+  GMutex mutex;
+  GCond cond;
+  gint queued; /* frames handed over but not yet encoded */
+  gboolean failed;
+} mpeg_encode_context_t;
+
+static gint end_of_frames; /* pushed on the queue to stop the encoder thread */
+
+/* encoder thread, colour conversion and encoding happen here while the
+   caller goes on to render the next frame */
+static gpointer mpeg_encode_thread(gpointer data) {
+
+  mpeg_encode_context_t * context = data;
+  gpointer frame;
+  gboolean success;
+
+  while ((frame = g_async_queue_pop(context->frames)) != &end_of_frames) {
+    success = encode_frame(context->encoder, GDK_PIXBUF(frame));
+    g_object_unref(frame);
+
+    g_mutex_lock(&context->mutex);
+    if (!success) context->failed = TRUE;
+    context->queued--;
+    g_cond_signal(&context->cond);
+    g_mutex_unlock(&context->mutex);
+  }
+
+  return NULL;
+}
+
+gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsize, gint ysize) {
+
+  mpeg_encode_context_t * context;
+  gpointer encoder;
+
+  encoder = encode_setup(output_filename, type, xsize, ysize);
+  if (encoder == NULL) return NULL;
+
+  context = g_new(mpeg_encode_context_t, 1);
+  context->encoder = encoder;
+  context->frames = g_async_queue_new();
+  g_mutex_init(&context->mutex);
+  g_cond_init(&context->cond);
+  context->queued = 0;
+  context->failed = FALSE;
+  context->thread = g_thread_new("mpeg_encode", mpeg_encode_thread, context);
+
+  return (gpointer) context;
+}
+
+/* hands the frame off to the encoder thread, blocking if the encoder is
+   MPEG_ENCODE_QUEUE_LENGTH frames behind.  The pixbuf is referenced, and
+   must not be modified afterwards.  Returns FALSE if encoding of any
+   frame so far has failed. */
+gboolean mpeg_encode_frame(gpointer data, GdkPixbuf * pixbuf) {
+
+  mpeg_encode_context_t * context = data;
+  gboolean failed;
+
+  g_return_val_if_fail(context != NULL, FALSE);
+  g_return_val_if_fail(GDK_IS_PIXBUF(pixbuf), FALSE);
+
+  g_mutex_lock(&context->mutex);
+  while (context->queued >= MPEG_ENCODE_QUEUE_LENGTH)
+    g_cond_wait(&context->cond, &context->mutex);
+  context->queued++;
+  failed = context->failed;
+  g_mutex_unlock(&context->mutex);
+
+  g_async_queue_push(context->frames, g_object_ref(pixbuf));
+
+  return !failed;
+}
+
+/* waits for the queued frames to be encoded, and closes everything up.
+   Returns FALSE if encoding of any frame failed, which for the last few
+   frames mpeg_encode_frame has no chance to report */
+gboolean mpeg_encode_close(gpointer data) {
+
+  mpeg_encode_context_t * context = data;
+  gboolean failed;
+
+  if (context == NULL) return FALSE;
+
+  g_async_queue_push(context->frames, &end_of_frames);
+  g_thread_join(context->thread);
+  failed = context->failed; /* the thread's done, no need to lock */
+
+  encode_close(context->encoder);
+
+  g_async_queue_unref(context->frames);
+  g_mutex_clear(&context->mutex);
+  g_cond_clear(&context->cond);
+  g_free(context);
+
+  return !failed;
+}
+
+#endif /* AMIDE_FFMPEG_SUPPORT || AMIDE_LIBFAME_SUPPORT */
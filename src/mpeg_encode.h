@@ -42,7 +42,7 @@ typedef enum {
 
 gpointer mpeg_encode_setup(gchar * output_filename, mpeg_encode_t type, gint xsize, gint ysize);
 gboolean mpeg_encode_frame(gpointer mpeg_encode_context, GdkPixbuf * pixbuf);
-gpointer mpeg_encode_close(gpointer mpeg_encode_context);
+gboolean mpeg_encode_close(gpointer mpeg_encode_context);
 
 #endif /* __MPEG_ENCODE_H__ */
 #endif /* AMIDE_FFMPEG_SUPPORT || AMIDE_LIBFAME_SUPPORT */
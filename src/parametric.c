@@ -0,0 +1,417 @@
+/* parametric.c
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+#include "amide_config.h"
+#include <math.h>
+#include <glib.h>
+#include "amide.h"
+#include "parametric.h"
+#include "amitk_data_set_FLOAT_0D_SCALING.h"
+
+/* fits with a denominator smaller than this are considered degenerate */
+#define PARAMETRIC_EPSILON 1e-12
+
+gchar * parametric_model_name[NUM_PARAMETRIC_MODELS] = {
+  N_("Patlak"),
+  N_("Logan"),
+  N_("SRTM")
+};
+
+gchar * parametric_model_explanation[NUM_PARAMETRIC_MODELS] = {
+  N_("Patlak graphical analysis, for tracers that are irreversibly "
+     "trapped. The slope is the net influx rate Ki with a plasma input, "
+     "or Ki relative to the reference region with a reference region input."),
+
+  N_("Logan graphical analysis, for reversibly binding tracers. The slope "
+     "is the total distribution volume with a plasma input, or the "
+     "distribution volume ratio with a reference region input."),
+
+  N_("Simplified reference tissue model, for reversibly binding tracers "
+     "with a reference region input. The linearised model is fitted at "
+     "each voxel, giving the non-displaceable binding potential BPnd.")
+};
+
+gchar * parametric_model_parameter[NUM_PARAMETRIC_MODELS] = {
+  N_("slope"),
+  N_("slope"),
+  N_("BPnd")
+};
+
+typedef struct {
+  const AmitkDataSet * data_set;
+  AmitkDataSet * output_ds;
+  parametric_model_t model;
+  AmitkVoxel dim;
+  gint num_frames;
+  gsize plane_size;
+  guint64 first_plane; /* of the current batch, planes are numbered gate*dim.z+z */
+
+  amide_time_t * start;
+  amide_time_t * end;
+  amide_time_t * midpt;
+  gboolean * use_frame;
+  const amide_data_t * input;
+  amide_data_t * input_integral;
+  amide_data_t patlak_sx, patlak_sxx; /* the patlak x's are the same for every voxel */
+  gint patlak_n;
+  amide_data_t inv_k2_ref;
+
+  gboolean failed;
+} parametric_t;
+
+
+/* the integral of a time activity curve from the start of the first frame up to
+   the midpoint of each frame, taking the values as frame averages, and bridging
+   any gaps between frames linearly */
+static void calc_integral(const parametric_t * p, const amide_data_t * values,
+			  amide_data_t * integral) {
+
+  amide_data_t total=0.0;
+  gint t;
+
+  for (t=0; t<p->num_frames; t++) {
+    if (t > 0)
+      total += 0.5*(values[t-1]+values[t])*(p->start[t]-p->end[t-1]);
+    integral[t] = total + values[t]*(p->midpt[t]-p->start[t]);
+    total += values[t]*(p->end[t]-p->start[t]);
+  }
+
+  return;
+}
+
+
+/* least squares fit of the linearised simplified reference tissue model,
+     C(t) = R1 Cr(t) + k2 int(Cr) - k2a int(C)
+   returns the binding potential, BPnd = k2/k2a - 1 */
+static amide_data_t fit_srtm(const parametric_t * p, const amide_data_t * tac,
+			     amide_data_t * integral) {
+
+  amide_data_t a[3][4]; /* the normal equations, with the right hand side in the last column */
+  amide_data_t x[3], theta[3];
+  amide_data_t temp, factor;
+  gint i, j, k, n, t;
+
+  calc_integral(p, tac, integral);
+  for (i=0; i<3; i++)
+    for (j=0; j<4; j++)
+      a[i][j] = 0.0;
+
+  n = 0;
+  for (t=0; t<p->num_frames; t++) {
+    if (!p->use_frame[t]) continue;
+    x[0] = p->input[t];
+    x[1] = p->input_integral[t];
+    x[2] = -integral[t];
+    for (i=0; i<3; i++) {
+      for (j=0; j<3; j++)
+	a[i][j] += x[i]*x[j];
+      a[i][3] += x[i]*tac[t];
+    }
+    n++;
+  }
+  if ((n < 3) || !finite(a[2][3])) return 0.0;
+
+  /* gaussian elimination with partial pivoting */
+  for (k=0; k<3; k++) {
+    j = k;
+    for (i=k+1; i<3; i++)
+      if (fabs(a[i][k]) > fabs(a[j][k])) j = i;
+    if (fabs(a[j][k]) < PARAMETRIC_EPSILON) return 0.0;
+    if (j != k)
+      for (i=k; i<4; i++) {
+	temp = a[k][i];
+	a[k][i] = a[j][i];
+	a[j][i] = temp;
+      }
+    for (i=k+1; i<3; i++) {
+      factor = a[i][k]/a[k][k];
+      for (j=k; j<4; j++)
+	a[i][j] -= factor*a[k][j];
+    }
+  }
+  for (k=2; k>=0; k--) {
+    theta[k] = a[k][3];
+    for (j=k+1; j<3; j++)
+      theta[k] -= a[k][j]*theta[j];
+    theta[k] /= a[k][k];
+  }
+
+  /* k2a has to be positive for the binding potential to mean anything */
+  if (!(theta[2] > PARAMETRIC_EPSILON)) return 0.0;
+
+  return theta[1]/theta[2] - 1.0;
+}
+
+
+/* fits the model at a voxel over the frames we're using, returns the slope 
+   for the graphical methods, or the binding potential for SRTM */
+static amide_data_t fit_voxel(const parametric_t * p, const amide_data_t * tac,
+			      amide_data_t * integral) {
+
+  amide_data_t sx, sy, sxx, sxy, x, y, denom;
+  gint n, t;
+
+  switch(p->model) {
+  case PARAMETRIC_MODEL_PATLAK:
+    n = p->patlak_n;
+    sx = p->patlak_sx;
+    sxx = p->patlak_sxx;
+    sy = sxy = 0.0;
+    for (t=0; t<p->num_frames; t++) {
+      if (!p->use_frame[t]) continue;
+      y = tac[t]/p->input[t];
+      sy += y;
+      sxy += (p->input_integral[t]/p->input[t])*y;
+    }
+    if (!finite(sy)) return 0.0;
+    break;
+  case PARAMETRIC_MODEL_LOGAN:
+    calc_integral(p, tac, integral);
+    n = 0;
+    sx = sy = sxx = sxy = 0.0;
+    for (t=0; t<p->num_frames; t++) {
+      if ((!p->use_frame[t]) || !(tac[t] > 0.0)) continue;
+      x = (p->input_integral[t] + p->input[t]*p->inv_k2_ref)/tac[t];
+      y = integral[t]/tac[t];
+      n++;
+      sx += x;
+      sy += y;
+      sxx += x*x;
+      sxy += x*y;
+    }
+    if (!finite(sxy)) return 0.0;
+    break;
+  case PARAMETRIC_MODEL_SRTM:
+    return fit_srtm(p, tac, integral);
+  default:
+    g_error("unexpected case in %s at line %d", __FILE__, __LINE__);
+    return 0.0;
+  }
+
+  if (n < 2) return 0.0;
+  denom = n*sxx - sx*sx;
+  if (fabs(denom) < PARAMETRIC_EPSILON) return 0.0;
+
+  return (n*sxy - sx*sy)/denom;
+}
+
+
+/* fits all the voxels in planes [start, end) of the current batch.  Each plane only
+   gets read and written by one thread, so this doesn't need any locking */
+static void fit_planes(guint64 start, guint64 end, gpointer data) {
+
+  parametric_t * p = data;
+  amide_data_t * values;
+  amide_data_t * tac;
+  amide_data_t * integral;
+  amitk_format_FLOAT_t * output;
+  AmitkVoxel i_voxel;
+  guint64 plane;
+  gsize k;
+  gint t;
+
+  values = g_try_new(amide_data_t, p->plane_size*p->num_frames);
+  tac = g_try_new(amide_data_t, p->num_frames);
+  integral = g_try_new(amide_data_t, p->num_frames);
+  if ((values == NULL) || (tac == NULL) || (integral == NULL)) {
+    p->failed = TRUE;
+    goto ending;
+  }
+
+  for (plane=p->first_plane+start; plane<p->first_plane+end; plane++) {
+    i_voxel.g = plane / p->dim.z;
+    i_voxel.z = plane % p->dim.z;
+    i_voxel.x = i_voxel.y = i_voxel.t = 0;
+
+    for (t=0; t<p->num_frames; t++)
+      amitk_data_set_get_plane(p->data_set, t, i_voxel.g, i_voxel.z, values+t*p->plane_size);
+
+    output = AMITK_RAW_DATA_FLOAT_POINTER(AMITK_DATA_SET_RAW_DATA(p->output_ds), i_voxel);
+    for (k=0; k<p->plane_size; k++) {
+      for (t=0; t<p->num_frames; t++)
+	tac[t] = values[t*p->plane_size+k];
+      output[k] = fit_voxel(p, tac, integral);
+    }
+  }
+
+ ending:
+  g_free(values);
+  g_free(tac);
+  g_free(integral);
+
+  return;
+}
+
+
+AmitkDataSet * parametric_calc(AmitkDataSet * data_set,
+			       parametric_model_t model,
+			       const amide_data_t * input,
+			       amide_time_t start_time,
+			       amide_data_t k2_ref,
+			       AmitkUpdateFunc update_func,
+			       gpointer update_data) {
+
+  parametric_t p;
+  AmitkVoxel output_dim;
+  AmitkViewMode i_view_mode;
+  guint64 total_planes, batch_planes, num_planes;
+  gint t, first_frame, last_frame, num_used;
+  amide_data_t x;
+  gchar * temp_string;
+  gboolean continue_work=TRUE;
+
+  g_return_val_if_fail(AMITK_IS_DATA_SET(data_set), NULL);
+  g_return_val_if_fail(input != NULL, NULL);
+
+  p.data_set = data_set;
+  p.output_ds = NULL;
+  p.model = model;
+  p.dim = AMITK_DATA_SET_DIM(data_set);
+  p.num_frames = p.dim.t;
+  p.plane_size = ((gsize) p.dim.x)*((gsize) p.dim.y);
+  p.input = input;
+  p.inv_k2_ref = (k2_ref > 0.0) ? 1.0/k2_ref : 0.0;
+  p.failed = FALSE;
+
+  p.start = g_new(amide_time_t, p.num_frames);
+  p.end = g_new(amide_time_t, p.num_frames);
+  p.midpt = g_new(amide_time_t, p.num_frames);
+  p.use_frame = g_new(gboolean, p.num_frames);
+  p.input_integral = g_new(amide_data_t, p.num_frames);
+
+  /* figure out which frames we're fitting */
+  first_frame = last_frame = -1;
+  num_used = 0;
+  for (t=0; t<p.num_frames; t++) {
+    p.start[t] = amitk_data_set_get_start_time(data_set, t);
+    p.end[t] = amitk_data_set_get_end_time(data_set, t);
+    p.midpt[t] = amitk_data_set_get_midpt_time(data_set, t);
+    p.use_frame[t] = (p.midpt[t] >= start_time) && finite(input[t]);
+    if (model == PARAMETRIC_MODEL_PATLAK) /* patlak divides by the input */
+      p.use_frame[t] = p.use_frame[t] && (input[t] > 0.0);
+    if (p.use_frame[t]) {
+      if (first_frame < 0) first_frame = t;
+      last_frame = t;
+      num_used++;
+    }
+  }
+  calc_integral(&p, input, p.input_integral);
+
+  if ((first_frame < 0) || (first_frame == last_frame)) {
+    g_warning(_("Need at least two frames after the start time with a valid input function"));
+    goto error;
+  }
+
+  /* srtm fits three parameters */
+  if ((model == PARAMETRIC_MODEL_SRTM) && (num_used < 3)) {
+    g_warning(_("Need at least three frames after the start time with a valid input function"));
+    goto error;
+  }
+
+  p.patlak_n = 0;
+  p.patlak_sx = p.patlak_sxx = 0.0;
+  for (t=0; t<p.num_frames; t++)
+    if (p.use_frame[t]) {
+      x = p.input_integral[t]/input[t];
+      p.patlak_n++;
+      p.patlak_sx += x;
+      p.patlak_sxx += x*x;
+    }
+
+  /* setup the output data set */
+  output_dim = p.dim;
+  output_dim.t = 1;
+  p.output_ds = amitk_data_set_new_with_data(NULL, AMITK_DATA_SET_MODALITY(data_set),
+					     AMITK_FORMAT_FLOAT, output_dim, AMITK_SCALING_TYPE_0D);
+  if (p.output_ds == NULL) {
+    g_warning(_("couldn't allocate %" G_GUINT64_FORMAT " MB for the output_ds data set structure"),
+	      amitk_raw_format_calc_num_bytes(output_dim, AMITK_FORMAT_FLOAT)/(1024*1024));
+    goto error;
+  }
+
+  amitk_space_copy_in_place(AMITK_SPACE(p.output_ds), AMITK_SPACE(data_set));
+  amitk_data_set_set_scale_factor(p.output_ds, 1.0);
+  amitk_data_set_set_voxel_size(p.output_ds, AMITK_DATA_SET_VOXEL_SIZE(data_set));
+  amitk_data_set_calc_far_corner(p.output_ds);
+  amitk_data_set_set_scan_start(p.output_ds, p.start[first_frame]);
+  amitk_data_set_set_frame_duration(p.output_ds, 0, p.end[last_frame]-p.start[first_frame]);
+  for (t=0; t<p.dim.g; t++)
+    amitk_data_set_set_gate_time(p.output_ds, t, amitk_data_set_get_gate_time(data_set, t));
+  amitk_data_set_set_interpolation(p.output_ds, AMITK_DATA_SET_INTERPOLATION(data_set));
+
+  for (i_view_mode=0; i_view_mode < AMITK_VIEW_MODE_NUM; i_view_mode++)
+    amitk_data_set_set_color_table(p.output_ds, i_view_mode, AMITK_DATA_SET_COLOR_TABLE(data_set, i_view_mode));
+
+  temp_string = g_strdup_printf(_("%s: %s %s"), AMITK_OBJECT_NAME(data_set),
+				_(parametric_model_name[model]), _(parametric_model_parameter[model]));
+  amitk_object_set_name(AMITK_OBJECT(p.output_ds), temp_string);
+  g_free(temp_string);
+
+  if (update_func != NULL) {
+    temp_string = g_strdup_printf(_("Calculating %s parametric image of:\n   %s"),
+				  _(parametric_model_name[model]), AMITK_OBJECT_NAME(data_set));
+    continue_work = (*update_func)(update_data, temp_string, (gdouble) 0.0);
+    g_free(temp_string);
+  }
+
+  /* do the planes in batches, so we can keep the progress bar going */
+  total_planes = ((guint64) p.dim.g)*((guint64) p.dim.z);
+  batch_planes = MAX(1, MIN(4*amitk_get_num_threads(), total_planes));
+  for (p.first_plane=0; (p.first_plane < total_planes) && continue_work; p.first_plane += num_planes) {
+    num_planes = MIN(batch_planes, total_planes-p.first_plane);
+    amitk_parallel_for(num_planes, 1, fit_planes, &p);
+    if (p.failed) {
+      g_warning(_("failed to allocate memory for the parametric fit"));
+      goto error;
+    }
+
+    if (update_func != NULL)
+      continue_work = (*update_func)(update_data, NULL,
+				     ((gdouble) (p.first_plane+num_planes))/((gdouble) total_planes));
+  }
+  if (!continue_work) goto error;
+
+  amitk_data_set_calc_min_max(p.output_ds, NULL, NULL);
+  amitk_data_set_set_threshold_max(p.output_ds, 0, amitk_data_set_get_global_max(p.output_ds));
+  amitk_data_set_set_threshold_min(p.output_ds, 0, amitk_data_set_get_global_min(p.output_ds));
+
+  goto exit;
+
+ error:
+  if (p.output_ds != NULL) {
+    amitk_object_unref(p.output_ds);
+    p.output_ds = NULL;
+  }
+
+ exit:
+  g_free(p.start);
+  g_free(p.end);
+  g_free(p.midpt);
+  g_free(p.use_frame);
+  g_free(p.input_integral);
+
+  if (update_func != NULL) /* remove progress bar */
+    (*update_func)(update_data, NULL, (gdouble) 2.0);
+
+  return p.output_ds;
+}
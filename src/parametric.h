@@ -0,0 +1,54 @@
+/* parametric.h
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+#ifndef __PARAMETRIC_H__
+#define __PARAMETRIC_H__
+
+/* header files that are always needed with this file */
+#include "amitk_data_set.h"
+
+typedef enum {
+  PARAMETRIC_MODEL_PATLAK,
+  PARAMETRIC_MODEL_LOGAN,
+  PARAMETRIC_MODEL_SRTM,
+  NUM_PARAMETRIC_MODELS
+} parametric_model_t;
+
+extern gchar * parametric_model_name[];
+extern gchar * parametric_model_explanation[];
+extern gchar * parametric_model_parameter[];
+
+/* input is the input function (plasma or reference region), one value per frame of
+   the data set, SRTM needs a reference region.  Frames whose midpoint is before 
+   start_time are not used in the fit.  k2_ref is only used by Logan with a reference
+   region input, and should be 0.0 for a plasma input.  Returns a single frame data
+   set of the fitted parameter, the caller is responsible for unref'ing it */
+AmitkDataSet * parametric_calc(AmitkDataSet * data_set,
+			       parametric_model_t model,
+			       const amide_data_t * input,
+			       amide_time_t start_time,
+			       amide_data_t k2_ref,
+			       AmitkUpdateFunc update_func,
+			       gpointer update_data);
+
+#endif /* __PARAMETRIC_H__ */
@@ -63,7 +63,7 @@ static void change_modality_cb(GtkWidget * widget, gpointer data);
 static void change_raw_format_cb(GtkWidget * widget, gpointer data);
 
 
-static guint update_num_bytes(raw_data_info_t * raw_data_info);
+static guint64 update_num_bytes(raw_data_info_t * raw_data_info);
 static void read_last_values(AmitkModality * plast_modality,
 			     AmitkRawFormat * plast_raw_format,
 			     AmitkVoxel * plast_data_dim,
@@ -246,19 +246,21 @@ static void update_offset_label(raw_data_info_t * raw_data_info) {
 }
 
 /* calculate the total amount of the file that will be read through */
-static guint update_num_bytes(raw_data_info_t * raw_data_info) {
+static guint64 update_num_bytes(raw_data_info_t * raw_data_info) {
 
-  gsize num_bytes;
-  guint num_entries;
+  guint64 num_bytes;
+  guint64 num_entries;
   gchar * temp_string;
   
   /* how many bytes we're currently reading from the file */
   if (raw_data_info->raw_format == AMITK_RAW_FORMAT_ASCII_8_NE) {
     num_entries = raw_data_info->offset + 
-      raw_data_info->data_dim.x*raw_data_info->data_dim.y*raw_data_info->data_dim.z*raw_data_info->data_dim.g*raw_data_info->data_dim.t;
+      ((guint64) raw_data_info->data_dim.x)*((guint64) raw_data_info->data_dim.y)*
+      ((guint64) raw_data_info->data_dim.z)*((guint64) raw_data_info->data_dim.g)*
+      ((guint64) raw_data_info->data_dim.t);
     gtk_label_set_text(GTK_LABEL(raw_data_info->num_bytes_label1), 
 		       _("total entries to read through:"));
-    temp_string = g_strdup_printf("%d",num_entries);
+    temp_string = g_strdup_printf("%" G_GUINT64_FORMAT, num_entries);
     gtk_label_set_text(GTK_LABEL(raw_data_info->num_bytes_label2), temp_string);
     g_free(temp_string);
 
@@ -273,7 +275,7 @@ static guint update_num_bytes(raw_data_info_t * raw_data_info) {
 				      raw_data_info->raw_format);
     gtk_label_set_text(GTK_LABEL(raw_data_info->num_bytes_label1), 
 		       _("total bytes to read through:"));
-    temp_string = g_strdup_printf("%lu",num_bytes);
+    temp_string = g_strdup_printf("%" G_GUINT64_FORMAT, num_bytes);
     gtk_label_set_text(GTK_LABEL(raw_data_info->num_bytes_label2), temp_string);
     g_free(temp_string);
   }
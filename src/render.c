@@ -29,6 +29,7 @@
 
 #include <glib.h>
 #include <stdlib.h>
+#include <string.h>
 #include "render.h"
 #include "amitk_roi.h"
 #include "amitk_data_set_DOUBLE_0D_SCALING.h"
@@ -56,6 +57,22 @@ gchar * pixel_type_names[] = {
 
 rendering_voxel_t * dummy_voxel;
 
+/* drops the right eye's context, it gets rebuilt the next time it's needed */
+static void rendering_free_eye(rendering_t * rendering) {
+
+  if (rendering->eye_vpc != NULL) {
+    vpDestroyContext(rendering->eye_vpc);
+    rendering->eye_vpc = NULL;
+  }
+
+  if (rendering->eye_image != NULL) {
+    g_free(rendering->eye_image);
+    rendering->eye_image = NULL;
+  }
+
+  return;
+}
+
 rendering_t * rendering_unref(rendering_t * rendering) {
   
   classification_t i_class;
@@ -90,6 +107,8 @@ rendering_t * rendering_unref(rendering_t * rendering) {
       rendering->name = NULL;
     }
 
+    rendering_free_eye(rendering);
+
     if (rendering->vpc != NULL) {
       vpDestroyContext(rendering->vpc);
       rendering->vpc = NULL;
@@ -125,6 +144,61 @@ rendering_t * rendering_unref(rendering_t * rendering) {
 
 
 
+/* tells a volpack context about our voxel structure and classification tables */
+static gboolean rendering_setup_context(rendering_t * rendering, vpContext * vpc) {
+
+  /* tell the rendering context info on the voxel structure */
+  if (vpSetVoxelSize(vpc,  RENDERING_BYTES_PER_VOXEL, RENDERING_VOXEL_FIELDS, 
+		     RENDERING_SHADE_FIELDS, RENDERING_CLSFY_FIELDS) != VP_OK) {
+    g_warning(_("Error Setting the Rendering Voxel Size (%s): %s"), 
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
+    return FALSE;
+  }
+
+  /* now tell the rendering context the location of each field in voxel, 
+     do this for each field in the context */
+  if (vpSetVoxelField (vpc,RENDERING_NORMAL_FIELD, RENDERING_NORMAL_SIZE, 
+		       RENDERING_NORMAL_OFFSET, RENDERING_NORMAL_MAX) != VP_OK) {
+    g_warning(_("Error Specifying the Rendering Voxel Fields (%s, NORMAL): %s"), 
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
+    return FALSE;
+  }
+  if (vpSetVoxelField (vpc,RENDERING_DENSITY_FIELD, RENDERING_DENSITY_SIZE, 
+		       RENDERING_DENSITY_OFFSET, RENDERING_DENSITY_MAX) != VP_OK) {
+    g_warning(_("Error Specifying the Rendering Voxel Fields (%s, DENSITY): %s"), 
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
+    return FALSE;
+  }
+
+  if (vpSetVoxelField (vpc,RENDERING_GRADIENT_FIELD, RENDERING_GRADIENT_SIZE, 
+		       RENDERING_GRADIENT_OFFSET, RENDERING_GRADIENT_MAX) != VP_OK) {
+    g_warning(_("Error Specifying the Rendering Voxel Fields (%s, GRADIENT): %s"),
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
+    return FALSE;
+  }
+
+  /* apply density classification to the vpc */
+  if (vpSetClassifierTable(vpc, RENDERING_DENSITY_PARAM, RENDERING_DENSITY_FIELD, 
+			   rendering->density_ramp,
+			   sizeof(rendering->density_ramp)) != VP_OK){
+    g_warning(_("Error Setting the Rendering Classifier Table (%s, DENSITY): %s"),
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
+    return FALSE;
+  }
+
+  /* apply it to the different vpc's */
+  if (vpSetClassifierTable(vpc, RENDERING_GRADIENT_PARAM, RENDERING_GRADIENT_FIELD, 
+			   rendering->gradient_ramp,
+			   sizeof(rendering->gradient_ramp)) != VP_OK){
+    g_warning(_("Error Setting the Classifier Table (%s, GRADIENT): %s"),
+	      rendering->name,  vpGetErrorString(vpGetError(vpc)));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+
 /* either volume or object must be NULL */
 rendering_t * rendering_init(const AmitkObject * object,
 			     AmitkVolume * rendering_volume,
@@ -155,6 +229,14 @@ rendering_t * rendering_init(const AmitkObject * object,
   new_rendering->ref_count = 1;
   new_rendering->need_rerender = TRUE;
   new_rendering->need_reclassify = TRUE;
+  new_rendering->quality = RENDERING_DEFAULT_QUALITY;
+  new_rendering->depth_cueing = RENDERING_DEFAULT_DEPTH_CUEING;
+  new_rendering->front_factor = RENDERING_DEFAULT_FRONT_FACTOR;
+  new_rendering->density = RENDERING_DEFAULT_DENSITY;
+  new_rendering->image_dim = 0;
+  new_rendering->eye_vpc = NULL;
+  new_rendering->eye_image = NULL;
+  new_rendering->eye_need_reclassify = TRUE;
   
   /* start initializing what we can */
   new_rendering->vpc = vpCreateContext();
@@ -268,56 +350,8 @@ rendering_t * rendering_init(const AmitkObject * object,
     return new_rendering;
   }
 
-  /* tell the rendering context info on the voxel structure */
-  if (vpSetVoxelSize(new_rendering->vpc,  RENDERING_BYTES_PER_VOXEL, RENDERING_VOXEL_FIELDS, 
-		     RENDERING_SHADE_FIELDS, RENDERING_CLSFY_FIELDS) != VP_OK) {
-    g_warning(_("Error Setting the Rendering Voxel Size (%s): %s"), 
-	      new_rendering->name, vpGetErrorString(vpGetError(new_rendering->vpc)));
-    new_rendering = rendering_unref(new_rendering);
-    return new_rendering;
-  }
-
-  /* now tell the rendering context the location of each field in voxel, 
-     do this for each field in the context */
-  if (vpSetVoxelField (new_rendering->vpc,RENDERING_NORMAL_FIELD, RENDERING_NORMAL_SIZE, 
-		       RENDERING_NORMAL_OFFSET, RENDERING_NORMAL_MAX) != VP_OK) {
-    g_warning(_("Error Specifying the Rendering Voxel Fields (%s, NORMAL): %s"), 
-	      new_rendering->name, vpGetErrorString(vpGetError(new_rendering->vpc)));
-    new_rendering = rendering_unref(new_rendering);
-    return new_rendering;
-  }
-  if (vpSetVoxelField (new_rendering->vpc,RENDERING_DENSITY_FIELD, RENDERING_DENSITY_SIZE, 
-		       RENDERING_DENSITY_OFFSET, RENDERING_DENSITY_MAX) != VP_OK) {
-    g_warning(_("Error Specifying the Rendering Voxel Fields (%s, DENSITY): %s"), 
-	      new_rendering->name, vpGetErrorString(vpGetError(new_rendering->vpc)));
-    new_rendering = rendering_unref(new_rendering);
-    return new_rendering;
-  }
-
-  if (vpSetVoxelField (new_rendering->vpc,RENDERING_GRADIENT_FIELD, RENDERING_GRADIENT_SIZE, 
-		       RENDERING_GRADIENT_OFFSET, RENDERING_GRADIENT_MAX) != VP_OK) {
-    g_warning(_("Error Specifying the Rendering Voxel Fields (%s, GRADIENT): %s"),
-	      new_rendering->name, vpGetErrorString(vpGetError(new_rendering->vpc)));
-    new_rendering = rendering_unref(new_rendering);
-    return new_rendering;
-  }
-
-  /* apply density classification to the vpc */
-  if (vpSetClassifierTable(new_rendering->vpc, RENDERING_DENSITY_PARAM, RENDERING_DENSITY_FIELD, 
-			   new_rendering->density_ramp,
-			   sizeof(new_rendering->density_ramp)) != VP_OK){
-    g_warning(_("Error Setting the Rendering Classifier Table (%s, DENSITY): %s"),
-	      new_rendering->name, vpGetErrorString(vpGetError(new_rendering->vpc)));
-    new_rendering = rendering_unref(new_rendering);
-    return new_rendering;
-  }
-
-  /* apply it to the different vpc's */
-  if (vpSetClassifierTable(new_rendering->vpc, RENDERING_GRADIENT_PARAM, RENDERING_GRADIENT_FIELD, 
-			   new_rendering->gradient_ramp,
-			   sizeof(new_rendering->gradient_ramp)) != VP_OK){
-    g_warning(_("Error Setting the Classifier Table (%s, GRADIENT): %s"),
-	      new_rendering->name,  vpGetErrorString(vpGetError(new_rendering->vpc)));
+  /* tell the rendering context about our voxels and classification */
+  if (!rendering_setup_context(new_rendering, new_rendering->vpc)) {
     new_rendering = rendering_unref(new_rendering);
     return new_rendering;
   }
@@ -335,12 +369,11 @@ rendering_t * rendering_init(const AmitkObject * object,
 }
 
 
-/* function to reload the rendering context's concept of an object when necessary */
-gboolean rendering_reload_object(rendering_t * rendering, 
-				 const amide_time_t new_start,
-				 const amide_time_t new_duration,
-				 AmitkUpdateFunc update_func,
-				 gpointer update_data) {
+/* updates the time frame of the rendering context, returns TRUE if the 
+   context's concept of the object needs to be reloaded */
+static gboolean rendering_set_time(rendering_t * rendering, 
+				   const amide_time_t new_start,
+				   const amide_time_t new_duration) {
   
   amide_time_t old_start, old_duration;
   guint frame;
@@ -354,10 +387,10 @@ gboolean rendering_reload_object(rendering_t * rendering,
 
   /* only need to do stuff for dynamic data sets */
   if (!AMITK_IS_DATA_SET(rendering->object))
-    return TRUE;
+    return FALSE;
 
   if (!(AMITK_DATA_SET_DYNAMIC(rendering->object) || AMITK_DATA_SET_GATED(rendering->object)))
-    return TRUE;
+    return FALSE;
 
   // changed as of 0.8.12 -- delete when sure everything works
   //  if (amitk_data_set_get_frame(AMITK_DATA_SET(rendering->object), new_start) == 
@@ -373,15 +406,28 @@ gboolean rendering_reload_object(rendering_t * rendering,
       (REAL_EQUAL(new_start, old_start) && REAL_EQUAL(new_duration, old_duration)))
     if (AMITK_DATA_SET_VIEW_START_GATE(rendering->object) == rendering->view_start_gate)
       if (AMITK_DATA_SET_VIEW_END_GATE(rendering->object) == rendering->view_end_gate)
-	return TRUE;
+	return FALSE;
 
   rendering->view_start_gate = AMITK_DATA_SET_VIEW_START_GATE(rendering->object);
   rendering->view_end_gate = AMITK_DATA_SET_VIEW_END_GATE(rendering->object);
 
-  /* allright, reload the rendering context's data */
+  /* allright, the rendering context's data needs reloading */
   rendering->need_rerender = TRUE;
   rendering->need_reclassify = TRUE; 
 
+  return TRUE;
+}
+
+/* function to reload the rendering context's concept of an object when necessary */
+gboolean rendering_reload_object(rendering_t * rendering, 
+				 const amide_time_t new_start,
+				 const amide_time_t new_duration,
+				 AmitkUpdateFunc update_func,
+				 gpointer update_data) {
+
+  if (!rendering_set_time(rendering, new_start, new_duration))
+    return TRUE;
+
   return rendering_load_object(rendering, update_func, update_data);
 }
 
@@ -410,6 +456,8 @@ gboolean rendering_load_object(rendering_t * rendering,
   gettimeofday(&tv1, NULL);
 #endif
 
+  /* the right eye's context points at the voxels we're about to replace */
+  rendering_free_eye(rendering);
 
   /* tell the volpack context the dimensions of our rendering context */
   if (vpSetVolumeSize(rendering->vpc, rendering->dim.x, 
@@ -750,7 +798,7 @@ gboolean rendering_load_object(rendering_t * rendering,
 
 
 
-static void set_space(rendering_t * rendering) {
+static void set_context_space(rendering_t * rendering, vpContext * vpc, AmitkSpace * space) {
 
   vpMatrix4 m; 
   guint i,j;
@@ -766,22 +814,26 @@ static void set_space(rendering_t * rendering) {
 
   /* and setup the matrix we're feeding into volpack */
   for (i=0;i<3;i++) {
-    axis = amitk_space_get_axis(AMITK_SPACE(rendering->transformed_volume), i);
+    axis = amitk_space_get_axis(space, i);
     m[i][0] = axis.x;
     m[i][1] = axis.y;
     m[i][2] = axis.z;
   }
 
   /* we want to rotate the data set */
-  if (vpCurrentMatrix(rendering->vpc, VP_MODEL) != VP_OK)
+  if (vpCurrentMatrix(vpc, VP_MODEL) != VP_OK)
     g_warning(_("Error Setting The Item To Rotate (%s): %s"),
-	      rendering->name, vpGetErrorString(vpGetError(rendering->vpc)));
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
 
   /* set the rotation */
-  if (vpSetMatrix(rendering->vpc, m) != VP_OK)
+  if (vpSetMatrix(vpc, m) != VP_OK)
     g_warning(_("Error Rotating Rendering (%s): %s"),
-	      rendering->name, vpGetErrorString(vpGetError(rendering->vpc)));
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
+
+}
 
+static void set_space(rendering_t * rendering) {
+  set_context_space(rendering, rendering->vpc, AMITK_SPACE(rendering->transformed_volume));
 }
 
 /* set the rotation space for a rendering context */
@@ -825,15 +877,12 @@ void rendering_reset_rotation(rendering_t * rendering) {
 }
 
 
-/* set the speed versus quality parameters of a rendering context */
-void rendering_set_quality(rendering_t * rendering, rendering_quality_t quality) {
+static void set_context_quality(rendering_t * rendering, vpContext * vpc) {
 
   gdouble max_ray_opacity, min_voxel_opacity;
 
-  rendering->need_rerender = TRUE;
-
   /* set the rendering speed parameters MAX_RAY_OPACITY and MIN_VOXEL_OPACITY*/
-  switch (quality) {
+  switch (rendering->quality) {
   case HIGH:
     max_ray_opacity = 0.99;
     min_voxel_opacity = 0.01;
@@ -856,17 +905,28 @@ void rendering_set_quality(rendering_t * rendering, rendering_quality_t quality)
 
 
   /* set the maximum ray opacity (the renderer quits follow a ray if this value is reached */
-  if (vpSetd(rendering->vpc, VP_MAX_RAY_OPACITY, max_ray_opacity) != VP_OK){
+  if (vpSetd(vpc, VP_MAX_RAY_OPACITY, max_ray_opacity) != VP_OK){
     g_warning(_("Error Setting Rendering Max Ray Opacity (%s): %s"),
-	      rendering->name, vpGetErrorString(vpGetError(rendering->vpc)));
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
   }
 
   /* set the minimum voxel opacity (the render ignores voxels with values below this*/
-  if (vpSetd(rendering->vpc, VP_MIN_VOXEL_OPACITY, min_voxel_opacity) != VP_OK) {
+  if (vpSetd(vpc, VP_MIN_VOXEL_OPACITY, min_voxel_opacity) != VP_OK) {
     g_warning(_("Error Setting the Min Voxel Opacity (%s): %s"), 
-	      rendering->name, vpGetErrorString(vpGetError(rendering->vpc)));
+	      rendering->name, vpGetErrorString(vpGetError(vpc)));
   }
 
+  return;
+}
+
+/* set the speed versus quality parameters of a rendering context */
+void rendering_set_quality(rendering_t * rendering, rendering_quality_t quality) {
+
+  rendering->need_rerender = TRUE;
+  rendering->quality = quality;
+  set_context_quality(rendering, rendering->vpc);
+  rendering_free_eye(rendering);
+
   rendering->need_reclassify = TRUE; 
 
   return;
@@ -890,6 +950,7 @@ void rendering_set_image(rendering_t * rendering, pixel_type_t pixel_type, gdoub
     break;
   }
   size_dim = ceil(zoom*POINT_MAX(rendering->dim));
+  rendering_free_eye(rendering);
   g_free(rendering->image);
   if ((rendering->image = g_try_new(guchar,size_dim*size_dim)) == NULL) {
     g_warning(_("Could not allocate memory space for Rendering Image for %s"), 
@@ -898,6 +959,7 @@ void rendering_set_image(rendering_t * rendering, pixel_type_t pixel_type, gdoub
   }
 
   rendering->pixel_type = pixel_type;
+  rendering->image_dim = size_dim;
   if (vpSetImage(rendering->vpc, (guchar *) rendering->image, size_dim,
 		 size_dim, size_dim* RENDERING_DENSITY_SIZE, volpack_pixel_type)) {
     g_warning(_("Error Switching the Rendering Image Pixel Return Type (%s): %s"),
@@ -910,6 +972,8 @@ void rendering_set_image(rendering_t * rendering, pixel_type_t pixel_type, gdoub
 void rendering_set_depth_cueing(rendering_t * rendering, gboolean state) {
 
   rendering->need_rerender = TRUE;
+  rendering->depth_cueing = state;
+  rendering_free_eye(rendering);
 
   if (vpEnable(rendering->vpc, VP_DEPTH_CUE, state) != VP_OK) {
       g_warning(_("Error Setting the Rendering Depth Cue (%s): %s"),
@@ -926,6 +990,9 @@ void rendering_set_depth_cueing_parameters(rendering_t * rendering,
 					   gdouble front_factor, gdouble density) {
 
   rendering->need_rerender = TRUE;
+  rendering->front_factor = front_factor;
+  rendering->density = density;
+  rendering_free_eye(rendering);
 
   /* the defaults should be 1.0 and 1.0 */
   if (vpSetDepthCueing(rendering->vpc, front_factor, density) != VP_OK){
@@ -937,6 +1004,36 @@ void rendering_set_depth_cueing_parameters(rendering_t * rendering,
 }
 
 
+/* renders one of the rendering context's volpack contexts */
+static gboolean render_context(rendering_t * rendering, vpContext * vpc, gboolean reclassify) {
+
+  if (rendering->optimize_rendering) {
+    if (reclassify) {
+#if AMIDE_DEBUG
+      g_print("\tClassifying\n");
+#endif
+      if (vpClassifyVolume(vpc) != VP_OK) {
+	g_warning(_("Error Classifying the Volume (%s): %s"),
+		  rendering->name,vpGetErrorString(vpGetError(vpc))); 
+	return FALSE; 
+      }
+    }
+    if (vpRenderClassifiedVolume(vpc) != VP_OK) {
+      g_warning(_("Error Rendering the Classified Volume (%s): %s"), 
+		rendering->name, vpGetErrorString(vpGetError(vpc)));
+      return FALSE;
+    }
+  } else {
+    if (vpRenderRawVolume(vpc) != VP_OK) {
+      g_warning(_("Error Rendering the Volume (%s): %s"), 
+		rendering->name, vpGetErrorString(vpGetError(vpc)));
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
 /* to render a rendering context... */
 void rendering_render(rendering_t * rendering)
 {
@@ -951,33 +1048,10 @@ void rendering_render(rendering_t * rendering)
   gettimeofday(&tv1, NULL);
 #endif
 
-  if (rendering->need_rerender) {
-    if (rendering->vpc != NULL) {
-      if (rendering->optimize_rendering) {
-	if (rendering->need_reclassify) {
-#if AMIDE_DEBUG
-	  g_print("\tClassifying\n");
-#endif
-	  if (vpClassifyVolume(rendering->vpc) != VP_OK) {
-	    g_warning(_("Error Classifying the Volume (%s): %s"),
-		      rendering->name,vpGetErrorString(vpGetError(rendering->vpc))); 
-	    return; 
-	  }
-	}
-	if (vpRenderClassifiedVolume(rendering->vpc) != VP_OK) {
-	  g_warning(_("Error Rendering the Classified Volume (%s): %s"), 
-		    rendering->name, vpGetErrorString(vpGetError(rendering->vpc)));
-	  return;
-	}
-      } else {
-	if (vpRenderRawVolume(rendering->vpc) != VP_OK) {
-	  g_warning(_("Error Rendering the Volume (%s): %s"), 
-		    rendering->name, vpGetErrorString(vpGetError(rendering->vpc)));
-	  return;
-	}
-      }
-    }
-  }
+  if (rendering->need_rerender) 
+    if (rendering->vpc != NULL) 
+      if (!render_context(rendering, rendering->vpc, rendering->need_reclassify))
+	return;
 
 #ifdef AMIDE_COMMENT_OUT
  /* and wrapup our timing */
@@ -996,6 +1070,87 @@ void rendering_render(rendering_t * rendering)
 }
 
 
+/* sets up a second volpack context for the right eye, sharing the voxels,
+   classification and shading tables of the main context, so that the two
+   eyes of a stereo pair can be rendered at the same time */
+static gboolean rendering_init_eye(rendering_t * rendering) {
+
+  guint context_size;
+  guint volpack_pixel_type;
+
+  if (rendering->eye_vpc != NULL) return TRUE;
+  if ((rendering->vpc == NULL) || (rendering->rendering_data == NULL)) return FALSE;
+
+  rendering->eye_vpc = vpCreateContext();
+  rendering->eye_need_reclassify = TRUE;
+
+  if (!rendering_setup_context(rendering, rendering->eye_vpc)) 
+    goto error;
+
+  if (vpSetVolumeSize(rendering->eye_vpc, rendering->dim.x, 
+		      rendering->dim.y, rendering->dim.z) != VP_OK) {
+    g_warning(_("Error Setting the Context Size (%s): %s"), 
+	      rendering->name, vpGetErrorString(vpGetError(rendering->eye_vpc)));
+    goto error;
+  }
+
+  context_size =  rendering->dim.x *  rendering->dim.y * 
+     rendering->dim.z * RENDERING_BYTES_PER_VOXEL;
+  vpSetRawVoxels(rendering->eye_vpc, rendering->rendering_data, context_size, 
+		 RENDERING_BYTES_PER_VOXEL,  rendering->dim.x * RENDERING_BYTES_PER_VOXEL,
+		 rendering->dim.x* rendering->dim.y * RENDERING_BYTES_PER_VOXEL);
+
+  if (rendering->optimize_rendering) { 
+    if ((vpMinMaxOctreeThreshold(rendering->eye_vpc, RENDERING_DENSITY_PARAM, 
+				 RENDERING_OCTREE_DENSITY_THRESH) != VP_OK) ||
+	(vpMinMaxOctreeThreshold(rendering->eye_vpc, RENDERING_GRADIENT_PARAM, 
+				 RENDERING_OCTREE_GRADIENT_THRESH) != VP_OK) ||
+	(vpCreateMinMaxOctree(rendering->eye_vpc, 0, RENDERING_OCTREE_BASE_NODE_SIZE) != VP_OK)) {
+      g_warning(_("Error Generating Octree (%s): %s"), rendering->name, 
+		vpGetErrorString(vpGetError(rendering->eye_vpc)));
+      goto error;
+    }
+  }
+
+  /* the shade table was already filled in by the main context */
+  if ((vpSetMaterial(rendering->eye_vpc, VP_MATERIAL0, VP_SHINYNESS, VP_BOTH_SIDES,0.0,0.0,0.0) != VP_OK) ||
+      (vpSetLookupShader(rendering->eye_vpc, 1, 1, RENDERING_NORMAL_FIELD, 
+			 rendering->shade_table, sizeof(rendering->shade_table), 
+			 0, NULL, 0) != VP_OK)) {
+    g_warning(_("Error Setting the Rendering Shader (%s): %s"),
+	      rendering->name, vpGetErrorString(vpGetError(rendering->eye_vpc)));
+    goto error;
+  }
+
+  set_context_quality(rendering, rendering->eye_vpc);
+
+  if ((vpEnable(rendering->eye_vpc, VP_DEPTH_CUE, rendering->depth_cueing) != VP_OK) ||
+      (vpSetDepthCueing(rendering->eye_vpc, rendering->front_factor, rendering->density) != VP_OK)) {
+    g_warning(_("Error Enabling Rendering Depth Cueing (%s): %s"),
+	      rendering->name, vpGetErrorString(vpGetError(rendering->eye_vpc)));
+    goto error;
+  }
+
+  if ((rendering->eye_image = g_try_new(guchar,rendering->image_dim*rendering->image_dim)) == NULL) {
+    g_warning(_("Could not allocate memory space for Rendering Image for %s"), 
+	      rendering->name);
+    goto error;
+  }
+  volpack_pixel_type = (rendering->pixel_type == GRAYSCALE) ? VP_LUMINANCE : VP_ALPHA;
+  if (vpSetImage(rendering->eye_vpc, rendering->eye_image, rendering->image_dim,
+		 rendering->image_dim, rendering->image_dim* RENDERING_DENSITY_SIZE, 
+		 volpack_pixel_type)) {
+    g_warning(_("Error Switching the Rendering Image Pixel Return Type (%s): %s"),
+	      rendering->name, vpGetErrorString(vpGetError(rendering->eye_vpc)));
+    goto error;
+  }
+
+  return TRUE;
+
+ error:
+  rendering_free_eye(rendering);
+  return FALSE;
+}
 
 
 
@@ -1146,6 +1301,42 @@ renderings_t * renderings_init(GList * objects,const amide_time_t start, const a
 }
 
 
+/* the volpack contexts in a rendering list are independent of each other, 
+   so the per-context work is spread over threads, one context (or for 
+   stereo, one eye of a context) per task */
+typedef struct {
+  rendering_t ** renderings;
+  AmideEye eyes;
+  guchar ** eye_images; /* eyes images per context, when rendering stereo */
+  gsize image_size;
+  gint failed;
+} renderings_work_t;
+
+static GPtrArray * renderings_to_array(renderings_t * renderings) {
+
+  GPtrArray * array;
+
+  array = g_ptr_array_new();
+  while (renderings != NULL) {
+    g_ptr_array_add(array, renderings->rendering);
+    renderings = renderings->next;
+  }
+
+  return array;
+}
+
+static void renderings_load_contexts(guint64 start, guint64 end, gpointer data) {
+
+  renderings_work_t * work = data;
+  guint64 i;
+
+  for (i=start; i<end; i++)
+    if (!rendering_load_object(work->renderings[i], NULL, NULL))
+      g_atomic_int_set(&(work->failed), TRUE);
+
+  return;
+}
+
 /* reloads the rendering list when needed, returns FALSE if not everything was done correctly */
 gboolean renderings_reload_objects(renderings_t * renderings, 
 				   const amide_time_t start, 
@@ -1153,18 +1344,48 @@ gboolean renderings_reload_objects(renderings_t * renderings,
 				   AmitkUpdateFunc update_func,
 				   gpointer update_data) {
   
-  gboolean correct=TRUE;
+  GPtrArray * to_load;
+  renderings_work_t work;
+  gboolean continue_work=TRUE;
+  guint i;
+
+  /* figure out which contexts actually need their data reloaded */
+  to_load = g_ptr_array_new();
+  while (renderings != NULL) {
+    if (rendering_set_time(renderings->rendering, start, duration))
+      g_ptr_array_add(to_load, renderings->rendering);
+    renderings = renderings->next;
+  }
 
-  if (renderings != NULL) {
-    /* reload this rendering context */
-    correct = rendering_reload_object(renderings->rendering, start, duration, update_func, update_data);
-    /* and do the next */
-    correct = 
-      correct && 
-      renderings_reload_objects(renderings->next, start, duration, update_func, update_data);
+  work.renderings = (rendering_t **) to_load->pdata;
+  work.failed = FALSE;
+
+  /* the data set's min/max get calculated (and stored) on first use, get
+     that done here, before the slices are pulled out from several threads */
+  for (i=0; i<to_load->len; i++)
+    if (AMITK_IS_DATA_SET(work.renderings[i]->object)) 
+      amitk_data_set_calc_min_max_if_needed(AMITK_DATA_SET(work.renderings[i]->object), 
+					    update_func, update_data);
+
+  if (to_load->len == 1) {
+    /* only one, can give detailed progress on it */
+    work.failed = !rendering_load_object(work.renderings[0], update_func, update_data);
+  } else if (to_load->len > 1) {
+    /* progress can't be reported from the worker threads, so just put up a 
+       message while the contexts are loaded concurrently */
+    if (update_func != NULL) 
+      continue_work = (*update_func)(update_data, _("Converting for rendering"), (gdouble) -1.0);
+    if (continue_work)
+      amitk_parallel_for(to_load->len, 1, renderings_load_contexts, &work);
+    else
+      work.failed = TRUE;
+    if (update_func != NULL) 
+      (*update_func)(update_data, NULL, (gdouble) 2.0); /* remove progress bar */
   }
 
-  return correct;
+  g_ptr_array_free(to_load, TRUE);
+
+  return !work.failed;
 }
     
 
@@ -1255,14 +1476,133 @@ void renderings_set_depth_cueing_parameters(renderings_t * renderings,
 }
 
 
+static void renderings_render_contexts(guint64 start, guint64 end, gpointer data) {
+
+  renderings_work_t * work = data;
+  guint64 i;
+
+  for (i=start; i<end; i++)
+    rendering_render(work->renderings[i]);
+
+  return;
+}
+
+static void renderings_render_eye_contexts(guint64 start, guint64 end, gpointer data) {
+
+  renderings_work_t * work = data;
+  rendering_t * rendering;
+  guint64 i;
+
+  for (i=start; i<end; i++) {
+    rendering = work->renderings[i/work->eyes];
+
+    if (i % work->eyes == AMIDE_EYE_LEFT) {
+      if (render_context(rendering, rendering->vpc, rendering->need_reclassify))
+	memcpy(work->eye_images[i], rendering->image, work->image_size);
+      else
+	g_atomic_int_set(&(work->failed), TRUE);
+    } else {
+      if (render_context(rendering, rendering->eye_vpc, rendering->eye_need_reclassify))
+	memcpy(work->eye_images[i], rendering->eye_image, work->image_size);
+      else
+	g_atomic_int_set(&(work->failed), TRUE);
+    }
+  }
+
+  return;
+}
+
+/* points each eye's context of a rendering at its view, the data rotated 
+   about the y axis by half the eye angle one way or the other */
+static void rendering_set_eye_spaces(rendering_t * rendering, const gdouble eye_angle) {
+
+  AmitkSpace * eye_space;
+  AmideEye i_eye;
+  gdouble rot;
+
+  for (i_eye = 0; i_eye < AMIDE_EYE_NUM; i_eye++) {
+    rot = (-0.5 + i_eye*1.0) * eye_angle;
+    rot = M_PI*rot/180; /* convert to radians */
+
+    eye_space = amitk_space_copy(AMITK_SPACE(rendering->transformed_volume));
+    amitk_space_rotate_on_vector(eye_space, amitk_space_get_axis(eye_space, AMITK_AXIS_Y),
+				 -rot, zero_point);
+    set_context_space(rendering, (i_eye == AMIDE_EYE_LEFT) ? rendering->vpc : rendering->eye_vpc, 
+		      eye_space);
+    g_object_unref(eye_space);
+  }
+
+  return;
+}
+
 /* to render a list of rendering contexts... */
 void renderings_render(renderings_t * renderings) {
 
- while (renderings != NULL) {
-    rendering_render(renderings->rendering);
-    renderings = renderings->next;
+  renderings_render_eyes(renderings, 1, 0.0, NULL, 0);
+
+  return;
+}
+
+/* renders the list of rendering contexts, with the contexts rendered concurrently.
+   For stereo (eyes > 1), eye_angle is in degrees, and the image for eye i_eye of the 
+   n'th context in the list is copied into eye_images[n*eyes+i_eye], each of which 
+   should hold image_size bytes.  For a single eye, the images are left in the contexts. */
+void renderings_render_eyes(renderings_t * renderings, 
+			    const AmideEye eyes, 
+			    const gdouble eye_angle,
+			    guchar ** eye_images,
+			    const gsize image_size) {
+
+  GPtrArray * array;
+  renderings_work_t work;
+  rendering_t * rendering;
+  guint i;
+
+  g_return_if_fail((eyes == 1) || (eyes == AMIDE_EYE_NUM));
+  g_return_if_fail((eyes == 1) || (eye_images != NULL));
+
+  array = renderings_to_array(renderings);
+  work.renderings = (rendering_t **) array->pdata;
+  work.eyes = eyes;
+  work.eye_images = eye_images;
+  work.image_size = image_size;
+  work.failed = FALSE;
+
+  if (eyes == 1) {
+    amitk_parallel_for(array->len, 1, renderings_render_contexts, &work);
+  } else {
+    /* each context's right eye gets its own volpack context, so that
+       every eye of every context can be rendered as a separate task */
+    for (i=0; i<array->len; i++) {
+      rendering = work.renderings[i];
+      if (!rendering_init_eye(rendering)) {
+	for (i=0; i<array->len*eyes; i++)
+	  memset(eye_images[i], 0, image_size);
+	g_ptr_array_free(array, TRUE);
+	return;
+      }
+      if (rendering->need_reclassify)
+	rendering->eye_need_reclassify = TRUE;
+      rendering_set_eye_spaces(rendering, eye_angle);
+    }
+
+    amitk_parallel_for(((guint64) array->len)*eyes, 1, renderings_render_eye_contexts, &work);
+
+    /* put the main contexts back to the unrotated view, their images 
+       now hold the left eye so they'll need rerendering for a single eye */
+    for (i=0; i<array->len; i++) {
+      rendering = work.renderings[i];
+      set_space(rendering);
+      rendering->need_rerender = TRUE;
+      if (!work.failed) {
+	rendering->need_reclassify = FALSE;
+	rendering->eye_need_reclassify = FALSE;
+      }
+    }
   }
 
+  g_ptr_array_free(array, TRUE);
+
   return;
 }
 
@@ -32,6 +32,7 @@
 #include <volpack.h>
 #include "amitk_object.h"
 #include "amitk_data_set.h"
+#include "amide.h"
 
 /* -------------- structures and such ------------- */
 
@@ -139,6 +140,14 @@ typedef struct _rendering_t {
   gboolean optimize_rendering;
   gboolean need_rerender;
   gboolean need_reclassify;
+  rendering_quality_t quality;
+  gboolean depth_cueing;
+  gdouble front_factor;
+  gdouble density;
+  amide_intpoint_t image_dim; /* image is image_dim x image_dim */
+  vpContext * eye_vpc; /* context for the right eye, so stereo eyes can render concurrently */
+  guchar * eye_image;
+  gboolean eye_need_reclassify;
   guint ref_count;
 } rendering_t;
 
@@ -212,6 +221,11 @@ void renderings_set_depth_cueing(renderings_t * renderings, gboolean state);
 void renderings_set_depth_cueing_parameters(renderings_t * renderings, 
 					    gdouble front_factor, gdouble density);
 void renderings_render(renderings_t * renderings);
+void renderings_render_eyes(renderings_t * renderings, 
+			    const AmideEye eyes, 
+			    const gdouble eye_angle,
+			    guchar ** eye_images,
+			    const gsize image_size);
 guint renderings_count(renderings_t * renderings);
 
 /* external variables */
@@ -36,6 +36,7 @@
 #define AXIS_HEIGHT 120
 #define CURSOR_SIZE 1
 #define NUM_ROWS 4
+#define MAX_CACHED_PROJECTIONS 16 /* number of frame/gate combinations to keep */
 
 static const char * finish_page_text = 
 N_("When the apply button is hit, a new data set will be created\n"
@@ -57,6 +58,13 @@ typedef enum {
   NUM_RANGES
 } range_t;
 
+/* the projections of one frame and gate */
+typedef struct {
+  guint frame;
+  guint gate;
+  AmitkDataSet * projections[AMITK_VIEW_NUM];
+} projection_cache_t;
+
 /* data structures */
 typedef struct tb_crop_t {
   GtkWidget * dialog;
@@ -75,6 +83,7 @@ typedef struct tb_crop_t {
   AmitkStudy * study;
   AmitkDataSet * data_set;
   AmitkDataSet * projections[AMITK_VIEW_NUM];
+  GList * projection_cache; /* of projection_cache_t, most recently used first */
   GtkWidget * canvas[AMITK_VIEW_NUM];
   AmitkCanvasItem * image[AMITK_VIEW_NUM];
   gint canvas_width[AMITK_VIEW_NUM];
@@ -121,6 +130,9 @@ static void change_scaling_type_cb(GtkWidget * widget, gpointer data);
 static void update_mm_labels(tb_crop_t * tb_crop, AmitkView view);
 static void update_crop_lines(tb_crop_t * tb_crop, AmitkView view);
 static void add_canvas_update(tb_crop_t * tb_crop, AmitkView view);
+static void projection_cache_add(tb_crop_t * tb_crop);
+static void projection_cache_lookup(tb_crop_t * tb_crop);
+static GList * projection_cache_free(GList * projection_cache);
 static gboolean update_canvas_while_idle(gpointer tb_crop);
 
 
@@ -527,7 +539,6 @@ static void frame_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
 
   tb_crop_t * tb_crop = data;
   AmitkView view;
-  AmitkView i_view;
   gint int_value;
 
   int_value = gtk_spin_button_get_value_as_int(spin_button);
@@ -549,10 +560,8 @@ static void frame_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
     g_signal_handlers_unblock_by_func(G_OBJECT(tb_crop->frame_spinner[view]), 
 				      G_CALLBACK(frame_spinner_cb), tb_crop);
     
-    /* unref all the computed projections */
-    for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) 
-      if (tb_crop->projections[i_view] != NULL)
-	tb_crop->projections[i_view] = amitk_object_unref(tb_crop->projections[i_view]);
+    /* switch to the projections of this frame and gate, if we've already computed them */
+    projection_cache_lookup(tb_crop);
     
     /* just update the current projection for now */
     add_canvas_update(tb_crop, view);
@@ -566,7 +575,6 @@ static void gate_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
 
   tb_crop_t * tb_crop = data;
   AmitkView view;
-  AmitkView i_view;
   gint int_value;
 
   int_value = gtk_spin_button_get_value_as_int(spin_button);
@@ -588,10 +596,8 @@ static void gate_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
     g_signal_handlers_unblock_by_func(G_OBJECT(tb_crop->gate_spinner[view]), 
 				      G_CALLBACK(gate_spinner_cb), tb_crop);
     
-    /* unref all the computed projections */
-    for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) 
-      if (tb_crop->projections[i_view] != NULL)
-	tb_crop->projections[i_view] = amitk_object_unref(tb_crop->projections[i_view]);
+    /* switch to the projections of this frame and gate, if we've already computed them */
+    projection_cache_lookup(tb_crop);
     
     /* just update the current projection for now */
     add_canvas_update(tb_crop, view);
@@ -830,10 +836,21 @@ static gboolean update_canvas_while_idle(gpointer data) {
     tb_crop->update_view = g_list_remove(tb_crop->update_view, GINT_TO_POINTER(view));
 
     /* create the projections if we haven't already */
-    if (tb_crop->projections[view] == NULL) 
+    if (tb_crop->projections[view] == NULL) {
       amitk_data_set_get_projections(tb_crop->data_set, tb_crop->frame, tb_crop->gate, 
 				     tb_crop->projections, 
 				     amitk_progress_dialog_update, tb_crop->progress_dialog);
+      for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++) {
+	if (tb_crop->projections[i_view] != NULL) {
+	  g_object_set_data(G_OBJECT(tb_crop->projections[i_view]), "which_view", GINT_TO_POINTER(i_view));
+	  g_signal_connect(G_OBJECT(tb_crop->projections[i_view]), "thresholds_changed",
+			   G_CALLBACK(projection_thresholds_changed_cb), tb_crop);
+	  g_signal_connect(G_OBJECT(tb_crop->projections[i_view]), "color_table_changed",
+			   G_CALLBACK(projection_color_table_changed_cb), tb_crop);
+	}
+      }
+      projection_cache_add(tb_crop);
+    }
 
     for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++) {
       if (tb_crop->projections[i_view] != NULL) {
@@ -847,11 +864,6 @@ static gboolean update_canvas_while_idle(gpointer data) {
 	  amitk_data_set_set_threshold_max(tb_crop->projections[i_view], 0, tb_crop->threshold_max);
 	  amitk_data_set_set_threshold_min(tb_crop->projections[i_view], 0, tb_crop->threshold_min);
 	}
-	g_object_set_data(G_OBJECT(tb_crop->projections[i_view]), "which_view", GINT_TO_POINTER(i_view));
-	g_signal_connect(G_OBJECT(tb_crop->projections[i_view]), "thresholds_changed",
-			 G_CALLBACK(projection_thresholds_changed_cb), tb_crop);
-	g_signal_connect(G_OBJECT(tb_crop->projections[i_view]), "color_table_changed",
-			 G_CALLBACK(projection_color_table_changed_cb), tb_crop);
 	//	if (tb_crop->threshold[i_view] != NULL)
 	//	  amitk_threshold_new_data_set(AMITK_THRESHOLD(tb_crop->threshold[i_view]), 
 	//				       tb_crop->projections[i_view]);
@@ -889,6 +901,79 @@ static gboolean update_canvas_while_idle(gpointer data) {
 }
 
 
+/* keeps a reference to the current projections, so we don't need to recompute 
+   them if the user comes back to this frame and gate */
+static void projection_cache_add(tb_crop_t * tb_crop) {
+
+  projection_cache_t * entry;
+  AmitkView i_view;
+  GList * last;
+
+  for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++)
+    if (tb_crop->projections[i_view] == NULL) return;
+
+  if ((entry = g_try_new(projection_cache_t,1)) == NULL) return; /* just won't be cached */
+  entry->frame = tb_crop->frame;
+  entry->gate = tb_crop->gate;
+  for (i_view=0; i_view<AMITK_VIEW_NUM; i_view++)
+    entry->projections[i_view] = amitk_object_ref(tb_crop->projections[i_view]);
+  tb_crop->projection_cache = g_list_prepend(tb_crop->projection_cache, entry);
+
+  /* trim off the least recently used */
+  if (g_list_length(tb_crop->projection_cache) > MAX_CACHED_PROJECTIONS) {
+    last = g_list_last(tb_crop->projection_cache);
+    tb_crop->projection_cache = g_list_remove_link(tb_crop->projection_cache, last);
+    projection_cache_free(last);
+  }
+
+  return;
+}
+
+/* drops the current projections, and picks up the cached ones for the current
+   frame and gate if we have them */
+static void projection_cache_lookup(tb_crop_t * tb_crop) {
+
+  projection_cache_t * entry;
+  AmitkView i_view;
+  GList * cache;
+
+  for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) 
+    if (tb_crop->projections[i_view] != NULL)
+      tb_crop->projections[i_view] = amitk_object_unref(tb_crop->projections[i_view]);
+
+  for (cache = tb_crop->projection_cache; cache != NULL; cache = cache->next) {
+    entry = cache->data;
+    if ((entry->frame == tb_crop->frame) && (entry->gate == tb_crop->gate)) {
+      for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) 
+	tb_crop->projections[i_view] = amitk_object_ref(entry->projections[i_view]);
+
+      /* move it to the front of the cache */
+      tb_crop->projection_cache = g_list_remove_link(tb_crop->projection_cache, cache);
+      tb_crop->projection_cache = g_list_concat(cache, tb_crop->projection_cache);
+      return;
+    }
+  }
+
+  return;
+}
+
+static GList * projection_cache_free(GList * projection_cache) {
+
+  projection_cache_t * entry;
+  AmitkView i_view;
+  GList * cache;
+
+  for (cache = projection_cache; cache != NULL; cache = cache->next) {
+    entry = cache->data;
+    for (i_view=0; i_view < AMITK_VIEW_NUM; i_view++) 
+      amitk_object_unref(entry->projections[i_view]);
+    g_free(entry);
+  }
+  g_list_free(projection_cache);
+
+  return NULL;
+}
+
 
 static tb_crop_t * tb_crop_free(tb_crop_t * tb_crop) {
 
@@ -929,6 +1014,7 @@ static tb_crop_t * tb_crop_free(tb_crop_t * tb_crop) {
 	tb_crop->projections[i_view] = NULL;
       }
     }
+    tb_crop->projection_cache = projection_cache_free(tb_crop->projection_cache);
 
     if (tb_crop->progress_dialog != NULL) {
       g_signal_emit_by_name(G_OBJECT(tb_crop->progress_dialog), "delete_event", NULL, &return_val);
@@ -983,6 +1069,7 @@ static tb_crop_t * tb_crop_init(void) {
       for (i_range=0; i_range<NUM_RANGES; i_range++) 
 	tb_crop->line[i_view][j][i_range]=NULL;
   }
+  tb_crop->projection_cache = NULL;
   tb_crop->update_view=NULL;
   tb_crop->idle_handler_id = 0;
 
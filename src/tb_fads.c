@@ -103,6 +103,7 @@ typedef struct tb_fads_t {
   gdouble k32;
   fads_type_t fads_type;
   fads_minimizer_algorithm_t algorithm;
+  fads_svd_method_t svd_method;
   GArray * initial_curves; 
 
   GtkWidget * page[NUM_PAGES];
@@ -136,6 +137,7 @@ static gchar * get_filename(tb_fads_t * tb_fads);
 
 static void fads_type_cb(GtkWidget * widget, gpointer data);
 static void algorithm_cb(GtkWidget * widget, gpointer data);
+static void svd_method_cb(GtkWidget * widget, gpointer data);
 static void svd_pressed_cb(GtkButton * button, gpointer data);
 static void blood_cell_edited(GtkCellRendererText *cellrenderertext,
 			      gchar *arg1, gchar *arg2,gpointer data);
@@ -290,7 +292,7 @@ static void svd_pressed_cb(GtkButton * button, gpointer data) {
 
   /* calculate factors */
   ui_common_place_cursor(UI_CURSOR_WAIT, tb_fads->page[PARAMETERS_PAGE]);
-  fads_svd_factors(tb_fads->data_set, &num_factors, &factors);
+  fads_svd_factors(tb_fads->data_set, tb_fads->svd_method, &num_factors, &factors);
   ui_common_remove_wait_cursor(tb_fads->page[PARAMETERS_PAGE]);
 
   for (i=0; i<num_factors; i++) {
@@ -496,6 +498,12 @@ static void algorithm_cb(GtkWidget * widget, gpointer data) {
   return;
 }
 
+static void svd_method_cb(GtkWidget * widget, gpointer data) {
+  tb_fads_t * tb_fads = data;
+  tb_fads->svd_method = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+  return;
+}
+
 static void num_factors_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
   tb_fads_t * tb_fads = data;
   tb_fads->num_factors = gtk_spin_button_get_value_as_int(spin_button);
@@ -596,7 +604,7 @@ static void apply_cb(GtkAssistant * assistant, gpointer data) {
   ui_common_place_cursor(UI_CURSOR_WAIT, tb_fads->page[CONCLUSION_PAGE]);
   switch(tb_fads->fads_type) {
   case FADS_TYPE_PCA:
-    fads_pca(tb_fads->data_set, tb_fads->num_factors, output_filename,
+    fads_pca(tb_fads->data_set, tb_fads->num_factors, tb_fads->svd_method, output_filename,
 	     amitk_progress_dialog_update, tb_fads->progress_dialog);
     break;
   case FADS_TYPE_PLS:
@@ -723,6 +731,7 @@ static tb_fads_t * tb_fads_init(void) {
   tb_fads->fads_type = FADS_TYPE_PCA;
   //  tb_fads->algorithm = FADS_MINIMIZER_VECTOR_BFGS;
   tb_fads->algorithm = FADS_MINIMIZER_CONJUGATE_PR;
+  tb_fads->svd_method = FADS_SVD_GRAM;
   tb_fads->initial_curves = NULL;
   tb_fads->explanation_buffer = NULL;
   tb_fads->progress_dialog = NULL;
@@ -813,6 +822,7 @@ static GtkWidget * create_page(tb_fads_t * tb_fads, which_page_t i_page) {
 
   fads_type_t i_fads_type;
   fads_minimizer_algorithm_t i_algorithm;
+  fads_svd_method_t i_svd_method;
   GtkWidget * label;
   GtkWidget * button;
   GtkCellRenderer *renderer;
@@ -838,14 +848,23 @@ static GtkWidget * create_page(tb_fads_t * tb_fads, which_page_t i_page) {
     view = gtk_text_view_new ();
     buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (view));
     gtk_text_buffer_set_text (buffer, _(svd_page_text), -1);
-    gtk_grid_attach(GTK_GRID(table), view, 0, table_row, 1, 2);
+    gtk_grid_attach(GTK_GRID(table), view, 0, table_row, 1, 3);
     gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(view), GTK_WRAP_WORD);
     gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
     gtk_widget_set_size_request(view,300,-1);
     
     /* a separator for clarity */
     vseparator = gtk_separator_new(GTK_ORIENTATION_VERTICAL);
-    gtk_grid_attach(GTK_GRID(table), vseparator, 1, table_row, 1, 2);
+    gtk_grid_attach(GTK_GRID(table), vseparator, 1, table_row, 1, 3);
+
+    /* how to do the decomposition, also used for principle component analysis */
+    menu = gtk_combo_box_text_new();
+    for (i_svd_method = 0; i_svd_method < NUM_FADS_SVD_METHODS; i_svd_method++) 
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(menu), _(fads_svd_method_name[i_svd_method]));
+    gtk_combo_box_set_active(GTK_COMBO_BOX(menu), tb_fads->svd_method);
+    g_signal_connect(G_OBJECT(menu), "changed", G_CALLBACK(svd_method_cb), tb_fads);
+    gtk_grid_attach(GTK_GRID(table), menu, 2, table_row, 1, 1);
+    table_row++;
 
     /* do I need to compute factors? */
     button = gtk_button_new_with_label(_("Compute Singular Values?"));
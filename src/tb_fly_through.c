@@ -474,12 +474,12 @@ static void movie_generate(tb_fly_through_t * tb_fly_through, gchar * output_fil
     return_val = mpeg_encode_frame(mpeg_encode_context, pixbuf);
     g_object_unref(pixbuf);
 
-    if (return_val != 1) 
-      g_warning(_("encoding of frame %d failed"), i_frame);
-
     current_point.z += increment_z;
   }
-  mpeg_encode_close(mpeg_encode_context);
+
+  /* failures are only seen a few frames late, if at all before closing */
+  if (!mpeg_encode_close(mpeg_encode_context))
+    g_warning(_("encoding of the movie failed"));
   amitk_progress_dialog_set_fraction(AMITK_PROGRESS_DIALOG(tb_fly_through->progress_dialog),2.0);
 
   /* reset the canvas */
@@ -0,0 +1,438 @@
+/* tb_parametric.c
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+
+#include "amide_config.h"
+#include "amide.h"
+#include "amitk_data_set.h"
+#include "amitk_progress_dialog.h"
+#include "analysis.h"
+#include "parametric.h"
+#include "tb_parametric.h"
+
+
+#define LABEL_WIDTH 375
+
+#define MAX_START_TIME 1e6 /* s */
+#define MAX_K2_REF 10.0 /* 1/s */
+
+static const char * wizard_name = N_("Parametric Image Wizard");
+
+static const char * start_page_text =
+N_("A model will be fitted at every voxel of the active data set, "
+   "using the mean of the chosen ROI as the input function. The ROI "
+   "can be a blood pool (plasma input), or a reference region. SRTM "
+   "needs a reference region.\n"
+   "\n"
+   "Only frames whose midpoint is after the start time are used in "
+   "the fit. For Logan analysis against a reference region, the "
+   "reference region's efflux rate constant (k2') can be given, leave "
+   "it at zero for a plasma input.");
+
+static const char * finish_page_text =
+N_("When the apply button is hit, a new data set will be created "
+   "and placed into the study's tree, consisting of the fitted values\n");
+
+
+typedef enum {
+  PARAMETERS_PAGE,
+  CONCLUSION_PAGE,
+  NUM_PAGES
+} which_page_t;
+
+/* data structures */
+typedef struct tb_parametric_t {
+  GtkWidget * dialog;
+
+  parametric_model_t model;
+  amide_time_t start_time;
+  amide_data_t k2_ref;
+  AmitkRoi * roi;
+  GList * rois;
+
+  AmitkDataSet * data_set;
+  AmitkStudy * study;
+
+  GtkWidget * page[NUM_PAGES];
+  GtkWidget * explanation_label;
+  GtkWidget * progress_dialog;
+
+  guint reference_count;
+} tb_parametric_t;
+
+
+static void model_cb(GtkWidget * widget, gpointer data);
+static void roi_cb(GtkWidget * widget, gpointer data);
+static void start_time_spinner_cb(GtkSpinButton * spin_button, gpointer data);
+static void k2_ref_spinner_cb(GtkSpinButton * spin_button, gpointer data);
+
+static void apply_cb(GtkAssistant * assistant, gpointer data);
+static void close_cb(GtkAssistant * assistant, gpointer data);
+
+static tb_parametric_t * tb_parametric_free(tb_parametric_t * tb_parametric);
+static tb_parametric_t * tb_parametric_init(void);
+
+static GtkWidget * create_parameters_page(tb_parametric_t * tb_parametric);
+
+
+
+static void model_cb(GtkWidget * widget, gpointer data) {
+
+  tb_parametric_t * tb_parametric = data;
+
+  tb_parametric->model = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+  gtk_label_set_text(GTK_LABEL(tb_parametric->explanation_label),
+		     _(parametric_model_explanation[tb_parametric->model]));
+  return;
+}
+
+static void roi_cb(GtkWidget * widget, gpointer data) {
+
+  tb_parametric_t * tb_parametric = data;
+  gint which;
+
+  which = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+  if (which >= 0)
+    tb_parametric->roi = g_list_nth_data(tb_parametric->rois, which);
+
+  return;
+}
+
+static void start_time_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
+
+  tb_parametric_t * tb_parametric = data;
+
+  tb_parametric->start_time = gtk_spin_button_get_value(spin_button);
+  return;
+}
+
+static void k2_ref_spinner_cb(GtkSpinButton * spin_button, gpointer data) {
+
+  tb_parametric_t * tb_parametric = data;
+
+  tb_parametric->k2_ref = gtk_spin_button_get_value(spin_button);
+  return;
+}
+
+
+/* the input function is the mean of the roi in each frame, averaged over the gates */
+static amide_data_t * calc_input(tb_parametric_t * tb_parametric) {
+
+  analysis_roi_t * roi_analysis;
+  analysis_frame_t * frame_analyses;
+  analysis_gate_t * gate_analyses;
+  GList * rois;
+  GList * data_sets;
+  amide_data_t * input;
+  gint frame, num_gates;
+
+  rois = g_list_append(NULL, amitk_object_ref(tb_parametric->roi));
+  data_sets = g_list_append(NULL, amitk_object_ref(tb_parametric->data_set));
+  roi_analysis = analysis_roi_init_moments(tb_parametric->study, rois, data_sets, FALSE);
+  rois = amitk_objects_unref(rois);
+  data_sets = amitk_objects_unref(data_sets);
+  g_return_val_if_fail(roi_analysis != NULL, NULL);
+
+  input = g_new0(amide_data_t, AMITK_DATA_SET_NUM_FRAMES(tb_parametric->data_set));
+  frame_analyses = roi_analysis->volume_analyses->frame_analyses;
+  frame = 0;
+  while ((frame_analyses != NULL) && (frame < AMITK_DATA_SET_NUM_FRAMES(tb_parametric->data_set))) {
+    num_gates = 0;
+    gate_analyses = frame_analyses->gate_analyses;
+    while (gate_analyses != NULL) {
+      input[frame] += gate_analyses->mean;
+      num_gates++;
+      gate_analyses = gate_analyses->next_gate_analysis;
+    }
+    if (num_gates > 0) input[frame] /= num_gates;
+
+    frame_analyses = frame_analyses->next_frame_analysis;
+    frame++;
+  }
+
+  roi_analysis = analysis_roi_unref(roi_analysis);
+
+  return input;
+}
+
+/* function called when the finish button is hit */
+static void apply_cb(GtkAssistant * assistant, gpointer data) {
+
+  tb_parametric_t * tb_parametric = data;
+  AmitkDataSet * parametric_ds;
+  amide_data_t * input;
+
+  /* disable the buttons */
+  gtk_widget_set_sensitive(GTK_WIDGET(assistant), FALSE);
+
+  input = calc_input(tb_parametric);
+  if (input == NULL) {
+    g_warning(_("Failed to calculate the input function"));
+    return;
+  }
+
+  /* generate the new data set */
+  parametric_ds = parametric_calc(tb_parametric->data_set,
+				  tb_parametric->model,
+				  input,
+				  tb_parametric->start_time,
+				  tb_parametric->k2_ref,
+				  amitk_progress_dialog_update,
+				  tb_parametric->progress_dialog);
+  g_free(input);
+
+  if (parametric_ds != NULL) {
+    /* and add the new data set to the study */
+    amitk_object_add_child(AMITK_OBJECT(tb_parametric->study), AMITK_OBJECT(parametric_ds)); /* this adds a reference to the data set*/
+    amitk_object_unref(parametric_ds); /* so remove a reference */
+  } else
+    g_warning("Failed to generate parametric data set");
+
+  return;
+}
+
+
+/* function called to cancel the dialog */
+static void close_cb(GtkAssistant * assistant, gpointer data) {
+
+  tb_parametric_t * tb_parametric = data;
+  GtkWidget * dialog = tb_parametric->dialog;
+
+  tb_parametric = tb_parametric_free(tb_parametric); /* trash collection */
+  gtk_widget_destroy(dialog);
+
+  return;
+}
+
+
+static tb_parametric_t * tb_parametric_free(tb_parametric_t * tb_parametric) {
+
+  gboolean return_val;
+
+  /* sanity checks */
+  g_return_val_if_fail(tb_parametric != NULL, NULL);
+  g_return_val_if_fail(tb_parametric->reference_count > 0, NULL);
+
+  /* remove a reference count */
+  tb_parametric->reference_count--;
+
+  /* things to do if we've removed all reference's */
+  if (tb_parametric->reference_count == 0) {
+#ifdef AMIDE_DEBUG
+    g_print("freeing tb_parametric\n");
+#endif
+
+    if (tb_parametric->data_set != NULL) {
+      amitk_object_unref(tb_parametric->data_set);
+      tb_parametric->data_set = NULL;
+    }
+
+    if (tb_parametric->study != NULL) {
+      amitk_object_unref(tb_parametric->study);
+      tb_parametric->study = NULL;
+    }
+
+    if (tb_parametric->rois != NULL)
+      tb_parametric->rois = amitk_objects_unref(tb_parametric->rois);
+    tb_parametric->roi = NULL;
+
+    if (tb_parametric->progress_dialog != NULL) {
+      g_signal_emit_by_name(G_OBJECT(tb_parametric->progress_dialog), "delete_event", NULL, &return_val);
+      tb_parametric->progress_dialog = NULL;
+    }
+
+    g_free(tb_parametric);
+    tb_parametric = NULL;
+  }
+
+  return tb_parametric;
+}
+
+static tb_parametric_t * tb_parametric_init(void) {
+
+  tb_parametric_t * tb_parametric;
+
+  /* alloc space for the data structure for passing ui info */
+  if ((tb_parametric = g_try_new(tb_parametric_t,1)) == NULL) {
+    g_warning(_("couldn't allocate memory space for tb_parametric_t"));
+    return NULL;
+  }
+
+  tb_parametric->reference_count = 1;
+  tb_parametric->model = PARAMETRIC_MODEL_PATLAK;
+  tb_parametric->start_time = 0.0;
+  tb_parametric->k2_ref = 0.0;
+  tb_parametric->roi = NULL;
+  tb_parametric->rois = NULL;
+  tb_parametric->dialog = NULL;
+  tb_parametric->study = NULL;
+  tb_parametric->data_set = NULL;
+  tb_parametric->progress_dialog = NULL;
+
+  return tb_parametric;
+}
+
+
+
+static GtkWidget * create_parameters_page(tb_parametric_t * tb_parametric) {
+
+  GtkWidget * label;
+  GtkWidget * spin_button;
+  GtkWidget * menu;
+  GtkWidget * table;
+  gint table_row;
+  parametric_model_t i_model;
+  GList * rois;
+
+  table = gtk_grid_new();
+  gtk_grid_set_row_spacing(GTK_GRID(table), Y_PADDING);
+  gtk_grid_set_column_spacing(GTK_GRID(table), X_PADDING);
+  table_row=0;
+
+  label = gtk_label_new(_(start_page_text));
+  gtk_widget_set_size_request(label, LABEL_WIDTH, -1);
+  gtk_label_set_line_wrap(GTK_LABEL(label), TRUE);
+  gtk_grid_attach(GTK_GRID(table), label, 0, table_row, 2, 1);
+  table_row++;
+
+  /* the model */
+  label = gtk_label_new(_("Model"));
+  gtk_grid_attach(GTK_GRID(table), label, 0, table_row, 1, 1);
+
+  menu = gtk_combo_box_text_new();
+  for (i_model=0; i_model<NUM_PARAMETRIC_MODELS; i_model++)
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(menu), _(parametric_model_name[i_model]));
+  gtk_combo_box_set_active(GTK_COMBO_BOX(menu), tb_parametric->model);
+  g_signal_connect(G_OBJECT(menu), "changed", G_CALLBACK(model_cb), tb_parametric);
+  gtk_grid_attach(GTK_GRID(table), menu, 1, table_row, 1, 1);
+  table_row++;
+
+  tb_parametric->explanation_label = gtk_label_new(_(parametric_model_explanation[tb_parametric->model]));
+  gtk_widget_set_size_request(tb_parametric->explanation_label, LABEL_WIDTH, -1);
+  gtk_label_set_line_wrap(GTK_LABEL(tb_parametric->explanation_label), TRUE);
+  gtk_grid_attach(GTK_GRID(table), tb_parametric->explanation_label, 0, table_row, 2, 1);
+  table_row++;
+
+  /* the input function */
+  label = gtk_label_new(_("Input Function ROI"));
+  gtk_grid_attach(GTK_GRID(table), label, 0, table_row, 1, 1);
+
+  menu = gtk_combo_box_text_new();
+  for (rois = tb_parametric->rois; rois != NULL; rois = rois->next)
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(menu), AMITK_OBJECT_NAME(rois->data));
+  gtk_combo_box_set_active(GTK_COMBO_BOX(menu), 0);
+  g_signal_connect(G_OBJECT(menu), "changed", G_CALLBACK(roi_cb), tb_parametric);
+  gtk_grid_attach(GTK_GRID(table), menu, 1, table_row, 1, 1);
+  table_row++;
+
+  /* the start time */
+  label = gtk_label_new(_("Start Time (s)"));
+  gtk_grid_attach(GTK_GRID(table), label, 0, table_row, 1, 1);
+
+  spin_button = gtk_spin_button_new_with_range(0.0, MAX_START_TIME, 1.0);
+  gtk_spin_button_set_digits(GTK_SPIN_BUTTON(spin_button), 1);
+  gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), tb_parametric->start_time);
+  g_signal_connect(G_OBJECT(spin_button), "value_changed",
+		   G_CALLBACK(start_time_spinner_cb), tb_parametric);
+  gtk_grid_attach(GTK_GRID(table), spin_button, 1, table_row, 1, 1);
+  table_row++;
+
+  /* the reference region's efflux rate */
+  label = gtk_label_new(_("Reference k2' (1/s)"));
+  gtk_grid_attach(GTK_GRID(table), label, 0, table_row, 1, 1);
+
+  spin_button = gtk_spin_button_new_with_range(0.0, MAX_K2_REF, 0.0001);
+  gtk_spin_button_set_digits(GTK_SPIN_BUTTON(spin_button), 5);
+  gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), tb_parametric->k2_ref);
+  g_signal_connect(G_OBJECT(spin_button), "value_changed",
+		   G_CALLBACK(k2_ref_spinner_cb), tb_parametric);
+  gtk_grid_attach(GTK_GRID(table), spin_button, 1, table_row, 1, 1);
+  table_row++;
+
+  return table;
+}
+
+
+
+void tb_parametric(AmitkStudy * study, AmitkDataSet * active_ds, GtkWindow * parent) {
+
+  tb_parametric_t * tb_parametric;
+  which_page_t i_page;
+
+  if (active_ds == NULL) {
+    g_warning(_("No data set is currently marked as active"));
+    return;
+  }
+
+  if (AMITK_DATA_SET_NUM_FRAMES(active_ds) < 2) {
+    g_warning(_("need dynamic data set in order to generate a parametric image"));
+    return;
+  }
+
+  tb_parametric = tb_parametric_init();
+  tb_parametric->study = amitk_object_ref(study);
+  tb_parametric->data_set = amitk_object_ref(active_ds);
+  tb_parametric->rois = amitk_object_get_children_of_type(AMITK_OBJECT(study), AMITK_OBJECT_TYPE_ROI, TRUE);
+
+  if (tb_parametric->rois == NULL) {
+    g_warning(_("Need an ROI to use as the input function"));
+    tb_parametric_free(tb_parametric);
+    return;
+  }
+  tb_parametric->roi = tb_parametric->rois->data;
+
+  tb_parametric->dialog = gtk_assistant_new();
+  gtk_window_set_transient_for(GTK_WINDOW(tb_parametric->dialog), parent);
+  gtk_window_set_destroy_with_parent(GTK_WINDOW(tb_parametric->dialog), TRUE);
+  g_signal_connect(G_OBJECT(tb_parametric->dialog), "cancel", G_CALLBACK(close_cb), tb_parametric);
+  g_signal_connect(G_OBJECT(tb_parametric->dialog), "close", G_CALLBACK(close_cb), tb_parametric);
+  g_signal_connect(G_OBJECT(tb_parametric->dialog), "apply", G_CALLBACK(apply_cb), tb_parametric);
+
+  tb_parametric->progress_dialog = amitk_progress_dialog_new(GTK_WINDOW(tb_parametric->dialog));
+
+
+  /* --------------parameters page ------------------- */
+  tb_parametric->page[PARAMETERS_PAGE] = create_parameters_page(tb_parametric);
+  gtk_assistant_append_page(GTK_ASSISTANT(tb_parametric->dialog), tb_parametric->page[PARAMETERS_PAGE]);
+
+
+  /* ----------------  conclusion page ---------------------------------- */
+  tb_parametric->page[CONCLUSION_PAGE] = gtk_label_new(_(finish_page_text));
+  gtk_widget_set_size_request(tb_parametric->page[CONCLUSION_PAGE],LABEL_WIDTH, -1);
+  gtk_label_set_line_wrap(GTK_LABEL(tb_parametric->page[CONCLUSION_PAGE]), TRUE);
+  gtk_assistant_append_page(GTK_ASSISTANT(tb_parametric->dialog), tb_parametric->page[CONCLUSION_PAGE]);
+  gtk_assistant_set_page_type(GTK_ASSISTANT(tb_parametric->dialog), tb_parametric->page[CONCLUSION_PAGE],
+			      GTK_ASSISTANT_PAGE_CONFIRM);
+
+
+  /* things for all pages */
+  for (i_page=0; i_page<NUM_PAGES; i_page++) {
+    gtk_assistant_set_page_title(GTK_ASSISTANT(tb_parametric->dialog), tb_parametric->page[i_page], _(wizard_name));
+    gtk_assistant_set_page_complete(GTK_ASSISTANT(tb_parametric->dialog), tb_parametric->page[i_page], TRUE); /* all pages have default values */
+    g_object_set_data(G_OBJECT(tb_parametric->page[i_page]),"which_page", GINT_TO_POINTER(i_page));
+  }
+
+  gtk_widget_show_all(tb_parametric->dialog);
+
+  return;
+}
@@ -0,0 +1,34 @@
+/* tb_parametric.h
+ *
+ * Part of amide - Amide's a Medical Image Dataset Examiner
+ * Copyright (C) 2026 the AMIDE contributors
+ */
+
+/*
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2, or (at your option)
+  any later version.
+ 
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+ 
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+  02111-1307, USA.
+*/
+
+#ifndef __TB_PARAMETRIC_H__
+#define __TB_PARAMETRIC_H__
+
+/* includes always needed with this */
+#include "amitk_study.h"
+
+
+/* external functions */
+void tb_parametric(AmitkStudy * study, AmitkDataSet * active_ds, GtkWindow * parent);
+
+#endif /* __TB_PARAMETRIC_H__ */
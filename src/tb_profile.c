@@ -58,6 +58,7 @@ typedef struct tb_profile_t {
   AmitkStudy * study;
   AmitkPreferences * preferences;
   GtkWidget * angle_spin;
+  amide_real_t width; /* in mm, 0 for a one voxel wide profile */
   guint idle_handler_id;
   GtkWidget * canvas;
   GtkWidget * text;
@@ -128,6 +129,7 @@ static void selections_changed_cb(AmitkObject * object, gpointer data);
 static void profile_changed_cb(AmitkLineProfile * line_profile, gpointer data);
 static void profile_switch_view_cb(GtkWidget * widget, gpointer data);
 static void profile_angle_cb(GtkWidget * widget, gpointer data);
+static void profile_width_cb(GtkWidget * widget, gpointer data);
 static void profile_update_entries(tb_profile_t * tb_profile);
 
 
@@ -229,6 +231,7 @@ static tb_profile_t * profile_init(void) {
   tb_profile->study = NULL;
   tb_profile->preferences = NULL;
   tb_profile->dialog = NULL;
+  tb_profile->width = 0.0;
   tb_profile->idle_handler_id = 0;
   tb_profile->results = NULL;
   tb_profile->x_label[0] = NULL;
@@ -257,6 +260,8 @@ static gchar * results_as_string(tb_profile_t * tb_profile) {
   time(&current_time);
   results = g_strdup_printf(_("# Profiles on Study: %s\tGenerated on: %s"),
 			    AMITK_OBJECT_NAME(tb_profile->study), ctime(&current_time));
+  if (tb_profile->width > 0.0)
+    amitk_append_str(&results, _("# Profiles averaged over a width of %g mm\n"), tb_profile->width);
   
   for (i=0; i < tb_profile->results->len; i++) {
     result = g_ptr_array_index(tb_profile->results, i);
@@ -863,7 +868,11 @@ static gboolean update_while_idle(gpointer data) {
   gboolean initialized=FALSE;
   GList * data_sets;
   GList * temp_data_sets;
+  GPtrArray * lines;
   GPtrArray * one_line;
+  AmitkLineProfile * line_profile;
+  AmitkSpace * view_space;
+  AmitkPoint width_axis;
   gint i,j;
   AmitkLineProfileDataElement * element;
   AmitkCanvasPoints * points;
@@ -881,16 +890,29 @@ static gboolean update_while_idle(gpointer data) {
   tb_profile->results = results_free(tb_profile->results);
   tb_profile->results = g_ptr_array_new();
 
+  /* a thick profile is averaged across the line, within the plane of the view */
+  line_profile = AMITK_STUDY_LINE_PROFILE(tb_profile->study);
+  view_space = amitk_space_get_view_space(AMITK_LINE_PROFILE_VIEW(line_profile),
+					  AMITK_STUDY_CANVAS_LAYOUT(tb_profile->study));
+  width_axis = point_cross_product(amitk_space_get_axis(view_space, AMITK_AXIS_Z),
+				   point_sub(AMITK_LINE_PROFILE_END_POINT(line_profile),
+					     AMITK_LINE_PROFILE_START_POINT(line_profile)));
+  g_object_unref(view_space);
+  if (point_mag(width_axis) > EPSILON)
+    width_axis = point_cmult(1.0/point_mag(width_axis), width_axis);
+
   /* recalc profiles */
+  lines = amitk_data_sets_get_line_profiles(data_sets,
+					    AMITK_STUDY_VIEW_START_TIME(tb_profile->study),
+					    AMITK_STUDY_VIEW_DURATION(tb_profile->study),
+					    AMITK_LINE_PROFILE_START_POINT(line_profile),
+					    AMITK_LINE_PROFILE_END_POINT(line_profile),
+					    tb_profile->width, width_axis);
+
   tb_profile->max_x = tb_profile->min_x = 0.0;
   temp_data_sets = data_sets;
-  while (temp_data_sets != NULL) {
-    amitk_data_set_get_line_profile(AMITK_DATA_SET(temp_data_sets->data),
-				    AMITK_STUDY_VIEW_START_TIME(tb_profile->study),
-				    AMITK_STUDY_VIEW_DURATION(tb_profile->study),
-				    AMITK_LINE_PROFILE_START_POINT(AMITK_STUDY_LINE_PROFILE(tb_profile->study)),
-				    AMITK_LINE_PROFILE_END_POINT(AMITK_STUDY_LINE_PROFILE(tb_profile->study)),
-				    &one_line);
+  for (i=0; i < lines->len; i++) {
+    one_line = g_ptr_array_index(lines, i);
 
     if (one_line->len > 1) { /* need at least two points for a valid line */
 
@@ -932,6 +954,7 @@ static gboolean update_while_idle(gpointer data) {
     temp_data_sets = temp_data_sets->next;
     
   }
+  g_ptr_array_free(lines, FALSE);
 
   root = amitk_simple_canvas_get_root_item(AMITK_SIMPLE_CANVAS(tb_profile->canvas));
   label = g_strdup_printf("%g", tb_profile->min_x);
@@ -1137,6 +1160,16 @@ static void profile_angle_cb(GtkWidget * widget, gpointer data) {
   return;
 }
 
+static void profile_width_cb(GtkWidget * widget, gpointer data) {
+
+  tb_profile_t * tb_profile = data;
+
+  tb_profile->width = gtk_spin_button_get_value(GTK_SPIN_BUTTON(widget));
+  recalc_profiles(tb_profile);
+
+  return;
+}
+
 static void profile_update_entries(tb_profile_t * tb_profile) {
   amide_real_t angle;
 
@@ -1164,6 +1197,7 @@ void tb_profile(AmitkStudy * study, AmitkPreferences * preferences, GtkWindow *
   GtkWidget * radio_button[3];
   GtkWidget * hbox;
   GtkWidget * label;
+  GtkWidget * spin_button;
   AmitkCanvasItem * root;
   AmitkCanvasItem * item;
 #ifdef AMIDE_LIBGSL_SUPPORT
@@ -1261,6 +1295,22 @@ void tb_profile(AmitkStudy * study, AmitkPreferences * preferences, GtkWindow *
   gtk_widget_show(tb_profile->angle_spin);
   table_row++;
 
+  /* averaging across the line */
+  label = gtk_label_new(_("Width (mm):"));
+  gtk_grid_attach(GTK_GRID(table), label, 0, table_row, 1, 1);
+  gtk_widget_show(label);
+
+  /* anything wider than the field of view just averages in empty space */
+  spin_button = gtk_spin_button_new_with_range(0.0, MAX(1.0, AMITK_STUDY_FOV(tb_profile->study)), 1.0);
+  gtk_spin_button_set_numeric(GTK_SPIN_BUTTON(spin_button), FALSE);
+  gtk_spin_button_set_digits(GTK_SPIN_BUTTON(spin_button),3);
+  gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), tb_profile->width);
+  g_signal_connect(G_OBJECT(spin_button), "value_changed", 
+		   G_CALLBACK(profile_width_cb), tb_profile);
+  gtk_grid_attach(GTK_GRID(table), spin_button, 1, table_row, 2, 1);
+  gtk_widget_show(spin_button);
+  table_row++;
+
 
   /* the canvas */
   tb_profile->canvas = amitk_simple_canvas_new();
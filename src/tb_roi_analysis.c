@@ -39,6 +39,12 @@
 
 #define ROI_STATISTICS_WIDTH 950
 
+/* how much exported text/data we collect before handing it to the file */
+#define EXPORT_BUFFER_SIZE (1<<20)
+#define EXPORT_RECORD_FIELDS 12
+#define EXPORT_END_OF_HEADER "# End of Header\n"
+
+
 /* keep in sync with array below */
 typedef enum {
   COLUMN_ROI_NAME,
@@ -107,11 +113,18 @@ typedef struct tb_roi_analysis_t {
   analysis_roi_t * roi_analyses;
   guint reference_count;
 } tb_roi_analysis_t;
+
+typedef enum {
+  EXPORT_STATISTICS,
+  EXPORT_RAW_TEXT,
+  EXPORT_RAW_BINARY
+} export_t;
   
 
-static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_values);
+static void export_data(tb_roi_analysis_t * tb_roi_analysis, export_t export_type);
 static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_analyses,
 			    gboolean raw_data);
+static void export_analyses_binary(const gchar * save_filename, analysis_roi_t * roi_analyses);
 static gchar * analyses_as_string(analysis_roi_t * roi_analyses);
 static void response_cb (GtkDialog * dialog, gint response_id, gpointer data);
 static void destroy_cb(GtkWidget * object, gpointer data);
@@ -130,16 +143,30 @@ static tb_roi_analysis_t * tb_roi_analysis_init(void);
 
 
 /* function to save the generated roi statistics */
-static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_data) {  
+static void export_data(tb_roi_analysis_t * tb_roi_analysis, export_t export_type) {  
   analysis_roi_t * temp_analyses = tb_roi_analysis->roi_analyses;
   GtkWidget * file_chooser;
   gchar * temp_string;
   gchar * filename = NULL;
+  const gchar * title;
 
   /* sanity checks */
   g_return_if_fail(tb_roi_analysis->roi_analyses != NULL);
 
-  file_chooser = gtk_file_chooser_dialog_new ((!raw_data) ? _("Export Statistics") : _("Export ROI Raw Data Values"),
+  switch(export_type) {
+  case EXPORT_RAW_TEXT:
+    title = _("Export ROI Raw Data Values");
+    break;
+  case EXPORT_RAW_BINARY:
+    title = _("Export ROI Raw Data Values as Binary");
+    break;
+  case EXPORT_STATISTICS:
+  default:
+    title = _("Export Statistics");
+    break;
+  }
+
+  file_chooser = gtk_file_chooser_dialog_new (title,
 					      GTK_WINDOW(tb_roi_analysis->dialog), /* parent window */
 					      GTK_FILE_CHOOSER_ACTION_SAVE,
 					      _("_Cancel"), GTK_RESPONSE_CANCEL,
@@ -152,7 +179,7 @@ static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_data)
   /* take a guess at the filename */
   filename = g_strdup_printf("%s_%s_{%s",
 			     AMITK_OBJECT_NAME(tb_roi_analysis->roi_analyses->study), 
-			     raw_data ? _("roi_raw_data"): _("analysis"),
+			     (export_type != EXPORT_STATISTICS) ? _("roi_raw_data"): _("analysis"),
 			     AMITK_OBJECT_NAME(tb_roi_analysis->roi_analyses->roi));
   
   temp_analyses= tb_roi_analysis->roi_analyses->next_roi_analysis;
@@ -162,7 +189,7 @@ static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_data)
     filename = temp_string;
     temp_analyses= temp_analyses->next_roi_analysis;
   }
-  temp_string = g_strdup_printf("%s}.tsv",filename);
+  temp_string = g_strdup_printf("%s}.%s",filename, (export_type == EXPORT_RAW_BINARY) ? "dat" : "tsv");
   g_free(filename);
   filename = temp_string;
   gtk_file_chooser_set_current_name (GTK_FILE_CHOOSER (file_chooser), filename);
@@ -170,7 +197,11 @@ static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_data)
 
   if (gtk_dialog_run (GTK_DIALOG (file_chooser)) == GTK_RESPONSE_ACCEPT)  {
     filename = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (file_chooser));
-    export_analyses(filename, tb_roi_analysis->roi_analyses, raw_data); /* allright, save the data */
+    /* allright, save the data */
+    if (export_type == EXPORT_RAW_BINARY)
+      export_analyses_binary(filename, tb_roi_analysis->roi_analyses);
+    else
+      export_analyses(filename, tb_roi_analysis->roi_analyses, export_type == EXPORT_RAW_TEXT);
     g_free (filename);
   }
   gtk_widget_destroy (file_chooser);
@@ -178,9 +209,102 @@ static void export_data(tb_roi_analysis_t * tb_roi_analysis, gboolean raw_data)
   return;
 }
 
+/* write out what's accumulated in the buffer once it's big enough, or always if forced */
+static gboolean export_flush(GString * buffer, FILE * file_pointer, gboolean force) {
+
+  gboolean okay = TRUE;
+
+  if ((buffer->len >= EXPORT_BUFFER_SIZE) || (force && (buffer->len > 0))) {
+    okay = (fwrite(buffer->str, 1, buffer->len, file_pointer) == buffer->len);
+    g_string_truncate(buffer, 0);
+  }
+
+  return okay;
+}
+
+/* the comment lines describing an roi */
+static void export_roi_header(GString * buffer, analysis_roi_t * roi_analyses) {
+
+  g_string_append_printf(buffer, _("# ROI:\t%s\tType:\t%s"),
+			 AMITK_OBJECT_NAME(roi_analyses->roi),
+			 amitk_roi_type_get_name(AMITK_ROI_TYPE(roi_analyses->roi)));
+  if (AMITK_ROI_TYPE_ISOCONTOUR(roi_analyses->roi)) {
+    if (AMITK_ROI_ISOCONTOUR_RANGE(roi_analyses->roi) == AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN) 
+      g_string_append_printf(buffer, _("\tIsocontour Above Value:\t%g"), AMITK_ROI_ISOCONTOUR_MIN_VALUE(roi_analyses->roi));
+    else if (AMITK_ROI_ISOCONTOUR_RANGE(roi_analyses->roi) == AMITK_ROI_ISOCONTOUR_RANGE_BELOW_MAX) 
+      g_string_append_printf(buffer, _("\tIsocontour Below Value:\t%g"), AMITK_ROI_ISOCONTOUR_MAX_VALUE(roi_analyses->roi));
+    else  /* AMITK_ROI_ISOCONTOUR_RANGE_BETWEEN_MIN_MAX */
+      g_string_append_printf(buffer, _("\tIsocontour Between Values:\t%g %g"), 
+			     AMITK_ROI_ISOCONTOUR_MIN_VALUE(roi_analyses->roi),
+			     AMITK_ROI_ISOCONTOUR_MAX_VALUE(roi_analyses->roi));
+  }
+  g_string_append_c(buffer, '\n');
+
+  return;
+}
+
+/* the comment lines describing a data set */
+static void export_data_set_header(GString * buffer, AmitkDataSet * ds) {
+
+  g_string_append_printf(buffer, _("#   Data Set:\t%s\tScaling Factor:\t%g\n"),
+			 AMITK_OBJECT_NAME(ds),
+			 AMITK_DATA_SET_SCALE_FACTOR(ds));
+
+  switch(AMITK_DATA_SET_CONVERSION(ds)) {
+  case AMITK_CONVERSION_PERCENT_ID_PER_CC:
+  case AMITK_CONVERSION_SUV:
+    g_string_append_printf(buffer, _("#      Output Data Units: %s\n"),
+			   amitk_conversion_names[AMITK_DATA_SET_CONVERSION(ds)]);
+    g_string_append_printf(buffer, _("#         Injected Dose: %g [%s]\n"),
+			   amitk_dose_unit_convert_to(AMITK_DATA_SET_INJECTED_DOSE(ds),
+						      AMITK_DATA_SET_DISPLAYED_DOSE_UNIT(ds)),
+			   amitk_dose_unit_names[AMITK_DATA_SET_DISPLAYED_DOSE_UNIT(ds)]);
+    g_string_append_printf(buffer, _("#         Cylinder Factor: %g [%s]\n"),
+			   amitk_cylinder_unit_convert_to(AMITK_DATA_SET_CYLINDER_FACTOR(ds),
+							  AMITK_DATA_SET_DISPLAYED_CYLINDER_UNIT(ds)),
+			   amitk_cylinder_unit_names[AMITK_DATA_SET_DISPLAYED_CYLINDER_UNIT(ds)]);
+    break;
+  default:
+    break;
+  }
+
+  switch(AMITK_DATA_SET_CONVERSION(ds)) {
+  case AMITK_CONVERSION_SUV:
+    g_string_append_printf(buffer, _("#         Subject Weight: %g [%s]\n"),
+			   amitk_weight_unit_convert_to(AMITK_DATA_SET_SUBJECT_WEIGHT(ds),
+							AMITK_DATA_SET_DISPLAYED_WEIGHT_UNIT(ds)),
+			   amitk_weight_unit_names[AMITK_DATA_SET_DISPLAYED_WEIGHT_UNIT(ds)]);
+    break;
+  default:
+    break;
+  }
+
+  return;
+}
+
+/* the statistics for a frame/gate following the frame column, without the trailing newline */
+static void export_gate_stats(GString * buffer, analysis_gate_t * gate_analyses,
+			      guint gate, amide_real_t voxel_volume) {
+
+  g_string_append_printf(buffer, "\t% 12.3f\t% 12.3f\t% 12d\t% 12.3f", 
+			 gate_analyses->duration, gate_analyses->time_midpoint,
+			 gate, gate_analyses->gate_time);
+  /*  g_string_append_printf(buffer, "\t% 12g", gate_analyses->total); */
+  g_string_append_printf(buffer, "\t% 12g\t% 12g\t% 12g\t% 12g\t% 12g\t% 12g",
+			 gate_analyses->median, gate_analyses->mean, gate_analyses->var,
+			 sqrt(gate_analyses->var), gate_analyses->min, gate_analyses->max);
+  g_string_append_printf(buffer, "\t% 12g\t% 12.2f\t% 12d",
+			 gate_analyses->fractional_voxels*voxel_volume,
+			 gate_analyses->fractional_voxels,
+			 gate_analyses->voxels);
+
+  return;
+}
+
 static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_analyses, gboolean raw_data) {
 
   FILE * file_pointer;
+  GString * buffer;
   time_t current_time;
   analysis_volume_t * volume_analyses;
   analysis_frame_t * frame_analyses;
@@ -190,6 +314,7 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
   guint i;
   amide_real_t voxel_volume;
   gboolean title_printed;
+  gboolean okay = TRUE;
   AmitkPoint location;
   analysis_element_t * element;
 
@@ -200,43 +325,31 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
     g_warning(_("couldn't open: %s for writing roi data"), save_filename);
     return;
   }
+  buffer = g_string_sized_new(EXPORT_BUFFER_SIZE);
 
   /* intro information */
   time(&current_time);
-  fprintf(file_pointer, _("# %s: ROI Analysis File - generated on %s"), PACKAGE, ctime(&current_time));
-  fprintf(file_pointer, "#\n");
-  fprintf(file_pointer, _("# Study:\t%s\n"), AMITK_OBJECT_NAME(roi_analyses->study));
-  fprintf(file_pointer, "#\n");
+  g_string_append_printf(buffer, _("# %s: ROI Analysis File - generated on %s"), PACKAGE, ctime(&current_time));
+  g_string_append(buffer, "#\n");
+  g_string_append_printf(buffer, _("# Study:\t%s\n"), AMITK_OBJECT_NAME(roi_analyses->study));
+  g_string_append(buffer, "#\n");
   
   while (roi_analyses != NULL) {
-    fprintf(file_pointer, _("# ROI:\t%s\tType:\t%s"),
-	    AMITK_OBJECT_NAME(roi_analyses->roi),
-	    amitk_roi_type_get_name(AMITK_ROI_TYPE(roi_analyses->roi)));
-    if (AMITK_ROI_TYPE_ISOCONTOUR(roi_analyses->roi)) {
-      if (AMITK_ROI_ISOCONTOUR_RANGE(roi_analyses->roi) == AMITK_ROI_ISOCONTOUR_RANGE_ABOVE_MIN) 
-	fprintf(file_pointer, _("\tIsocontour Above Value:\t%g"), AMITK_ROI_ISOCONTOUR_MIN_VALUE(roi_analyses->roi));
-      else if (AMITK_ROI_ISOCONTOUR_RANGE(roi_analyses->roi) == AMITK_ROI_ISOCONTOUR_RANGE_BELOW_MAX) 
-	fprintf(file_pointer, _("\tIsocontour Below Value:\t%g"), AMITK_ROI_ISOCONTOUR_MAX_VALUE(roi_analyses->roi));
-      else  /* AMITK_ROI_ISOCONTOUR_RANGE_BETWEEN_MIN_MAX */
-	fprintf(file_pointer, _("\tIsocontour Between Values:\t%g %g"), 
-		AMITK_ROI_ISOCONTOUR_MIN_VALUE(roi_analyses->roi),
-		AMITK_ROI_ISOCONTOUR_MAX_VALUE(roi_analyses->roi));
-    }
-    fprintf(file_pointer,"\n");
+    export_roi_header(buffer, roi_analyses);
 
     if (!raw_data) {
       switch(roi_analyses->calculation_type) {
       case ALL_VOXELS:
-	fprintf(file_pointer, _("#   Calculation done with all voxels in ROI\n"));
+	g_string_append(buffer, _("#   Calculation done with all voxels in ROI\n"));
 	break;
       case HIGHEST_FRACTION_VOXELS:
-	fprintf(file_pointer, _("#   Calculation done on %5.3f percentile of voxels in ROI\n"), roi_analyses->subfraction*100);
+	g_string_append_printf(buffer, _("#   Calculation done on %5.3f percentile of voxels in ROI\n"), roi_analyses->subfraction*100);
 	break;
       case VOXELS_NEAR_MAX:
-	fprintf(file_pointer, _("#   Calculation done on voxels >= %5.3f percent of maximum value in ROI\n"), roi_analyses->threshold_percentage);
+	g_string_append_printf(buffer, _("#   Calculation done on voxels >= %5.3f percent of maximum value in ROI\n"), roi_analyses->threshold_percentage);
 	break;
       case VOXELS_GREATER_THAN_VALUE:
-	fprintf(file_pointer, _("#   Calculation done on voxels >= %g in ROI\n"), roi_analyses->threshold_value);
+	g_string_append_printf(buffer, _("#   Calculation done on voxels >= %g in ROI\n"), roi_analyses->threshold_value);
 	break;
       default:
 	g_error("unexpected case in %s at line %d",__FILE__, __LINE__);
@@ -248,44 +361,13 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
     volume_analyses = roi_analyses->volume_analyses;
     while (volume_analyses != NULL) {
 
-      fprintf(file_pointer, _("#   Data Set:\t%s\tScaling Factor:\t%g\n"),
-	      AMITK_OBJECT_NAME(volume_analyses->data_set),
-	      AMITK_DATA_SET_SCALE_FACTOR(volume_analyses->data_set));
-
-      switch(AMITK_DATA_SET_CONVERSION(volume_analyses->data_set)) {
-      case AMITK_CONVERSION_PERCENT_ID_PER_CC:
-      case AMITK_CONVERSION_SUV:
-	fprintf(file_pointer, _("#      Output Data Units: %s\n"),
-		amitk_conversion_names[AMITK_DATA_SET_CONVERSION(volume_analyses->data_set)]);
-	fprintf(file_pointer, _("#         Injected Dose: %g [%s]\n"),
-		amitk_dose_unit_convert_to(AMITK_DATA_SET_INJECTED_DOSE(volume_analyses->data_set),
-					   AMITK_DATA_SET_DISPLAYED_DOSE_UNIT(volume_analyses->data_set)),
-		amitk_dose_unit_names[AMITK_DATA_SET_DISPLAYED_DOSE_UNIT(volume_analyses->data_set)]);
-	fprintf(file_pointer, _("#         Cylinder Factor: %g [%s]\n"),
- 		amitk_cylinder_unit_convert_to(AMITK_DATA_SET_CYLINDER_FACTOR(volume_analyses->data_set),
-					       AMITK_DATA_SET_DISPLAYED_CYLINDER_UNIT(volume_analyses->data_set)),
-		amitk_cylinder_unit_names[AMITK_DATA_SET_DISPLAYED_CYLINDER_UNIT(volume_analyses->data_set)]);
-	break;
-      default:
-	break;
-      }
-
-      switch(AMITK_DATA_SET_CONVERSION(volume_analyses->data_set)) {
-      case AMITK_CONVERSION_SUV:
-	fprintf(file_pointer, _("#         Subject Weight: %g [%s]\n"),
- 		amitk_weight_unit_convert_to(AMITK_DATA_SET_SUBJECT_WEIGHT(volume_analyses->data_set),
-					       AMITK_DATA_SET_DISPLAYED_WEIGHT_UNIT(volume_analyses->data_set)),
-		amitk_weight_unit_names[AMITK_DATA_SET_DISPLAYED_WEIGHT_UNIT(volume_analyses->data_set)]);
-	break;
-      default:
-	break;
-      }
+      export_data_set_header(buffer, volume_analyses->data_set);
 
       if ((!raw_data) && (!title_printed)) {
-	fprintf(file_pointer, "#   %s", _(analysis_titles[COLUMN_FRAME]));
+	g_string_append_printf(buffer, "#   %s", _(analysis_titles[COLUMN_FRAME]));
 	for (i=COLUMN_FRAME+1;i<NUM_ANALYSIS_COLUMNS;i++)
-	  fprintf(file_pointer, "\t%12s", _(analysis_titles[i]));
-	fprintf(file_pointer, "\n");
+	  g_string_append_printf(buffer, "\t%12s", _(analysis_titles[i]));
+	g_string_append_c(buffer, '\n');
 	title_printed = TRUE;
       }
 
@@ -299,32 +381,21 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
 	gate = 0;
 	while (gate_analyses != NULL) {
 	  if (!raw_data) {
-	    fprintf(file_pointer, "    %5d", frame);
-	    fprintf(file_pointer, "\t% 12.3f", gate_analyses->duration);
-	    fprintf(file_pointer, "\t% 12.3f", gate_analyses->time_midpoint);
-	    fprintf(file_pointer, "\t% 12d", gate);
-	    fprintf(file_pointer, "\t% 12.3f", gate_analyses->gate_time);
-	    /*	  fprintf(file_pointer, "\t% 12g", gate_analyses->total); */
-	    fprintf(file_pointer, "\t% 12g", gate_analyses->median);
-	    fprintf(file_pointer, "\t% 12g", gate_analyses->mean);
-	    fprintf(file_pointer, "\t% 12g", gate_analyses->var);
-	    fprintf(file_pointer, "\t% 12g", sqrt(gate_analyses->var));
-	    fprintf(file_pointer, "\t% 12g", gate_analyses->min);
-	    fprintf(file_pointer, "\t% 12g", gate_analyses->max);
-	    fprintf(file_pointer, "\t% 12g", gate_analyses->fractional_voxels*voxel_volume);
-	    fprintf(file_pointer, "\t% 12.2f", gate_analyses->fractional_voxels);
-	    fprintf(file_pointer, "\t% 12d", gate_analyses->voxels);
-	    fprintf(file_pointer, "\n");
+	    g_string_append_printf(buffer, "    %5d", frame);
+	    export_gate_stats(buffer, gate_analyses, gate, voxel_volume);
+	    g_string_append_c(buffer, '\n');
 	  } else { /* raw data */
-	    fprintf(file_pointer, "#   Frame %d, Gate %d, Gate Time %5.3f\n", frame, gate,gate_analyses->gate_time);
-	    fprintf(file_pointer, "#      Value\t      Weight\t      X (mm)\t      Y (mm)\t      Z (mm)\n");
+	    g_string_append_printf(buffer, "#   Frame %d, Gate %d, Gate Time %5.3f\n", frame, gate,gate_analyses->gate_time);
+	    g_string_append(buffer, "#      Value\t      Weight\t      X (mm)\t      Y (mm)\t      Z (mm)\n");
 	    for (i=0; i < gate_analyses->data_array->len; i++) {
 	      element = g_ptr_array_index(gate_analyses->data_array, i);
 	      VOXEL_TO_POINT(element->ds_voxel, AMITK_DATA_SET_VOXEL_SIZE(volume_analyses->data_set),location);
 	      location = amitk_space_s2b(AMITK_SPACE(volume_analyses->data_set), location);
-	      fprintf(file_pointer, "%12g\t%12g\t%12g\t%12g\t%12g\n", element->value, element->weight, location.x, location.y, location.z);
+	      g_string_append_printf(buffer, "%12g\t%12g\t%12g\t%12g\t%12g\n", element->value, element->weight, location.x, location.y, location.z);
+	      okay = export_flush(buffer, file_pointer, FALSE) && okay;
 	    }
 	  }
+	  okay = export_flush(buffer, file_pointer, FALSE) && okay;
 
 	  gate_analyses = gate_analyses->next_gate_analysis;
 	  gate++;
@@ -337,18 +408,129 @@ static void export_analyses(const gchar * save_filename, analysis_roi_t * roi_an
     }
     roi_analyses = roi_analyses->next_roi_analysis;
     if (roi_analyses != NULL)
-      fprintf(file_pointer, "#\n");
+      g_string_append(buffer, "#\n");
   }
 
+  okay = export_flush(buffer, file_pointer, TRUE) && okay;
+  g_string_free(buffer, TRUE);
 
-  fclose(file_pointer);
+  if (fclose(file_pointer) != 0) okay = FALSE;
+  if (!okay)
+    g_warning(_("error writing roi data to: %s"), save_filename);
+
+  return;
+}
+
+/* dump the raw voxel values as fixed size little endian records behind a
+   text header, this is a lot smaller and quicker than the text version for
+   big dynamic studies */
+static void export_analyses_binary(const gchar * save_filename, analysis_roi_t * roi_analyses) {
+
+  FILE * file_pointer;
+  GString * buffer;
+  time_t current_time;
+  analysis_roi_t * temp_roi_analyses;
+  analysis_volume_t * volume_analyses;
+  analysis_frame_t * frame_analyses;
+  analysis_gate_t * gate_analyses;
+  guint32 record[EXPORT_RECORD_FIELDS];
+  guint32 roi_num, data_set_num;
+  guint32 frame, gate;
+  guint i;
+  gboolean okay = TRUE;
+  AmitkPoint location;
+  analysis_element_t * element;
+  union {
+    gfloat f;
+    guint32 u;
+  } value;
+
+  /* sanity checks */
+  g_return_if_fail(save_filename != NULL);
+
+  if ((file_pointer = fopen(save_filename, "wb")) == NULL) {
+    g_warning(_("couldn't open: %s for writing roi data"), save_filename);
+    return;
+  }
+  buffer = g_string_sized_new(EXPORT_BUFFER_SIZE);
+
+  /* the header says what the indices in the records refer to */
+  time(&current_time);
+  g_string_append_printf(buffer, _("# %s: ROI Raw Data File - generated on %s"), PACKAGE, ctime(&current_time));
+  g_string_append(buffer, "#\n");
+  g_string_append_printf(buffer, _("# Study:\t%s\n"), AMITK_OBJECT_NAME(roi_analyses->study));
+  g_string_append(buffer, "#\n");
+
+  for (temp_roi_analyses = roi_analyses, roi_num = 0; 
+       temp_roi_analyses != NULL; 
+       temp_roi_analyses = temp_roi_analyses->next_roi_analysis, roi_num++) {
+    g_string_append_printf(buffer, _("# ROI Index: %d\n"), roi_num);
+    export_roi_header(buffer, temp_roi_analyses);
+    for (volume_analyses = temp_roi_analyses->volume_analyses, data_set_num = 0;
+	 volume_analyses != NULL;
+	 volume_analyses = volume_analyses->next_volume_analysis, data_set_num++) {
+      g_string_append_printf(buffer, _("#   Data Set Index: %d\n"), data_set_num);
+      export_data_set_header(buffer, volume_analyses->data_set);
+    }
+  }
+  g_string_append(buffer, "#\n");
+  g_string_append_printf(buffer, _("# Each record is %d bytes, little endian:\n"), 
+			 (gint) (EXPORT_RECORD_FIELDS*sizeof(guint32)));
+  g_string_append(buffer, _("#   uint32 ROI Index, uint32 Data Set Index, uint32 Frame, uint32 Gate,\n"));
+  g_string_append(buffer, _("#   uint32 Voxel X, uint32 Voxel Y, uint32 Voxel Z,\n"));
+  g_string_append(buffer, _("#   float32 Value, float32 Weight, float32 X (mm), float32 Y (mm), float32 Z (mm)\n"));
+  g_string_append(buffer, EXPORT_END_OF_HEADER);
+
+  /* and the records */
+  for (roi_num = 0; roi_analyses != NULL; roi_analyses = roi_analyses->next_roi_analysis, roi_num++) {
+    for (volume_analyses = roi_analyses->volume_analyses, data_set_num = 0;
+	 volume_analyses != NULL;
+	 volume_analyses = volume_analyses->next_volume_analysis, data_set_num++) {
+      for (frame_analyses = volume_analyses->frame_analyses, frame = 0;
+	   frame_analyses != NULL;
+	   frame_analyses = frame_analyses->next_frame_analysis, frame++) {
+	for (gate_analyses = frame_analyses->gate_analyses, gate = 0;
+	     gate_analyses != NULL;
+	     gate_analyses = gate_analyses->next_gate_analysis, gate++) {
+	  for (i=0; i < gate_analyses->data_array->len; i++) {
+	    element = g_ptr_array_index(gate_analyses->data_array, i);
+	    VOXEL_TO_POINT(element->ds_voxel, AMITK_DATA_SET_VOXEL_SIZE(volume_analyses->data_set),location);
+	    location = amitk_space_s2b(AMITK_SPACE(volume_analyses->data_set), location);
+
+	    record[0] = GUINT32_TO_LE(roi_num);
+	    record[1] = GUINT32_TO_LE(data_set_num);
+	    record[2] = GUINT32_TO_LE(frame);
+	    record[3] = GUINT32_TO_LE(gate);
+	    record[4] = GUINT32_TO_LE(element->ds_voxel.x);
+	    record[5] = GUINT32_TO_LE(element->ds_voxel.y);
+	    record[6] = GUINT32_TO_LE(element->ds_voxel.z);
+	    value.f = element->value;   record[7] = GUINT32_TO_LE(value.u);
+	    value.f = element->weight;  record[8] = GUINT32_TO_LE(value.u);
+	    value.f = location.x;       record[9] = GUINT32_TO_LE(value.u);
+	    value.f = location.y;       record[10] = GUINT32_TO_LE(value.u);
+	    value.f = location.z;       record[11] = GUINT32_TO_LE(value.u);
+
+	    g_string_append_len(buffer, (gchar *) record, sizeof(record));
+	    okay = export_flush(buffer, file_pointer, FALSE) && okay;
+	  }
+	}
+      }
+    }
+  }
+
+  okay = export_flush(buffer, file_pointer, TRUE) && okay;
+  g_string_free(buffer, TRUE);
+
+  if (fclose(file_pointer) != 0) okay = FALSE;
+  if (!okay)
+    g_warning(_("error writing roi data to: %s"), save_filename);
 
   return;
 }
 
 static gchar * analyses_as_string(analysis_roi_t * roi_analyses) {
 
-  gchar * roi_stats;
+  GString * roi_stats;
   time_t current_time;
   analysis_volume_t * volume_analyses;
   analysis_frame_t * frame_analyses;
@@ -360,15 +542,16 @@ static gchar * analyses_as_string(analysis_roi_t * roi_analyses) {
 
   /* intro information */
   time(&current_time);
-  roi_stats = g_strdup_printf(_("# Stats for Study: %s\tGenerated on: %s"),
-			      AMITK_OBJECT_NAME(roi_analyses->study), ctime(&current_time));
+  roi_stats = g_string_new(NULL);
+  g_string_append_printf(roi_stats, _("# Stats for Study: %s\tGenerated on: %s"),
+			 AMITK_OBJECT_NAME(roi_analyses->study), ctime(&current_time));
   
   /* print the titles */
-  amitk_append_str(&roi_stats,"# %-10s", _(analysis_titles[COLUMN_ROI_NAME]));
-  amitk_append_str(&roi_stats,"\t%-12s", _(analysis_titles[COLUMN_DATA_SET_NAME]));
+  g_string_append_printf(roi_stats,"# %-10s", _(analysis_titles[COLUMN_ROI_NAME]));
+  g_string_append_printf(roi_stats,"\t%-12s", _(analysis_titles[COLUMN_DATA_SET_NAME]));
   for (i=COLUMN_DATA_SET_NAME+1;i<NUM_ANALYSIS_COLUMNS;i++)
-    amitk_append_str(&roi_stats,"\t%12s", _(analysis_titles[i]));
-  amitk_append_str(&roi_stats,"\n");
+    g_string_append_printf(roi_stats,"\t%12s", _(analysis_titles[i]));
+  g_string_append_c(roi_stats, '\n');
 
   /* print the stats */
   while (roi_analyses != NULL) {
@@ -386,25 +569,12 @@ static gchar * analyses_as_string(analysis_roi_t * roi_analyses) {
 	gate_analyses = frame_analyses->gate_analyses;
 	gate = 0;
 	while (gate_analyses != NULL) {
-	  amitk_append_str(&roi_stats, "%-12s\t%-12s",
-			   AMITK_OBJECT_NAME(roi_analyses->roi),
-			   AMITK_OBJECT_NAME(volume_analyses->data_set));
-
-	  amitk_append_str(&roi_stats, "\t% 12d", frame);
-	  amitk_append_str(&roi_stats, "\t% 12.3f", gate_analyses->duration);
-	  amitk_append_str(&roi_stats, "\t% 12.3f", gate_analyses->time_midpoint);
-	  amitk_append_str(&roi_stats, "\t% 12d", gate);
-	  amitk_append_str(&roi_stats, "\t% 12.3f", gate_analyses->gate_time);
-	  /*	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->total); */
-	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->median);
-	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->mean);
-	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->var);
-	  amitk_append_str(&roi_stats, "\t% 12g", sqrt(gate_analyses->var));
-	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->min);
-	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->max);
-	  amitk_append_str(&roi_stats, "\t% 12g", gate_analyses->fractional_voxels*voxel_volume);
-	  amitk_append_str(&roi_stats, "\t% 12.2f", gate_analyses->fractional_voxels);
-	  amitk_append_str(&roi_stats, "\t% 12d\n", gate_analyses->voxels);
+	  g_string_append_printf(roi_stats, "%-12s\t%-12s",
+				 AMITK_OBJECT_NAME(roi_analyses->roi),
+				 AMITK_OBJECT_NAME(volume_analyses->data_set));
+	  g_string_append_printf(roi_stats, "\t% 12d", frame);
+	  export_gate_stats(roi_stats, gate_analyses, gate, voxel_volume);
+	  g_string_append_c(roi_stats, '\n');
 
 	  gate_analyses = gate_analyses->next_gate_analysis;
 	  gate++;
@@ -419,7 +589,7 @@ static gchar * analyses_as_string(analysis_roi_t * roi_analyses) {
   }
 
 
-  return roi_stats;
+  return g_string_free(roi_stats, FALSE);
 }
 
 static void response_cb (GtkDialog * dialog, gint response_id, gpointer data) {
@@ -431,11 +601,15 @@ static void response_cb (GtkDialog * dialog, gint response_id, gpointer data) {
 
   switch(response_id) {
   case AMITK_RESPONSE_SAVE_AS:
-    export_data(tb_roi_analysis, FALSE);
+    export_data(tb_roi_analysis, EXPORT_STATISTICS);
     break;
 
   case AMITK_RESPONSE_SAVE_RAW_AS:
-    export_data(tb_roi_analysis, TRUE);
+    export_data(tb_roi_analysis, EXPORT_RAW_TEXT);
+    break;
+
+  case AMITK_RESPONSE_SAVE_RAW_BINARY_AS:
+    export_data(tb_roi_analysis, EXPORT_RAW_BINARY);
     break;
 
   case AMITK_RESPONSE_COPY:
@@ -834,6 +1008,7 @@ void tb_roi_analysis(AmitkStudy * study, AmitkPreferences * preferences, GtkWind
 							_("Save _As"), AMITK_RESPONSE_SAVE_AS,
 							_("_Copy"), AMITK_RESPONSE_COPY,
 							"Save Raw Values", AMITK_RESPONSE_SAVE_RAW_AS,
+							_("Save Raw Binary"), AMITK_RESPONSE_SAVE_RAW_BINARY_AS,
 							_("_Help"), GTK_RESPONSE_HELP,
 							_("_Close"), GTK_RESPONSE_CLOSE,
 							NULL);
@@ -57,6 +57,7 @@ static void threshold_style_cb(GtkWidget * widget, gpointer data);
 
 static void warnings_to_console_cb(GtkWidget * widget, gpointer data);
 static void save_on_exit_cb(GtkWidget * widget, gpointer data);
+static void save_xif_compressed_cb(GtkWidget * widget, gpointer data);
 static void which_default_directory_cb(GtkWidget * widget, gpointer data);
 static void default_directory_cb(GtkWidget * fc, gpointer data);
 static void response_cb (GtkDialog * dialog, gint response_id, gpointer data);
@@ -172,6 +173,15 @@ static void save_on_exit_cb(GtkWidget * widget, gpointer data) {
   return;
 }
 
+static void save_xif_compressed_cb(GtkWidget * widget, gpointer data) {
+
+  ui_study_t * ui_study = data;
+  amitk_preferences_set_xif_compressed(ui_study->preferences, 
+				       gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget)));
+
+  return;
+}
+
 static void which_default_directory_cb(GtkWidget * widget, gpointer data) {
 
   ui_study_t * ui_study = data;
@@ -514,6 +524,17 @@ void ui_preferences_dialog_create(ui_study_t * ui_study) {
   table_row++;
 
 
+  label = gtk_label_new(_("Compress Data in Saved XIF Files:"));
+  gtk_grid_attach(GTK_GRID(packing_table), label, 0, table_row, 1, 1);
+
+  check_button = gtk_check_button_new();
+  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), 
+			       AMITK_PREFERENCES_SAVE_XIF_COMPRESSED(ui_study->preferences));
+  g_signal_connect(G_OBJECT(check_button), "toggled", G_CALLBACK(save_xif_compressed_cb), ui_study);
+  gtk_grid_attach(GTK_GRID(packing_table), check_button, 1, table_row, 1, 1);
+  table_row++;
+
+
   label = gtk_label_new(_("Which Default Directory:"));
   gtk_grid_attach(GTK_GRID(packing_table), label, 0, table_row, 1, 1);
 
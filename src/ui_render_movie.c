@@ -36,6 +36,8 @@
 #include "amitk_type_builtins.h"
 #include "amitk_progress_dialog.h"
 #include "mpeg_encode.h"
+#include "mip.h"
+#include "image.h"
 
 
 #define MOVIE_DEFAULT_DURATION 10.0
@@ -61,6 +63,8 @@ typedef struct ui_render_movie_t {
   guint end_frame;
   gdouble rotation[AMITK_AXIS_NUM];
   dynamic_t type;
+  gboolean use_mip; /* intensity projections instead of volume rendering */
+  mip_type_t mip_type;
   gboolean in_generation;
   gboolean quit_generation;
 
@@ -78,6 +82,7 @@ typedef struct ui_render_movie_t {
   GtkWidget * time_on_image_label;
   GtkWidget * time_on_image_button;
   GtkWidget * dynamic_type;
+  GtkWidget * projection_menu;
   GtkWidget * axis_spin_button[AMITK_AXIS_NUM];
 
   guint reference_count;
@@ -89,6 +94,7 @@ typedef struct ui_render_movie_t {
 static void change_frames_cb(GtkWidget * widget, gpointer data);
 static void change_rotation_cb(GtkWidget * widget, gpointer data);
 static void dynamic_type_cb(GtkWidget * widget, gpointer data);
+static void change_projection_cb(GtkWidget * widget, gpointer data);
 static void change_start_time_cb(GtkWidget * widget, gpointer data);
 static void change_start_frame_cb(GtkWidget * widget, gpointer data);
 static void change_end_time_cb(GtkWidget * widget, gpointer data);
@@ -101,6 +107,10 @@ static void dialog_set_sensitive(ui_render_movie_t * ui_render_movie, gboolean s
 
 static ui_render_movie_t * movie_unref(ui_render_movie_t * ui_render_movie);
 static ui_render_movie_t * movie_init(void);
+static void movie_set_frame_time(ui_render_movie_t * ui_render_movie, guint i_frame, 
+				 guint num_frames, AmitkDataSet * most_frames_ds);
+static void movie_generate_mip(ui_render_movie_t * ui_render_movie, gchar * output_filename,
+			       guint num_frames, AmitkDataSet * most_frames_ds);
 static void movie_generate(ui_render_movie_t * ui_render_movie, char * output_file_name);
 
 
@@ -177,6 +187,24 @@ static void dynamic_type_cb(GtkWidget * widget, gpointer data) {
   return;
 }
 
+/* entry 0 is volume rendering, the rest are the intensity projections */
+static void change_projection_cb(GtkWidget * widget, gpointer data) {
+
+  ui_render_movie_t * ui_render_movie = data;
+  gint which;
+
+  which = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+  ui_render_movie->use_mip = (which > 0);
+  if (ui_render_movie->use_mip)
+    ui_render_movie->mip_type = which-1;
+
+  /* the time label is drawn by the rendering canvas */
+  if (ui_render_movie->use_mip)
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(ui_render_movie->time_on_image_button), FALSE);
+  gtk_widget_set_sensitive(ui_render_movie->time_on_image_button, !ui_render_movie->use_mip);
+
+  return;
+}
 
 /* function to change the start time */
 static void change_start_time_cb(GtkWidget * widget, gpointer data) {
@@ -326,6 +354,7 @@ static void dialog_set_sensitive(ui_render_movie_t * ui_render_movie, gboolean s
   gtk_widget_set_sensitive(ui_render_movie->start_frame_spin_button, sensitive);
   gtk_widget_set_sensitive(ui_render_movie->end_frame_spin_button, sensitive);
   gtk_widget_set_sensitive(ui_render_movie->dynamic_type, sensitive);
+  gtk_widget_set_sensitive(ui_render_movie->projection_menu, sensitive);
   gtk_dialog_set_response_sensitive(GTK_DIALOG(ui_render_movie->dialog), 
 				    AMITK_RESPONSE_EXECUTE, sensitive);
 }
@@ -387,6 +416,8 @@ static ui_render_movie_t * movie_init(void) {
   ui_render_movie->rotation[AMITK_AXIS_Y] = 1;
   ui_render_movie->rotation[AMITK_AXIS_Z] = 0;
   ui_render_movie->type = NOT_DYNAMIC;
+  ui_render_movie->use_mip = FALSE;
+  ui_render_movie->mip_type = MIP_TYPE_MAXIMUM;
   ui_render_movie->ui_render = NULL;
   ui_render_movie->start_time = 0.0;
   ui_render_movie->end_time = 1.0;
@@ -401,6 +432,179 @@ static ui_render_movie_t * movie_init(void) {
 
 
 
+/* sets the time (or gates) rendered for frame i_frame of the movie */
+static void movie_set_frame_time(ui_render_movie_t * ui_render_movie, guint i_frame, 
+				 guint num_frames, AmitkDataSet * most_frames_ds) {
+
+  ui_render_t * ui_render = ui_render_movie->ui_render;
+  renderings_t * renderings;
+  guint ds_frame=0;
+  gdouble ds_frame_real;
+  amide_time_t start_time, duration;
+  gint ds_gate;
+
+  switch (ui_render_movie->type) {
+  case OVER_TIME:
+    ui_render->start = ui_render_movie->start_time + i_frame*ui_render->duration;
+    break;
+  case OVER_FRAMES_SMOOTHED:
+  case OVER_FRAMES:
+    if (most_frames_ds) {
+      ds_frame_real = (i_frame/((gdouble) num_frames)) * AMITK_DATA_SET_NUM_FRAMES(most_frames_ds);
+      ds_frame = floor(ds_frame_real);
+      start_time = amitk_data_set_get_start_time(most_frames_ds, ds_frame);
+      duration = amitk_data_set_get_end_time(most_frames_ds, ds_frame) - start_time;
+      ui_render->start = start_time + EPSILON*fabs(start_time) + 
+	((ui_render_movie->type == OVER_FRAMES_SMOOTHED) ? ((ds_frame_real-ds_frame)*duration) : 0.0);
+      ui_render->duration = duration - EPSILON*fabs(duration);
+    } else { /* just have roi's.... doesn't make much sense if we get here */
+      ui_render->start = 0.0;
+      ui_render->duration = 1.0;
+    }
+    break;
+  case OVER_GATES:
+    renderings = ui_render->renderings;
+    while (renderings != NULL) {
+      if (AMITK_IS_DATA_SET(renderings->rendering->object)) {
+	ds_gate = floor((i_frame/((gdouble) num_frames))*AMITK_DATA_SET_NUM_GATES(renderings->rendering->object));
+	amitk_data_set_set_view_start_gate(AMITK_DATA_SET(renderings->rendering->object), ds_gate);
+	amitk_data_set_set_view_end_gate(AMITK_DATA_SET(renderings->rendering->object), ds_gate);
+      }
+      renderings = renderings->next;
+    }
+    break;
+  default:
+    /* NOT_DYNAMIC */
+    break;
+  }
+
+  return;
+}
+
+/* generate the movie as intensity projections of the first data set in the
+   rendering, instead of going through volpack.  The views follow the 
+   rendering's current orientation.  A movie that isn't dynamic only needs the 
+   volume extracted once, so its frames get projected a batch at a time. */
+static void movie_generate_mip(ui_render_movie_t * ui_render_movie, gchar * output_filename,
+			       guint num_frames, AmitkDataSet * most_frames_ds) {
+
+  ui_render_t * ui_render = ui_render_movie->ui_render;
+  renderings_t * renderings;
+  rendering_t * rendering=NULL;
+  mip_t * mip=NULL;
+  AmitkSpace * view_space=NULL;
+  AmitkAxes * views=NULL;
+  gfloat ** images=NULL;
+  guint batch_views, num_views=0, i_view;
+  guint i_frame;
+  AmitkAxis i_axis;
+  gpointer mpeg_encode_context=NULL;
+  GdkPixbuf * pixbuf;
+  gboolean continue_work=TRUE;
+  gboolean return_val=TRUE;
+
+  for (renderings = ui_render->renderings; 
+       (renderings != NULL) && (rendering == NULL); 
+       renderings = renderings->next)
+    if (AMITK_IS_DATA_SET(renderings->rendering->object))
+      rendering = renderings->rendering;
+  if (rendering == NULL) {
+    g_warning(_("No data set in the rendering to project"));
+    return;
+  }
+
+  mip = mip_init(AMITK_DATA_SET(rendering->object), 
+		 AMITK_SPACE(rendering->extraction_volume), 
+		 ui_render_movie->mip_type);
+  if (mip == NULL) return;
+
+  batch_views = (ui_render_movie->type == NOT_DYNAMIC) ? amitk_get_num_threads() : 1;
+  if (((views = g_try_new(AmitkAxes, batch_views)) == NULL) ||
+      ((images = g_try_new0(gfloat *, batch_views)) == NULL)) {
+    g_warning(_("couldn't allocate memory space for the projection images"));
+    goto exit;
+  }
+  for (i_view = 0; i_view < batch_views; i_view++)
+    if ((images[i_view] = g_try_new(gfloat, mip->image_dim*mip->image_dim)) == NULL) {
+      g_warning(_("couldn't allocate memory space for the projection images"));
+      goto exit;
+    }
+
+  mpeg_encode_context = mpeg_encode_setup(output_filename, ENCODE_MPEG1,
+					  mip->image_dim, mip->image_dim);
+  if (mpeg_encode_context == NULL) goto exit;
+
+  view_space = amitk_space_new();
+
+  for (i_frame = 0; 
+       ((i_frame < num_frames) && !ui_render_movie->quit_generation && return_val && continue_work);
+       i_frame += num_views) {
+
+    /* update the progress bar */
+    continue_work = amitk_progress_dialog_set_fraction(AMITK_PROGRESS_DIALOG(ui_render_movie->progress_dialog),
+						       (gdouble) i_frame/((gdouble) num_frames));
+
+    num_views = MIN(batch_views, num_frames-i_frame);
+    movie_set_frame_time(ui_render_movie, i_frame, num_frames, most_frames_ds);
+    if (!mip_load(mip, ui_render->start, ui_render->duration, NULL, NULL)) {
+      return_val = FALSE;
+      break;
+    }
+
+    /* rotate the same way the rendering contexts get rotated */
+    for (i_view = 0; i_view < num_views; i_view++) {
+      amitk_space_copy_in_place(view_space, AMITK_SPACE(rendering->transformed_volume));
+      for (i_axis = 0; i_axis < AMITK_AXIS_NUM ; i_axis++) 
+	amitk_space_rotate_on_vector(view_space, amitk_space_get_axis(view_space, i_axis),
+				     (((gdouble) (i_frame+i_view))*2.0*M_PI*ui_render_movie->rotation[i_axis])
+				     / num_frames, zero_point);
+      for (i_axis = 0; i_axis < AMITK_AXIS_NUM ; i_axis++) 
+	views[i_view][i_axis] = amitk_space_get_axis(view_space, i_axis);
+    }
+
+    return_val = mip_project(mip, views, num_views, images);
+
+    for (i_view = 0; (i_view < num_views) && return_val; i_view++) {
+      pixbuf = image_from_float_data(mip->data_set, images[i_view], 
+				     mip->image_dim, mip->image_dim,
+				     ui_render->start, ui_render->duration);
+      if (pixbuf == NULL) {
+	return_val = FALSE;
+	break;
+      }
+      return_val = mpeg_encode_frame(mpeg_encode_context, pixbuf);
+      g_object_unref(pixbuf);
+    }
+
+    /* keep the dialog responsive */
+    while (gtk_events_pending()) 
+      gtk_main_iteration();
+  }
+
+  if (!return_val)
+    g_warning(_("Failed to generate the projection movie, stopped near frame %u"), i_frame);
+
+ exit:
+
+  if (mpeg_encode_context != NULL)
+    if (!mpeg_encode_close(mpeg_encode_context) && return_val)
+      g_warning(_("Encoding of the projection movie failed"));
+
+  if (view_space != NULL)
+    g_object_unref(view_space);
+
+  if (images != NULL) {
+    for (i_view = 0; i_view < batch_views; i_view++)
+      g_free(images[i_view]);
+    g_free(images);
+  }
+
+  g_free(views);
+  mip = mip_unref(mip);
+
+  return;
+}
+
 /* perform the movie generation */
 static void movie_generate(ui_render_movie_t * ui_render_movie, gchar * output_filename) {
 
@@ -409,16 +613,12 @@ static void movie_generate(ui_render_movie_t * ui_render_movie, gchar * output_f
   AmitkAxis i_axis;
   gint return_val = TRUE;
   amide_time_t initial_start, initial_duration;
-  amide_time_t start_time, duration;
   ui_render_t * ui_render;
   AmitkDataSet * most_frames_ds=NULL;
   renderings_t * renderings;
-  guint ds_frame=0;
-  gdouble ds_frame_real;
   guint num_frames;
   gpointer mpeg_encode_context;
   gboolean continue_work=TRUE;
-  gint ds_gate;
   GdkPixbuf * pixbuf;
 
   /* gray out anything that could screw up the movie */
@@ -456,6 +656,10 @@ static void movie_generate(ui_render_movie_t * ui_render_movie, gchar * output_f
       (ui_render_movie->end_time-ui_render_movie->start_time) /((amide_time_t) num_frames);
   }
 
+  if (ui_render_movie->use_mip) {
+    movie_generate_mip(ui_render_movie, output_filename, num_frames, most_frames_ds);
+    goto finish;
+  }
   
   mpeg_encode_context = mpeg_encode_setup(output_filename, ENCODE_MPEG1,
 					  ui_render->pixbuf_width,
@@ -480,42 +684,7 @@ static void movie_generate(ui_render_movie_t * ui_render_movie, gchar * output_f
     }
 
     /* figure out the start interval for this frame */
-    switch (ui_render_movie->type) {
-    case OVER_TIME:
-      ui_render->start = ui_render_movie->start_time + i_frame*ui_render->duration;
-      break;
-    case OVER_FRAMES_SMOOTHED:
-    case OVER_FRAMES:
-      if (most_frames_ds) {
-	ds_frame_real = (i_frame/((gdouble) num_frames)) * AMITK_DATA_SET_NUM_FRAMES(most_frames_ds);
-	ds_frame = floor(ds_frame_real);
-	start_time = amitk_data_set_get_start_time(most_frames_ds, ds_frame);
-	duration = amitk_data_set_get_end_time(most_frames_ds, ds_frame) - start_time;
-	ui_render->start = start_time + EPSILON*fabs(start_time) + 
-	  ((ui_render_movie->type == OVER_FRAMES_SMOOTHED) ? ((ds_frame_real-ds_frame)*duration) : 0.0);
-	ui_render->duration = duration - EPSILON*fabs(duration);
-      } else { /* just have roi's.... doesn't make much sense if we get here */
-	ui_render->start = 0.0;
-	ui_render->duration = 1.0;
-      }
-      break;
-    case OVER_GATES:
-      renderings = ui_render->renderings;
-      while (renderings != NULL) {
-	if (AMITK_IS_DATA_SET(renderings->rendering->object)) {
-	  ds_gate = floor((i_frame/((gdouble) num_frames))*AMITK_DATA_SET_NUM_GATES(renderings->rendering->object));
-	  amitk_data_set_set_view_start_gate(AMITK_DATA_SET(renderings->rendering->object), ds_gate);
-	  amitk_data_set_set_view_end_gate(AMITK_DATA_SET(renderings->rendering->object), ds_gate);
-	}
-	renderings = renderings->next;
-      }
-      break;
-    default:
-      /* NOT_DYNAMIC */
-      break;
-    }
-
-
+    movie_set_frame_time(ui_render_movie, i_frame, num_frames, most_frames_ds);
  
     /* render the contexts */
     ui_render_update_immediate(ui_render);
@@ -543,7 +712,11 @@ static void movie_generate(ui_render_movie_t * ui_render_movie, gchar * output_f
     }
   }
 
-  mpeg_encode_close(mpeg_encode_context);
+  /* failures are only seen a few frames late, if at all before closing */
+  if (!mpeg_encode_close(mpeg_encode_context))
+    g_warning(_("Encoding of the movie failed"));
+
+ finish:
   amitk_progress_dialog_set_fraction(AMITK_PROGRESS_DIALOG(ui_render_movie->progress_dialog),2.0);
 
   /* and rerender one last time to back to the initial rotation and time */
@@ -575,6 +748,7 @@ gpointer * ui_render_movie_dialog_create(ui_render_t * ui_render) {
   GtkWidget * hbox;
   guint table_row = 0;
   AmitkAxis i_axis;
+  mip_type_t i_mip_type;
   renderings_t * renderings;
   AmitkDataSet * temp_ds;
   gboolean valid;
@@ -666,6 +840,23 @@ gpointer * ui_render_movie_dialog_create(ui_render_t * ui_render) {
                   1, table_row, 1, 1);
   table_row++;
 
+  /* volume rendering or an intensity projection */
+  label = gtk_label_new(_("Movie Type"));
+  gtk_grid_attach(GTK_GRID(packing_table), label, 0, table_row, 1, 1);
+  ui_render_movie->projection_menu = gtk_combo_box_text_new();
+  gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ui_render_movie->projection_menu), 
+				 _("Volume Rendering"));
+  for (i_mip_type=0; i_mip_type<NUM_MIP_TYPES; i_mip_type++) 
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ui_render_movie->projection_menu), 
+				   _(mip_type_name[i_mip_type]));
+  gtk_combo_box_set_active(GTK_COMBO_BOX(ui_render_movie->projection_menu), 0);
+  g_signal_connect(G_OBJECT(ui_render_movie->projection_menu), "changed", 
+		   G_CALLBACK(change_projection_cb), ui_render_movie);
+  gtk_grid_attach(GTK_GRID(packing_table),
+                  ui_render_movie->projection_menu,
+                  1, table_row, 1, 1);
+  table_row++;
+
   /* a separator for clarity */
   hseparator = gtk_separator_new(GTK_ORIENTATION_HORIZONTAL);
   gtk_grid_attach(GTK_GRID(packing_table), hseparator, 0, table_row, 3, 1);
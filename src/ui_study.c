@@ -391,6 +391,7 @@ static const GActionEntry normal_items[] = {
   { "distance", ui_study_cb_distance_selected },
   { "fads", ui_study_cb_fads_selected },
   { "filter", ui_study_cb_filter_selected },
+  { "parametric", ui_study_cb_parametric_selected },
   { "profile", ui_study_cb_profile_selected },
   { "math", ui_study_cb_data_set_math_selected },
   { "roi", ui_study_cb_roi_statistics },
@@ -859,6 +860,7 @@ ui_study_t * ui_study_init(AmitkPreferences * preferences) {
 
   ui_study->study_altered=FALSE;
   ui_study->study_virgin=TRUE;
+  ui_study->study_saving=FALSE;
   
   for (i_line=0 ;i_line < NUM_HELP_INFO_LINES;i_line++) {
     ui_study->help_line[i_line] = NULL;
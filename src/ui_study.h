@@ -98,6 +98,7 @@ typedef struct ui_study_t {
 
   gboolean study_altered;
   gboolean study_virgin;
+  gboolean study_saving; /* a background save is in progress */
 
   guint reference_count;
 } ui_study_t;
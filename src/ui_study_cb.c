@@ -50,6 +50,7 @@
 #include "tb_fads.h"
 #include "tb_filter.h"
 #include "tb_math.h"
+#include "tb_parametric.h"
 #include "tb_profile.h"
 #include "tb_roi_analysis.h"
 
@@ -314,12 +315,32 @@ static gchar * verify_save_name(GtkWindow * parent, const gchar * filename) {
 }
 
 
+/* called once a background save has finished */
+static void save_xif_done(AmitkStudy * study, const gchar * filename, gboolean saved, gpointer data) {
+
+  ui_study_t * ui_study = data;
+
+  if (!saved) {
+    g_warning(_("Failure Saving File: %s"),filename);
+    ui_study->study_altered=TRUE;
+  }
+  ui_study->study_saving=FALSE;
+  ui_study_update_title(ui_study);
+
+  return;
+}
+
 void save_xif(ui_study_t * ui_study, gboolean as_directory) {
   GtkWidget * file_chooser;
   gchar * initial_filename;
   gchar * final_filename;
   gchar * temp_str;
 
+  if (ui_study->study_saving) {
+    g_warning(_("The study is still being saved, please wait until the save completes"));
+    return;
+  }
+
   /* get the name of the file to save */
   file_chooser = gtk_file_chooser_dialog_new (_("Save AMIDE XIF File"),
 					      GTK_WINDOW(ui_study->window), /* parent window */
@@ -392,13 +413,28 @@ void save_xif(ui_study_t * ui_study, gboolean as_directory) {
   ui_common_place_cursor(UI_CURSOR_WAIT, ui_study->canvas[AMITK_VIEW_MODE_SINGLE][AMITK_VIEW_TRANSVERSE]);
 
   /* allright, save our study */
-  if (amitk_study_save_xml(ui_study->study, final_filename, as_directory) == FALSE) {
-    g_warning(_("Failure Saving File: %s"),final_filename);
-  } else {
+  if (!as_directory) {
+    /* flat files get written from a worker thread, so the study stays usable */
+    if (amitk_study_save_xml_in_background(ui_study->study, final_filename,
+					   amitk_progress_dialog_update, ui_study->progress_dialog,
+					   save_xif_done, ui_study)) {
+      /* changes made while saving will mark the study as altered again */
+      ui_study->study_saving=TRUE;
+      ui_study->study_altered=FALSE;
+      ui_study_update_title(ui_study);
+    } else {
+      g_warning(_("Failure Saving File: %s"),final_filename);
+    }
 
-    /* indicate no new changes */
-    ui_study->study_altered=FALSE;
-    ui_study_update_title(ui_study);
+  } else {
+    if (amitk_study_save_xml(ui_study->study, final_filename, as_directory) == FALSE) {
+      g_warning(_("Failure Saving File: %s"),final_filename);
+    } else {
+      
+      /* indicate no new changes */
+      ui_study->study_altered=FALSE;
+      ui_study_update_title(ui_study);
+    }
   }
 
   ui_common_remove_wait_cursor(ui_study->canvas[AMITK_VIEW_MODE_SINGLE][AMITK_VIEW_TRANSVERSE]);
@@ -1115,6 +1151,18 @@ void ui_study_cb_filter_selected(GSimpleAction * action, GVariant * param, gpoin
   return;
 }
 
+/* user wants to run the parametric image wizard */
+void ui_study_cb_parametric_selected(GSimpleAction * action, GVariant * param, gpointer data) {
+  ui_study_t * ui_study = data;
+
+  if (!AMITK_IS_DATA_SET(ui_study->active_object)) 
+    g_warning("%s",no_active_ds);
+  else 
+    tb_parametric(ui_study->study, AMITK_DATA_SET(ui_study->active_object), ui_study->window);
+
+  return;
+}
+
 /* user wants to run the profile wizard */
 void ui_study_cb_profile_selected(GSimpleAction * action, GVariant * param, gpointer data) {
   ui_study_t * ui_study = data;
@@ -1370,6 +1418,12 @@ gboolean ui_study_cb_delete_event(GtkWidget* widget, GdkEvent * event, gpointer
   GtkWidget * exit_dialog;
   gint return_val;
 
+  /* the background save still needs this window */
+  if (ui_study->study_saving) {
+    g_warning(_("The study is still being saved, please wait until the save completes"));
+    return TRUE;
+  }
+
   /* check to see if we need saving */
   if ((ui_study->study_altered == TRUE) && 
       (AMITK_PREFERENCES_PROMPT_FOR_SAVE_ON_EXIT(ui_study->preferences))) {
@@ -73,6 +73,7 @@ void ui_study_cb_crop_selected(GSimpleAction * action, GVariant * param, gpointe
 void ui_study_cb_distance_selected(GSimpleAction * action, GVariant * param, gpointer data);
 void ui_study_cb_fads_selected(GSimpleAction * action, GVariant * param, gpointer data);
 void ui_study_cb_filter_selected(GSimpleAction * action, GVariant * param, gpointer data);
+void ui_study_cb_parametric_selected(GSimpleAction * action, GVariant * param, gpointer data);
 void ui_study_cb_profile_selected(GSimpleAction * action, GVariant * param, gpointer data);
 void ui_study_cb_data_set_math_selected(GSimpleAction * action, GVariant * param, gpointer data);
 void ui_study_cb_canvas_target(GSimpleAction * action, GVariant * state, gpointer data);
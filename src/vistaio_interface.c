@@ -129,7 +129,7 @@ AmitkDataSet * do_vistaio_import(const gchar * filename,
   gboolean convert = FALSE; 
 
   gint format_size;
-  gint bytes_per_image;
+  gsize bytes_per_image;
   gint i, t;
   void *ds_pointer = NULL;
   IOUpdate update; 
@@ -284,7 +284,7 @@ AmitkDataSet * do_vistaio_import(const gchar * filename,
     g_warning(_("Couldn't allocate memory space for the data set structure to hold Vista data"));
     goto error;
   }
-  bytes_per_image = format_size * dim.x * dim.y * dim.z;
+  bytes_per_image = ((gsize) format_size) * ((gsize) dim.x) * ((gsize) dim.y) * ((gsize) dim.z);
 
   /* Just use the file name, we can figure out somethink more sophisticated later*/
   amitk_object_set_name(AMITK_OBJECT(ds),filename);
@@ -305,7 +305,7 @@ AmitkDataSet * do_vistaio_import(const gchar * filename,
   
   ds->scan_start = 0.0;
   
-  g_debug("Now copying data: %d bytes per %d image(s)", bytes_per_image, dim.t); 
+  g_debug("Now copying data: %" G_GSIZE_FORMAT " bytes per %d image(s)", bytes_per_image, dim.t); 
   /* now load the data */
   if (!convert) {
     ds_pointer = (char*)amitk_raw_data_get_pointer(AMITK_DATA_SET_RAW_DATA(ds), zero_voxel);
@@ -316,8 +316,8 @@ AmitkDataSet * do_vistaio_import(const gchar * filename,
     }
   } else {
     // conversion is always from double to float
-    int pixel_per_image = dim.x * dim.y * dim.z;
-    int p; 
+    gsize pixel_per_image = ((gsize) dim.x) * ((gsize) dim.y) * ((gsize) dim.z);
+    gsize p; 
     float * ds_float = (float*)amitk_raw_data_get_pointer(AMITK_DATA_SET_RAW_DATA(ds), zero_voxel);
     for (t = 0; t < dim.t; ++t) {
       double *in_ptr = (double* )VistaIOPixelPtr(images[t],0,0,0);
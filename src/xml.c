@@ -50,10 +50,12 @@ void xml_convert_radix_to_local(gchar * conv_str) {
   if (temp_float > 1.1) period=FALSE;
 
   if (period == FALSE) { /* using comma's */
-    while ((radix_ptr = strchr(conv_str, '.')) != NULL)
+    radix_ptr = conv_str;
+    while ((radix_ptr = strchr(radix_ptr, '.')) != NULL)
       *radix_ptr = ',';
   } else { /* using period */
-    while ((radix_ptr = strchr(conv_str, ',')) != NULL)
+    radix_ptr = conv_str;
+    while ((radix_ptr = strchr(radix_ptr, ',')) != NULL)
       *radix_ptr = '.';
   }
 
@@ -106,14 +108,13 @@ gboolean xml_node_exists(xmlNodePtr nodes, const gchar * descriptor) {
    matching the descriptor */
 xmlNodePtr xml_get_node(xmlNodePtr nodes, const gchar * descriptor) {
 
-  if (nodes == NULL)
-    return NULL;
-  else {
+  while (nodes != NULL) {
     if (xmlStrcmp(nodes->name, (const xmlChar *) descriptor) == 0)
       return nodes;
-    else
-      return xml_get_node(nodes->next, descriptor);
+    nodes = nodes->next;
   }
+
+  return NULL;
 }
 
 
@@ -181,50 +182,43 @@ amide_time_t xml_get_time(xmlNodePtr nodes, const gchar * descriptor, gchar ** p
 
 
 
+/* parsed in a single pass over the tab separated list, as data sets with
+   many frames or gates can have very long time lists */
 amide_time_t * xml_get_times(xmlNodePtr nodes, const gchar * descriptor, guint num_times, gchar ** perror_buf) {
 
   gchar * temp_str;
-  gchar ** string_chunks;
+  gchar * chunk;
+  gchar * end_ptr;
+  gchar * radix_ptr;
   amide_time_t * return_times=NULL;
-  gint error;
   guint i;
-  gchar * saved_locale;
   gboolean corrupted=FALSE;
   
-  saved_locale = g_strdup(setlocale(LC_NUMERIC,NULL));
-  setlocale(LC_NUMERIC,"POSIX");
-
   temp_str = xml_get_string(nodes, descriptor);
 
   if ((return_times = g_try_new(amide_time_t,num_times)) == NULL) {
     amitk_append_str_with_newline(perror_buf, _("Couldn't allocate memory space for time data"));
+    g_free(temp_str);
     return return_times;
   }
 
   if (temp_str != NULL) {
-    /* split-up the string so we can process it */
-    string_chunks = g_strsplit(temp_str, "\t", num_times);
-    g_free(temp_str);
-    
+    /* g_ascii_strtod is locale independent, so just make sure the radix is a period */
+    radix_ptr = temp_str;
+    while ((radix_ptr = strchr(radix_ptr, ',')) != NULL)
+      *radix_ptr = '.';
+
+    chunk = temp_str;
     for (i=0; (i<num_times) && (!corrupted);i++) {
 
-      if (string_chunks[i] == NULL) 
-	  corrupted = TRUE;
+      if (chunk == NULL) 
+	corrupted = TRUE;
       else {
-
-	xml_convert_radix_to_local(string_chunks[i]);
-
-#if (SIZE_OF_AMIDE_TIME_T == 8)
-	/* convert to doubles */
-	error = sscanf(string_chunks[i], "%lf", &(return_times[i]));
-#elif (SIZE_OF_AMIDE_TIME_T == 4)
-	/* convert to float */
-	error = sscanf(string_chunks[i], "%f", &(return_times[i]));
-#else
-#error "Unknown size for SIZE_OF_AMIDE_TIME_T"
-#endif
-
-	if ((error == EOF)) corrupted = TRUE;
+	return_times[i] = g_ascii_strtod(chunk, &end_ptr);
+	if (end_ptr == chunk) 
+	  corrupted = TRUE;
+	else if ((chunk = strchr(end_ptr, '\t')) != NULL)
+	  chunk++;
       }
     }
 
@@ -233,16 +227,12 @@ amide_time_t * xml_get_times(xmlNodePtr nodes, const gchar * descriptor, guint n
       amitk_append_str_with_newline(perror_buf, _("XIF File appears corrupted, setting frame/gate time to 1"));
     }
 
-    g_strfreev(string_chunks);
-  }
-
-  if (temp_str == NULL) {
+    g_free(temp_str);
+  } else {
     amitk_append_str_with_newline(perror_buf,_("Couldn't read value for %s, substituting 1"),descriptor);
     for (i=0; i<num_times; i++) return_times[i]=1.0;
   }
 
-  setlocale(LC_NUMERIC, saved_locale);
-  g_free(saved_locale);
   return return_times;
 }
 